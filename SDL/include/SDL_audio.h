@@ -103,8 +103,11 @@ typedef struct SDL_AudioSpec {
 #define AUDIO_S16LSB	0x8010	/**< Signed 16-bit samples */
 #define AUDIO_U16MSB	0x1010	/**< As above, but big-endian byte order */
 #define AUDIO_S16MSB	0x9010	/**< As above, but big-endian byte order */
+#define AUDIO_F32LSB	0x8120	/**< 32-bit floating point samples */
+#define AUDIO_F32MSB	0x9120	/**< As above, but big-endian byte order */
 #define AUDIO_U16	AUDIO_U16LSB
 #define AUDIO_S16	AUDIO_S16LSB
+#define AUDIO_F32	AUDIO_F32LSB
 
 /**
  *  @name Native audio byte ordering
@@ -113,15 +116,20 @@ typedef struct SDL_AudioSpec {
 #if SDL_BYTEORDER == SDL_LIL_ENDIAN
 #define AUDIO_U16SYS	AUDIO_U16LSB
 #define AUDIO_S16SYS	AUDIO_S16LSB
+#define AUDIO_F32SYS	AUDIO_F32LSB
 #else
 #define AUDIO_U16SYS	AUDIO_U16MSB
 #define AUDIO_S16SYS	AUDIO_S16MSB
+#define AUDIO_F32SYS	AUDIO_F32MSB
 #endif
 /*@}*/
 
 /*@}*/
 
 
+/** Input frames per channel that rate conversion carries between buffers */
+#define SDL_AUDIOCVT_HISTORY	128
+
 /** A structure to hold a set of audio conversion filters and buffers */
 typedef struct SDL_AudioCVT {
 	int needed;			/**< Set to 1 if conversion possible */
@@ -135,8 +143,23 @@ typedef struct SDL_AudioCVT {
 	double len_ratio; 	/**< Given len, final size is len*len_ratio */
 	void (SDLCALL *filters[10])(struct SDL_AudioCVT *cvt, Uint16 format);
 	int filter_index;		/**< Current audio conversion function */
+	int rate_quality;		/**< One of SDL_AUDIO_RESAMPLE_* */
+	int rate_pos;			/**< Next output position, in input frames */
+	Uint32 rate_frac;		/**< Fractional part of rate_pos */
+	float rate_history[6*SDL_AUDIOCVT_HISTORY]; /**< Last input frames */
 } SDL_AudioCVT;
 
+/**
+ * @name Rate conversion quality
+ * SDL_BuildAudioCVT() picks SDL_AUDIO_RESAMPLE_SINC; set cvt->rate_quality
+ * afterwards to trade quality for speed.
+ */
+/*@{*/
+#define SDL_AUDIO_RESAMPLE_LINEAR	0	/**< Linear interpolation */
+#define SDL_AUDIO_RESAMPLE_CUBIC	1	/**< Catmull-Rom spline */
+#define SDL_AUDIO_RESAMPLE_SINC	2	/**< Bandlimited windowed sinc */
+/*@}*/
+
 
 /* Function prototypes */
 
@@ -243,6 +266,8 @@ extern DECLSPEC int SDLCALL SDL_BuildAudioCVT(SDL_AudioCVT *cvt,
  * The data conversion may expand the size of the audio data, so the buffer
  * cvt->buf should be allocated after the cvt structure is initialized by
  * SDL_BuildAudioCVT(), and should be cvt->len*cvt->len_mult bytes long.
+ * Rate conversion carries on from one call to the next, so a stream can be
+ * converted a buffer at a time; build the structure again to start afresh.
  */
 extern DECLSPEC int SDLCALL SDL_ConvertAudio(SDL_AudioCVT *cvt);
 
@@ -124,6 +124,8 @@ typedef unsigned int uintptr_t;
 
 /* Enable various audio drivers */
 #define SDL_AUDIO_DRIVER_DSOUND	1
+#define SDL_AUDIO_DRIVER_DISK	1
+#define SDL_AUDIO_DRIVER_DUMMY	1
 
 /* Enable various cdrom drivers */
 #ifdef _WIN32_WCE
@@ -159,6 +161,7 @@ typedef unsigned int uintptr_t;
 #ifndef _WIN32_WCE
 #define SDL_VIDEO_DRIVER_DDRAW	1
 #endif
+#define SDL_VIDEO_DRIVER_OFFSCREEN	1
 
 /* Disable screensaver */
 #define SDL_VIDEO_DISABLE_SCREENSAVER	1
@@ -126,10 +126,18 @@ typedef enum {
 	MUS_MODPLUG
 } Mix_MusicType;
 
+typedef enum {
+	MIX_MIXING_CLIPPED,
+	MIX_MIXING_ACCUMULATED
+} Mix_MixingMode;
+
 /* The internal format for a music chunk interpreted via mikmod */
 typedef struct _Mix_Music Mix_Music;
 
-/* Open the mixer with a certain audio format */
+/* Open the mixer with a certain audio format.  With AUDIO_F32SYS the
+   channels, music and effects are mixed as floats, unclipped, and SDL
+   converts the result to what the audio device takes just once.
+ */
 extern DECLSPEC int SDLCALL Mix_OpenAudio(int frequency, Uint16 format, int channels,
 							int chunksize);
 
@@ -140,6 +148,28 @@ extern DECLSPEC int SDLCALL Mix_OpenAudio(int frequency, Uint16 format, int chan
  */
 extern DECLSPEC int SDLCALL Mix_AllocateChannels(int numchans);
 
+/* Choose how the playing channels are mixed together.
+   MIX_MIXING_CLIPPED (the default) adds each channel to the stream in
+   turn, clipping after every one.  MIX_MIXING_ACCUMULATED sums all the
+   channels, after their volume and effects, into 32 bits and clips once
+   at the end.  Only 8-bit and signed 16-bit audio can be accumulated,
+   other formats are always clipped per channel, except float, which is
+   never clipped in the mixer at all.  Built-in posteffects
+   such as Mix_SetLimiter() work on the sums before they are clipped,
+   unless another kind of posteffect was registered ahead of them.
+   This function returns the previous mixing mode.
+ */
+extern DECLSPEC Mix_MixingMode SDLCALL Mix_SetMixingMode(Mix_MixingMode mode);
+
+/* Choose the rate conversion quality used for sounds and music whose
+   frequency differs from the audio device's: SDL_AUDIO_RESAMPLE_LINEAR,
+   SDL_AUDIO_RESAMPLE_CUBIC or SDL_AUDIO_RESAMPLE_SINC (the default).
+   It applies to sounds loaded and music started after the call, so set
+   it right after Mix_OpenAudio().  If 'quality' is -1, it isn't changed.
+   This function returns the previous quality.
+ */
+extern DECLSPEC int SDLCALL Mix_SetResampleQuality(int quality);
+
 /* Find out what the actual audio device parameters are.
    This function returns 1 if the audio has been opened, 0 otherwise.
  */
@@ -157,6 +187,15 @@ extern DECLSPEC Mix_Music * SDLCALL Mix_LoadMUS_RW(SDL_RWops *rw);
 /* Load a music file from an SDL_RWop object assuming a specific format */
 extern DECLSPEC Mix_Music * SDLCALL Mix_LoadMUSType_RW(SDL_RWops *rw, Mix_MusicType type, int freesrc);
 
+/* Open a sound file to be decoded from 'src' as it plays, a buffer at a
+   time, instead of loaded whole.  The file types are those that can be
+   played on a music layer (WAV, OGG, FLAC, MP3 and modplug), and 'src'
+   is kept open until the chunk is freed.  A streamed chunk can only play
+   on one channel at a time.
+ */
+extern DECLSPEC Mix_Chunk * SDLCALL Mix_StreamWAV_RW(SDL_RWops *src, int freesrc);
+#define Mix_StreamWAV(file)	Mix_StreamWAV_RW(SDL_RWFromFile(file, "rb"), 1)
+
 /* Load a wave file of the mixer format from a memory buffer */
 extern DECLSPEC Mix_Chunk * SDLCALL Mix_QuickLoad_WAV(Uint8 *mem);
 
@@ -448,29 +487,80 @@ extern DECLSPEC int SDLCALL Mix_SetPosition(int channel, Sint16 angle, Uint8 dis
 extern DECLSPEC int SDLCALL Mix_SetDistance(int channel, Uint8 distance);
 
 
-/*
- * !!! FIXME : Haven't implemented, since the effect goes past the
- *              end of the sound buffer. Will have to think about this.
- *               --ryan.
+/* Causes a reverb to be mixed into a sound. (room) sets the size of the
+ *  room and how long the reverb rings, from a small room at 0 (about 0.2
+ *  seconds) to a hall at 255 (about 4 seconds). (damping) is how much
+ *  faster high frequencies die away, 0 for not at all. (wet) is the level
+ *  of reverb added to the sound, 255 being as loud as the sound itself.
+ *
+ * The reverb can only be heard while the channel plays, so its tail is
+ *  cut off when the sound ends. Setting (channel) to MIX_CHANNEL_POST
+ *  registers this as a posteffect, and the reverbing will be done to the
+ *  final mixed stream before passing it on to the audio device, with full
+ *  tails. Only signed 16-bit and float native output are supported.
+ *
+ * This uses the Mix_RegisterEffect() API internally. If you specify a wet
+ *  level of zero, the effect is unregistered, as the data is already in
+ *  that state.
+ *
+ * returns zero if error (no such channel, unsupported format, or
+ *  Mix_RegisterEffect() fails), nonzero if reverb effect is enabled.
+ *  Error messages can be retrieved from Mix_GetError().
  */
-#if 0
-/* Causes an echo effect to be mixed into a sound. (echo) is the amount
- *  of echo to mix. 0 is no echo, 255 is infinite (and probably not
- *  what you want).
+extern DECLSPEC int SDLCALL Mix_SetReverb(int channel, Uint8 room, Uint8 damping, Uint8 wet);
+
+/* Filter shapes for Mix_SetFilter() */
+typedef enum {
+	MIX_FILTER_NONE,
+	MIX_FILTER_LOWPASS,
+	MIX_FILTER_HIGHPASS,
+	MIX_FILTER_BANDPASS,
+	MIX_FILTER_NOTCH,
+	MIX_FILTER_PEAKING,
+	MIX_FILTER_LOWSHELF,
+	MIX_FILTER_HIGHSHELF
+} Mix_FilterType;
+
+#define MIX_FILTER_BANDS	4
+
+/* Set one band of a channel's filter, which has MIX_FILTER_BANDS bands
+ *  run one after the other, to make an equalizer for example. Each band is
+ *  a biquad of the given (type) at (frequency) in Hz, with the quality
+ *  (q), 0.7071 for the flattest response if you aren't sure. (gain) in
+ *  decibels is used by the peaking and shelving types.
  *
- * Setting (channel) to MIX_CHANNEL_POST registers this as a posteffect, and
- *  the reverbing will be done to the final mixed stream before passing it on
- *  to the audio device.
+ * Setting a band's (type) to MIX_FILTER_NONE switches it off; the effect
+ *  is unregistered when all the bands are off. Setting (channel) to
+ *  MIX_CHANNEL_POST filters the final mixed stream. Only signed 16-bit
+ *  and float native output are supported.
  *
- * This uses the Mix_RegisterEffect() API internally. If you specify an echo
- *  of zero, the effect is unregistered, as the data is already in that state.
+ * This uses the Mix_RegisterEffect() API internally.
  *
- * returns zero if error (no such channel or Mix_RegisterEffect() fails),
- *  nonzero if reversing effect is enabled.
+ * returns zero if error (no such channel or band, unsupported format, or
+ *  Mix_RegisterEffect() fails), nonzero if the band is set.
  *  Error messages can be retrieved from Mix_GetError().
  */
-extern no_parse_DECLSPEC int SDLCALL Mix_SetReverb(int channel, Uint8 echo);
-#endif
+extern DECLSPEC int SDLCALL Mix_SetFilter(int channel, int band, Mix_FilterType type, int frequency, float q, float gain);
+
+/* Keep a channel's peaks under (ceiling), in decibels below full scale.
+ *  The sound is delayed by (lookahead) milliseconds so the gain can come
+ *  down smoothly before each peak, and comes back up over about (release)
+ *  milliseconds. A few milliseconds of look-ahead is usually enough.
+ *
+ * This is most useful with MIX_CHANNEL_POST, as a posteffect on the final
+ *  mixed stream. When Mix_SetMixingMode() is MIX_MIXING_ACCUMULATED, it
+ *  then works on the 32-bit sums of the channels, so peaks that would
+ *  have clipped are brought down instead. Only signed 16-bit and float
+ *  native output are supported.
+ *
+ * This uses the Mix_RegisterEffect() API internally. A negative
+ *  (lookahead) unregisters the effect.
+ *
+ * returns zero if error (no such channel, unsupported format, or
+ *  Mix_RegisterEffect() fails), nonzero if the limiter is enabled.
+ *  Error messages can be retrieved from Mix_GetError().
+ */
+extern DECLSPEC int SDLCALL Mix_SetLimiter(int channel, float ceiling, int lookahead, int release);
 
 /* Causes a channel to reverse its stereo. This is handy if the user has his
  *  speakers hooked up backwards, or you would like to have a minor bit of
@@ -494,6 +584,64 @@ extern no_parse_DECLSPEC int SDLCALL Mix_SetReverb(int channel, Uint8 echo);
  */
 extern DECLSPEC int SDLCALL Mix_SetReverseStereo(int channel, int flip);
 
+/* Place a channel around a listener wearing headphones. The channel is
+ *  folded down to mono and convolved with the head-related impulse
+ *  responses (HRIRs) nearest its direction, which gives cues for
+ *  elevation and for front versus back that plain panning lacks.
+ *
+ * (azimuth) is in degrees clockwise from straight ahead, as the angle of
+ *  Mix_SetPosition(); (elevation) is in degrees from -90 (below) to 90
+ *  (above); and (distance) is from 0 (overlapping the listener) to 255,
+ *  as for Mix_SetDistance(). Setting all three to 0 unregisters the
+ *  effect. Changes are crossfaded over the next buffer mixed.
+ *
+ * Until a set is loaded with Mix_LoadHRTF(), responses come from a
+ *  spherical head model, which has the delay and shadow of the head but
+ *  only a rough front/back cue and no real elevation cues.
+ *
+ * Only the nearest voices are convolved, up to the budget set with
+ *  Mix_SetBinauralBudget(); the others are panned by the loudness of
+ *  their responses at each ear, costing about as much as Mix_SetPanning().
+ *
+ * This needs signed 16-bit or float stereo output. If the audio device has another number
+ *  of channels, this calls Mix_SetPosition() instead. Positioning the
+ *  final mixed stream with MIX_CHANNEL_POST is not supported.
+ *
+ * This uses the Mix_RegisterEffect() API internally.
+ *
+ * returns zero if error (no such channel, unsupported format, or
+ *  Mix_RegisterEffect() fails), nonzero if the effect is enabled.
+ *  Error messages can be retrieved from Mix_GetError().
+ */
+extern DECLSPEC int SDLCALL Mix_SetBinaural(int channel, Sint16 azimuth, Sint16 elevation, Uint8 distance);
+
+/* Set how many channels Mix_SetBinaural() convolves at once, nearest first.
+ *  The rest are panned until a nearer voice stops or they come closer.
+ *  The default is 32. If (voices) is negative, the budget isn't changed.
+ *
+ * returns the previous budget.
+ */
+extern DECLSPEC int SDLCALL Mix_SetBinauralBudget(int voices);
+
+/* Load a set of head-related impulse responses for Mix_SetBinaural(),
+ *  replacing the current set; channels already positioned switch to it.
+ *  The audio device must be open, since the responses are resampled to its
+ *  rate, and the set is freed by Mix_CloseAudio(). Responses longer than
+ *  256 frames at the output rate are truncated.
+ *
+ * The file starts with the four bytes "HRIR", the sample rate as 32 bits,
+ *  then the number of taps per response and the number of directions as
+ *  16 bits each. For each direction follow its azimuth and elevation in
+ *  degrees, then the left and right ear responses, each tap a signed
+ *  16-bit sample where 32767 is a gain of one. Everything is little endian.
+ *
+ * returns zero if error (audio not open, bad file, or out of memory),
+ *  nonzero if the set was loaded.
+ *  Error messages can be retrieved from Mix_GetError().
+ */
+extern DECLSPEC int SDLCALL Mix_LoadHRTF_RW(SDL_RWops *src, int freesrc);
+#define Mix_LoadHRTF(file)	Mix_LoadHRTF_RW(SDL_RWFromFile(file, "rb"), 1)
+
 /* end of effects API. --ryan. */
 
 
@@ -528,7 +676,8 @@ extern DECLSPEC int SDLCALL Mix_GroupOldest(int tag);
 extern DECLSPEC int SDLCALL Mix_GroupNewer(int tag);
 
 /* Play an audio chunk on a specific channel.
-   If the specified channel is -1, play on the first free channel.
+   If the specified channel is -1, play on the free channel
+   that was stopped most recently.
    If 'loops' is greater than zero, loop the sound that many times.
    If 'loops' is -1, loop inifinitely (~65000 times).
    Returns which channel was used to play the sound.
@@ -601,6 +750,99 @@ extern DECLSPEC int SDLCALL Mix_SetMusicPosition(double position);
 extern DECLSPEC int SDLCALL Mix_Playing(int channel);
 extern DECLSPEC int SDLCALL Mix_PlayingMusic(void);
 
+/* Queue the channel and effect calls made outside the audio callback,
+   instead of taking the audio lock, if 'on' is 1.  They're run at the
+   start of the next buffer, so Mix_Playing() and the like don't see them
+   until then.  Mix_PlayChannel() on channel -1 still returns the channel
+   it will use.  Calls that fail once queued fail silently, and calls that
+   return a count return 1.  Mix_AllocateChannels(), Mix_FreeChunk() and
+   Mix_CloseAudio() wait for the queued calls to be run.
+   If 'on' is -1, queueing isn't changed.
+   This function returns the previous setting, or -1 on error.
+ */
+extern DECLSPEC int SDLCALL Mix_QueueCommands(int on);
+
+/* Get the number of sample frames mixed since the audio was opened, as a
+   clock for the calls below.  It wraps after 2^32 frames.
+ */
+extern DECLSPEC Uint32 SDLCALL Mix_GetSampleClock(void);
+
+/* Start, halt or fade out a channel when the mix clock reaches 'when',
+   to the sample frame.  These are always queued.  A time that has
+   already passed runs at the start of the next buffer.
+ */
+#define Mix_PlayChannelAt(channel,chunk,loops,when) Mix_FadeInChannelAt(channel,chunk,loops,0,-1,when)
+extern DECLSPEC int SDLCALL Mix_FadeInChannelAt(int channel, Mix_Chunk *chunk, int loops, int ms, int ticks, Uint32 when);
+extern DECLSPEC int SDLCALL Mix_HaltChannelAt(int channel, Uint32 when);
+extern DECLSPEC int SDLCALL Mix_FadeOutChannelAt(int which, int ms, Uint32 when);
+
+/* Decode music up to 'ms' milliseconds ahead on a separate thread, so the
+   audio callback only has to copy it out.  Slow decoding then doesn't
+   cause dropouts, and the music functions don't hold up the callback.
+   Volume changes and fades are heard after the lookahead has played.
+   0 (the default) decodes the music in the audio callback.  If 'ms' is
+   -1, it isn't changed.
+   This function returns the previous lookahead.
+ */
+extern DECLSPEC int SDLCALL Mix_SetMusicLookahead(int ms);
+
+/* Get the number of bytes of music decoded ahead, the size of the
+   lookahead buffer, and the number of times the audio callback found it
+   empty while music was playing.  All are 0 if there's no lookahead.
+ */
+extern DECLSPEC void SDLCALL Mix_GetMusicLookaheadStats(int *queued, int *size, int *underruns);
+
+/* Music layers are extra music streams played along with the music, each
+   with its own volume, fade and position, for crossfading or layering
+   tracks without loading them whole.  WAV, OGG, FLAC, MP3 and modplug
+   music can be played on a layer.  Layers are mixed in with the music:
+   they pause with Mix_PauseMusic(), are replaced by Mix_HookMusic(), and
+   changes to them are heard after the music lookahead.
+ */
+
+/* Set the number of music layers, halting any layers removed.  There are
+   none until this is called.  If 'numlayers' is -1 it isn't changed.
+   This function returns the number of layers allocated.
+ */
+extern DECLSPEC int SDLCALL Mix_AllocateMusicLayers(int numlayers);
+
+/* Play music on a layer, or on the first free layer if 'layer' is -1,
+   fading in over 'ms' milliseconds from 'position'.  'loops' is as for
+   Mix_PlayMusic().  The music can't already be playing elsewhere.
+   This function returns the layer used, or -1 if there was an error.
+ */
+extern DECLSPEC int SDLCALL Mix_FadeInMusicLayerPos(int layer, Mix_Music *music, int loops, int ms, double position);
+#define Mix_FadeInMusicLayer(layer,music,loops,ms) Mix_FadeInMusicLayerPos(layer,music,loops,ms,0.0)
+#define Mix_PlayMusicLayer(layer,music,loops) Mix_FadeInMusicLayerPos(layer,music,loops,0,0.0)
+
+/* Set the volume of a layer, or of all layers if 'layer' is -1.  If
+   'volume' is -1 it isn't changed.  This function returns the previous
+   volume, or the average volume of all layers if 'layer' is -1.
+ */
+extern DECLSPEC int SDLCALL Mix_VolumeMusicLayer(int layer, int volume);
+
+/* Halt a layer, or all layers if 'layer' is -1, at once or over 'ms'
+   milliseconds.  Mix_FadeOutMusicLayer() returns the number of layers
+   set to fade out.
+ */
+extern DECLSPEC int SDLCALL Mix_HaltMusicLayer(int layer);
+extern DECLSPEC int SDLCALL Mix_FadeOutMusicLayer(int layer, int ms);
+
+/* Set the position of a playing layer, as for Mix_SetMusicPosition() */
+extern DECLSPEC int SDLCALL Mix_SetMusicLayerPosition(int layer, double position);
+
+/* Check the status of a layer, or the number of layers playing if
+   'layer' is -1.
+ */
+extern DECLSPEC int SDLCALL Mix_PlayingMusicLayer(int layer);
+extern DECLSPEC Mix_Fading SDLCALL Mix_FadingMusicLayer(int layer);
+
+/* Add your own callback when a layer has finished playing.
+   This callback is only called if the layer finishes naturally or fades
+   out, and it may not call SDL_LockAudio().
+ */
+extern DECLSPEC void SDLCALL Mix_HookMusicLayerFinished(void (*layer_finished)(int layer));
+
 /* Stop music and set external music playback command */
 extern DECLSPEC int SDLCALL Mix_SetMusicCMD(const char *command);
 
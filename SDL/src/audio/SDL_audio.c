@@ -179,35 +179,53 @@ int SDLCALL SDL_RunAudio(void *audiop)
 
 		/* Fill the current buffer with sound */
 		if ( audio->convert.needed ) {
-			if ( audio->convert.buf ) {
-				stream = audio->convert.buf;
-			} else {
+			if ( audio->convert.buf == NULL ) {
 				continue;
 			}
-		} else {
+
+			/* Rate conversion may come out a frame long or short,
+			   so convert until there's a buffer's worth and keep
+			   the rest for the next one. */
+			while ( audio->convert_fifo_len < audio->spec.size ) {
+				stream = audio->convert.buf;
+				SDL_memset(stream, silence, stream_len);
+
+				if ( ! audio->paused ) {
+					SDL_mutexP(audio->mixer_lock);
+					(*fill)(udata, stream, stream_len);
+					SDL_mutexV(audio->mixer_lock);
+				}
+
+				SDL_ConvertAudio(&audio->convert);
+				SDL_memcpy(audio->convert_fifo +
+				           audio->convert_fifo_len,
+				           audio->convert.buf,
+				           audio->convert.len_cvt);
+				audio->convert_fifo_len += audio->convert.len_cvt;
+			}
+
 			stream = audio->GetAudioBuf(audio);
 			if ( stream == NULL ) {
 				stream = audio->fake_stream;
 			}
-		}
-
-		SDL_memset(stream, silence, stream_len);
-
-		if ( ! audio->paused ) {
-			SDL_mutexP(audio->mixer_lock);
-			(*fill)(udata, stream, stream_len);
-			SDL_mutexV(audio->mixer_lock);
-		}
-
-		/* Convert the audio if necessary */
-		if ( audio->convert.needed ) {
-			SDL_ConvertAudio(&audio->convert);
+			SDL_memcpy(stream, audio->convert_fifo, audio->spec.size);
+			audio->convert_fifo_len -= audio->spec.size;
+			SDL_memmove(audio->convert_fifo,
+			            audio->convert_fifo + audio->spec.size,
+			            audio->convert_fifo_len);
+		} else {
 			stream = audio->GetAudioBuf(audio);
 			if ( stream == NULL ) {
 				stream = audio->fake_stream;
 			}
-			SDL_memcpy(stream, audio->convert.buf,
-			               audio->convert.len_cvt);
+
+			SDL_memset(stream, silence, stream_len);
+
+			if ( ! audio->paused ) {
+				SDL_mutexP(audio->mixer_lock);
+				(*fill)(udata, stream, stream_len);
+				SDL_mutexV(audio->mixer_lock);
+			}
 		}
 
 		/* Ready current buffer for play and change current buffer */
@@ -265,17 +283,26 @@ static Uint16 SDL_ParseAudioFormat(const char *string)
 		++string;
 		format |= 0x8000;
 		break;
+	    case 'F':
+		++string;
+		format |= 0x8100;
+		break;
 	    default:
 		return 0;
 	}
+	/* Float is 32 bits only, integers are never 32 bits */
+	if ( (SDL_atoi(string) == 32) != ((format & 0x0100) != 0) ) {
+		return 0;
+	}
 	switch (SDL_atoi(string)) {
 	    case 8:
 		string += 1;
 		format |= 8;
 		break;
 	    case 16:
+	    case 32:
+		format |= SDL_atoi(string);
 		string += 2;
-		format |= 16;
 		if ( SDL_strcmp(string, "LSB") == 0
 #if SDL_BYTEORDER == SDL_LIL_ENDIAN
 		     || SDL_strcmp(string, "SYS") == 0
@@ -532,8 +559,13 @@ int SDL_OpenAudio(SDL_AudioSpec *desired, SDL_AudioSpec *obtained)
 			return(-1);
 		}
 		if ( audio->convert.needed ) {
+			/* Whole source frames, enough to fill the device buffer */
+			int frame = ((desired->format & 0xFF) / 8) *
+			            desired->channels;
 			audio->convert.len = (int) ( ((double) audio->spec.size) /
                                           audio->convert.len_ratio );
+			audio->convert.len = ((audio->convert.len + frame - 1) /
+			                      frame) * frame;
 			audio->convert.buf =(Uint8 *)SDL_AllocAudioMem(
 			   audio->convert.len*audio->convert.len_mult);
 			if ( audio->convert.buf == NULL ) {
@@ -541,6 +573,16 @@ int SDL_OpenAudio(SDL_AudioSpec *desired, SDL_AudioSpec *obtained)
 				SDL_OutOfMemory();
 				return(-1);
 			}
+			/* Room for what's left of one conversion and the next */
+			audio->convert_fifo = (Uint8 *)SDL_malloc(
+			   audio->spec.size +
+			   audio->convert.len*audio->convert.len_mult);
+			audio->convert_fifo_len = 0;
+			if ( audio->convert_fifo == NULL ) {
+				SDL_CloseAudio();
+				SDL_OutOfMemory();
+				return(-1);
+			}
 		}
 	}
 
@@ -636,7 +678,7 @@ void SDL_AudioQuit(void)
 		}
 		if ( audio->convert.needed ) {
 			SDL_FreeAudioMem(audio->convert.buf);
-
+			SDL_free(audio->convert_fifo);
 		}
 		if ( audio->opened ) {
 			audio->CloseAudio(audio);
@@ -648,16 +690,26 @@ void SDL_AudioQuit(void)
 	}
 }
 
-#define NUM_FORMATS	6
+#define NUM_FORMATS	8
 static int format_idx;
 static int format_idx_sub;
 static Uint16 format_list[NUM_FORMATS][NUM_FORMATS] = {
- { AUDIO_U8, AUDIO_S8, AUDIO_S16LSB, AUDIO_S16MSB, AUDIO_U16LSB, AUDIO_U16MSB },
- { AUDIO_S8, AUDIO_U8, AUDIO_S16LSB, AUDIO_S16MSB, AUDIO_U16LSB, AUDIO_U16MSB },
- { AUDIO_S16LSB, AUDIO_S16MSB, AUDIO_U16LSB, AUDIO_U16MSB, AUDIO_U8, AUDIO_S8 },
- { AUDIO_S16MSB, AUDIO_S16LSB, AUDIO_U16MSB, AUDIO_U16LSB, AUDIO_U8, AUDIO_S8 },
- { AUDIO_U16LSB, AUDIO_U16MSB, AUDIO_S16LSB, AUDIO_S16MSB, AUDIO_U8, AUDIO_S8 },
- { AUDIO_U16MSB, AUDIO_U16LSB, AUDIO_S16MSB, AUDIO_S16LSB, AUDIO_U8, AUDIO_S8 },
+ { AUDIO_U8, AUDIO_S8, AUDIO_S16LSB, AUDIO_S16MSB, AUDIO_U16LSB, AUDIO_U16MSB,
+   AUDIO_F32LSB, AUDIO_F32MSB },
+ { AUDIO_S8, AUDIO_U8, AUDIO_S16LSB, AUDIO_S16MSB, AUDIO_U16LSB, AUDIO_U16MSB,
+   AUDIO_F32LSB, AUDIO_F32MSB },
+ { AUDIO_S16LSB, AUDIO_S16MSB, AUDIO_U16LSB, AUDIO_U16MSB, AUDIO_F32LSB,
+   AUDIO_F32MSB, AUDIO_U8, AUDIO_S8 },
+ { AUDIO_S16MSB, AUDIO_S16LSB, AUDIO_U16MSB, AUDIO_U16LSB, AUDIO_F32MSB,
+   AUDIO_F32LSB, AUDIO_U8, AUDIO_S8 },
+ { AUDIO_U16LSB, AUDIO_U16MSB, AUDIO_S16LSB, AUDIO_S16MSB, AUDIO_F32LSB,
+   AUDIO_F32MSB, AUDIO_U8, AUDIO_S8 },
+ { AUDIO_U16MSB, AUDIO_U16LSB, AUDIO_S16MSB, AUDIO_S16LSB, AUDIO_F32MSB,
+   AUDIO_F32LSB, AUDIO_U8, AUDIO_S8 },
+ { AUDIO_F32LSB, AUDIO_F32MSB, AUDIO_S16LSB, AUDIO_S16MSB, AUDIO_U16LSB,
+   AUDIO_U16MSB, AUDIO_U8, AUDIO_S8 },
+ { AUDIO_F32MSB, AUDIO_F32LSB, AUDIO_S16MSB, AUDIO_S16LSB, AUDIO_U16MSB,
+   AUDIO_U16LSB, AUDIO_U8, AUDIO_S8 },
 };
 
 Uint16 SDL_FirstAudioFormat(Uint16 format)
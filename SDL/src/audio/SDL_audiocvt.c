@@ -24,6 +24,15 @@
 /* Functions for audio drivers to perform runtime conversion of audio format */
 
 #include "SDL_audio.h"
+#include "SDL_cpuinfo.h"
+#include "SDL_mixer_SSE2.h"
+
+#ifdef HAVE_MATH_H
+#include <math.h>
+#endif
+#if SDL_SSE2_MIXERS
+#include <emmintrin.h>
+#endif
 
 
 /* Effectively mix right and left channels into a single channel */
@@ -37,6 +46,19 @@ void SDLCALL SDL_ConvertMono(SDL_AudioCVT *cvt, Uint16 format)
 #endif
 	switch (format&0x8018) {
 
+		case (AUDIO_F32SYS&0x8018): {
+			float *src, *dst;
+
+			src = (float *)cvt->buf;
+			dst = (float *)cvt->buf;
+			for ( i=cvt->len_cvt/8; i; --i ) {
+				*dst = (src[0] + src[1]) * 0.5f;
+				src += 2;
+				dst += 1;
+			}
+		}
+		break;
+
 		case AUDIO_U8: {
 			Uint8 *src, *dst;
 
@@ -144,6 +166,20 @@ void SDLCALL SDL_ConvertStrip(SDL_AudioCVT *cvt, Uint16 format)
 #endif
 	switch (format&0x8018) {
 
+		case (AUDIO_F32SYS&0x8018): {
+			float *src, *dst;
+
+			src = (float *)cvt->buf;
+			dst = (float *)cvt->buf;
+			for ( i=cvt->len_cvt/24; i; --i ) {
+				dst[0] = src[0];
+				dst[1] = src[1];
+				src += 6;
+				dst += 2;
+			}
+		}
+		break;
+
 		case AUDIO_U8: {
 			Uint8 *src, *dst;
 
@@ -260,6 +296,24 @@ void SDLCALL SDL_ConvertStrip_2(SDL_AudioCVT *cvt, Uint16 format)
 #endif
 	switch (format&0x8018) {
 
+		case (AUDIO_F32SYS&0x8018): {
+			float *src, *dst;
+
+			src = (float *)cvt->buf;
+			dst = (float *)cvt->buf;
+			for ( i=cvt->len_cvt/24; i; --i ) {
+				dst[0] = src[0];
+				dst[1] = src[1];
+				dst[2] = src[2];
+				dst[3] = src[3];
+				src += 6;
+				dst += 4;
+			}
+			/* Four of every six, once it's halved below */
+			cvt->len_cvt = (cvt->len_cvt / 24) * 32;
+		}
+		break;
+
 		case AUDIO_U8: {
 			Uint8 *src, *dst;
 
@@ -372,7 +426,18 @@ void SDLCALL SDL_ConvertStereo(SDL_AudioCVT *cvt, Uint16 format)
 #ifdef DEBUG_CONVERT
 	fprintf(stderr, "Converting to stereo\n");
 #endif
-	if ( (format & 0xFF) == 16 ) {
+	if ( (format & 0xFF) == 32 ) {
+		Uint32 *src, *dst;
+
+		src = (Uint32 *)(cvt->buf+cvt->len_cvt);
+		dst = (Uint32 *)(cvt->buf+cvt->len_cvt*2);
+		for ( i=cvt->len_cvt/4; i; --i ) {
+			dst -= 2;
+			src -= 1;
+			dst[0] = src[0];
+			dst[1] = src[0];
+		}
+	} else if ( (format & 0xFF) == 16 ) {
 		Uint16 *src, *dst;
 
 		src = (Uint16 *)(cvt->buf+cvt->len_cvt);
@@ -412,6 +477,27 @@ void SDLCALL SDL_ConvertSurround(SDL_AudioCVT *cvt, Uint16 format)
 #endif
 	switch (format&0x8018) {
 
+		case (AUDIO_F32SYS&0x8018): {
+			float *src, *dst, lf, rf, ce;
+
+			src = (float *)(cvt->buf+cvt->len_cvt);
+			dst = (float *)(cvt->buf+cvt->len_cvt*3);
+			for ( i=cvt->len_cvt/8; i; --i ) {
+				dst -= 6;
+				src -= 2;
+				lf = src[0];
+				rf = src[1];
+				ce = (lf + rf) * 0.5f;
+				dst[0] = lf;
+				dst[1] = rf;
+				dst[2] = rf - ce;
+				dst[3] = lf - ce;
+				dst[4] = ce;
+				dst[5] = ce;
+			}
+		}
+		break;
+
 		case AUDIO_U8: {
 			Uint8 *src, *dst, lf, rf, ce;
 
@@ -589,6 +675,25 @@ void SDLCALL SDL_ConvertSurround_4(SDL_AudioCVT *cvt, Uint16 format)
 #endif
 	switch (format&0x8018) {
 
+		case (AUDIO_F32SYS&0x8018): {
+			float *src, *dst, lf, rf, ce;
+
+			src = (float *)(cvt->buf+cvt->len_cvt);
+			dst = (float *)(cvt->buf+cvt->len_cvt*2);
+			for ( i=cvt->len_cvt/8; i; --i ) {
+				dst -= 4;
+				src -= 2;
+				lf = src[0];
+				rf = src[1];
+				ce = (lf + rf) * 0.5f;
+				dst[0] = lf;
+				dst[1] = rf;
+				dst[2] = rf - ce;
+				dst[3] = lf - ce;
+			}
+		}
+		break;
+
 		case AUDIO_U8: {
 			Uint8 *src, *dst, lf, rf, ce;
 
@@ -856,6 +961,135 @@ void SDLCALL SDL_ConvertEndian(SDL_AudioCVT *cvt, Uint16 format)
 	}
 }
 
+/* Toggle endianness of 32-bit samples */
+void SDLCALL SDL_ConvertEndian32(SDL_AudioCVT *cvt, Uint16 format)
+{
+	int i;
+	Uint8 *data, tmp;
+
+#ifdef DEBUG_CONVERT
+	fprintf(stderr, "Converting 32-bit audio endianness\n");
+#endif
+	data = cvt->buf;
+	for ( i=cvt->len_cvt/4; i; --i ) {
+		tmp = data[0];
+		data[0] = data[3];
+		data[3] = tmp;
+		tmp = data[1];
+		data[1] = data[2];
+		data[2] = tmp;
+		data += 4;
+	}
+	format = (format ^ 0x1000);
+	if ( cvt->filters[++cvt->filter_index] ) {
+		cvt->filters[cvt->filter_index](cvt, format);
+	}
+}
+
+/* Convert native float to native signed 16-bit, rounding and clipping.
+   This is the one place a float mix gets quantized for the device.
+*/
+void SDLCALL SDL_ConvertFloatToS16(SDL_AudioCVT *cvt, Uint16 format)
+{
+	int i;
+	const float *src;
+	Sint16 *dst;
+	float sample;
+
+#ifdef DEBUG_CONVERT
+	fprintf(stderr, "Converting float to 16-bit\n");
+#endif
+	src = (const float *)cvt->buf;
+	dst = (Sint16 *)cvt->buf;
+	i = cvt->len_cvt/4;
+#if SDL_SSE2_MIXERS
+	if ( SDL_HasSSE2() ) {
+		const __m128 scale = _mm_set1_ps(32768.0f);
+		const __m128 hi = _mm_set1_ps(32767.0f);
+		const __m128 lo = _mm_set1_ps(-32768.0f);
+		__m128 a, b;
+
+		/* The stores trail the loads, so this works in place */
+		for ( ; i >= 8; i -= 8 ) {
+			a = _mm_mul_ps(_mm_loadu_ps(src), scale);
+			b = _mm_mul_ps(_mm_loadu_ps(src + 4), scale);
+			a = _mm_max_ps(_mm_min_ps(a, hi), lo);
+			b = _mm_max_ps(_mm_min_ps(b, hi), lo);
+			_mm_storeu_si128((__m128i *)dst, _mm_packs_epi32(
+				_mm_cvtps_epi32(a), _mm_cvtps_epi32(b)));
+			src += 8;
+			dst += 8;
+		}
+	}
+#endif
+	for ( ; i; --i ) {
+		sample = *src++ * 32768.0f;
+		if ( sample >= 32767.0f ) {
+			*dst++ = 32767;
+		} else if ( sample <= -32768.0f ) {
+			*dst++ = -32768;
+		} else {
+			/* Round half to even, like the SSE2 conversion */
+			int n = (int)sample;
+			float frac = sample - (float)n;
+			if ( frac > 0.5f || (frac == 0.5f && (n & 1)) ) {
+				++n;
+			} else if ( frac < -0.5f || (frac == -0.5f && (n & 1)) ) {
+				--n;
+			}
+			*dst++ = (Sint16)n;
+		}
+	}
+	format = AUDIO_S16SYS;
+	cvt->len_cvt /= 2;
+	if ( cvt->filters[++cvt->filter_index] ) {
+		cvt->filters[cvt->filter_index](cvt, format);
+	}
+}
+
+/* Convert native signed 16-bit to native float, from the end backwards */
+void SDLCALL SDL_ConvertS16ToFloat(SDL_AudioCVT *cvt, Uint16 format)
+{
+	int i;
+	const Sint16 *src;
+	float *dst;
+
+#ifdef DEBUG_CONVERT
+	fprintf(stderr, "Converting 16-bit to float\n");
+#endif
+	i = cvt->len_cvt/2;
+	src = (const Sint16 *)cvt->buf + i;
+	dst = (float *)cvt->buf + i;
+	for ( ; i & 7; --i ) {
+		*--dst = *--src * (1.0f / 32768.0f);
+	}
+#if SDL_SSE2_MIXERS
+	if ( SDL_HasSSE2() ) {
+		const __m128 scale = _mm_set1_ps(1.0f / 32768.0f);
+		__m128i s;
+
+		/* Each block is loaded before anything of it is stored */
+		for ( ; i; i -= 8 ) {
+			src -= 8;
+			dst -= 8;
+			s = _mm_loadu_si128((const __m128i *)src);
+			_mm_storeu_ps(dst, _mm_mul_ps(scale, _mm_cvtepi32_ps(
+				_mm_srai_epi32(_mm_unpacklo_epi16(s, s), 16))));
+			_mm_storeu_ps(dst + 4, _mm_mul_ps(scale, _mm_cvtepi32_ps(
+				_mm_srai_epi32(_mm_unpackhi_epi16(s, s), 16))));
+		}
+	}
+#endif
+	for ( ; i; --i ) {
+		*--dst = *--src * (1.0f / 32768.0f);
+	}
+	format = AUDIO_F32SYS;
+	cvt->len_cvt *= 2;
+	if ( cvt->filters[++cvt->filter_index] ) {
+		cvt->filters[cvt->filter_index](cvt, format);
+	}
+}
+
 /* Convert rate up by multiple of 2 */
 void SDLCALL SDL_RateMUL2(SDL_AudioCVT *cvt, Uint16 format)
 {
@@ -1300,6 +1534,564 @@ void SDLCALL SDL_RateSLOW(SDL_AudioCVT *cvt, Uint16 format)
 	}
 }
 
+/* Bandlimited rate conversion, after Julius O. Smith's resample:
+   every output sample is a windowed sinc interpolation of the input,
+   with the sinc stretched to the lower of the two Nyquist rates so that
+   downsampling doesn't alias.  The sinc is kept in a table, sampled
+   RESAMPLE_STEPS times per zero crossing and linearly interpolated, so
+   any rate ratio works with fixed-point arithmetic.  The linear and
+   cubic qualities are cheaper stand-ins, and the sinc falls back to
+   cubic when there is no math library to build the table with.
+*/
+#define RESAMPLE_ZEROS		10	/* zero crossings on each side */
+#define RESAMPLE_STEPS		512	/* table entries per zero crossing */
+#define RESAMPLE_ROLLOFF	0.92	/* cutoff, as a fraction of Nyquist */
+#define RESAMPLE_BETA		8.0	/* Kaiser window shape */
+#define RESAMPLE_TABLE		(RESAMPLE_ZEROS*RESAMPLE_STEPS)
+
+/* The sinc in Q15, and the difference to the next entry */
+static Sint16 resample_filter[RESAMPLE_TABLE+1];
+static Sint16 resample_deltas[RESAMPLE_TABLE+1];
+static int resample_filter_ready = 0;
+
+#ifdef HAVE_MATH_H
+static double BesselI0(double x)
+{
+	double sum = 1.0, term = 1.0;
+	int k;
+
+	for ( k = 1; k < 32; ++k ) {
+		term *= (x / (2.0 * k)) * (x / (2.0 * k));
+		sum += term;
+	}
+	return sum;
+}
+#endif
+
+static void InitResampleFilter(void)
+{
+#ifdef HAVE_MATH_H
+	const double pi = 3.14159265358979323846;
+	int i;
+
+	if ( resample_filter_ready ) {
+		return;
+	}
+	for ( i = 0; i < RESAMPLE_TABLE; ++i ) {
+		double x = (double)i / RESAMPLE_STEPS;
+		double w = x / RESAMPLE_ZEROS;
+		double h = (i == 0) ? 1.0 : sin(pi * x) / (pi * x);
+		h *= BesselI0(RESAMPLE_BETA * sqrt(1.0 - w * w)) /
+		     BesselI0(RESAMPLE_BETA);
+		h = floor(h * 32768.0 + 0.5);
+		resample_filter[i] = (Sint16)((h > 32767.0) ? 32767.0 : h);
+	}
+	resample_filter[RESAMPLE_TABLE] = 0;
+	for ( i = 0; i < RESAMPLE_TABLE; ++i ) {
+		resample_deltas[i] = resample_filter[i+1] - resample_filter[i];
+	}
+	resample_deltas[RESAMPLE_TABLE] = 0;
+	resample_filter_ready = 1;
+#endif
+}
+
+/* Read a sample of any format as signed 16 bits */
+static __inline__ Sint32 ResampleLoad(const Uint8 *p, Uint16 format)
+{
+	switch (format) {
+		case AUDIO_U8:
+			return (p[0] ^ 0x80) << 8;
+		case AUDIO_S8:
+			return ((Sint8)p[0]) << 8;
+		case AUDIO_U16LSB:
+			return ((p[1] << 8) | p[0]) - 0x8000;
+		case AUDIO_S16LSB:
+			return (Sint16)((p[1] << 8) | p[0]);
+		case AUDIO_U16MSB:
+			return ((p[0] << 8) | p[1]) - 0x8000;
+		case AUDIO_S16MSB:
+			return (Sint16)((p[0] << 8) | p[1]);
+	}
+	return 0;
+}
+
+/* Clip a signed 16 bit sample and write it in the given format */
+static __inline__ void ResampleStore(Uint8 *p, Sint32 v, Uint16 format)
+{
+	if ( (format & 0xFF) == 8 ) {
+		v = (v + 0x80) >> 8;
+		if ( v > 127 ) {
+			v = 127;
+		} else if ( v < -128 ) {
+			v = -128;
+		}
+		p[0] = (format == AUDIO_U8) ? (Uint8)(v ^ 0x80) : (Uint8)v;
+		return;
+	}
+	if ( v > 32767 ) {
+		v = 32767;
+	} else if ( v < -32768 ) {
+		v = -32768;
+	}
+	if ( (format & 0x8000) == 0 ) {
+		v ^= 0x8000;
+	}
+	if ( format & 0x1000 ) {
+		p[0] = (Uint8)(v >> 8);
+		p[1] = (Uint8)v;
+	} else {
+		p[0] = (Uint8)v;
+		p[1] = (Uint8)(v >> 8);
+	}
+}
+
+/* Multiply n (a multiple of 8) samples by the filter taps and sum them.
+   The taps never add up to more than 2.0 in magnitude, so the sum fits.
+*/
+static Sint32 ResampleDot(const Sint16 *x, const Sint16 *h, int n)
+{
+#if SDL_SSE2_MIXERS
+	if ( SDL_HasSSE2() ) {
+		__m128i sum = _mm_setzero_si128();
+		for ( ; n; n -= 8 ) {
+			sum = _mm_add_epi32(sum, _mm_madd_epi16(
+				_mm_loadu_si128((const __m128i *)x),
+				_mm_loadu_si128((const __m128i *)h)));
+			x += 8;
+			h += 8;
+		}
+		sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, 0x4E));
+		sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, 0xB1));
+		return _mm_cvtsi128_si32(sum);
+	}
+#endif
+	{
+		Sint32 sum = 0;
+		while ( n-- ) {
+			sum += *x++ * *h++;
+		}
+		return sum;
+	}
+}
+
+/* Table position of a distance in 0.16 input samples, keeping all 32 bits */
+static __inline__ Uint32 ResampleScale(Uint32 f16, Uint32 scale_steps)
+{
+	return f16 * (scale_steps >> 16) + ((f16 * (scale_steps & 0xFFFF)) >> 16);
+}
+
+/* Filter tap in Q15 for a position in the table, 16.16 in table entries */
+static __inline__ Sint32 ResampleTap(Uint32 pos, Sint32 gain)
+{
+	Uint32 i = pos >> 16;
+	Sint32 h;
+
+	if ( i >= RESAMPLE_TABLE ) {
+		return 0;
+	}
+	h = resample_filter[i] +
+	    ((resample_deltas[i] * (Sint32)((pos & 0xFFFF) >> 1)) >> 15);
+	return (h * gain + 0x4000) >> 15;
+}
+
+/* The same for float samples, which keep the taps unrounded */
+static float ResampleDotFloat(const float *x, const float *h, int n)
+{
+#if SDL_SSE2_MIXERS
+	if ( SDL_HasSSE2() ) {
+		__m128 sum0 = _mm_setzero_ps();
+		__m128 sum1 = _mm_setzero_ps();
+		for ( ; n; n -= 8 ) {
+			sum0 = _mm_add_ps(sum0, _mm_mul_ps(_mm_loadu_ps(x), _mm_loadu_ps(h)));
+			sum1 = _mm_add_ps(sum1, _mm_mul_ps(_mm_loadu_ps(x + 4), _mm_loadu_ps(h + 4)));
+			x += 8;
+			h += 8;
+		}
+		sum0 = _mm_add_ps(sum0, sum1);
+		sum0 = _mm_add_ps(sum0, _mm_movehl_ps(sum0, sum0));
+		sum0 = _mm_add_ss(sum0, _mm_shuffle_ps(sum0, sum0, 1));
+		return _mm_cvtss_f32(sum0);
+	}
+#endif
+	{
+		float sum = 0.0f;
+		while ( n-- ) {
+			sum += *x++ * *h++;
+		}
+		return sum;
+	}
+}
+
+static __inline__ float ResampleTapFloat(Uint32 pos, float gain)
+{
+	Uint32 i = pos >> 16;
+
+	if ( i >= RESAMPLE_TABLE ) {
+		return 0.0f;
+	}
+	return (resample_filter[i] + resample_deltas[i] *
+	        (float)(pos & 0xFFFF) * (1.0f / 65536.0f)) * gain;
+}
+
+/* Half the width of the sinc in input frames, and the scale that stretches
+   it to the lower Nyquist rate.  Past about 5.8:1 down the filter would
+   outgrow the history carried between buffers, so the cutoff stops
+   following the rate down there.
+*/
+static int ResampleHalf(double rate_incr, double *scale)
+{
+	*scale = RESAMPLE_ROLLOFF;
+	if ( rate_incr > 1.0 ) {
+		*scale /= rate_incr;
+	}
+	if ( RESAMPLE_ZEROS / *scale + 1 > SDL_AUDIOCVT_HISTORY / 2 ) {
+		*scale = RESAMPLE_ZEROS / (SDL_AUDIOCVT_HISTORY / 2 - 1.0);
+	}
+	return (int)(RESAMPLE_ZEROS / *scale) + 1;
+}
+
+/* The filter reads planes, one per channel, holding a window onto the
+   history followed by the buffer being converted.  They are 16-bit, or
+   float when converting float.  Frame "base" of that stream is at the
+   start of each plane and "end" is one past the last frame loaded.  Once
+   the planes are full, everything before "keep" is dropped to make room.
+*/
+#define RESAMPLE_BLOCK		256
+#define RESAMPLE_WINDOW		(2*SDL_AUDIOCVT_HISTORY+RESAMPLE_BLOCK)
+
+typedef union {
+	Sint16 s16[6 * RESAMPLE_WINDOW];
+	float f32[6 * RESAMPLE_WINDOW];
+} ResamplePlanes;
+
+static void ResampleFill(ResamplePlanes *planes, int channels, int *base,
+                         int *end, int keep, const Uint8 *in, int count,
+                         Uint16 format)
+{
+	const int size = (format & 0xFF) / 8;
+	const int frame = size * channels;
+	int c, i, n;
+
+	while ( count > 0 ) {
+		if ( *end - *base == RESAMPLE_WINDOW ) {
+			for ( c = 0; c < channels; ++c ) {
+				if ( format == AUDIO_F32SYS ) {
+					float *plane = planes->f32 + c * RESAMPLE_WINDOW;
+					SDL_memmove(plane, plane + (keep - *base),
+					            (*end - keep) * sizeof(float));
+				} else {
+					Sint16 *plane = planes->s16 + c * RESAMPLE_WINDOW;
+					SDL_memmove(plane, plane + (keep - *base),
+					            (*end - keep) * sizeof(Sint16));
+				}
+			}
+			*base = keep;
+		}
+		n = RESAMPLE_WINDOW - (*end - *base);
+		if ( n > count ) {
+			n = count;
+		}
+		for ( c = 0; c < channels; ++c ) {
+			const Uint8 *p = in + c * size;
+			if ( format == AUDIO_F32SYS ) {
+				float *plane = planes->f32 + c * RESAMPLE_WINDOW + (*end - *base);
+				for ( i = 0; i < n; ++i ) {
+					plane[i] = *(const float *)p;
+					p += frame;
+				}
+			} else {
+				Sint16 *plane = planes->s16 + c * RESAMPLE_WINDOW + (*end - *base);
+				for ( i = 0; i < n; ++i ) {
+					plane[i] = (Sint16)ResampleLoad(p, format);
+					p += frame;
+				}
+			}
+		}
+		in += n * frame;
+		*end += n;
+		count -= n;
+	}
+}
+
+/* Convert one buffer of a stream, 8 or 16-bit, or native float when both
+   ends of the conversion are float.  The stream is the last "taps" input
+   frames kept in cvt->rate_history, followed by this buffer, and output
+   carries on from the position left in cvt->rate_pos and rate_frac.  The
+   output goes over the input in place, so it is only written once the
+   input under it has been loaded, and converting up, the input is first
+   moved to the end of the buffer to stay ahead of the output.
+*/
+static void Resample(SDL_AudioCVT *cvt, Uint16 format, int channels)
+{
+	const int size = (format & 0xFF) / 8;
+	const int frame = size * channels;
+	const int in_frames = cvt->len_cvt / frame;
+	const int max_frames = (cvt->len * cvt->len_mult) / frame;
+	const int is_float = (format == AUDIO_F32SYS);
+	int quality = cvt->rate_quality;
+	int half, taps, behind, ahead, shift, loaded, need;
+	int i, c, j, ipos, base, end, step_int;
+	Uint32 frac, step_frac, scale_steps;
+	Sint32 gain;
+	float gain_f;
+	double scale, step;
+	ResamplePlanes planes;
+	Sint16 coeffs[SDL_AUDIOCVT_HISTORY];
+	float coeffs_f[SDL_AUDIOCVT_HISTORY];
+	const Uint8 *in;
+	Uint8 *out;
+
+	if ( in_frames == 0 ) {
+		cvt->len_cvt = 0;
+		goto next_filter;
+	}
+	if ( quality == SDL_AUDIO_RESAMPLE_SINC && !resample_filter_ready ) {
+		quality = SDL_AUDIO_RESAMPLE_CUBIC;
+	}
+
+	/* Stretch the sinc to the lower Nyquist rate, keeping unity gain */
+	half = ResampleHalf(cvt->rate_incr, &scale);
+	taps = (2 * half + 7) & ~7;
+	scale_steps = (Uint32)(scale * RESAMPLE_STEPS * 65536.0);
+	gain = (Sint32)(scale * 32768.0);
+	gain_f = (float)(scale / 32768.0);
+
+	/* Frames the sinc reads either side of the output position.  Every
+	   quality waits for the same input, so the stream comes out as long
+	   whatever the quality is changed to along the way. */
+	behind = half - 1;
+	ahead = taps - half;
+
+	for ( c = 0; c < channels; ++c ) {
+		const float *history = cvt->rate_history + c * SDL_AUDIOCVT_HISTORY;
+		if ( is_float ) {
+			SDL_memcpy(planes.f32 + c * RESAMPLE_WINDOW, history,
+			           taps * sizeof(float));
+		} else {
+			Sint16 *plane = planes.s16 + c * RESAMPLE_WINDOW;
+			for ( i = 0; i < taps; ++i ) {
+				plane[i] = (Sint16)history[i];
+			}
+		}
+	}
+	base = 0;
+	end = taps;
+	loaded = 0;
+
+	shift = 0;
+	if ( cvt->rate_incr < 1.0 ) {
+		shift = max_frames - in_frames;
+		SDL_memmove(cvt->buf + shift * frame, cvt->buf, in_frames * frame);
+	}
+	in = cvt->buf + shift * frame;
+
+	/* Step through the input in 32.32 fixed point, rounding the step up
+	   so the output never outgrows the room len_mult makes for it */
+	step_int = (int)cvt->rate_incr;
+	step = (cvt->rate_incr - step_int) * 4294967296.0;
+	step_frac = (Uint32)step;
+	if ( step_frac < step && ++step_frac == 0 ) {
+		++step_int;
+	}
+	ipos = taps + cvt->rate_pos;
+	frac = cvt->rate_frac;
+	out = cvt->buf;
+	for ( j = 0; j < max_frames; ++j ) {
+		Uint32 f16 = frac >> 16;
+		Uint32 next;
+
+		/* Input this output reads, and the input it overwrites */
+		need = ipos + ahead + 1 - taps;
+		if ( need > in_frames ) {
+			break;
+		}
+		if ( need < j + 1 - shift ) {
+			need = j + 1 - shift;
+			if ( need > in_frames ) {
+				need = in_frames;
+			}
+		}
+		if ( need > loaded ) {
+			need = SDL_min(need + RESAMPLE_BLOCK / 4, in_frames);
+			ResampleFill(&planes, channels, &base, &end,
+			             SDL_min(ipos - behind, end - taps),
+			             in + loaded * frame, need - loaded, format);
+			loaded = need;
+		}
+
+		if ( is_float ) {
+			const float *x = planes.f32 + (ipos - base);
+			float *dst = (float *)out;
+
+			switch (quality) {
+				case SDL_AUDIO_RESAMPLE_LINEAR: {
+					float t = (float)f16 * (1.0f / 65536.0f);
+					for ( c = 0; c < channels; ++c ) {
+						dst[c] = x[0] + (x[1] - x[0]) * t;
+						x += RESAMPLE_WINDOW;
+					}
+				}
+				break;
+
+				case SDL_AUDIO_RESAMPLE_CUBIC: {
+					float t = (float)f16 * (1.0f / 65536.0f);
+					float t2 = t * t;
+					float t3 = t2 * t;
+					float c0 = 0.5f * (-t3 + 2.0f * t2 - t);
+					float c1 = 0.5f * (3.0f * t3 - 5.0f * t2 + 2.0f);
+					float c2 = 0.5f * (-3.0f * t3 + 4.0f * t2 + t);
+					float c3 = 0.5f * (t3 - t2);
+					for ( c = 0; c < channels; ++c ) {
+						dst[c] = c0 * x[-1] + c1 * x[0] +
+						         c2 * x[1] + c3 * x[2];
+						x += RESAMPLE_WINDOW;
+					}
+				}
+				break;
+
+				default: {
+					Uint32 left = ResampleScale(f16, scale_steps);
+					Uint32 right = ResampleScale(0x10000 - f16, scale_steps);
+					for ( i = 0; i < half; ++i ) {
+						coeffs_f[half - 1 - i] = ResampleTapFloat(left, gain_f);
+						left += scale_steps;
+					}
+					for ( i = half; i < taps; ++i ) {
+						coeffs_f[i] = ResampleTapFloat(right, gain_f);
+						right += scale_steps;
+					}
+					x -= half - 1;
+					for ( c = 0; c < channels; ++c ) {
+						dst[c] = ResampleDotFloat(x, coeffs_f, taps);
+						x += RESAMPLE_WINDOW;
+					}
+				}
+				break;
+			}
+			out += frame;
+		} else {
+			const Sint16 *x = planes.s16 + (ipos - base);
+
+			switch (quality) {
+				case SDL_AUDIO_RESAMPLE_LINEAR: {
+					Sint32 t = (Sint32)(frac >> 17);
+					for ( c = 0; c < channels; ++c ) {
+						ResampleStore(out, x[0] + (((x[1] - x[0]) * t) >> 15), format);
+						x += RESAMPLE_WINDOW;
+						out += size;
+					}
+				}
+				break;
+
+				case SDL_AUDIO_RESAMPLE_CUBIC: {
+					/* Catmull-Rom spline, coefficients in Q14 */
+					Sint32 t = (Sint32)(frac >> 18);
+					Sint32 t2 = (t * t) >> 14;
+					Sint32 t3 = (t2 * t) >> 14;
+					Sint32 c0 = (-t3 + 2 * t2 - t) / 2;
+					Sint32 c1 = (3 * t3 - 5 * t2 + 2 * 16384) / 2;
+					Sint32 c2 = (-3 * t3 + 4 * t2 + t) / 2;
+					Sint32 c3 = (t3 - t2) / 2;
+					for ( c = 0; c < channels; ++c ) {
+						ResampleStore(out, (c0 * x[-1] + c1 * x[0] +
+						                    c2 * x[1] + c3 * x[2]) >> 14, format);
+						x += RESAMPLE_WINDOW;
+						out += size;
+					}
+				}
+				break;
+
+				default: {
+					/* Taps for x[1-half] .. x[taps-half], shared by all channels */
+					Uint32 left = ResampleScale(f16, scale_steps);
+					Uint32 right = ResampleScale(0x10000 - f16, scale_steps);
+					for ( i = 0; i < half; ++i ) {
+						coeffs[half - 1 - i] = (Sint16)ResampleTap(left, gain);
+						left += scale_steps;
+					}
+					for ( i = half; i < taps; ++i ) {
+						coeffs[i] = (Sint16)ResampleTap(right, gain);
+						right += scale_steps;
+					}
+					x -= half - 1;
+					for ( c = 0; c < channels; ++c ) {
+						ResampleStore(out, (ResampleDot(x, coeffs, taps) + 0x4000) >> 15, format);
+						x += RESAMPLE_WINDOW;
+						out += size;
+					}
+				}
+				break;
+			}
+		}
+
+		next = frac + step_frac;
+		ipos += step_int + (next < frac);
+		frac = next;
+	}
+	cvt->len_cvt = j * frame;
+
+	/* Skip anything the buffer had no room for, then keep the last
+	   frames of input for the next buffer */
+	while ( ipos + ahead + 1 - taps <= in_frames ) {
+		Uint32 next = frac + step_frac;
+		ipos += step_int + (next < frac);
+		frac = next;
+	}
+	while ( loaded < in_frames ) {
+		int n = SDL_min(in_frames - loaded, RESAMPLE_BLOCK);
+		ResampleFill(&planes, channels, &base, &end, end - taps,
+		             in + loaded * frame, n, format);
+		loaded += n;
+	}
+	for ( c = 0; c < channels; ++c ) {
+		float *history = cvt->rate_history + c * SDL_AUDIOCVT_HISTORY;
+		if ( is_float ) {
+			SDL_memcpy(history, planes.f32 + c * RESAMPLE_WINDOW +
+			           (end - taps - base), taps * sizeof(float));
+		} else {
+			const Sint16 *plane = planes.s16 + c * RESAMPLE_WINDOW +
+			                      (end - taps - base);
+			for ( i = 0; i < taps; ++i ) {
+				history[i] = plane[i];
+			}
+		}
+	}
+	cvt->rate_pos = ipos - end;
+	cvt->rate_frac = frac;
+
+next_filter:
+	if ( cvt->filters[++cvt->filter_index] ) {
+		cvt->filters[cvt->filter_index](cvt, format);
+	}
+}
+
+/* Convert rate by any ratio, using cvt->rate_quality */
+void SDLCALL SDL_RateResample(SDL_AudioCVT *cvt, Uint16 format)
+{
+#ifdef DEBUG_CONVERT
+	fprintf(stderr, "Resampling audio * %4.4f\n", 1.0/cvt->rate_incr);
+#endif
+	Resample(cvt, format, 1);
+}
+
+/* Convert rate by any ratio, for stereo */
+void SDLCALL SDL_RateResample_c2(SDL_AudioCVT *cvt, Uint16 format)
+{
+	Resample(cvt, format, 2);
+}
+
+/* Convert rate by any ratio, for quad */
+void SDLCALL SDL_RateResample_c4(SDL_AudioCVT *cvt, Uint16 format)
+{
+	Resample(cvt, format, 4);
+}
+
+/* Convert rate by any ratio, for 5.1 */
+void SDLCALL SDL_RateResample_c6(SDL_AudioCVT *cvt, Uint16 format)
+{
+	Resample(cvt, format, 6);
+}
+
 int SDL_ConvertAudio(SDL_AudioCVT *cvt)
 {
 	/* Make sure there's data to convert */
@@ -1328,6 +2120,13 @@ int SDL_BuildAudioCVT(SDL_AudioCVT *cvt,
 	Uint16 src_format, Uint8 src_channels, int src_rate,
 	Uint16 dst_format, Uint8 dst_channels, int dst_rate)
 {
+	Uint16 src_orig = src_format;
+	Uint16 dst_orig = dst_format;
+	int float_out = 0;
+	int float_swap = 0;
+	int half;
+	double scale;
+
 /*printf("Build format %04x->%04x, channels %u->%u, rate %d->%d\n",
 		src_format, dst_format, src_channels, dst_channels, src_rate, dst_rate);*/
 	/* Start off with no conversion necessary */
@@ -1336,6 +2135,38 @@ int SDL_BuildAudioCVT(SDL_AudioCVT *cvt,
 	cvt->filters[0] = NULL;
 	cvt->len_mult = 1;
 	cvt->len_ratio = 1.0;
+	cvt->rate_quality = SDL_AUDIO_RESAMPLE_SINC;
+
+	/* Float goes through the other filters as native 16-bit, converted
+	   on the way in and out.  Float to float may just swap bytes, and
+	   otherwise stays native float through the channel and rate filters,
+	   so it isn't quantized or clipped on the way.
+	 */
+	if ( ((src_format & 0xFF) == 32) && ((dst_format & 0xFF) == 32) ) {
+		if ( (src_channels == dst_channels) &&
+		     ((src_rate/100) == (dst_rate/100)) ) {
+			if ( src_format != dst_format ) {
+				cvt->filters[cvt->filter_index++] = SDL_ConvertEndian32;
+			}
+		} else {
+			if ( src_format != AUDIO_F32SYS ) {
+				cvt->filters[cvt->filter_index++] = SDL_ConvertEndian32;
+			}
+			float_swap = (dst_format != AUDIO_F32SYS);
+		}
+		src_format = dst_format = AUDIO_F32SYS;
+	} else if ( (src_format & 0xFF) == 32 ) {
+		if ( src_format != AUDIO_F32SYS ) {
+			cvt->filters[cvt->filter_index++] = SDL_ConvertEndian32;
+		}
+		cvt->filters[cvt->filter_index++] = SDL_ConvertFloatToS16;
+		cvt->len_ratio /= 2;
+		src_format = AUDIO_S16SYS;
+	}
+	if ( ((dst_format & 0xFF) == 32) && ((src_format & 0xFF) != 32) ) {
+		float_out = 1;
+		dst_format = AUDIO_S16SYS;
+	}
 
 	/* First filter:  Endian conversion from src to dst */
 	if ( (src_format & 0x1000) != (dst_format & 0x1000)
@@ -1436,75 +2267,311 @@ int SDL_BuildAudioCVT(SDL_AudioCVT *cvt,
 	/* Do rate conversion */
 	cvt->rate_incr = 0.0;
 	if ( (src_rate/100) != (dst_rate/100) ) {
-		Uint32 hi_rate, lo_rate;
-		int len_mult;
-		double len_ratio;
-		void (SDLCALL *rate_cvt)(SDL_AudioCVT *cvt, Uint16 format);
-
-		if ( src_rate > dst_rate ) {
-			hi_rate = src_rate;
-			lo_rate = dst_rate;
-			switch (src_channels) {
-				case 1: rate_cvt = SDL_RateDIV2; break;
-				case 2: rate_cvt = SDL_RateDIV2_c2; break;
-				case 4: rate_cvt = SDL_RateDIV2_c4; break;
-				case 6: rate_cvt = SDL_RateDIV2_c6; break;
-				default: return -1;
-			}
-			len_mult = 1;
-			len_ratio = 0.5;
-		} else {
-			hi_rate = dst_rate;
-			lo_rate = src_rate;
-			switch (src_channels) {
-				case 1: rate_cvt = SDL_RateMUL2; break;
-				case 2: rate_cvt = SDL_RateMUL2_c2; break;
-				case 4: rate_cvt = SDL_RateMUL2_c4; break;
-				case 6: rate_cvt = SDL_RateMUL2_c6; break;
-				default: return -1;
-			}
-			len_mult = 2;
-			len_ratio = 2.0;
-		}
-		/* If hi_rate = lo_rate*2^x then conversion is easy */
-		while ( ((lo_rate*2)/100) <= (hi_rate/100) ) {
-			cvt->filters[cvt->filter_index++] = rate_cvt;
-			cvt->len_mult *= len_mult;
-			lo_rate *= 2;
-			cvt->len_ratio *= len_ratio;
-		}
-		/* We may need a slow conversion here to finish up */
-		if ( (lo_rate/100) != (hi_rate/100) ) {
-#if 1
-			/* The problem with this is that if the input buffer is
-			   say 1K, and the conversion rate is say 1.1, then the
-			   output buffer is 1.1K, which may not be an acceptable
-			   buffer size for the audio driver (not a power of 2)
-			*/
-			/* For now, punt and hope the rate distortion isn't great.
-			*/
-#else
-			if ( src_rate < dst_rate ) {
-				cvt->rate_incr = (double)lo_rate/hi_rate;
-				cvt->len_mult *= 2;
-				cvt->len_ratio /= cvt->rate_incr;
-			} else {
-				cvt->rate_incr = (double)hi_rate/lo_rate;
-				cvt->len_ratio *= cvt->rate_incr;
-			}
-			cvt->filters[cvt->filter_index++] = SDL_RateSLOW;
-#endif
+		switch (src_channels) {
+			case 1: cvt->filters[cvt->filter_index++] =
+						SDL_RateResample; break;
+			case 2: cvt->filters[cvt->filter_index++] =
+						SDL_RateResample_c2; break;
+			case 4: cvt->filters[cvt->filter_index++] =
+						SDL_RateResample_c4; break;
+			case 6: cvt->filters[cvt->filter_index++] =
+						SDL_RateResample_c6; break;
+			default: return -1;
 		}
+		cvt->rate_incr = (double)src_rate/dst_rate;
+		if ( src_rate < dst_rate ) {
+			cvt->len_mult *= (dst_rate + src_rate - 1) / src_rate;
+		}
+		cvt->len_ratio /= cvt->rate_incr;
+		InitResampleFilter();
+
+		/* Start the stream on silence, a filter's lookahead early */
+		half = ResampleHalf(cvt->rate_incr, &scale);
+		cvt->rate_pos = half - ((2 * half + 7) & ~7);
+		cvt->rate_frac = 0;
+		SDL_memset(cvt->rate_history, 0, sizeof(cvt->rate_history));
+	}
+
+	/* Back out to float */
+	if ( float_out ) {
+		cvt->filters[cvt->filter_index++] = SDL_ConvertS16ToFloat;
+		cvt->len_mult *= 2;
+		cvt->len_ratio *= 2;
+		if ( dst_orig != AUDIO_F32SYS ) {
+			cvt->filters[cvt->filter_index++] = SDL_ConvertEndian32;
+		}
+	}
+	if ( float_swap ) {
+		cvt->filters[cvt->filter_index++] = SDL_ConvertEndian32;
 	}
 
 	/* Set up the filter information */
 	if ( cvt->filter_index != 0 ) {
 		cvt->needed = 1;
-		cvt->src_format = src_format;
-		cvt->dst_format = dst_format;
+		cvt->src_format = src_orig;
+		cvt->dst_format = dst_orig;
 		cvt->len = 0;
 		cvt->buf = NULL;
 		cvt->filters[cvt->filter_index] = NULL;
 	}
 	return(cvt->needed);
 }
+
+#ifdef TEST_MAIN
+
+#include <stdio.h>
+#include <time.h>
+
+/* Measure the rate converters on a sine wave: THD+N is what is left after
+   least-squares fitting a sine of the expected frequency to the output,
+   skipping the edges, and throughput is mono 16-bit output samples per
+   second.  The old power-of-two and "slow" converters are run on the same
+   input for comparison.
+*/
+#define TEST_FRAMES	16384
+
+static Sint16 test_in[TEST_FRAMES];
+static Sint16 test_buf[TEST_FRAMES * 4];
+static double test_out[TEST_FRAMES * 4];
+
+static double ThdN(const double *y, int n, double w)
+{
+	double s2 = 0, c2 = 0, sc = 0, sy = 0, cy = 0, a, b, d, err = 0, sig = 0;
+	int i, skip = 256;
+
+	for ( i = skip; i < n - skip; ++i ) {
+		double s = sin(w * i), c = cos(w * i);
+		s2 += s * s; c2 += c * c; sc += s * c;
+		sy += s * y[i]; cy += c * y[i];
+	}
+	d = s2 * c2 - sc * sc;
+	a = (sy * c2 - cy * sc) / d;
+	b = (cy * s2 - sy * sc) / d;
+	for ( i = skip; i < n - skip; ++i ) {
+		double fit = a * sin(w * i) + b * cos(w * i);
+		err += (y[i] - fit) * (y[i] - fit);
+		sig += fit * fit;
+	}
+	return 10.0 * log10(err / sig);
+}
+
+static void RunTest(const char *name, SDL_AudioCVT *cvt, int src_rate, int dst_rate, double freq)
+{
+	const double pi = 3.14159265358979323846;
+	clock_t start;
+	int i, runs = 0, frames;
+
+	for ( i = 0; i < TEST_FRAMES; ++i ) {
+		test_in[i] = (Sint16)floor(16384.0 * sin(2.0 * pi * freq * i / src_rate) + 0.5);
+	}
+	start = clock();
+	do {
+		SDL_memcpy(test_buf, test_in, sizeof(test_in));
+		cvt->buf = (Uint8 *)test_buf;
+		cvt->len = sizeof(test_in);
+		SDL_ConvertAudio(cvt);
+		++runs;
+	} while ( clock() - start < CLOCKS_PER_SEC / 4 );
+	frames = cvt->len_cvt / 2;
+	for ( i = 0; i < frames; ++i ) {
+		test_out[i] = test_buf[i];
+	}
+	printf("%-8s %5d -> %5d  %5.0f Hz: THD+N %6.1f dB, %7.1f Msamples/s\n",
+	       name, src_rate, dst_rate, freq,
+	       ThdN(test_out, frames, 2.0 * pi * freq / dst_rate),
+	       (double)frames * runs * CLOCKS_PER_SEC / (clock() - start) / 1e6);
+}
+
+static void TestRates(int src_rate, int dst_rate, double freq)
+{
+	static const char *names[] = { "linear", "cubic", "sinc" };
+	SDL_AudioCVT cvt;
+	int q;
+
+	for ( q = 0; q < SDL_arraysize(names); ++q ) {
+		SDL_BuildAudioCVT(&cvt, AUDIO_S16SYS, 1, src_rate,
+		                        AUDIO_S16SYS, 1, dst_rate);
+		cvt.rate_quality = q;
+		RunTest(names[q], &cvt, src_rate, dst_rate, freq);
+	}
+
+	SDL_memset(&cvt, 0, sizeof(cvt));
+	cvt.src_format = cvt.dst_format = AUDIO_S16SYS;
+	cvt.rate_incr = (double)src_rate / dst_rate;
+	if ( src_rate * 2 == dst_rate ) {
+		cvt.filters[0] = SDL_RateMUL2;
+		RunTest("mul2", &cvt, src_rate, dst_rate, freq);
+	} else if ( src_rate == dst_rate * 2 ) {
+		cvt.filters[0] = SDL_RateDIV2;
+		RunTest("div2", &cvt, src_rate, dst_rate, freq);
+	} else {
+		cvt.filters[0] = SDL_RateSLOW;
+		RunTest("slow", &cvt, src_rate, dst_rate, freq);
+	}
+}
+
+/* A stream converted a buffer at a time has to come out the same as when
+   it is converted all at once, with no frames gained or lost.
+*/
+static void TestBuffers(int src_rate, int dst_rate, int frames)
+{
+	static Sint16 test_whole[TEST_FRAMES * 4];
+	const double pi = 3.14159265358979323846;
+	SDL_AudioCVT cvt;
+	int i, whole, total = 0, okay = 1;
+
+	for ( i = 0; i < TEST_FRAMES; ++i ) {
+		test_in[i] = (Sint16)floor(16384.0 * sin(2.0 * pi * 1000.0 * i / src_rate) + 0.5);
+	}
+	SDL_BuildAudioCVT(&cvt, AUDIO_S16SYS, 1, src_rate,
+	                        AUDIO_S16SYS, 1, dst_rate);
+	SDL_memcpy(test_whole, test_in, sizeof(test_in));
+	cvt.buf = (Uint8 *)test_whole;
+	cvt.len = sizeof(test_in);
+	SDL_ConvertAudio(&cvt);
+	whole = cvt.len_cvt / 2;
+
+	SDL_BuildAudioCVT(&cvt, AUDIO_S16SYS, 1, src_rate,
+	                        AUDIO_S16SYS, 1, dst_rate);
+	for ( i = 0; i < TEST_FRAMES; i += frames ) {
+		int n = SDL_min(frames, TEST_FRAMES - i);
+		SDL_memcpy(test_buf, test_in + i, n * 2);
+		cvt.buf = (Uint8 *)test_buf;
+		cvt.len = n * 2;
+		SDL_ConvertAudio(&cvt);
+		if ( total + cvt.len_cvt / 2 > whole ||
+		     SDL_memcmp(test_buf, test_whole + total, cvt.len_cvt) != 0 ) {
+			okay = 0;
+		}
+		total += cvt.len_cvt / 2;
+	}
+	printf("sinc     %5d -> %5d  %4d-frame buffers %s, %d frames for %d expected\n",
+	       src_rate, dst_rate, frames,
+	       (okay && total == whole) ? "match" : "differ", total,
+	       (int)ceil((double)TEST_FRAMES * dst_rate / src_rate));
+}
+
+/* Float to float with a rate and channel change has to stay float: a
+   sine over full scale mustn't clip, and a quiet one mustn't pick up 16-bit
+   quantization noise, as they would going through the 16-bit filters.
+*/
+static double ThdNFloat(const float *buf, int len, double w, double *peak)
+{
+	int i, frames = len / (2 * sizeof(float));
+
+	*peak = 0.0;
+	for ( i = 0; i < frames; ++i ) {
+		test_out[i] = buf[i * 2];
+		if ( fabs(test_out[i]) > *peak ) {
+			*peak = fabs(test_out[i]);
+		}
+	}
+	return ThdN(test_out, frames, w);
+}
+
+static void TestFloatRates(int src_rate, int dst_rate, double level)
+{
+	static float test_float[TEST_FRAMES];
+	static float test_fbuf[TEST_FRAMES * 4];
+	const double pi = 3.14159265358979323846;
+	const double w = 2.0 * pi * 1000.0 / dst_rate;
+	SDL_AudioCVT cvt;
+	double thdn, thdn16, peak, peak16;
+	int i;
+
+	for ( i = 0; i < TEST_FRAMES; ++i ) {
+		test_float[i] = (float)(level * sin(2.0 * pi * 1000.0 * i / src_rate));
+	}
+	SDL_BuildAudioCVT(&cvt, AUDIO_F32SYS, 1, src_rate,
+	                        AUDIO_F32SYS, 2, dst_rate);
+	SDL_memcpy(test_fbuf, test_float, sizeof(test_float));
+	cvt.buf = (Uint8 *)test_fbuf;
+	cvt.len = sizeof(test_float);
+	SDL_ConvertAudio(&cvt);
+	thdn = ThdNFloat(test_fbuf, cvt.len_cvt, w, &peak);
+
+	/* The same, quantized to 16-bit on the way as it used to be */
+	SDL_BuildAudioCVT(&cvt, AUDIO_F32SYS, 1, src_rate,
+	                        AUDIO_S16SYS, 1, src_rate);
+	SDL_memcpy(test_fbuf, test_float, sizeof(test_float));
+	cvt.buf = (Uint8 *)test_fbuf;
+	cvt.len = sizeof(test_float);
+	SDL_ConvertAudio(&cvt);
+	i = cvt.len_cvt;
+	SDL_BuildAudioCVT(&cvt, AUDIO_S16SYS, 1, src_rate,
+	                        AUDIO_F32SYS, 2, dst_rate);
+	cvt.buf = (Uint8 *)test_fbuf;
+	cvt.len = i;
+	SDL_ConvertAudio(&cvt);
+	thdn16 = ThdNFloat(test_fbuf, cvt.len_cvt, w, &peak16);
+
+	printf("float    %5d -> %5d  mono to stereo at %5.3f: THD+N %6.1f dB, peak %5.3f, through 16-bit %6.1f dB, peak %5.3f\n",
+	       src_rate, dst_rate, level, thdn, peak, thdn16, peak16);
+}
+
+/* Every 16-bit value has to survive a trip through float in either byte
+   order, and then the float to 16-bit throughput, the device end of a
+   float mix.
+*/
+static void TestFloat(Uint16 format)
+{
+	static float test_float[TEST_FRAMES * 2];
+	SDL_AudioCVT to, from;
+	clock_t start;
+	int i, runs = 0, okay = 1;
+
+	SDL_BuildAudioCVT(&to, AUDIO_S16SYS, 2, 44100, format, 2, 44100);
+	SDL_BuildAudioCVT(&from, format, 2, 44100, AUDIO_S16SYS, 2, 44100);
+	for ( i = 0; i < 65536; i += TEST_FRAMES * 2 ) {
+		int j;
+		for ( j = 0; j < TEST_FRAMES * 2; ++j ) {
+			test_buf[j] = (Sint16)(i + j - 32768);
+		}
+		to.buf = (Uint8 *)test_buf;
+		to.len = TEST_FRAMES * 2 * 2;
+		SDL_ConvertAudio(&to);
+		from.buf = (Uint8 *)test_buf;
+		from.len = to.len_cvt;
+		SDL_ConvertAudio(&from);
+		for ( j = 0; j < TEST_FRAMES * 2; ++j ) {
+			if ( test_buf[j] != (Sint16)(i + j - 32768) ) {
+				okay = 0;
+			}
+		}
+	}
+	for ( i = 0; i < TEST_FRAMES * 2; ++i ) {
+		test_float[i] = (float)sin(i * 0.01) * 1.25f;
+	}
+	start = clock();
+	do {
+		SDL_memcpy(test_buf, test_float, sizeof(test_float));
+		from.buf = (Uint8 *)test_buf;
+		from.len = sizeof(test_float);
+		SDL_ConvertAudio(&from);
+		++runs;
+	} while ( clock() - start < CLOCKS_PER_SEC / 4 );
+	printf("float %s round trip %s, %7.1f Msamples/s to 16-bit\n",
+	       (format == AUDIO_F32LSB) ? "LSB" : "MSB",
+	       okay ? "okay" : "failed",
+	       (double)TEST_FRAMES * 2 * runs * CLOCKS_PER_SEC / (clock() - start) / 1e6);
+}
+
+int main(int argc, char *argv[])
+{
+	TestFloat(AUDIO_F32LSB);
+	TestFloat(AUDIO_F32MSB);
+	TestRates(22050, 44100, 1000.0);
+	TestRates(22050, 44100, 8000.0);
+	TestRates(44100, 48000, 1000.0);
+	TestRates(44100, 48000, 8000.0);
+	TestRates(48000, 44100, 8000.0);
+	TestRates(44100, 22050, 8000.0);
+	TestBuffers(44100, 48000, 1024);
+	TestBuffers(22050, 44100, 512);
+	TestBuffers(48000, 44100, 1000);
+	TestFloatRates(44100, 48000, 1.25);
+	TestFloatRates(44100, 48000, 0.001);
+	return 0;
+}
+
+#endif /* TEST_MAIN */
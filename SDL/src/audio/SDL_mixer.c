@@ -30,6 +30,7 @@
 #include "SDL_mixer_MMX.h"
 #include "SDL_mixer_MMX_VC.h"
 #include "SDL_mixer_m68k.h"
+#include "SDL_mixer_SSE2.h"
 
 /* This table is used to add two sound values together and pin
  * the value to avoid overflow.  (used with permission from ARDI)
@@ -108,6 +109,25 @@ void SDL_MixAudio (Uint8 *dst, const Uint8 *src, Uint32 len, int volume)
   		/* HACK HACK HACK */
 		format = AUDIO_S16;
 	}
+
+#if SDL_SSE2_MIXERS
+	/* Whole vectors go to SSE2 or AVX2, the C mixer does the rest */
+	if ( volume > 0 && volume <= SDL_MIX_MAXVOLUME ) {
+		Uint32 done = 0;
+#if SDL_AVX2_MIXERS
+		if ( SDL_HasAVX2() ) {
+			done = SDL_MixAudio_AVX2(dst, src, len, volume, format);
+		} else
+#endif
+		if ( SDL_HasSSE2() ) {
+			done = SDL_MixAudio_SSE2(dst, src, len, volume, format);
+		}
+		dst += done;
+		src += done;
+		len -= done;
+	}
+#endif
+
 	switch (format) {
 
 		case AUDIO_U8: {
@@ -256,9 +276,138 @@ void SDL_MixAudio (Uint8 *dst, const Uint8 *src, Uint32 len, int volume)
 		}
 		break;
 
+		case AUDIO_F32LSB:
+		case AUDIO_F32MSB: {
+			/* Float has the headroom, so there's nothing to clip */
+			const float fvolume = (float)volume / SDL_MIX_MAXVOLUME;
+			union { Uint32 bits; float f; } src1, dst1;
+
+			len /= 4;
+			if ( format == AUDIO_F32SYS ) {
+				while ( len-- ) {
+					SDL_memcpy(&src1.f, src, 4);
+					SDL_memcpy(&dst1.f, dst, 4);
+					dst1.f += src1.f * fvolume;
+					SDL_memcpy(dst, &dst1.f, 4);
+					src += 4;
+					dst += 4;
+				}
+			} else {
+				while ( len-- ) {
+					SDL_memcpy(&src1.bits, src, 4);
+					SDL_memcpy(&dst1.bits, dst, 4);
+					src1.bits = SDL_Swap32(src1.bits);
+					dst1.bits = SDL_Swap32(dst1.bits);
+					dst1.f += src1.f * fvolume;
+					dst1.bits = SDL_Swap32(dst1.bits);
+					SDL_memcpy(dst, &dst1.bits, 4);
+					src += 4;
+					dst += 4;
+				}
+			}
+		}
+		break;
+
 		default: /* If this happens... FIXME! */
 			SDL_SetError("SDL_MixAudio(): unknown audio format");
 			return;
 	}
 }
 
+#ifdef TEST_MAIN
+
+#include <stdio.h>
+#include <stdlib.h>
+
+static void RandomFloats(Uint8 *buf, int n)
+{
+	float f;
+
+	while ( n-- ) {
+		f = (float)(rand() - RAND_MAX / 2) / RAND_MAX;
+		SDL_memcpy(buf, &f, 4);
+		buf += 4;
+	}
+}
+
+/* Mix with a vector mixer, letting SDL_MixAudio() finish the buffer, and
+   compare against SDL_MixAudio() fed one sample at a time, which never
+   fills a vector and so always takes the C path.
+*/
+static int CompareMix(Uint32 (*mix)(Uint8 *, const Uint8 *, Uint32, int, Uint16),
+                      Uint16 format)
+{
+	static const int volumes[] = { 1, 3, 37, 64, 100, 127, 128 };
+	enum { LEN = 160 };
+	Uint8 src[LEN + 1];
+	Uint8 dst[2][LEN + 1];
+	int size = (format & 0xFF) / 8;
+	Uint32 len, i, done;
+	int v;
+
+	current_audio->spec.format = format;
+	for ( v = 0; v < SDL_arraysize(volumes); ++v ) {
+		for ( len = 0; len <= LEN; len += size ) {
+			for ( i = 0; i <= LEN; ++i ) {
+				src[i] = rand();
+				dst[0][i] = dst[1][i] = rand();
+			}
+			if ( (format & 0xFF) == 32 ) {
+				/* random bits could be NaNs, which needn't compare */
+				RandomFloats(src + 1, LEN / 4);
+				RandomFloats(dst[0] + 1, LEN / 4);
+				SDL_memcpy(dst[1], dst[0], sizeof(dst[0]));
+			}
+			/* start off by one to keep the vector accesses unaligned */
+			for ( i = 0; i < len; i += size ) {
+				SDL_MixAudio(dst[0] + 1 + i, src + 1 + i, size, volumes[v]);
+			}
+			done = mix(dst[1] + 1, src + 1, len, volumes[v], format);
+			SDL_MixAudio(dst[1] + 1 + done, src + 1 + done, len - done, volumes[v]);
+			if ( SDL_memcmp(dst[0], dst[1], sizeof(dst[0])) != 0 ) {
+				return 0;
+			}
+		}
+	}
+	return 1;
+}
+
+static void Report(const char *name, int okay)
+{
+	printf("%s... %s\n", name, okay ? "okay" : "failed");
+}
+
+int main(int argc, char *argv[])
+{
+	SDL_AudioDevice device;
+
+	SDL_memset(&device, 0, sizeof(device));
+	current_audio = &device;
+
+#if SDL_SSE2_MIXERS
+	if ( SDL_HasSSE2() ) {
+		Report("SSE2 U8", CompareMix(SDL_MixAudio_SSE2, AUDIO_U8));
+		Report("SSE2 S8", CompareMix(SDL_MixAudio_SSE2, AUDIO_S8));
+		Report("SSE2 S16LSB", CompareMix(SDL_MixAudio_SSE2, AUDIO_S16LSB));
+		Report("SSE2 S16MSB", CompareMix(SDL_MixAudio_SSE2, AUDIO_S16MSB));
+		Report("SSE2 F32SYS", CompareMix(SDL_MixAudio_SSE2, AUDIO_F32SYS));
+	} else {
+		printf("SSE2 not available, skipped\n");
+	}
+#endif
+#if SDL_AVX2_MIXERS
+	if ( SDL_HasAVX2() ) {
+		Report("AVX2 U8", CompareMix(SDL_MixAudio_AVX2, AUDIO_U8));
+		Report("AVX2 S8", CompareMix(SDL_MixAudio_AVX2, AUDIO_S8));
+		Report("AVX2 S16LSB", CompareMix(SDL_MixAudio_AVX2, AUDIO_S16LSB));
+		Report("AVX2 S16MSB", CompareMix(SDL_MixAudio_AVX2, AUDIO_S16MSB));
+		Report("AVX2 F32SYS", CompareMix(SDL_MixAudio_AVX2, AUDIO_F32SYS));
+	} else {
+		printf("AVX2 not available, skipped\n");
+	}
+#endif
+	current_audio = NULL;
+	return 0;
+}
+
+#endif /* TEST_MAIN */
@@ -0,0 +1,253 @@
+/*
+    SDL - Simple DirectMedia Layer
+    Copyright (C) 1997-2012 Sam Lantinga
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+
+    Sam Lantinga
+    slouken@libsdl.org
+*/
+#include "SDL_config.h"
+
+/* SSE2 and AVX2 versions of SDL_MixAudio */
+
+#include "SDL_audio.h"
+#include "SDL_mixer_SSE2.h"
+
+#if SDL_SSE2_MIXERS
+
+#include <emmintrin.h>
+
+/* The C mixer scales with (sample*volume)/SDL_MIX_MAXVOLUME, which rounds
+   toward zero, so negative products get 127 added before the shift.
+*/
+
+/* Scale eight signed 16 bit samples by volume (in every 16 bit lane) */
+static __inline__ __m128i AdjustVolumeS16_SSE2(__m128i s, __m128i vol)
+{
+	__m128i lo = _mm_mullo_epi16(s, vol);
+	__m128i hi = _mm_mulhi_epi16(s, vol);
+	__m128i p0 = _mm_unpacklo_epi16(lo, hi);
+	__m128i p1 = _mm_unpackhi_epi16(lo, hi);
+
+	p0 = _mm_add_epi32(p0, _mm_srli_epi32(_mm_srai_epi32(p0, 31), 25));
+	p1 = _mm_add_epi32(p1, _mm_srli_epi32(_mm_srai_epi32(p1, 31), 25));
+	return _mm_packs_epi32(_mm_srai_epi32(p0, 7), _mm_srai_epi32(p1, 7));
+}
+
+/* Scale sixteen signed 8 bit samples by volume (in every 16 bit lane) */
+static __inline__ __m128i AdjustVolumeS8_SSE2(__m128i s, __m128i vol)
+{
+	__m128i lo = _mm_srai_epi16(_mm_unpacklo_epi8(s, s), 8);
+	__m128i hi = _mm_srai_epi16(_mm_unpackhi_epi8(s, s), 8);
+
+	lo = _mm_mullo_epi16(lo, vol);
+	hi = _mm_mullo_epi16(hi, vol);
+	lo = _mm_add_epi16(lo, _mm_srli_epi16(_mm_srai_epi16(lo, 15), 9));
+	hi = _mm_add_epi16(hi, _mm_srli_epi16(_mm_srai_epi16(hi, 15), 9));
+	return _mm_packs_epi16(_mm_srai_epi16(lo, 7), _mm_srai_epi16(hi, 7));
+}
+
+#define SWAP16_SSE2(x)	_mm_or_si128(_mm_slli_epi16(x, 8), _mm_srli_epi16(x, 8))
+
+Uint32 SDL_MixAudio_SSE2(Uint8 *dst, const Uint8 *src, Uint32 len, int volume, Uint16 format)
+{
+	const __m128i vol = _mm_set1_epi16((short)volume);
+	const __m128i bias = _mm_set1_epi8((char)0x80);
+	Uint32 n;
+
+	len &= ~15;
+	switch (format) {
+		case AUDIO_U8:
+			/* mix8[] is the sum less 128, clamped to 0..0xFE */
+			for ( n = len; n; n -= 16 ) {
+				__m128i s = _mm_loadu_si128((const __m128i *)src);
+				__m128i d = _mm_loadu_si128((__m128i *)dst);
+				s = AdjustVolumeS8_SSE2(_mm_xor_si128(s, bias), vol);
+				d = _mm_xor_si128(_mm_adds_epi8(_mm_xor_si128(d, bias), s), bias);
+				d = _mm_min_epu8(d, _mm_set1_epi8((char)0xFE));
+				_mm_storeu_si128((__m128i *)dst, d);
+				src += 16;
+				dst += 16;
+			}
+			break;
+
+		case AUDIO_S8:
+			for ( n = len; n; n -= 16 ) {
+				__m128i s = _mm_loadu_si128((const __m128i *)src);
+				__m128i d = _mm_loadu_si128((__m128i *)dst);
+				s = AdjustVolumeS8_SSE2(s, vol);
+				_mm_storeu_si128((__m128i *)dst, _mm_adds_epi8(d, s));
+				src += 16;
+				dst += 16;
+			}
+			break;
+
+		case AUDIO_S16LSB:
+			for ( n = len; n; n -= 16 ) {
+				__m128i s = _mm_loadu_si128((const __m128i *)src);
+				__m128i d = _mm_loadu_si128((__m128i *)dst);
+				s = AdjustVolumeS16_SSE2(s, vol);
+				_mm_storeu_si128((__m128i *)dst, _mm_adds_epi16(d, s));
+				src += 16;
+				dst += 16;
+			}
+			break;
+
+		case AUDIO_S16MSB:
+			for ( n = len; n; n -= 16 ) {
+				__m128i s = _mm_loadu_si128((const __m128i *)src);
+				__m128i d = _mm_loadu_si128((__m128i *)dst);
+				s = AdjustVolumeS16_SSE2(SWAP16_SSE2(s), vol);
+				d = _mm_adds_epi16(SWAP16_SSE2(d), s);
+				_mm_storeu_si128((__m128i *)dst, SWAP16_SSE2(d));
+				src += 16;
+				dst += 16;
+			}
+			break;
+
+		case AUDIO_F32SYS: {
+			const __m128 fvol = _mm_set1_ps((float)volume / SDL_MIX_MAXVOLUME);
+			for ( n = len; n; n -= 16 ) {
+				__m128 s = _mm_loadu_ps((const float *)src);
+				__m128 d = _mm_loadu_ps((float *)dst);
+				_mm_storeu_ps((float *)dst, _mm_add_ps(d, _mm_mul_ps(s, fvol)));
+				src += 16;
+				dst += 16;
+			}
+			break;
+		}
+
+		default:
+			return 0;
+	}
+	return len;
+}
+
+#endif /* SDL_SSE2_MIXERS */
+
+#if SDL_AVX2_MIXERS
+
+#include <immintrin.h>
+
+/* GCC only emits AVX2 code in functions that ask for it */
+#if defined(__GNUC__)
+#define SDL_TARGET_AVX2	__attribute__((target("avx2")))
+#else
+#define SDL_TARGET_AVX2
+#endif
+
+/* Same as the SSE2 versions, with each 128 bit lane done on its own */
+static __inline__ SDL_TARGET_AVX2 __m256i AdjustVolumeS16_AVX2(__m256i s, __m256i vol)
+{
+	__m256i lo = _mm256_mullo_epi16(s, vol);
+	__m256i hi = _mm256_mulhi_epi16(s, vol);
+	__m256i p0 = _mm256_unpacklo_epi16(lo, hi);
+	__m256i p1 = _mm256_unpackhi_epi16(lo, hi);
+
+	p0 = _mm256_add_epi32(p0, _mm256_srli_epi32(_mm256_srai_epi32(p0, 31), 25));
+	p1 = _mm256_add_epi32(p1, _mm256_srli_epi32(_mm256_srai_epi32(p1, 31), 25));
+	return _mm256_packs_epi32(_mm256_srai_epi32(p0, 7), _mm256_srai_epi32(p1, 7));
+}
+
+static __inline__ SDL_TARGET_AVX2 __m256i AdjustVolumeS8_AVX2(__m256i s, __m256i vol)
+{
+	__m256i lo = _mm256_srai_epi16(_mm256_unpacklo_epi8(s, s), 8);
+	__m256i hi = _mm256_srai_epi16(_mm256_unpackhi_epi8(s, s), 8);
+
+	lo = _mm256_mullo_epi16(lo, vol);
+	hi = _mm256_mullo_epi16(hi, vol);
+	lo = _mm256_add_epi16(lo, _mm256_srli_epi16(_mm256_srai_epi16(lo, 15), 9));
+	hi = _mm256_add_epi16(hi, _mm256_srli_epi16(_mm256_srai_epi16(hi, 15), 9));
+	return _mm256_packs_epi16(_mm256_srai_epi16(lo, 7), _mm256_srai_epi16(hi, 7));
+}
+
+#define SWAP16_AVX2(x)	_mm256_or_si256(_mm256_slli_epi16(x, 8), _mm256_srli_epi16(x, 8))
+
+SDL_TARGET_AVX2
+Uint32 SDL_MixAudio_AVX2(Uint8 *dst, const Uint8 *src, Uint32 len, int volume, Uint16 format)
+{
+	const __m256i vol = _mm256_set1_epi16((short)volume);
+	const __m256i bias = _mm256_set1_epi8((char)0x80);
+	Uint32 n;
+
+	len &= ~31;
+	switch (format) {
+		case AUDIO_U8:
+			for ( n = len; n; n -= 32 ) {
+				__m256i s = _mm256_loadu_si256((const __m256i *)src);
+				__m256i d = _mm256_loadu_si256((__m256i *)dst);
+				s = AdjustVolumeS8_AVX2(_mm256_xor_si256(s, bias), vol);
+				d = _mm256_xor_si256(_mm256_adds_epi8(_mm256_xor_si256(d, bias), s), bias);
+				d = _mm256_min_epu8(d, _mm256_set1_epi8((char)0xFE));
+				_mm256_storeu_si256((__m256i *)dst, d);
+				src += 32;
+				dst += 32;
+			}
+			break;
+
+		case AUDIO_S8:
+			for ( n = len; n; n -= 32 ) {
+				__m256i s = _mm256_loadu_si256((const __m256i *)src);
+				__m256i d = _mm256_loadu_si256((__m256i *)dst);
+				s = AdjustVolumeS8_AVX2(s, vol);
+				_mm256_storeu_si256((__m256i *)dst, _mm256_adds_epi8(d, s));
+				src += 32;
+				dst += 32;
+			}
+			break;
+
+		case AUDIO_S16LSB:
+			for ( n = len; n; n -= 32 ) {
+				__m256i s = _mm256_loadu_si256((const __m256i *)src);
+				__m256i d = _mm256_loadu_si256((__m256i *)dst);
+				s = AdjustVolumeS16_AVX2(s, vol);
+				_mm256_storeu_si256((__m256i *)dst, _mm256_adds_epi16(d, s));
+				src += 32;
+				dst += 32;
+			}
+			break;
+
+		case AUDIO_S16MSB:
+			for ( n = len; n; n -= 32 ) {
+				__m256i s = _mm256_loadu_si256((const __m256i *)src);
+				__m256i d = _mm256_loadu_si256((__m256i *)dst);
+				s = AdjustVolumeS16_AVX2(SWAP16_AVX2(s), vol);
+				d = _mm256_adds_epi16(SWAP16_AVX2(d), s);
+				_mm256_storeu_si256((__m256i *)dst, SWAP16_AVX2(d));
+				src += 32;
+				dst += 32;
+			}
+			break;
+
+		case AUDIO_F32SYS: {
+			const __m256 fvol = _mm256_set1_ps((float)volume / SDL_MIX_MAXVOLUME);
+			for ( n = len; n; n -= 32 ) {
+				__m256 s = _mm256_loadu_ps((const float *)src);
+				__m256 d = _mm256_loadu_ps((float *)dst);
+				_mm256_storeu_ps((float *)dst, _mm256_add_ps(d, _mm256_mul_ps(s, fvol)));
+				src += 32;
+				dst += 32;
+			}
+			break;
+		}
+
+		default:
+			return 0;
+	}
+	return len;
+}
+
+#endif /* SDL_AVX2_MIXERS */
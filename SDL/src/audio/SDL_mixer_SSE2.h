@@ -0,0 +1,52 @@
+/*
+    SDL - Simple DirectMedia Layer
+    Copyright (C) 1997-2012 Sam Lantinga
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+
+    Sam Lantinga
+    slouken@libsdl.org
+*/
+#include "SDL_config.h"
+
+/*
+    SSE2 and AVX2 versions of SDL_MixAudio for U8, S8, S16LSB, S16MSB and
+    native float.
+
+    They mix whole vectors only and return the number of bytes done, the
+    caller mixes what is left.  The results are the same as the C mixer's
+    for volumes from 1 to SDL_MIX_MAXVOLUME.  The Xbox CPU has no SSE2.
+*/
+
+#if SDL_ASSEMBLY_ROUTINES
+#  if (defined(__GNUC__) && defined(__SSE2__)) || \
+      (defined(_MSC_VER) && (_MSC_VER >= 1300) && \
+       (defined(_M_IX86) || defined(_M_X64)) && !defined(_XBOX))
+#    define SDL_SSE2_MIXERS	1
+#  endif
+#  if SDL_SSE2_MIXERS && \
+      ((defined(__GNUC__) && ((__GNUC__ > 4) || \
+        (__GNUC__ == 4 && __GNUC_MINOR__ >= 9))) || \
+       defined(__clang__) || (defined(_MSC_VER) && (_MSC_VER >= 1700)))
+#    define SDL_AVX2_MIXERS	1
+#  endif
+#endif /* SDL_ASSEMBLY_ROUTINES */
+
+#if SDL_SSE2_MIXERS
+Uint32 SDL_MixAudio_SSE2(Uint8 *dst, const Uint8 *src, Uint32 len, int volume, Uint16 format);
+#endif
+#if SDL_AVX2_MIXERS
+Uint32 SDL_MixAudio_AVX2(Uint8 *dst, const Uint8 *src, Uint32 len, int volume, Uint16 format);
+#endif
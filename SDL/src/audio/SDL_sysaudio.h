@@ -70,6 +70,11 @@ struct SDL_AudioDevice {
 	/* An audio conversion block for audio format emulation */
 	SDL_AudioCVT convert;
 
+	/* Converted audio waiting to be played, as rate conversion doesn't
+	   come out at exactly a buffer each time */
+	Uint8 *convert_fifo;
+	int convert_fifo_len;
+
 	/* Current state flags */
 	int enabled;
 	int paused;
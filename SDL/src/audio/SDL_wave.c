@@ -459,6 +459,9 @@ SDL_AudioSpec * SDL_LoadWAV_RW (SDL_RWops *src, int freesrc,
 		case PCM_CODE:
 			/* We can understand this */
 			break;
+		case IEEE_FLOAT_CODE:
+			/* So long as it's 32 bits, checked below */
+			break;
 		case MS_ADPCM_CODE:
 			/* Try to understand this */
 			if ( InitMS_ADPCM(format) < 0 ) {
@@ -502,10 +505,17 @@ SDL_AudioSpec * SDL_LoadWAV_RW (SDL_RWops *src, int freesrc,
 		case 16:
 			spec->format = AUDIO_S16;
 			break;
+		case 32:
+			spec->format = AUDIO_F32;
+			break;
 		default:
 			was_error = 1;
 			break;
 	}
+	if ( (spec->format == AUDIO_F32) !=
+	     (SDL_SwapLE16(format->encoding) == IEEE_FLOAT_CODE) ) {
+		was_error = 1;
+	}
 	if ( was_error ) {
 		SDL_SetError("Unknown %d-bit PCM data format",
 			SDL_SwapLE16(format->bitspersample));
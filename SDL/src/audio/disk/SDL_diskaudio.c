@@ -0,0 +1,255 @@
+/*
+    SDL - Simple DirectMedia Layer
+    Copyright (C) 1997-2012 Sam Lantinga
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+
+    Sam Lantinga
+    slouken@libsdl.org
+*/
+#include "SDL_config.h"
+
+/* Output raw audio data to a file.
+
+   The output is a WAV file, named by SDL_DISKAUDIOFILE, in unsigned 8-bit
+   or signed 16-bit little-endian samples; other formats are converted by
+   SDL.  SDL_DISKAUDIODELAY sets the pacing the same way as the dummy
+   driver's SDL_DUMMYAUDIODELAY: unset for the output rate, 0 for as fast
+   as possible, or a number of milliseconds per buffer.
+*/
+
+#include "SDL_rwops.h"
+#include "SDL_timer.h"
+#include "SDL_audio.h"
+#include "../SDL_audiomem.h"
+#include "../SDL_audio_c.h"
+#include "SDL_diskaudio.h"
+
+/* The tag name used by DISK audio */
+#define DISKAUD_DRIVER_NAME         "disk"
+
+/* environment variables and defaults. */
+#define DISKENVR_OUTFILE         "SDL_DISKAUDIOFILE"
+#define DISKDEFAULT_OUTFILE      "sdlaudio.wav"
+#define DISKENVR_WRITEDELAY      "SDL_DISKAUDIODELAY"
+
+/* The data chunk starts after a canonical 44 byte WAV header */
+#define WAV_HEADER_SIZE	44
+
+/* Audio driver functions */
+static int DISKAUD_OpenAudio(_THIS, SDL_AudioSpec *spec);
+static void DISKAUD_WaitAudio(_THIS);
+static void DISKAUD_PlayAudio(_THIS);
+static Uint8 *DISKAUD_GetAudioBuf(_THIS);
+static void DISKAUD_CloseAudio(_THIS);
+
+static const char *DISKAUD_GetOutputFilename(void)
+{
+	const char *envr = SDL_getenv(DISKENVR_OUTFILE);
+	return((envr != NULL) ? envr : DISKDEFAULT_OUTFILE);
+}
+
+/* Audio driver bootstrap functions */
+static int DISKAUD_Available(void)
+{
+	const char *envr = SDL_getenv("SDL_AUDIODRIVER");
+	if (envr && (SDL_strcmp(envr, DISKAUD_DRIVER_NAME) == 0)) {
+		return(1);
+	}
+	return(0);
+}
+
+static void DISKAUD_DeleteDevice(SDL_AudioDevice *device)
+{
+	SDL_free(device->hidden);
+	SDL_free(device);
+}
+
+static SDL_AudioDevice *DISKAUD_CreateDevice(int devindex)
+{
+	SDL_AudioDevice *this;
+
+	/* Initialize all variables that we clean on shutdown */
+	this = (SDL_AudioDevice *)SDL_malloc(sizeof(SDL_AudioDevice));
+	if ( this ) {
+		SDL_memset(this, 0, (sizeof *this));
+		this->hidden = (struct SDL_PrivateAudioData *)
+				SDL_malloc((sizeof *this->hidden));
+	}
+	if ( (this == NULL) || (this->hidden == NULL) ) {
+		SDL_OutOfMemory();
+		if ( this ) {
+			SDL_free(this);
+		}
+		return(0);
+	}
+	SDL_memset(this->hidden, 0, (sizeof *this->hidden));
+
+	/* Set the function pointers */
+	this->OpenAudio = DISKAUD_OpenAudio;
+	this->WaitAudio = DISKAUD_WaitAudio;
+	this->PlayAudio = DISKAUD_PlayAudio;
+	this->GetAudioBuf = DISKAUD_GetAudioBuf;
+	this->CloseAudio = DISKAUD_CloseAudio;
+
+	this->free = DISKAUD_DeleteDevice;
+
+	return this;
+}
+
+AudioBootStrap DISKAUD_bootstrap = {
+	DISKAUD_DRIVER_NAME, "direct-to-disk audio",
+	DISKAUD_Available, DISKAUD_CreateDevice
+};
+
+/* This function waits until it is possible to write a full sound buffer */
+static void DISKAUD_WaitAudio(_THIS)
+{
+	Uint32 now;
+
+	if ( this->hidden->realtime ) {
+		/* Keep the exact buffer length, so there's no drift */
+		this->hidden->next_frac += this->spec.samples * 1000;
+		this->hidden->next_tick += this->hidden->next_frac / this->spec.freq;
+		this->hidden->next_frac %= this->spec.freq;
+	} else if ( this->hidden->write_delay ) {
+		this->hidden->next_tick += this->hidden->write_delay;
+	} else {
+		return;
+	}
+
+	now = SDL_GetTicks();
+	if ( (Sint32)(this->hidden->next_tick - now) > 0 ) {
+		SDL_Delay(this->hidden->next_tick - now);
+	} else {
+		/* We fell behind, don't try to catch up all at once */
+		this->hidden->next_tick = now;
+	}
+}
+
+static void DISKAUD_PlayAudio(_THIS)
+{
+	int written;
+
+	/* Write the audio data */
+	written = SDL_RWwrite(this->hidden->output,
+	                      this->hidden->mixbuf, 1,
+	                      this->hidden->mixlen);
+
+	/* If we couldn't write, assume fatal error for now */
+	if ( (Uint32)written != this->hidden->mixlen ) {
+		this->enabled = 0;
+	}
+	if ( written > 0 ) {
+		this->hidden->written += written;
+	}
+#ifdef DEBUG_AUDIO
+	fprintf(stderr, "Wrote %d bytes of audio data\n", written);
+#endif
+}
+
+static Uint8 *DISKAUD_GetAudioBuf(_THIS)
+{
+	return(this->hidden->mixbuf);
+}
+
+static void DISKAUD_CloseAudio(_THIS)
+{
+	if ( this->hidden->mixbuf != NULL ) {
+		SDL_FreeAudioMem(this->hidden->mixbuf);
+		this->hidden->mixbuf = NULL;
+	}
+	if ( this->hidden->output != NULL ) {
+		/* Fill in the chunk sizes now that the length is known */
+		if ( SDL_RWseek(this->hidden->output, 4, RW_SEEK_SET) == 4 ) {
+			SDL_WriteLE32(this->hidden->output,
+			              WAV_HEADER_SIZE - 8 + this->hidden->written);
+		}
+		if ( SDL_RWseek(this->hidden->output, WAV_HEADER_SIZE - 4,
+		                RW_SEEK_SET) == WAV_HEADER_SIZE - 4 ) {
+			SDL_WriteLE32(this->hidden->output, this->hidden->written);
+		}
+		SDL_RWclose(this->hidden->output);
+		this->hidden->output = NULL;
+	}
+}
+
+static int DISKAUD_OpenAudio(_THIS, SDL_AudioSpec *spec)
+{
+	const char *fname = DISKAUD_GetOutputFilename();
+	const char *envr = SDL_getenv(DISKENVR_WRITEDELAY);
+	SDL_RWops *output;
+	int bits;
+
+	/* WAV files hold unsigned 8-bit or signed 16-bit little-endian data */
+	if ( (spec->format & 0xFF) == 8 ) {
+		spec->format = AUDIO_U8;
+	} else {
+		spec->format = AUDIO_S16LSB;
+	}
+	SDL_CalculateAudioSpec(spec);
+	bits = spec->format & 0xFF;
+
+	/* Open the audio device */
+	output = SDL_RWFromFile(fname, "wb");
+	if ( output == NULL ) {
+		return(-1);
+	}
+	this->hidden->output = output;
+	this->hidden->written = 0;
+
+	/* Write the header, the sizes are filled in on close */
+	SDL_RWwrite(output, "RIFF", 4, 1);
+	SDL_WriteLE32(output, WAV_HEADER_SIZE - 8);
+	SDL_RWwrite(output, "WAVEfmt ", 8, 1);
+	SDL_WriteLE32(output, 16);
+	SDL_WriteLE16(output, 1);		/* PCM */
+	SDL_WriteLE16(output, spec->channels);
+	SDL_WriteLE32(output, spec->freq);
+	SDL_WriteLE32(output, spec->freq * spec->channels * (bits / 8));
+	SDL_WriteLE16(output, (Uint16)(spec->channels * (bits / 8)));
+	SDL_WriteLE16(output, (Uint16)bits);
+	SDL_RWwrite(output, "data", 4, 1);
+	if ( SDL_WriteLE32(output, 0) != 1 ) {
+		SDL_SetError("Couldn't write WAV header to %s", fname);
+		DISKAUD_CloseAudio(this);
+		return(-1);
+	}
+
+	/* Allocate mixing buffer */
+	this->hidden->mixlen = spec->size;
+	this->hidden->mixbuf = (Uint8 *) SDL_AllocAudioMem(this->hidden->mixlen);
+	if ( this->hidden->mixbuf == NULL ) {
+		SDL_OutOfMemory();
+		DISKAUD_CloseAudio(this);
+		return(-1);
+	}
+	SDL_memset(this->hidden->mixbuf, spec->silence, spec->size);
+
+	/* Pace the callback at the output rate unless told otherwise */
+	this->hidden->realtime = (envr == NULL);
+	this->hidden->write_delay = (envr != NULL) ? SDL_atoi(envr) : 0;
+	this->hidden->next_tick = SDL_GetTicks();
+	this->hidden->next_frac = 0;
+
+#if HAVE_STDIO_H
+	fprintf(stderr,
+		"WARNING: You are using the SDL disk writer audio driver!\n"
+		" Writing to file [%s].\n", fname);
+#endif
+
+	/* We're ready to rock and roll. :-) */
+	return(0);
+}
@@ -0,0 +1,48 @@
+/*
+    SDL - Simple DirectMedia Layer
+    Copyright (C) 1997-2012 Sam Lantinga
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+
+    Sam Lantinga
+    slouken@libsdl.org
+*/
+#include "SDL_config.h"
+
+#ifndef _SDL_dummyaudio_h
+#define _SDL_dummyaudio_h
+
+#include "../SDL_sysaudio.h"
+
+/* Hidden "this" pointer for the audio functions */
+#define _THIS	SDL_AudioDevice *this
+
+struct SDL_PrivateAudioData {
+	/* The buffer the callback is mixed into, and then thrown away */
+	Uint8 *mixbuf;
+	Uint32 mixlen;
+
+	/* Pacing: when realtime, a buffer every spec.samples/spec.freq
+	   seconds, otherwise every write_delay milliseconds, or as fast as
+	   possible if that is 0.  next_tick is when the next buffer is due,
+	   and next_frac carries the leftover millisecond, in 1/freq units.
+	*/
+	int realtime;
+	Uint32 write_delay;
+	Uint32 next_tick;
+	Uint32 next_frac;
+};
+
+#endif /* _SDL_dummyaudio_h */
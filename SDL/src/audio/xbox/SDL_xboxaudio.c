@@ -553,6 +553,8 @@ static int XboxDX_OpenAudio(_THIS, SDL_AudioSpec *spec)
 			silence = 0x80;
 			waveformat.wBitsPerSample = 8;
 			break;
+		case 32:
+			/* No float output, SDL converts float to 16 bit */
 		case 16:
 			/* Signed 16 bit audio data */
 			spec->format = AUDIO_S16;
@@ -41,6 +41,8 @@
 #define CPU_HAS_SSE	0x00000040
 #define CPU_HAS_SSE2	0x00000080
 #define CPU_HAS_ALTIVEC	0x00000100
+#define CPU_HAS_AVX2	0x00000200
+#define CPU_HAS_SSSE3	0x00000400
 
 #if SDL_ALTIVEC_BLITTERS && HAVE_SETJMP && !__MACOSX__
 /* This is the brute force way of detecting instruction sets...
@@ -300,6 +302,159 @@ done:
 	return features;
 }
 
+static __inline__ int CPU_getCPUIDFeaturesECX(void)
+{
+	int features = 0;
+#if defined(__GNUC__) && defined(i386)
+	__asm__ (
+"        xorl    %%eax,%%eax         # Set up for CPUID instruction    \n"
+"        pushl   %%ebx                                                 \n"
+"        cpuid                       # Get and save vendor ID          \n"
+"        popl    %%ebx                                                 \n"
+"        cmpl    $1,%%eax            # Make sure 1 is valid input for CPUID\n"
+"        jl      1f                  # We dont have the CPUID instruction\n"
+"        xorl    %%eax,%%eax                                           \n"
+"        incl    %%eax                                                 \n"
+"        pushl   %%ebx                                                 \n"
+"        cpuid                       # Get family/model/stepping/features\n"
+"        popl    %%ebx                                                 \n"
+"        movl    %%ecx,%0                                              \n"
+"1:                                                                    \n"
+	: "=m" (features)
+	:
+	: "%eax", "%ecx", "%edx"
+	);
+#elif defined(__GNUC__) && defined(__x86_64__)
+	__asm__ (
+"        xorl    %%eax,%%eax         # Set up for CPUID instruction    \n"
+"        pushq   %%rbx                                                 \n"
+"        cpuid                       # Get and save vendor ID          \n"
+"        popq    %%rbx                                                 \n"
+"        cmpl    $1,%%eax            # Make sure 1 is valid input for CPUID\n"
+"        jl      1f                  # We dont have the CPUID instruction\n"
+"        xorl    %%eax,%%eax                                           \n"
+"        incl    %%eax                                                 \n"
+"        pushq   %%rbx                                                 \n"
+"        cpuid                       # Get family/model/stepping/features\n"
+"        popq    %%rbx                                                 \n"
+"        movl    %%ecx,%0                                              \n"
+"1:                                                                    \n"
+	: "=m" (features)
+	:
+	: "%rax", "%rcx", "%rdx"
+	);
+#elif (defined(_MSC_VER) && defined(_M_IX86)) || defined(__WATCOMC__)
+	__asm {
+        xor     eax, eax            ; Set up for CPUID instruction
+        push    ebx
+        cpuid                       ; Get and save vendor ID
+        pop     ebx
+        cmp     eax, 1              ; Make sure 1 is valid input for CPUID
+        jl      done                ; We dont have the CPUID instruction
+        xor     eax, eax
+        inc     eax
+        push    ebx
+        cpuid                       ; Get family/model/stepping/features
+        pop     ebx
+        mov     features, ecx
+done:
+	}
+#endif
+	return features;
+}
+
+static __inline__ int CPU_getCPUIDFeatures7(void)
+{
+	int features = 0;
+#if defined(__GNUC__) && defined(i386)
+	__asm__ (
+"        xorl    %%eax,%%eax         # Set up for CPUID instruction    \n"
+"        pushl   %%ebx                                                 \n"
+"        cpuid                       # Get and save vendor ID          \n"
+"        popl    %%ebx                                                 \n"
+"        cmpl    $7,%%eax            # Make sure 7 is valid input for CPUID\n"
+"        jl      1f                  # Nope, we dont have function 7   \n"
+"        movl    $7,%%eax                                              \n"
+"        xorl    %%ecx,%%ecx                                           \n"
+"        pushl   %%ebx                                                 \n"
+"        cpuid                       # Get structured extended features\n"
+"        movl    %%ebx,%%edx                                           \n"
+"        popl    %%ebx                                                 \n"
+"        movl    %%edx,%0                                              \n"
+"1:                                                                    \n"
+	: "=m" (features)
+	:
+	: "%eax", "%ecx", "%edx"
+	);
+#elif defined(__GNUC__) && defined(__x86_64__)
+	__asm__ (
+"        xorl    %%eax,%%eax         # Set up for CPUID instruction    \n"
+"        pushq   %%rbx                                                 \n"
+"        cpuid                       # Get and save vendor ID          \n"
+"        popq    %%rbx                                                 \n"
+"        cmpl    $7,%%eax            # Make sure 7 is valid input for CPUID\n"
+"        jl      1f                  # Nope, we dont have function 7   \n"
+"        movl    $7,%%eax                                              \n"
+"        xorl    %%ecx,%%ecx                                           \n"
+"        pushq   %%rbx                                                 \n"
+"        cpuid                       # Get structured extended features\n"
+"        movl    %%ebx,%%edx                                           \n"
+"        popq    %%rbx                                                 \n"
+"        movl    %%edx,%0                                              \n"
+"1:                                                                    \n"
+	: "=m" (features)
+	:
+	: "%rax", "%rcx", "%rdx"
+	);
+#elif (defined(_MSC_VER) && defined(_M_IX86)) || defined(__WATCOMC__)
+	__asm {
+        xor     eax, eax            ; Set up for CPUID instruction
+        push    ebx
+        cpuid                       ; Get and save vendor ID
+        pop     ebx
+        cmp     eax, 7              ; Make sure 7 is valid input for CPUID
+        jl      done                ; Nope, we dont have function 7
+        mov     eax, 7
+        xor     ecx, ecx
+        push    ebx
+        cpuid                       ; Get structured extended features
+        mov     edx, ebx
+        pop     ebx
+        mov     features, edx
+done:
+	}
+#endif
+	return features;
+}
+
+/* AVX registers are only usable if the OS saves them on context switch */
+static __inline__ int CPU_OSSavesYMM(void)
+{
+	int xcr0 = 0;
+	if ( !(CPU_getCPUIDFeaturesECX() & 0x08000000) ) {
+		return 0;	/* No OSXSAVE, so no XGETBV either */
+	}
+#if defined(__GNUC__) && (defined(i386) || defined(__x86_64__))
+	__asm__ (
+"        xorl    %%ecx,%%ecx         # Read XCR0                       \n"
+"        .byte   0x0f, 0x01, 0xd0    # xgetbv                          \n"
+"        movl    %%eax,%0                                              \n"
+	: "=m" (xcr0)
+	:
+	: "%eax", "%ecx", "%edx"
+	);
+#elif (defined(_MSC_VER) && defined(_M_IX86)) || defined(__WATCOMC__)
+	__asm {
+        xor     ecx, ecx            ; Read XCR0
+        _emit   0x0f                ; xgetbv
+        _emit   0x01
+        _emit   0xd0
+        mov     xcr0, eax
+	}
+#endif
+	return ((xcr0 & 0x00000006) == 0x00000006);
+}
+
 static __inline__ int CPU_haveRDTSC(void)
 {
 	if ( CPU_haveCPUID() ) {
@@ -356,6 +511,24 @@ static __inline__ int CPU_haveSSE2(void)
 	return 0;
 }
 
+static __inline__ int CPU_haveSSSE3(void)
+{
+	if ( CPU_haveCPUID() ) {
+		return (CPU_getCPUIDFeaturesECX() & 0x00000200);
+	}
+	return 0;
+}
+
+static __inline__ int CPU_haveAVX2(void)
+{
+	if ( CPU_haveCPUID() ) {
+		if ( (CPU_getCPUIDFeaturesECX() & 0x10000000) && CPU_OSSavesYMM() ) {
+			return (CPU_getCPUIDFeatures7() & 0x00000020);
+		}
+	}
+	return 0;
+}
+
 static __inline__ int CPU_haveAltiVec(void)
 {
 	volatile int altivec = 0;
@@ -408,6 +581,12 @@ static Uint32 SDL_GetCPUFeatures(void)
 		if ( CPU_haveSSE2() ) {
 			SDL_CPUFeatures |= CPU_HAS_SSE2;
 		}
+		if ( CPU_haveSSSE3() ) {
+			SDL_CPUFeatures |= CPU_HAS_SSSE3;
+		}
+		if ( CPU_haveAVX2() ) {
+			SDL_CPUFeatures |= CPU_HAS_AVX2;
+		}
 		if ( CPU_haveAltiVec() ) {
 			SDL_CPUFeatures |= CPU_HAS_ALTIVEC;
 		}
@@ -471,6 +650,22 @@ SDL_bool SDL_HasSSE2(void)
 	return SDL_FALSE;
 }
 
+SDL_bool SDL_HasSSSE3(void)
+{
+	if ( SDL_GetCPUFeatures() & CPU_HAS_SSSE3 ) {
+		return SDL_TRUE;
+	}
+	return SDL_FALSE;
+}
+
+SDL_bool SDL_HasAVX2(void)
+{
+	if ( SDL_GetCPUFeatures() & CPU_HAS_AVX2 ) {
+		return SDL_TRUE;
+	}
+	return SDL_FALSE;
+}
+
 SDL_bool SDL_HasAltiVec(void)
 {
 	if ( SDL_GetCPUFeatures() & CPU_HAS_ALTIVEC ) {
@@ -492,6 +687,8 @@ int main()
 	printf("3DNowExt: %d\n", SDL_Has3DNowExt());
 	printf("SSE: %d\n", SDL_HasSSE());
 	printf("SSE2: %d\n", SDL_HasSSE2());
+	printf("SSSE3: %d\n", SDL_HasSSSE3());
+	printf("AVX2: %d\n", SDL_HasAVX2());
 	printf("AltiVec: %d\n", SDL_HasAltiVec());
 	return 0;
 }
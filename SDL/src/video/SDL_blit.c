@@ -229,6 +229,33 @@ static void SDL_BlitCopyOverlap(SDL_BlitInfo *info)
 	}
 }
 
+#if SDL_SSE2_BLITTERS
+/* Blit the leftmost (width % pixels) columns with the C blitter and
+   point vinfo at the rest of each row, which is a multiple of pixels. */
+void SDL_SplitVectorBlit(SDL_BlitInfo *info, SDL_BlitInfo *vinfo,
+                         SDL_loblit cblit, int pixels)
+{
+	int lead = info->d_width % pixels;
+	int srcbpp = info->src->BytesPerPixel;
+	int dstbpp = info->dst->BytesPerPixel;
+
+	*vinfo = *info;
+	if ( lead ) {
+		SDL_BlitInfo cinfo = *info;
+		cinfo.d_width = lead;
+		cinfo.s_skip += (info->d_width - lead) * srcbpp;
+		cinfo.d_skip += (info->d_width - lead) * dstbpp;
+		cblit(&cinfo);
+
+		vinfo->d_width -= lead;
+		vinfo->s_pixels += lead * srcbpp;
+		vinfo->s_skip += lead * srcbpp;
+		vinfo->d_pixels += lead * dstbpp;
+		vinfo->d_skip += lead * dstbpp;
+	}
+}
+#endif /* SDL_SSE2_BLITTERS */
+
 /* Figure out which of many blit routines to set up on a surface */
 int SDL_CalculateBlit(SDL_Surface *surface)
 {
@@ -26,6 +26,41 @@
 
 #include "SDL_endian.h"
 
+/* SSE2, SSSE3 and AVX2 blitters are written with compiler intrinsics and
+   are picked at runtime with SDL_HasSSE2(), SDL_HasSSSE3() and
+   SDL_HasAVX2().  The Xbox CPU is a Pentium III, which stops at SSE, so
+   it never builds them.
+*/
+#if SDL_ASSEMBLY_ROUTINES
+#  if (defined(__GNUC__) && defined(__SSE2__)) || \
+      (defined(_MSC_VER) && (_MSC_VER >= 1300) && \
+       (defined(_M_IX86) || defined(_M_X64)) && !defined(_XBOX))
+#    define SDL_SSE2_BLITTERS	1
+#  endif
+#  if SDL_SSE2_BLITTERS && \
+      ((defined(__GNUC__) && ((__GNUC__ > 4) || \
+        (__GNUC__ == 4 && __GNUC_MINOR__ >= 9))) || \
+       defined(__clang__) || (defined(_MSC_VER) && (_MSC_VER >= 1700)))
+#    define SDL_SSSE3_BLITTERS	1
+#    define SDL_AVX2_BLITTERS	1
+#  endif
+#endif /* SDL_ASSEMBLY_ROUTINES */
+
+#if SDL_SSE2_BLITTERS
+#include <emmintrin.h>
+#endif
+#if SDL_AVX2_BLITTERS
+#include <immintrin.h>
+/* GCC only emits SSSE3 and AVX2 code in functions that ask for it */
+#  if defined(__GNUC__)
+#    define SDL_TARGET_SSSE3	__attribute__((target("ssse3")))
+#    define SDL_TARGET_AVX2	__attribute__((target("avx2")))
+#  else
+#    define SDL_TARGET_SSSE3
+#    define SDL_TARGET_AVX2
+#  endif
+#endif
+
 /* The structure passed to the low level blit functions */
 typedef struct {
 	Uint8 *s_pixels;
@@ -69,6 +104,10 @@ typedef struct SDL_BlitMap {
 
 /* Functions found in SDL_blit.c */
 extern int SDL_CalculateBlit(SDL_Surface *surface);
+#if SDL_SSE2_BLITTERS
+extern void SDL_SplitVectorBlit(SDL_BlitInfo *info, SDL_BlitInfo *vinfo,
+                                SDL_loblit cblit, int pixels);
+#endif
 
 /* Functions found in SDL_blit_{0,1,N,A}.c */
 extern SDL_loblit SDL_CalculateBlit0(SDL_Surface *surface, int complex);
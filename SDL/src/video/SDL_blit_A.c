@@ -2719,6 +2719,477 @@ static void BlitNtoNPixelAlpha(SDL_BlitInfo *info)
 	}
 }
 
+#if SDL_SSE2_BLITTERS
+/*
+ * The SSE2 and AVX2 blitters reproduce the C blitters above bit for bit,
+ * packed-channel rounding included, so which one runs never changes the
+ * picture.  Columns that don't fill a whole vector go to the C blitter.
+ */
+
+/* Only 8 bits per channel 32-bit formats go through the vector N->N path */
+static int IsVectorNtoNPixelAlpha(SDL_PixelFormat *sf, SDL_PixelFormat *df)
+{
+	return (sf->BytesPerPixel == 4 && df->BytesPerPixel == 4
+		&& sf->Rloss == 0 && sf->Gloss == 0 && sf->Bloss == 0
+		&& sf->Aloss == 0
+		&& df->Rloss == 0 && df->Gloss == 0 && df->Bloss == 0
+		&& (df->Amask == 0 || df->Aloss == 0));
+}
+
+/* 32-bit lane multiply; a holds the same 16-bit factor in both halves */
+static __inline__ __m128i MulLo32SSE2(__m128i v, __m128i a)
+{
+	__m128i lo = _mm_mullo_epi16(v, a);
+	__m128i hi = _mm_mulhi_epu16(v, a);
+	return _mm_add_epi32(lo, _mm_slli_epi32(hi, 16));
+}
+
+/* fast ARGB888->(A)RGB888 blending with pixel alpha */
+static void BlitRGBtoRGBPixelAlphaSSE2(SDL_BlitInfo *info)
+{
+	SDL_BlitInfo vinfo;
+	int width, height, srcskip, dstskip;
+	Uint32 *srcp, *dstp;
+	__m128i zero, rbmask, gmask, amask, opaque;
+
+	SDL_SplitVectorBlit(info, &vinfo, BlitRGBtoRGBPixelAlpha, 4);
+	width = vinfo.d_width >> 2;
+	height = vinfo.d_height;
+	srcp = (Uint32 *)vinfo.s_pixels;
+	srcskip = vinfo.s_skip >> 2;
+	dstp = (Uint32 *)vinfo.d_pixels;
+	dstskip = vinfo.d_skip >> 2;
+	if ( !width ) {
+		return;
+	}
+
+	zero = _mm_setzero_si128();
+	rbmask = _mm_set1_epi32(0x00ff00ff);
+	gmask = _mm_set1_epi32(0x0000ff00);
+	amask = _mm_set1_epi32(0xff000000);
+	opaque = _mm_set1_epi32(SDL_ALPHA_OPAQUE);
+
+	while ( height-- ) {
+		int n;
+		for ( n = width; n > 0; --n ) {
+			__m128i s = _mm_loadu_si128((__m128i *)srcp);
+			__m128i alpha = _mm_srli_epi32(s, 24);
+			/* skip fully transparent runs without touching dst */
+			if ( _mm_movemask_epi8(_mm_cmpeq_epi32(alpha, zero)) != 0xffff ) {
+				__m128i d = _mm_loadu_si128((__m128i *)dstp);
+				__m128i a = _mm_or_si128(alpha, _mm_slli_epi32(alpha, 16));
+				__m128i s1, d1, d2, op;
+
+				/* red and blue in parallel, then green */
+				s1 = _mm_and_si128(s, rbmask);
+				d1 = _mm_and_si128(d, rbmask);
+				d1 = _mm_add_epi32(d1, _mm_srli_epi32(
+					MulLo32SSE2(_mm_sub_epi32(s1, d1), a), 8));
+				d1 = _mm_and_si128(d1, rbmask);
+				s1 = _mm_and_si128(s, gmask);
+				d2 = _mm_and_si128(d, gmask);
+				d2 = _mm_add_epi32(d2, _mm_srli_epi32(
+					MulLo32SSE2(_mm_sub_epi32(s1, d2), a), 8));
+				d2 = _mm_and_si128(d2, gmask);
+				d1 = _mm_or_si128(_mm_or_si128(d1, d2),
+				                  _mm_and_si128(d, amask));
+
+				/* opaque alpha -- copy RGB, keep dst alpha */
+				s1 = _mm_or_si128(_mm_andnot_si128(amask, s),
+				                  _mm_and_si128(d, amask));
+				op = _mm_cmpeq_epi32(alpha, opaque);
+				d = _mm_or_si128(_mm_and_si128(op, s1),
+				                 _mm_andnot_si128(op, d1));
+				_mm_storeu_si128((__m128i *)dstp, d);
+			}
+			srcp += 4;
+			dstp += 4;
+		}
+		srcp += srcskip;
+		dstp += dstskip;
+	}
+}
+
+/* fast RGB888->(A)RGB888 blending with surface alpha */
+static void BlitRGBtoRGBSurfaceAlphaSSE2(SDL_BlitInfo *info)
+{
+	unsigned alpha = info->src->alpha;
+	SDL_BlitInfo vinfo;
+	int width, height, srcskip, dstskip;
+	Uint32 *srcp, *dstp;
+	__m128i zero, rbmask, amask, a;
+
+	/* the C version pairs pixels from the left, so keep the
+	   vectors in step with its pairs */
+	SDL_SplitVectorBlit(info, &vinfo, BlitRGBtoRGBSurfaceAlpha, 4);
+	width = vinfo.d_width >> 2;
+	height = vinfo.d_height;
+	srcp = (Uint32 *)vinfo.s_pixels;
+	srcskip = vinfo.s_skip >> 2;
+	dstp = (Uint32 *)vinfo.d_pixels;
+	dstskip = vinfo.d_skip >> 2;
+	if ( !width ) {
+		return;
+	}
+
+	zero = _mm_setzero_si128();
+	rbmask = _mm_set1_epi32(0x00ff00ff);
+	amask = _mm_set1_epi32(0xff000000);
+	a = _mm_set1_epi32(alpha | (alpha << 16));
+
+	if ( alpha == 128 ) {
+		__m128i hmask = _mm_set1_epi32(0x00fefefe);
+		__m128i lmask = _mm_set1_epi32(0x00010101);
+
+		while ( height-- ) {
+			int n;
+			for ( n = width; n > 0; --n ) {
+				__m128i s = _mm_loadu_si128((__m128i *)srcp);
+				__m128i d = _mm_loadu_si128((__m128i *)dstp);
+				__m128i d1;
+
+				d1 = _mm_add_epi32(_mm_and_si128(s, hmask),
+				                   _mm_and_si128(d, hmask));
+				d1 = _mm_srli_epi32(d1, 1);
+				d = _mm_and_si128(_mm_and_si128(s, d), lmask);
+				d = _mm_or_si128(_mm_add_epi32(d1, d), amask);
+				_mm_storeu_si128((__m128i *)dstp, d);
+				srcp += 4;
+				dstp += 4;
+			}
+			srcp += srcskip;
+			dstp += dstskip;
+		}
+	} else {
+		__m128i gbyte = _mm_set1_epi32(0xff);
+
+		while ( height-- ) {
+			int n;
+			for ( n = width; n > 0; --n ) {
+				__m128i s = _mm_loadu_si128((__m128i *)srcp);
+				__m128i d = _mm_loadu_si128((__m128i *)dstp);
+				__m128i s1, d1, sg, dg;
+
+				s1 = _mm_and_si128(s, rbmask);
+				d1 = _mm_and_si128(d, rbmask);
+				d1 = _mm_add_epi32(d1, _mm_srli_epi32(
+					MulLo32SSE2(_mm_sub_epi32(s1, d1), a), 8));
+				d1 = _mm_and_si128(d1, rbmask);
+
+				/* green of each pixel pair shares one 32-bit
+				   word: 0G0G, low pixel first */
+				sg = _mm_and_si128(_mm_srli_epi32(s, 8), gbyte);
+				sg = _mm_packs_epi32(sg, zero);
+				dg = _mm_and_si128(_mm_srli_epi32(d, 8), gbyte);
+				dg = _mm_packs_epi32(dg, zero);
+				dg = _mm_add_epi32(dg, _mm_srli_epi32(
+					MulLo32SSE2(_mm_sub_epi32(sg, dg), a), 8));
+				dg = _mm_and_si128(dg, rbmask);
+				dg = _mm_slli_epi32(_mm_unpacklo_epi16(dg, zero), 8);
+
+				d = _mm_or_si128(_mm_or_si128(d1, dg), amask);
+				_mm_storeu_si128((__m128i *)dstp, d);
+				srcp += 4;
+				dstp += 4;
+			}
+			srcp += srcskip;
+			dstp += dstskip;
+		}
+	}
+}
+
+/* ALPHA_BLEND() on one channel of four pixels, unsigned wraparound and all */
+static __inline__ __m128i BlendChannelSSE2(__m128i s, __m128i d, __m128i a,
+                                          int sshift, int dshift)
+{
+	__m128i chan = _mm_set1_epi32(0xff);
+	__m128i dcount = _mm_cvtsi32_si128(dshift);
+	__m128i sc = _mm_and_si128(_mm_srl_epi32(s, _mm_cvtsi32_si128(sshift)), chan);
+	__m128i dc = _mm_and_si128(_mm_srl_epi32(d, dcount), chan);
+
+	sc = MulLo32SSE2(_mm_sub_epi32(sc, dc), a);
+	sc = _mm_srli_epi32(_mm_add_epi32(sc, chan), 8);
+	return _mm_sll_epi32(_mm_add_epi32(sc, dc), dcount);
+}
+
+/* N->N blending with pixel alpha for 8 bits per channel 32-bit formats */
+static void BlitNtoNPixelAlphaSSE2(SDL_BlitInfo *info)
+{
+	SDL_PixelFormat *srcfmt = info->src;
+	SDL_PixelFormat *dstfmt = info->dst;
+	SDL_BlitInfo vinfo;
+	int width, height, srcskip, dstskip;
+	Uint32 *srcp, *dstp;
+	__m128i zero, chan, damask, ashift;
+
+	SDL_SplitVectorBlit(info, &vinfo, BlitNtoNPixelAlpha, 4);
+	width = vinfo.d_width >> 2;
+	height = vinfo.d_height;
+	srcp = (Uint32 *)vinfo.s_pixels;
+	srcskip = vinfo.s_skip >> 2;
+	dstp = (Uint32 *)vinfo.d_pixels;
+	dstskip = vinfo.d_skip >> 2;
+	if ( !width ) {
+		return;
+	}
+
+	zero = _mm_setzero_si128();
+	chan = _mm_set1_epi32(0xff);
+	damask = _mm_set1_epi32(dstfmt->Amask);
+	ashift = _mm_cvtsi32_si128(srcfmt->Ashift);
+
+	while ( height-- ) {
+		int n;
+		for ( n = width; n > 0; --n ) {
+			__m128i s = _mm_loadu_si128((__m128i *)srcp);
+			__m128i alpha = _mm_and_si128(_mm_srl_epi32(s, ashift), chan);
+			__m128i skip = _mm_cmpeq_epi32(alpha, zero);
+			if ( _mm_movemask_epi8(skip) != 0xffff ) {
+				__m128i d = _mm_loadu_si128((__m128i *)dstp);
+				__m128i a = _mm_or_si128(alpha, _mm_slli_epi32(alpha, 16));
+				__m128i p = _mm_and_si128(d, damask);
+
+				p = _mm_or_si128(p, BlendChannelSSE2(s, d, a,
+					srcfmt->Rshift, dstfmt->Rshift));
+				p = _mm_or_si128(p, BlendChannelSSE2(s, d, a,
+					srcfmt->Gshift, dstfmt->Gshift));
+				p = _mm_or_si128(p, BlendChannelSSE2(s, d, a,
+					srcfmt->Bshift, dstfmt->Bshift));
+				d = _mm_or_si128(_mm_and_si128(skip, d),
+				                 _mm_andnot_si128(skip, p));
+				_mm_storeu_si128((__m128i *)dstp, d);
+			}
+			srcp += 4;
+			dstp += 4;
+		}
+		srcp += srcskip;
+		dstp += dstskip;
+	}
+}
+#endif /* SDL_SSE2_BLITTERS */
+
+#if SDL_AVX2_BLITTERS
+/* fast ARGB888->(A)RGB888 blending with pixel alpha */
+static SDL_TARGET_AVX2 void BlitRGBtoRGBPixelAlphaAVX2(SDL_BlitInfo *info)
+{
+	SDL_BlitInfo vinfo;
+	int width, height, srcskip, dstskip;
+	Uint32 *srcp, *dstp;
+	__m256i zero, rbmask, gmask, amask, opaque;
+
+	SDL_SplitVectorBlit(info, &vinfo, BlitRGBtoRGBPixelAlpha, 8);
+	width = vinfo.d_width >> 3;
+	height = vinfo.d_height;
+	srcp = (Uint32 *)vinfo.s_pixels;
+	srcskip = vinfo.s_skip >> 2;
+	dstp = (Uint32 *)vinfo.d_pixels;
+	dstskip = vinfo.d_skip >> 2;
+	if ( !width ) {
+		return;
+	}
+
+	zero = _mm256_setzero_si256();
+	rbmask = _mm256_set1_epi32(0x00ff00ff);
+	gmask = _mm256_set1_epi32(0x0000ff00);
+	amask = _mm256_set1_epi32(0xff000000);
+	opaque = _mm256_set1_epi32(SDL_ALPHA_OPAQUE);
+
+	while ( height-- ) {
+		int n;
+		for ( n = width; n > 0; --n ) {
+			__m256i s = _mm256_loadu_si256((__m256i *)srcp);
+			__m256i alpha = _mm256_srli_epi32(s, 24);
+			/* skip fully transparent runs without touching dst */
+			if ( _mm256_movemask_epi8(_mm256_cmpeq_epi32(alpha, zero)) != -1 ) {
+				__m256i d = _mm256_loadu_si256((__m256i *)dstp);
+				__m256i s1, d1, d2, op;
+
+				/* red and blue in parallel, then green */
+				s1 = _mm256_and_si256(s, rbmask);
+				d1 = _mm256_and_si256(d, rbmask);
+				d1 = _mm256_add_epi32(d1, _mm256_srli_epi32(
+					_mm256_mullo_epi32(_mm256_sub_epi32(s1, d1), alpha), 8));
+				d1 = _mm256_and_si256(d1, rbmask);
+				s1 = _mm256_and_si256(s, gmask);
+				d2 = _mm256_and_si256(d, gmask);
+				d2 = _mm256_add_epi32(d2, _mm256_srli_epi32(
+					_mm256_mullo_epi32(_mm256_sub_epi32(s1, d2), alpha), 8));
+				d2 = _mm256_and_si256(d2, gmask);
+				d1 = _mm256_or_si256(_mm256_or_si256(d1, d2),
+				                     _mm256_and_si256(d, amask));
+
+				/* opaque alpha -- copy RGB, keep dst alpha */
+				s1 = _mm256_or_si256(_mm256_andnot_si256(amask, s),
+				                     _mm256_and_si256(d, amask));
+				op = _mm256_cmpeq_epi32(alpha, opaque);
+				d = _mm256_blendv_epi8(d1, s1, op);
+				_mm256_storeu_si256((__m256i *)dstp, d);
+			}
+			srcp += 8;
+			dstp += 8;
+		}
+		srcp += srcskip;
+		dstp += dstskip;
+	}
+}
+
+/* fast RGB888->(A)RGB888 blending with surface alpha */
+static SDL_TARGET_AVX2 void BlitRGBtoRGBSurfaceAlphaAVX2(SDL_BlitInfo *info)
+{
+	unsigned alpha = info->src->alpha;
+	SDL_BlitInfo vinfo;
+	int width, height, srcskip, dstskip;
+	Uint32 *srcp, *dstp;
+	__m256i zero, rbmask, amask, a;
+
+	/* the C version pairs pixels from the left, so keep the
+	   vectors in step with its pairs */
+	SDL_SplitVectorBlit(info, &vinfo, BlitRGBtoRGBSurfaceAlpha, 8);
+	width = vinfo.d_width >> 3;
+	height = vinfo.d_height;
+	srcp = (Uint32 *)vinfo.s_pixels;
+	srcskip = vinfo.s_skip >> 2;
+	dstp = (Uint32 *)vinfo.d_pixels;
+	dstskip = vinfo.d_skip >> 2;
+	if ( !width ) {
+		return;
+	}
+
+	zero = _mm256_setzero_si256();
+	rbmask = _mm256_set1_epi32(0x00ff00ff);
+	amask = _mm256_set1_epi32(0xff000000);
+	a = _mm256_set1_epi32(alpha);
+
+	if ( alpha == 128 ) {
+		__m256i hmask = _mm256_set1_epi32(0x00fefefe);
+		__m256i lmask = _mm256_set1_epi32(0x00010101);
+
+		while ( height-- ) {
+			int n;
+			for ( n = width; n > 0; --n ) {
+				__m256i s = _mm256_loadu_si256((__m256i *)srcp);
+				__m256i d = _mm256_loadu_si256((__m256i *)dstp);
+				__m256i d1;
+
+				d1 = _mm256_add_epi32(_mm256_and_si256(s, hmask),
+				                      _mm256_and_si256(d, hmask));
+				d1 = _mm256_srli_epi32(d1, 1);
+				d = _mm256_and_si256(_mm256_and_si256(s, d), lmask);
+				d = _mm256_or_si256(_mm256_add_epi32(d1, d), amask);
+				_mm256_storeu_si256((__m256i *)dstp, d);
+				srcp += 8;
+				dstp += 8;
+			}
+			srcp += srcskip;
+			dstp += dstskip;
+		}
+	} else {
+		__m256i gbyte = _mm256_set1_epi32(0xff);
+
+		while ( height-- ) {
+			int n;
+			for ( n = width; n > 0; --n ) {
+				__m256i s = _mm256_loadu_si256((__m256i *)srcp);
+				__m256i d = _mm256_loadu_si256((__m256i *)dstp);
+				__m256i s1, d1, sg, dg;
+
+				s1 = _mm256_and_si256(s, rbmask);
+				d1 = _mm256_and_si256(d, rbmask);
+				d1 = _mm256_add_epi32(d1, _mm256_srli_epi32(
+					_mm256_mullo_epi32(_mm256_sub_epi32(s1, d1), a), 8));
+				d1 = _mm256_and_si256(d1, rbmask);
+
+				/* green of each pixel pair shares one 32-bit
+				   word: 0G0G, low pixel first (per 128-bit lane) */
+				sg = _mm256_and_si256(_mm256_srli_epi32(s, 8), gbyte);
+				sg = _mm256_packs_epi32(sg, zero);
+				dg = _mm256_and_si256(_mm256_srli_epi32(d, 8), gbyte);
+				dg = _mm256_packs_epi32(dg, zero);
+				dg = _mm256_add_epi32(dg, _mm256_srli_epi32(
+					_mm256_mullo_epi32(_mm256_sub_epi32(sg, dg), a), 8));
+				dg = _mm256_and_si256(dg, rbmask);
+				dg = _mm256_slli_epi32(_mm256_unpacklo_epi16(dg, zero), 8);
+
+				d = _mm256_or_si256(_mm256_or_si256(d1, dg), amask);
+				_mm256_storeu_si256((__m256i *)dstp, d);
+				srcp += 8;
+				dstp += 8;
+			}
+			srcp += srcskip;
+			dstp += dstskip;
+		}
+	}
+}
+
+/* ALPHA_BLEND() on one channel of eight pixels, unsigned wraparound and all */
+static SDL_TARGET_AVX2 __inline__ __m256i BlendChannelAVX2(__m256i s, __m256i d,
+                                          __m256i a, int sshift, int dshift)
+{
+	__m256i chan = _mm256_set1_epi32(0xff);
+	__m128i dcount = _mm_cvtsi32_si128(dshift);
+	__m256i sc = _mm256_and_si256(_mm256_srl_epi32(s, _mm_cvtsi32_si128(sshift)), chan);
+	__m256i dc = _mm256_and_si256(_mm256_srl_epi32(d, dcount), chan);
+
+	sc = _mm256_mullo_epi32(_mm256_sub_epi32(sc, dc), a);
+	sc = _mm256_srli_epi32(_mm256_add_epi32(sc, chan), 8);
+	return _mm256_sll_epi32(_mm256_add_epi32(sc, dc), dcount);
+}
+
+/* N->N blending with pixel alpha for 8 bits per channel 32-bit formats */
+static SDL_TARGET_AVX2 void BlitNtoNPixelAlphaAVX2(SDL_BlitInfo *info)
+{
+	SDL_PixelFormat *srcfmt = info->src;
+	SDL_PixelFormat *dstfmt = info->dst;
+	SDL_BlitInfo vinfo;
+	int width, height, srcskip, dstskip;
+	Uint32 *srcp, *dstp;
+	__m256i zero, chan, damask;
+	__m128i ashift;
+
+	SDL_SplitVectorBlit(info, &vinfo, BlitNtoNPixelAlpha, 8);
+	width = vinfo.d_width >> 3;
+	height = vinfo.d_height;
+	srcp = (Uint32 *)vinfo.s_pixels;
+	srcskip = vinfo.s_skip >> 2;
+	dstp = (Uint32 *)vinfo.d_pixels;
+	dstskip = vinfo.d_skip >> 2;
+	if ( !width ) {
+		return;
+	}
+
+	zero = _mm256_setzero_si256();
+	chan = _mm256_set1_epi32(0xff);
+	damask = _mm256_set1_epi32(dstfmt->Amask);
+	ashift = _mm_cvtsi32_si128(srcfmt->Ashift);
+
+	while ( height-- ) {
+		int n;
+		for ( n = width; n > 0; --n ) {
+			__m256i s = _mm256_loadu_si256((__m256i *)srcp);
+			__m256i alpha = _mm256_and_si256(_mm256_srl_epi32(s, ashift), chan);
+			__m256i skip = _mm256_cmpeq_epi32(alpha, zero);
+			if ( _mm256_movemask_epi8(skip) != -1 ) {
+				__m256i d = _mm256_loadu_si256((__m256i *)dstp);
+				__m256i p = _mm256_and_si256(d, damask);
+
+				p = _mm256_or_si256(p, BlendChannelAVX2(s, d, alpha,
+					srcfmt->Rshift, dstfmt->Rshift));
+				p = _mm256_or_si256(p, BlendChannelAVX2(s, d, alpha,
+					srcfmt->Gshift, dstfmt->Gshift));
+				p = _mm256_or_si256(p, BlendChannelAVX2(s, d, alpha,
+					srcfmt->Bshift, dstfmt->Bshift));
+				d = _mm256_blendv_epi8(p, d, skip);
+				_mm256_storeu_si256((__m256i *)dstp, d);
+			}
+			srcp += 8;
+			dstp += 8;
+		}
+		srcp += srcskip;
+		dstp += dstskip;
+	}
+}
+#endif /* SDL_AVX2_BLITTERS */
+
 
 SDL_loblit SDL_CalculateAlphaBlit(SDL_Surface *surface, int blit_index)
 {
@@ -2772,6 +3243,17 @@ SDL_loblit SDL_CalculateAlphaBlit(SDL_Surface *surface, int blit_index)
 		   && sf->Bmask == df->Bmask
 		   && sf->BytesPerPixel == 4)
 		{
+#if SDL_SSE2_BLITTERS
+			if((sf->Rmask | sf->Gmask | sf->Bmask) == 0xffffff)
+			{
+#if SDL_AVX2_BLITTERS
+				if(SDL_HasAVX2())
+					return BlitRGBtoRGBSurfaceAlphaAVX2;
+#endif
+				if(SDL_HasSSE2())
+					return BlitRGBtoRGBSurfaceAlphaSSE2;
+			}
+#endif
 #if MMX_ASMBLIT
 			if(sf->Rshift % 8 == 0
 			   && sf->Gshift % 8 == 0
@@ -2833,6 +3315,17 @@ SDL_loblit SDL_CalculateAlphaBlit(SDL_Surface *surface, int blit_index)
 	       && sf->Bmask == df->Bmask
 	       && sf->BytesPerPixel == 4)
 	    {
+#if SDL_SSE2_BLITTERS
+		if(sf->Amask == 0xff000000)
+		{
+#if SDL_AVX2_BLITTERS
+			if(SDL_HasAVX2())
+				return BlitRGBtoRGBPixelAlphaAVX2;
+#endif
+			if(SDL_HasSSE2())
+				return BlitRGBtoRGBPixelAlphaSSE2;
+		}
+#endif
 #if MMX_ASMBLIT
 		if(sf->Rshift % 8 == 0
 		   && sf->Gshift % 8 == 0
@@ -2861,6 +3354,17 @@ SDL_loblit SDL_CalculateAlphaBlit(SDL_Surface *surface, int blit_index)
 	        !(surface->map->dst->flags & SDL_HWSURFACE) && SDL_HasAltiVec())
 		return Blit32to32PixelAlphaAltivec;
 	    else
+#endif
+#if SDL_SSE2_BLITTERS
+	    if(IsVectorNtoNPixelAlpha(sf, df))
+	    {
+#if SDL_AVX2_BLITTERS
+		if(SDL_HasAVX2())
+			return BlitNtoNPixelAlphaAVX2;
+#endif
+		if(SDL_HasSSE2())
+			return BlitNtoNPixelAlphaSSE2;
+	    }
 #endif
 		return BlitNtoNPixelAlpha;
 
@@ -2871,3 +3375,139 @@ SDL_loblit SDL_CalculateAlphaBlit(SDL_Surface *surface, int blit_index)
     }
 }
 
+
+#ifdef TEST_MAIN
+
+#include <stdio.h>
+#include <stdlib.h>
+
+static void SetFormat(SDL_PixelFormat *fmt, int r, int g, int b, int a)
+{
+	SDL_memset(fmt, 0, sizeof(*fmt));
+	fmt->BitsPerPixel = 32;
+	fmt->BytesPerPixel = 4;
+	fmt->Rshift = r;
+	fmt->Gshift = g;
+	fmt->Bshift = b;
+	fmt->Rmask = 0xff << r;
+	fmt->Gmask = 0xff << g;
+	fmt->Bmask = 0xff << b;
+	if ( a < 0 ) {
+		fmt->Aloss = 8;
+	} else {
+		fmt->Ashift = a;
+		fmt->Amask = 0xff << a;
+	}
+	fmt->alpha = SDL_ALPHA_OPAQUE;
+}
+
+/* Run blit and the C reference over the same random rectangle and compare */
+static int CompareBlit(SDL_loblit reference, SDL_loblit blit,
+                       SDL_PixelFormat *sf, SDL_PixelFormat *df)
+{
+	enum { PITCH = 48, ROWS = 7 };
+	Uint32 src[PITCH * ROWS];
+	Uint32 dst[2][PITCH * ROWS];
+	int width, i;
+
+	for ( width = 1; width <= PITCH - 4; ++width ) {
+		SDL_BlitInfo info[2];
+		for ( i = 0; i < PITCH * ROWS; ++i ) {
+			src[i] = (rand() << 16) ^ rand();
+			dst[0][i] = dst[1][i] = (rand() << 16) ^ rand();
+			/* plenty of transparent and opaque pixels */
+			switch ( rand() % 4 ) {
+			    case 0:
+				src[i] &= ~sf->Amask;
+				break;
+			    case 1:
+				src[i] |= sf->Amask;
+				break;
+			}
+		}
+		for ( i = 0; i < 2; ++i ) {
+			/* misalign the rows so the vector loads are unaligned */
+			info[i].s_pixels = (Uint8 *)(src + 1);
+			info[i].s_skip = (PITCH - width) * 4;
+			info[i].d_pixels = (Uint8 *)(dst[i] + 3);
+			info[i].d_skip = (PITCH - width) * 4;
+			info[i].d_width = width;
+			info[i].d_height = ROWS - 1;
+			info[i].src = sf;
+			info[i].dst = df;
+			info[i].table = NULL;
+		}
+		reference(&info[0]);
+		blit(&info[1]);
+		if ( SDL_memcmp(dst[0], dst[1], sizeof(dst[0])) != 0 ) {
+			return 0;
+		}
+	}
+	return 1;
+}
+
+static void Report(const char *name, int okay)
+{
+	printf("%s... %s\n", name, okay ? "okay" : "failed");
+}
+
+int main(int argc, char *argv[])
+{
+	SDL_PixelFormat argb, xrgb, abgr;
+	int okay;
+	int alpha;
+
+	SetFormat(&argb, 16, 8, 0, 24);
+	SetFormat(&xrgb, 16, 8, 0, -1);
+	SetFormat(&abgr, 0, 8, 16, 24);
+
+#if SDL_SSE2_BLITTERS
+	if ( SDL_HasSSE2() ) {
+		Report("SSE2 ARGB->ARGB pixel alpha", CompareBlit(
+			BlitRGBtoRGBPixelAlpha, BlitRGBtoRGBPixelAlphaSSE2,
+			&argb, &argb));
+		okay = 1;
+		for ( alpha = 0; alpha <= 255; ++alpha ) {
+			xrgb.alpha = alpha;
+			okay &= CompareBlit(BlitRGBtoRGBSurfaceAlpha,
+			                    BlitRGBtoRGBSurfaceAlphaSSE2,
+			                    &xrgb, &argb);
+		}
+		Report("SSE2 RGB->ARGB surface alpha", okay);
+		Report("SSE2 ABGR->ARGB pixel alpha", CompareBlit(
+			BlitNtoNPixelAlpha, BlitNtoNPixelAlphaSSE2,
+			&abgr, &argb));
+		Report("SSE2 ABGR->RGB pixel alpha", CompareBlit(
+			BlitNtoNPixelAlpha, BlitNtoNPixelAlphaSSE2,
+			&abgr, &xrgb));
+	} else {
+		printf("SSE2 not available, skipped\n");
+	}
+#endif
+#if SDL_AVX2_BLITTERS
+	if ( SDL_HasAVX2() ) {
+		Report("AVX2 ARGB->ARGB pixel alpha", CompareBlit(
+			BlitRGBtoRGBPixelAlpha, BlitRGBtoRGBPixelAlphaAVX2,
+			&argb, &argb));
+		okay = 1;
+		for ( alpha = 0; alpha <= 255; ++alpha ) {
+			xrgb.alpha = alpha;
+			okay &= CompareBlit(BlitRGBtoRGBSurfaceAlpha,
+			                    BlitRGBtoRGBSurfaceAlphaAVX2,
+			                    &xrgb, &argb);
+		}
+		Report("AVX2 RGB->ARGB surface alpha", okay);
+		Report("AVX2 ABGR->ARGB pixel alpha", CompareBlit(
+			BlitNtoNPixelAlpha, BlitNtoNPixelAlphaAVX2,
+			&abgr, &argb));
+		Report("AVX2 ABGR->RGB pixel alpha", CompareBlit(
+			BlitNtoNPixelAlpha, BlitNtoNPixelAlphaAVX2,
+			&abgr, &xrgb));
+	} else {
+		printf("AVX2 not available, skipped\n");
+	}
+#endif
+	return 0;
+}
+
+#endif /* TEST_MAIN */
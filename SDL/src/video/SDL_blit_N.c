@@ -837,8 +837,10 @@ static Uint32 GetBlitFeatures( void )
 #pragma altivec_model off
 #endif
 #else
-/* Feature 1 is has-MMX */
-#define GetBlitFeatures() ((Uint32)(SDL_HasMMX() ? 1 : 0))
+/* Feature 1 is has-MMX, 8 is has-SSE2 and 32 is has-AVX2 */
+#define GetBlitFeatures() ((Uint32)((SDL_HasMMX() ? 1 : 0) | \
+                                    (SDL_HasSSE2() ? 8 : 0) | \
+                                    (SDL_HasAVX2() ? 32 : 0)))
 #endif
 
 /* This is now endian dependent */
@@ -2269,6 +2271,498 @@ static void BlitNtoNKeyCopyAlpha(SDL_BlitInfo *info)
 	}
 }
 
+#if SDL_SSE2_BLITTERS
+/*
+ * SSE2, SSSE3 and AVX2 converters.  Each one gives exactly the pixels of
+ * the C blitter it stands in for, and leaves the columns that don't fill
+ * a whole vector to that C blitter.
+ */
+
+/* RGB 8-8-8 --> RGB 5-6-5 or 5-5-5 in the low 16 bits of each pixel */
+#define RGB888_16_SSE2(p, rs, gm, gs) \
+	_mm_or_si128(_mm_or_si128( \
+		_mm_srl_epi32(_mm_and_si128(p, _mm_set1_epi32(0x00F80000)), rs), \
+		_mm_srl_epi32(_mm_and_si128(p, gm), gs)), \
+		_mm_srli_epi32(_mm_and_si128(p, _mm_set1_epi32(0x000000F8)), 3))
+
+static void Blit_RGB888_16SSE2(SDL_BlitInfo *info,
+                               int rshift, Uint32 gmask, int gshift)
+{
+	SDL_BlitInfo vinfo;
+	int width, height;
+	Uint8 *src, *dst;
+	int srcskip, dstskip;
+	const __m128i rs = _mm_cvtsi32_si128(rshift);
+	const __m128i gs = _mm_cvtsi32_si128(gshift);
+	const __m128i gm = _mm_set1_epi32(gmask);
+
+	SDL_SplitVectorBlit(info, &vinfo, BlitNtoN, 8);
+	width = vinfo.d_width;
+	height = vinfo.d_height;
+	src = vinfo.s_pixels;
+	srcskip = vinfo.s_skip;
+	dst = vinfo.d_pixels;
+	dstskip = vinfo.d_skip;
+
+	while ( height-- ) {
+		int n;
+		for ( n = width / 8; n; --n ) {
+			__m128i lo = _mm_loadu_si128((__m128i *)src);
+			__m128i hi = _mm_loadu_si128((__m128i *)(src + 16));
+			lo = RGB888_16_SSE2(lo, rs, gm, gs);
+			hi = RGB888_16_SSE2(hi, rs, gm, gs);
+			/* sign extend so the saturating pack keeps all 16 bits */
+			lo = _mm_srai_epi32(_mm_slli_epi32(lo, 16), 16);
+			hi = _mm_srai_epi32(_mm_slli_epi32(hi, 16), 16);
+			_mm_storeu_si128((__m128i *)dst, _mm_packs_epi32(lo, hi));
+			src += 32;
+			dst += 16;
+		}
+		src += srcskip;
+		dst += dstskip;
+	}
+}
+static void Blit_RGB888_RGB565SSE2(SDL_BlitInfo *info)
+{
+	Blit_RGB888_16SSE2(info, 8, 0x0000FC00, 5);
+}
+static void Blit_RGB888_RGB555SSE2(SDL_BlitInfo *info)
+{
+	Blit_RGB888_16SSE2(info, 9, 0x0000F800, 6);
+}
+
+/* RGB 5-6-5 --> 32-bit RGB, widening channels the way the lookup
+   tables do: 5 bits as (x*1053)>>7, 6 bits from two 3-bit halves.
+   The byte left over by the RGB masks is set to 0xFF.
+*/
+static void Blit_RGB565_32SSE2(SDL_BlitInfo *info, SDL_loblit cblit)
+{
+	SDL_BlitInfo vinfo;
+	int width, height;
+	Uint8 *src, *dst;
+	int srcskip, dstskip;
+	SDL_PixelFormat *dstfmt = info->dst;
+	const __m128i rs = _mm_cvtsi32_si128(dstfmt->Rshift);
+	const __m128i gs = _mm_cvtsi32_si128(dstfmt->Gshift);
+	const __m128i bs = _mm_cvtsi32_si128(dstfmt->Bshift);
+	const __m128i fill = _mm_set1_epi32(
+		~(dstfmt->Rmask | dstfmt->Gmask | dstfmt->Bmask));
+	const __m128i m1053 = _mm_set1_epi16(1053);
+	const __m128i m259 = _mm_set1_epi16(259);
+	const __m128i zero = _mm_setzero_si128();
+
+	SDL_SplitVectorBlit(info, &vinfo, cblit, 8);
+	width = vinfo.d_width;
+	height = vinfo.d_height;
+	src = vinfo.s_pixels;
+	srcskip = vinfo.s_skip;
+	dst = vinfo.d_pixels;
+	dstskip = vinfo.d_skip;
+
+	while ( height-- ) {
+		int n;
+		for ( n = width / 8; n; --n ) {
+			__m128i p = _mm_loadu_si128((__m128i *)src);
+			__m128i r, g, b, out;
+
+			r = _mm_srli_epi16(_mm_mullo_epi16(
+				_mm_srli_epi16(p, 11), m1053), 7);
+			b = _mm_srli_epi16(_mm_mullo_epi16(
+				_mm_and_si128(p, _mm_set1_epi16(0x1F)), m1053), 7);
+			g = _mm_and_si128(_mm_srli_epi16(p, 5), _mm_set1_epi16(0x3F));
+			g = _mm_add_epi16(_mm_srli_epi16(_mm_mullo_epi16(
+				_mm_srli_epi16(g, 3), m259), 3),
+				_mm_slli_epi16(_mm_and_si128(g, _mm_set1_epi16(7)), 2));
+
+			out = _mm_or_si128(_mm_or_si128(
+				_mm_sll_epi32(_mm_unpacklo_epi16(r, zero), rs),
+				_mm_sll_epi32(_mm_unpacklo_epi16(g, zero), gs)),
+				_mm_or_si128(
+				_mm_sll_epi32(_mm_unpacklo_epi16(b, zero), bs), fill));
+			_mm_storeu_si128((__m128i *)dst, out);
+			out = _mm_or_si128(_mm_or_si128(
+				_mm_sll_epi32(_mm_unpackhi_epi16(r, zero), rs),
+				_mm_sll_epi32(_mm_unpackhi_epi16(g, zero), gs)),
+				_mm_or_si128(
+				_mm_sll_epi32(_mm_unpackhi_epi16(b, zero), bs), fill));
+			_mm_storeu_si128((__m128i *)(dst + 16), out);
+			src += 16;
+			dst += 32;
+		}
+		src += srcskip;
+		dst += dstskip;
+	}
+}
+static void Blit_RGB565_ARGB8888SSE2(SDL_BlitInfo *info)
+{
+	Blit_RGB565_32SSE2(info, Blit_RGB565_ARGB8888);
+}
+static void Blit_RGB565_ABGR8888SSE2(SDL_BlitInfo *info)
+{
+	Blit_RGB565_32SSE2(info, Blit_RGB565_ABGR8888);
+}
+static void Blit_RGB565_RGBA8888SSE2(SDL_BlitInfo *info)
+{
+	Blit_RGB565_32SSE2(info, Blit_RGB565_RGBA8888);
+}
+static void Blit_RGB565_BGRA8888SSE2(SDL_BlitInfo *info)
+{
+	Blit_RGB565_32SSE2(info, Blit_RGB565_BGRA8888);
+}
+
+#if SDL_SSSE3_BLITTERS
+/* An 8-bit channel sitting on a byte boundary */
+#define BYTE_CHANNEL(mask, shift) \
+	(!((shift) & 7) && (shift) < 32 && (mask) == ((Uint32)0xFF << (shift)))
+
+/* 32-bit formats whose bytes can be rearranged with a byte shuffle */
+static int IsVectorSwizzle(SDL_PixelFormat *sf, SDL_PixelFormat *df)
+{
+	if ( sf->BytesPerPixel != 4 || df->BytesPerPixel != 4 ) {
+		return 0;
+	}
+	if ( !BYTE_CHANNEL(sf->Rmask, sf->Rshift) ||
+	     !BYTE_CHANNEL(sf->Gmask, sf->Gshift) ||
+	     !BYTE_CHANNEL(sf->Bmask, sf->Bshift) ||
+	     !BYTE_CHANNEL(df->Rmask, df->Rshift) ||
+	     !BYTE_CHANNEL(df->Gmask, df->Gshift) ||
+	     !BYTE_CHANNEL(df->Bmask, df->Bshift) ) {
+		return 0;
+	}
+	/* alpha is only copied when both sides have it */
+	if ( sf->Amask && df->Amask ) {
+		return (BYTE_CHANNEL(sf->Amask, sf->Ashift) &&
+		        BYTE_CHANNEL(df->Amask, df->Ashift));
+	}
+	return 1;
+}
+
+/* Build the shuffle moving each source channel byte to its destination
+   byte for four pixels, and the constant ORed into every pixel after it.
+*/
+static Uint32 SwizzleControl(Uint8 *ctrl,
+                             SDL_PixelFormat *sf, SDL_PixelFormat *df)
+{
+	int i;
+
+	SDL_memset(ctrl, 0x80, 16);
+	for ( i = 0; i < 16; i += 4 ) {
+		ctrl[i + df->Rshift / 8] = i + sf->Rshift / 8;
+		ctrl[i + df->Gshift / 8] = i + sf->Gshift / 8;
+		ctrl[i + df->Bshift / 8] = i + sf->Bshift / 8;
+		if ( sf->Amask && df->Amask ) {
+			ctrl[i + df->Ashift / 8] = i + sf->Ashift / 8;
+		}
+	}
+	if ( df->Amask && !sf->Amask ) {
+		return (sf->alpha >> df->Aloss) << df->Ashift;
+	}
+	return 0;
+}
+
+static SDL_TARGET_SSSE3 void Blit32to32SwizzleSSSE3(SDL_BlitInfo *info)
+{
+	SDL_BlitInfo vinfo;
+	int width, height;
+	Uint8 *src, *dst;
+	int srcskip, dstskip;
+	SDL_PixelFormat *srcfmt = info->src;
+	SDL_PixelFormat *dstfmt = info->dst;
+	Uint8 ctrl[16];
+	__m128i shuf, fill;
+
+	fill = _mm_set1_epi32(SwizzleControl(ctrl, srcfmt, dstfmt));
+	shuf = _mm_loadu_si128((__m128i *)ctrl);
+
+	SDL_SplitVectorBlit(info, &vinfo, (srcfmt->Amask && dstfmt->Amask) ?
+	                    BlitNtoNCopyAlpha : BlitNtoN, 4);
+	width = vinfo.d_width;
+	height = vinfo.d_height;
+	src = vinfo.s_pixels;
+	srcskip = vinfo.s_skip;
+	dst = vinfo.d_pixels;
+	dstskip = vinfo.d_skip;
+
+	while ( height-- ) {
+		int n;
+		for ( n = width / 4; n; --n ) {
+			__m128i p = _mm_loadu_si128((__m128i *)src);
+			p = _mm_or_si128(_mm_shuffle_epi8(p, shuf), fill);
+			_mm_storeu_si128((__m128i *)dst, p);
+			src += 16;
+			dst += 16;
+		}
+		src += srcskip;
+		dst += dstskip;
+	}
+}
+
+static SDL_TARGET_SSSE3 void Blit32to32KeySSSE3(SDL_BlitInfo *info)
+{
+	SDL_BlitInfo vinfo;
+	int width, height;
+	Uint8 *src, *dst;
+	int srcskip, dstskip;
+	SDL_PixelFormat *srcfmt = info->src;
+	SDL_PixelFormat *dstfmt = info->dst;
+	Uint32 rgbmask = ~srcfmt->Amask;
+	Uint8 ctrl[16];
+	__m128i shuf, fill, mask, ckey;
+
+	fill = _mm_set1_epi32(SwizzleControl(ctrl, srcfmt, dstfmt));
+	shuf = _mm_loadu_si128((__m128i *)ctrl);
+	mask = _mm_set1_epi32(rgbmask);
+	ckey = _mm_set1_epi32(srcfmt->colorkey & rgbmask);
+
+	SDL_SplitVectorBlit(info, &vinfo, (srcfmt->Amask && dstfmt->Amask) ?
+	                    BlitNtoNKeyCopyAlpha : BlitNtoNKey, 4);
+	width = vinfo.d_width;
+	height = vinfo.d_height;
+	src = vinfo.s_pixels;
+	srcskip = vinfo.s_skip;
+	dst = vinfo.d_pixels;
+	dstskip = vinfo.d_skip;
+
+	while ( height-- ) {
+		int n;
+		for ( n = width / 4; n; --n ) {
+			__m128i p = _mm_loadu_si128((__m128i *)src);
+			__m128i d = _mm_loadu_si128((__m128i *)dst);
+			__m128i key = _mm_cmpeq_epi32(_mm_and_si128(p, mask), ckey);
+			p = _mm_or_si128(_mm_shuffle_epi8(p, shuf), fill);
+			d = _mm_or_si128(_mm_and_si128(key, d),
+			                 _mm_andnot_si128(key, p));
+			_mm_storeu_si128((__m128i *)dst, d);
+			src += 16;
+			dst += 16;
+		}
+		src += srcskip;
+		dst += dstskip;
+	}
+}
+#endif /* SDL_SSSE3_BLITTERS */
+
+#if SDL_AVX2_BLITTERS
+#define RGB888_16_AVX2(p, rs, gm, gs) \
+	_mm256_or_si256(_mm256_or_si256( \
+		_mm256_srl_epi32(_mm256_and_si256(p, \
+			_mm256_set1_epi32(0x00F80000)), rs), \
+		_mm256_srl_epi32(_mm256_and_si256(p, gm), gs)), \
+		_mm256_srli_epi32(_mm256_and_si256(p, \
+			_mm256_set1_epi32(0x000000F8)), 3))
+
+static SDL_TARGET_AVX2 void Blit_RGB888_16AVX2(SDL_BlitInfo *info,
+                               int rshift, Uint32 gmask, int gshift)
+{
+	SDL_BlitInfo vinfo;
+	int width, height;
+	Uint8 *src, *dst;
+	int srcskip, dstskip;
+	const __m128i rs = _mm_cvtsi32_si128(rshift);
+	const __m128i gs = _mm_cvtsi32_si128(gshift);
+	const __m256i gm = _mm256_set1_epi32(gmask);
+
+	SDL_SplitVectorBlit(info, &vinfo, BlitNtoN, 16);
+	width = vinfo.d_width;
+	height = vinfo.d_height;
+	src = vinfo.s_pixels;
+	srcskip = vinfo.s_skip;
+	dst = vinfo.d_pixels;
+	dstskip = vinfo.d_skip;
+
+	while ( height-- ) {
+		int n;
+		for ( n = width / 16; n; --n ) {
+			__m256i lo = _mm256_loadu_si256((__m256i *)src);
+			__m256i hi = _mm256_loadu_si256((__m256i *)(src + 32));
+			lo = RGB888_16_AVX2(lo, rs, gm, gs);
+			hi = RGB888_16_AVX2(hi, rs, gm, gs);
+			lo = _mm256_srai_epi32(_mm256_slli_epi32(lo, 16), 16);
+			hi = _mm256_srai_epi32(_mm256_slli_epi32(hi, 16), 16);
+			/* the pack works per 128-bit lane, put the halves back */
+			lo = _mm256_permute4x64_epi64(_mm256_packs_epi32(lo, hi), 0xD8);
+			_mm256_storeu_si256((__m256i *)dst, lo);
+			src += 64;
+			dst += 32;
+		}
+		src += srcskip;
+		dst += dstskip;
+	}
+}
+static void Blit_RGB888_RGB565AVX2(SDL_BlitInfo *info)
+{
+	Blit_RGB888_16AVX2(info, 8, 0x0000FC00, 5);
+}
+static void Blit_RGB888_RGB555AVX2(SDL_BlitInfo *info)
+{
+	Blit_RGB888_16AVX2(info, 9, 0x0000F800, 6);
+}
+
+static SDL_TARGET_AVX2 void Blit_RGB565_32AVX2(SDL_BlitInfo *info,
+                                               SDL_loblit cblit)
+{
+	SDL_BlitInfo vinfo;
+	int width, height;
+	Uint8 *src, *dst;
+	int srcskip, dstskip;
+	SDL_PixelFormat *dstfmt = info->dst;
+	const __m128i rs = _mm_cvtsi32_si128(dstfmt->Rshift);
+	const __m128i gs = _mm_cvtsi32_si128(dstfmt->Gshift);
+	const __m128i bs = _mm_cvtsi32_si128(dstfmt->Bshift);
+	const __m256i fill = _mm256_set1_epi32(
+		~(dstfmt->Rmask | dstfmt->Gmask | dstfmt->Bmask));
+	const __m256i m1053 = _mm256_set1_epi16(1053);
+	const __m256i m259 = _mm256_set1_epi16(259);
+	const __m256i zero = _mm256_setzero_si256();
+
+	SDL_SplitVectorBlit(info, &vinfo, cblit, 16);
+	width = vinfo.d_width;
+	height = vinfo.d_height;
+	src = vinfo.s_pixels;
+	srcskip = vinfo.s_skip;
+	dst = vinfo.d_pixels;
+	dstskip = vinfo.d_skip;
+
+	while ( height-- ) {
+		int n;
+		for ( n = width / 16; n; --n ) {
+			__m256i p = _mm256_loadu_si256((__m256i *)src);
+			__m256i r, g, b, lo, hi;
+
+			r = _mm256_srli_epi16(_mm256_mullo_epi16(
+				_mm256_srli_epi16(p, 11), m1053), 7);
+			b = _mm256_srli_epi16(_mm256_mullo_epi16(_mm256_and_si256(
+				p, _mm256_set1_epi16(0x1F)), m1053), 7);
+			g = _mm256_and_si256(_mm256_srli_epi16(p, 5),
+			                     _mm256_set1_epi16(0x3F));
+			g = _mm256_add_epi16(_mm256_srli_epi16(_mm256_mullo_epi16(
+				_mm256_srli_epi16(g, 3), m259), 3),
+				_mm256_slli_epi16(_mm256_and_si256(
+					g, _mm256_set1_epi16(7)), 2));
+
+			/* pixels 0-3 and 8-11 */
+			lo = _mm256_or_si256(_mm256_or_si256(
+				_mm256_sll_epi32(_mm256_unpacklo_epi16(r, zero), rs),
+				_mm256_sll_epi32(_mm256_unpacklo_epi16(g, zero), gs)),
+				_mm256_or_si256(_mm256_sll_epi32(
+				_mm256_unpacklo_epi16(b, zero), bs), fill));
+			/* pixels 4-7 and 12-15 */
+			hi = _mm256_or_si256(_mm256_or_si256(
+				_mm256_sll_epi32(_mm256_unpackhi_epi16(r, zero), rs),
+				_mm256_sll_epi32(_mm256_unpackhi_epi16(g, zero), gs)),
+				_mm256_or_si256(_mm256_sll_epi32(
+				_mm256_unpackhi_epi16(b, zero), bs), fill));
+			_mm256_storeu_si256((__m256i *)dst,
+			                    _mm256_permute2x128_si256(lo, hi, 0x20));
+			_mm256_storeu_si256((__m256i *)(dst + 32),
+			                    _mm256_permute2x128_si256(lo, hi, 0x31));
+			src += 32;
+			dst += 64;
+		}
+		src += srcskip;
+		dst += dstskip;
+	}
+}
+static void Blit_RGB565_ARGB8888AVX2(SDL_BlitInfo *info)
+{
+	Blit_RGB565_32AVX2(info, Blit_RGB565_ARGB8888);
+}
+static void Blit_RGB565_ABGR8888AVX2(SDL_BlitInfo *info)
+{
+	Blit_RGB565_32AVX2(info, Blit_RGB565_ABGR8888);
+}
+static void Blit_RGB565_RGBA8888AVX2(SDL_BlitInfo *info)
+{
+	Blit_RGB565_32AVX2(info, Blit_RGB565_RGBA8888);
+}
+static void Blit_RGB565_BGRA8888AVX2(SDL_BlitInfo *info)
+{
+	Blit_RGB565_32AVX2(info, Blit_RGB565_BGRA8888);
+}
+
+static SDL_TARGET_AVX2 void Blit32to32SwizzleAVX2(SDL_BlitInfo *info)
+{
+	SDL_BlitInfo vinfo;
+	int width, height;
+	Uint8 *src, *dst;
+	int srcskip, dstskip;
+	SDL_PixelFormat *srcfmt = info->src;
+	SDL_PixelFormat *dstfmt = info->dst;
+	Uint8 ctrl[16];
+	__m256i shuf, fill;
+
+	fill = _mm256_set1_epi32(SwizzleControl(ctrl, srcfmt, dstfmt));
+	shuf = _mm256_broadcastsi128_si256(_mm_loadu_si128((__m128i *)ctrl));
+
+	SDL_SplitVectorBlit(info, &vinfo, (srcfmt->Amask && dstfmt->Amask) ?
+	                    BlitNtoNCopyAlpha : BlitNtoN, 8);
+	width = vinfo.d_width;
+	height = vinfo.d_height;
+	src = vinfo.s_pixels;
+	srcskip = vinfo.s_skip;
+	dst = vinfo.d_pixels;
+	dstskip = vinfo.d_skip;
+
+	while ( height-- ) {
+		int n;
+		for ( n = width / 8; n; --n ) {
+			__m256i p = _mm256_loadu_si256((__m256i *)src);
+			p = _mm256_or_si256(_mm256_shuffle_epi8(p, shuf), fill);
+			_mm256_storeu_si256((__m256i *)dst, p);
+			src += 32;
+			dst += 32;
+		}
+		src += srcskip;
+		dst += dstskip;
+	}
+}
+
+static SDL_TARGET_AVX2 void Blit32to32KeyAVX2(SDL_BlitInfo *info)
+{
+	SDL_BlitInfo vinfo;
+	int width, height;
+	Uint8 *src, *dst;
+	int srcskip, dstskip;
+	SDL_PixelFormat *srcfmt = info->src;
+	SDL_PixelFormat *dstfmt = info->dst;
+	Uint32 rgbmask = ~srcfmt->Amask;
+	Uint8 ctrl[16];
+	__m256i shuf, fill, mask, ckey;
+
+	fill = _mm256_set1_epi32(SwizzleControl(ctrl, srcfmt, dstfmt));
+	shuf = _mm256_broadcastsi128_si256(_mm_loadu_si128((__m128i *)ctrl));
+	mask = _mm256_set1_epi32(rgbmask);
+	ckey = _mm256_set1_epi32(srcfmt->colorkey & rgbmask);
+
+	SDL_SplitVectorBlit(info, &vinfo, (srcfmt->Amask && dstfmt->Amask) ?
+	                    BlitNtoNKeyCopyAlpha : BlitNtoNKey, 8);
+	width = vinfo.d_width;
+	height = vinfo.d_height;
+	src = vinfo.s_pixels;
+	srcskip = vinfo.s_skip;
+	dst = vinfo.d_pixels;
+	dstskip = vinfo.d_skip;
+
+	while ( height-- ) {
+		int n;
+		for ( n = width / 8; n; --n ) {
+			__m256i p = _mm256_loadu_si256((__m256i *)src);
+			__m256i d = _mm256_loadu_si256((__m256i *)dst);
+			__m256i key = _mm256_cmpeq_epi32(
+				_mm256_and_si256(p, mask), ckey);
+			p = _mm256_or_si256(_mm256_shuffle_epi8(p, shuf), fill);
+			_mm256_storeu_si256((__m256i *)dst,
+			                    _mm256_blendv_epi8(p, d, key));
+			src += 32;
+			dst += 32;
+		}
+		src += srcskip;
+		dst += dstskip;
+	}
+}
+#endif /* SDL_AVX2_BLITTERS */
+#endif /* SDL_SSE2_BLITTERS */
+
 /* Normal N to N optimized blitters */
 struct blit_table {
 	Uint32 srcR, srcG, srcB;
@@ -2284,6 +2778,28 @@ static const struct blit_table normal_blit_1[] = {
 	{ 0,0,0, 0, 0,0,0, 0, NULL, NULL },
 };
 static const struct blit_table normal_blit_2[] = {
+#if SDL_AVX2_BLITTERS
+    /* has-AVX2 */
+    { 0x0000F800,0x000007E0,0x0000001F, 4, 0x00FF0000,0x0000FF00,0x000000FF,
+      32, NULL, Blit_RGB565_ARGB8888AVX2, SET_ALPHA },
+    { 0x0000F800,0x000007E0,0x0000001F, 4, 0x000000FF,0x0000FF00,0x00FF0000,
+      32, NULL, Blit_RGB565_ABGR8888AVX2, SET_ALPHA },
+    { 0x0000F800,0x000007E0,0x0000001F, 4, 0xFF000000,0x00FF0000,0x0000FF00,
+      32, NULL, Blit_RGB565_RGBA8888AVX2, SET_ALPHA },
+    { 0x0000F800,0x000007E0,0x0000001F, 4, 0x0000FF00,0x00FF0000,0xFF000000,
+      32, NULL, Blit_RGB565_BGRA8888AVX2, SET_ALPHA },
+#endif
+#if SDL_SSE2_BLITTERS
+    /* has-SSE2 */
+    { 0x0000F800,0x000007E0,0x0000001F, 4, 0x00FF0000,0x0000FF00,0x000000FF,
+      8, NULL, Blit_RGB565_ARGB8888SSE2, SET_ALPHA },
+    { 0x0000F800,0x000007E0,0x0000001F, 4, 0x000000FF,0x0000FF00,0x00FF0000,
+      8, NULL, Blit_RGB565_ABGR8888SSE2, SET_ALPHA },
+    { 0x0000F800,0x000007E0,0x0000001F, 4, 0xFF000000,0x00FF0000,0x0000FF00,
+      8, NULL, Blit_RGB565_RGBA8888SSE2, SET_ALPHA },
+    { 0x0000F800,0x000007E0,0x0000001F, 4, 0x0000FF00,0x00FF0000,0xFF000000,
+      8, NULL, Blit_RGB565_BGRA8888SSE2, SET_ALPHA },
+#endif
 #if SDL_HERMES_BLITTERS
     { 0x0000F800,0x000007E0,0x0000001F, 2, 0x0000001F,0x000007E0,0x0000F800,
       0, ConvertX86p16_16BGR565, ConvertX86, NO_ALPHA },
@@ -2315,6 +2831,20 @@ static const struct blit_table normal_blit_3[] = {
     { 0,0,0, 0, 0,0,0, 0, NULL, BlitNtoN, 0 }
 };
 static const struct blit_table normal_blit_4[] = {
+#if SDL_AVX2_BLITTERS
+    /* has-AVX2 */
+    { 0x00FF0000,0x0000FF00,0x000000FF, 2, 0x0000F800,0x000007E0,0x0000001F,
+      32, NULL, Blit_RGB888_RGB565AVX2, NO_ALPHA },
+    { 0x00FF0000,0x0000FF00,0x000000FF, 2, 0x00007C00,0x000003E0,0x0000001F,
+      32, NULL, Blit_RGB888_RGB555AVX2, NO_ALPHA },
+#endif
+#if SDL_SSE2_BLITTERS
+    /* has-SSE2 */
+    { 0x00FF0000,0x0000FF00,0x000000FF, 2, 0x0000F800,0x000007E0,0x0000001F,
+      8, NULL, Blit_RGB888_RGB565SSE2, NO_ALPHA },
+    { 0x00FF0000,0x0000FF00,0x000000FF, 2, 0x00007C00,0x000003E0,0x0000001F,
+      8, NULL, Blit_RGB888_RGB555SSE2, NO_ALPHA },
+#endif
 #if SDL_HERMES_BLITTERS
     { 0x00FF0000,0x0000FF00,0x000000FF, 2, 0x0000F800,0x000007E0,0x0000001F,
       1, ConvertMMXpII32_16RGB565, ConvertMMX, NO_ALPHA },
@@ -2411,6 +2941,11 @@ SDL_loblit SDL_CalculateBlitN(SDL_Surface *surface, int blit_index)
             return Blit32to32KeyAltivec;
         } else
 #endif
+#if SDL_SSSE3_BLITTERS
+		if(IsVectorSwizzle(srcfmt, dstfmt) && SDL_HasSSSE3()) {
+		    return SDL_HasAVX2() ? Blit32to32KeyAVX2 : Blit32to32KeySSSE3;
+		} else
+#endif
 
 		if(srcfmt->Amask && dstfmt->Amask)
 		    return BlitNtoNKeyCopyAlpha;
@@ -2467,6 +3002,12 @@ SDL_loblit SDL_CalculateBlitN(SDL_Surface *surface, int blit_index)
 			     srcfmt->Gmask == dstfmt->Gmask &&
 			     srcfmt->Bmask == dstfmt->Bmask ) {
 				blitfun = Blit4to4MaskAlpha;
+#if SDL_SSSE3_BLITTERS
+			} else if ( IsVectorSwizzle(srcfmt, dstfmt) &&
+			            SDL_HasSSSE3() ) {
+				blitfun = SDL_HasAVX2() ? Blit32to32SwizzleAVX2
+				                        : Blit32to32SwizzleSSSE3;
+#endif
 			} else if ( a_need == COPY_ALPHA ) {
 			    blitfun = BlitNtoNCopyAlpha;
 			}
@@ -2490,3 +3031,183 @@ SDL_loblit SDL_CalculateBlitN(SDL_Surface *surface, int blit_index)
 
 	return(blitfun);
 }
+
+#ifdef TEST_MAIN
+
+#include <stdio.h>
+#include <stdlib.h>
+
+static void SetFormat(SDL_PixelFormat *fmt, int bpp,
+                      Uint32 r, Uint32 g, Uint32 b, Uint32 a)
+{
+	Uint32 masks[4];
+	Uint8 *shifts[4];
+	Uint8 *losses[4];
+	int i;
+
+	SDL_memset(fmt, 0, sizeof(*fmt));
+	fmt->BitsPerPixel = bpp * 8;
+	fmt->BytesPerPixel = bpp;
+	fmt->Rmask = masks[0] = r;
+	fmt->Gmask = masks[1] = g;
+	fmt->Bmask = masks[2] = b;
+	fmt->Amask = masks[3] = a;
+	shifts[0] = &fmt->Rshift; losses[0] = &fmt->Rloss;
+	shifts[1] = &fmt->Gshift; losses[1] = &fmt->Gloss;
+	shifts[2] = &fmt->Bshift; losses[2] = &fmt->Bloss;
+	shifts[3] = &fmt->Ashift; losses[3] = &fmt->Aloss;
+	for ( i = 0; i < 4; ++i ) {
+		Uint32 m = masks[i];
+		*shifts[i] = 0;
+		*losses[i] = 8;
+		if ( m ) {
+			while ( !(m & 1) ) {
+				m >>= 1;
+				++*shifts[i];
+			}
+			while ( m & 1 ) {
+				m >>= 1;
+				--*losses[i];
+			}
+		}
+	}
+	fmt->alpha = 0xA5;
+}
+
+/* Run blit and the C reference over the same random rectangle and compare */
+static int CompareBlit(SDL_loblit reference, SDL_loblit blit,
+                       SDL_PixelFormat *sf, SDL_PixelFormat *df)
+{
+	enum { PITCH = 48, ROWS = 7 };
+	Uint32 src[PITCH * ROWS];
+	Uint32 dst[2][PITCH * ROWS];
+	int sbpp = sf->BytesPerPixel;
+	int dbpp = df->BytesPerPixel;
+	int width, i;
+
+	for ( width = 1; width <= PITCH - 4; ++width ) {
+		SDL_BlitInfo info[2];
+		for ( i = 0; i < PITCH * ROWS; ++i ) {
+			src[i] = (rand() << 16) ^ rand();
+			dst[0][i] = dst[1][i] = (rand() << 16) ^ rand();
+			/* plenty of colorkeyed pixels, whatever their alpha */
+			if ( rand() % 3 == 0 ) {
+				src[i] = (src[i] & sf->Amask) |
+				         (sf->colorkey & ~sf->Amask);
+			}
+		}
+		for ( i = 0; i < 2; ++i ) {
+			/* misalign the rows so the vector loads are unaligned */
+			info[i].s_pixels = (Uint8 *)src + sbpp;
+			info[i].s_skip = (PITCH - width) * sbpp;
+			info[i].d_pixels = (Uint8 *)dst[i] + 3 * dbpp;
+			info[i].d_skip = (PITCH - width) * dbpp;
+			info[i].d_width = width;
+			info[i].d_height = ROWS - 1;
+			info[i].src = sf;
+			info[i].dst = df;
+			info[i].table = NULL;
+		}
+		reference(&info[0]);
+		blit(&info[1]);
+		if ( SDL_memcmp(dst[0], dst[1], sizeof(dst[0])) != 0 ) {
+			return 0;
+		}
+	}
+	return 1;
+}
+
+static void Report(const char *name, int okay)
+{
+	printf("%s... %s\n", name, okay ? "okay" : "failed");
+}
+
+int main(int argc, char *argv[])
+{
+	SDL_PixelFormat argb, xrgb, abgr, rgba, bgra, xbgr;
+	SDL_PixelFormat rgb565, rgb555;
+
+	SetFormat(&argb, 4, 0x00FF0000, 0x0000FF00, 0x000000FF, 0xFF000000);
+	SetFormat(&xrgb, 4, 0x00FF0000, 0x0000FF00, 0x000000FF, 0);
+	SetFormat(&abgr, 4, 0x000000FF, 0x0000FF00, 0x00FF0000, 0xFF000000);
+	SetFormat(&rgba, 4, 0xFF000000, 0x00FF0000, 0x0000FF00, 0x000000FF);
+	SetFormat(&bgra, 4, 0x0000FF00, 0x00FF0000, 0xFF000000, 0x000000FF);
+	SetFormat(&xbgr, 4, 0x000000FF, 0x0000FF00, 0x00FF0000, 0);
+	SetFormat(&rgb565, 2, 0xF800, 0x07E0, 0x001F, 0);
+	SetFormat(&rgb555, 2, 0x7C00, 0x03E0, 0x001F, 0);
+	argb.colorkey = xrgb.colorkey = 0x00FF00FF;
+
+#if SDL_SSE2_BLITTERS
+	if ( SDL_HasSSE2() ) {
+		Report("SSE2 RGB888->RGB565", CompareBlit(
+			BlitNtoN, Blit_RGB888_RGB565SSE2, &argb, &rgb565));
+		Report("SSE2 RGB888->RGB555", CompareBlit(
+			BlitNtoN, Blit_RGB888_RGB555SSE2, &xrgb, &rgb555));
+		Report("SSE2 RGB565->ARGB8888", CompareBlit(
+			Blit_RGB565_ARGB8888, Blit_RGB565_ARGB8888SSE2,
+			&rgb565, &argb));
+		Report("SSE2 RGB565->ABGR8888", CompareBlit(
+			Blit_RGB565_ABGR8888, Blit_RGB565_ABGR8888SSE2,
+			&rgb565, &abgr));
+		Report("SSE2 RGB565->RGBA8888", CompareBlit(
+			Blit_RGB565_RGBA8888, Blit_RGB565_RGBA8888SSE2,
+			&rgb565, &rgba));
+		Report("SSE2 RGB565->BGRA8888", CompareBlit(
+			Blit_RGB565_BGRA8888, Blit_RGB565_BGRA8888SSE2,
+			&rgb565, &bgra));
+	} else {
+		printf("SSE2 not available, skipped\n");
+	}
+#endif
+#if SDL_SSSE3_BLITTERS
+	if ( SDL_HasSSSE3() ) {
+		Report("SSSE3 ARGB->ABGR", CompareBlit(
+			BlitNtoNCopyAlpha, Blit32to32SwizzleSSSE3, &argb, &abgr));
+		Report("SSSE3 RGB->ABGR", CompareBlit(
+			BlitNtoN, Blit32to32SwizzleSSSE3, &xrgb, &abgr));
+		Report("SSSE3 ARGB->BGR", CompareBlit(
+			BlitNtoN, Blit32to32SwizzleSSSE3, &argb, &xbgr));
+		Report("SSSE3 ARGB->ABGR colorkey", CompareBlit(
+			BlitNtoNKeyCopyAlpha, Blit32to32KeySSSE3, &argb, &abgr));
+		Report("SSSE3 RGB->RGBA colorkey", CompareBlit(
+			BlitNtoNKey, Blit32to32KeySSSE3, &xrgb, &rgba));
+	} else {
+		printf("SSSE3 not available, skipped\n");
+	}
+#endif
+#if SDL_AVX2_BLITTERS
+	if ( SDL_HasAVX2() ) {
+		Report("AVX2 RGB888->RGB565", CompareBlit(
+			BlitNtoN, Blit_RGB888_RGB565AVX2, &argb, &rgb565));
+		Report("AVX2 RGB888->RGB555", CompareBlit(
+			BlitNtoN, Blit_RGB888_RGB555AVX2, &xrgb, &rgb555));
+		Report("AVX2 RGB565->ARGB8888", CompareBlit(
+			Blit_RGB565_ARGB8888, Blit_RGB565_ARGB8888AVX2,
+			&rgb565, &argb));
+		Report("AVX2 RGB565->ABGR8888", CompareBlit(
+			Blit_RGB565_ABGR8888, Blit_RGB565_ABGR8888AVX2,
+			&rgb565, &abgr));
+		Report("AVX2 RGB565->RGBA8888", CompareBlit(
+			Blit_RGB565_RGBA8888, Blit_RGB565_RGBA8888AVX2,
+			&rgb565, &rgba));
+		Report("AVX2 RGB565->BGRA8888", CompareBlit(
+			Blit_RGB565_BGRA8888, Blit_RGB565_BGRA8888AVX2,
+			&rgb565, &bgra));
+		Report("AVX2 ARGB->ABGR", CompareBlit(
+			BlitNtoNCopyAlpha, Blit32to32SwizzleAVX2, &argb, &abgr));
+		Report("AVX2 RGB->ABGR", CompareBlit(
+			BlitNtoN, Blit32to32SwizzleAVX2, &xrgb, &abgr));
+		Report("AVX2 ARGB->BGR", CompareBlit(
+			BlitNtoN, Blit32to32SwizzleAVX2, &argb, &xbgr));
+		Report("AVX2 ARGB->ABGR colorkey", CompareBlit(
+			BlitNtoNKeyCopyAlpha, Blit32to32KeyAVX2, &argb, &abgr));
+		Report("AVX2 RGB->RGBA colorkey", CompareBlit(
+			BlitNtoNKey, Blit32to32KeyAVX2, &xrgb, &rgba));
+	} else {
+		printf("AVX2 not available, skipped\n");
+	}
+#endif
+	return 0;
+}
+
+#endif /* TEST_MAIN */
@@ -0,0 +1,255 @@
+/*
+    SDL - Simple DirectMedia Layer
+    Copyright (C) 1997-2012 Sam Lantinga
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+
+    Sam Lantinga
+    slouken@libsdl.org
+*/
+#include "SDL_config.h"
+
+/* Offscreen SDL video driver implementation
+
+   The screen is a plain block of memory, so everything SDL does in
+   software -- blits, RLE acceleration, stretching, YUV overlays -- runs
+   exactly as it would on a real display, with nothing else in the way.
+   That makes it the driver to profile and test those paths with.
+
+   Use it with SDL_VIDEODRIVER=offscreen.  If SDL_OFFSCREEN_DUMP is set,
+   each SDL_UpdateRects() or SDL_Flip() saves the screen as a BMP file
+   named by that prefix and the frame number, e.g. "frame00001.bmp" for
+   SDL_OFFSCREEN_DUMP=frame.
+*/
+
+#include "SDL_video.h"
+#include "SDL_mouse.h"
+#include "../SDL_sysvideo.h"
+#include "../SDL_pixels_c.h"
+#include "../../events/SDL_events_c.h"
+
+#include "SDL_offscreenvideo.h"
+#include "SDL_offscreenevents_c.h"
+
+#define OFFSCREENVID_DRIVER_NAME "offscreen"
+
+/* Initialization/Query functions */
+static int OFFSCREEN_VideoInit(_THIS, SDL_PixelFormat *vformat);
+static SDL_Rect **OFFSCREEN_ListModes(_THIS, SDL_PixelFormat *format, Uint32 flags);
+static SDL_Surface *OFFSCREEN_SetVideoMode(_THIS, SDL_Surface *current, int width, int height, int bpp, Uint32 flags);
+static int OFFSCREEN_SetColors(_THIS, int firstcolor, int ncolors, SDL_Color *colors);
+static void OFFSCREEN_VideoQuit(_THIS);
+
+/* Hardware surface functions */
+static int OFFSCREEN_AllocHWSurface(_THIS, SDL_Surface *surface);
+static int OFFSCREEN_LockHWSurface(_THIS, SDL_Surface *surface);
+static void OFFSCREEN_UnlockHWSurface(_THIS, SDL_Surface *surface);
+static void OFFSCREEN_FreeHWSurface(_THIS, SDL_Surface *surface);
+
+/* etc. */
+static void OFFSCREEN_UpdateRects(_THIS, int numrects, SDL_Rect *rects);
+
+/* OFFSCREEN driver bootstrap functions */
+
+static int OFFSCREEN_Available(void)
+{
+	const char *envr = SDL_getenv("SDL_VIDEODRIVER");
+	if ((envr) && (SDL_strcmp(envr, OFFSCREENVID_DRIVER_NAME) == 0)) {
+		return(1);
+	}
+
+	return(0);
+}
+
+static void OFFSCREEN_DeleteDevice(SDL_VideoDevice *device)
+{
+	SDL_free(device->hidden);
+	SDL_free(device);
+}
+
+static SDL_VideoDevice *OFFSCREEN_CreateDevice(int devindex)
+{
+	SDL_VideoDevice *device;
+
+	/* Initialize all variables that we clean on shutdown */
+	device = (SDL_VideoDevice *)SDL_malloc(sizeof(SDL_VideoDevice));
+	if ( device ) {
+		SDL_memset(device, 0, (sizeof *device));
+		device->hidden = (struct SDL_PrivateVideoData *)
+				SDL_malloc((sizeof *device->hidden));
+	}
+	if ( (device == NULL) || (device->hidden == NULL) ) {
+		SDL_OutOfMemory();
+		if ( device ) {
+			SDL_free(device);
+		}
+		return(0);
+	}
+	SDL_memset(device->hidden, 0, (sizeof *device->hidden));
+
+	/* Set the function pointers */
+	device->VideoInit = OFFSCREEN_VideoInit;
+	device->ListModes = OFFSCREEN_ListModes;
+	device->SetVideoMode = OFFSCREEN_SetVideoMode;
+	device->CreateYUVOverlay = NULL;
+	device->SetColors = OFFSCREEN_SetColors;
+	device->UpdateRects = OFFSCREEN_UpdateRects;
+	device->VideoQuit = OFFSCREEN_VideoQuit;
+	device->AllocHWSurface = OFFSCREEN_AllocHWSurface;
+	device->CheckHWBlit = NULL;
+	device->FillHWRect = NULL;
+	device->SetHWColorKey = NULL;
+	device->SetHWAlpha = NULL;
+	device->LockHWSurface = OFFSCREEN_LockHWSurface;
+	device->UnlockHWSurface = OFFSCREEN_UnlockHWSurface;
+	device->FlipHWSurface = NULL;
+	device->FreeHWSurface = OFFSCREEN_FreeHWSurface;
+	device->SetCaption = NULL;
+	device->SetIcon = NULL;
+	device->IconifyWindow = NULL;
+	device->GrabInput = NULL;
+	device->GetWMInfo = NULL;
+	device->InitOSKeymap = OFFSCREEN_InitOSKeymap;
+	device->PumpEvents = OFFSCREEN_PumpEvents;
+
+	device->free = OFFSCREEN_DeleteDevice;
+
+	return device;
+}
+
+VideoBootStrap OFFSCREEN_bootstrap = {
+	OFFSCREENVID_DRIVER_NAME, "SDL offscreen video driver",
+	OFFSCREEN_Available, OFFSCREEN_CreateDevice
+};
+
+
+static int OFFSCREEN_VideoInit(_THIS, SDL_PixelFormat *vformat)
+{
+	const char *envr = SDL_getenv("SDL_OFFSCREEN_DUMP");
+
+	/* Determine the screen depth (use default 32-bit depth) */
+	vformat->BitsPerPixel = 32;
+	vformat->BytesPerPixel = 4;
+
+	this->hidden->frames = 0;
+	if ( envr && *envr ) {
+		this->hidden->dump_prefix = SDL_strdup(envr);
+	}
+
+	/* We're done! */
+	return(0);
+}
+
+/* Any size and depth will do */
+static SDL_Rect **OFFSCREEN_ListModes(_THIS, SDL_PixelFormat *format, Uint32 flags)
+{
+	return (SDL_Rect **) -1;
+}
+
+static SDL_Surface *OFFSCREEN_SetVideoMode(_THIS, SDL_Surface *current,
+				int width, int height, int bpp, Uint32 flags)
+{
+	if ( this->hidden->buffer ) {
+		SDL_free( this->hidden->buffer );
+		this->hidden->buffer = NULL;
+	}
+	current->pixels = NULL;
+
+	/* Allocate the new pixel format for the screen */
+	if ( ! SDL_ReallocFormat(current, bpp, 0, 0, 0, 0) ) {
+		SDL_SetError("Couldn't allocate new pixel format for requested mode");
+		return(NULL);
+	}
+
+	/* Set up the new mode framebuffer, with the same pitch
+	   a software surface of this size would have */
+	current->flags = flags & SDL_FULLSCREEN;
+	current->w = width;
+	current->h = height;
+	current->pitch = SDL_CalculatePitch(current);
+
+	this->hidden->buffer = SDL_malloc(current->h * current->pitch);
+	if ( ! this->hidden->buffer ) {
+		SDL_SetError("Couldn't allocate buffer for requested mode");
+		return(NULL);
+	}
+	SDL_memset(this->hidden->buffer, 0, current->h * current->pitch);
+	current->pixels = this->hidden->buffer;
+
+	/* We're done */
+	return(current);
+}
+
+/* We don't actually allow hardware surfaces other than the main one */
+static int OFFSCREEN_AllocHWSurface(_THIS, SDL_Surface *surface)
+{
+	return(-1);
+}
+static void OFFSCREEN_FreeHWSurface(_THIS, SDL_Surface *surface)
+{
+	return;
+}
+
+/* The framebuffer is always there, there's nothing to lock */
+static int OFFSCREEN_LockHWSurface(_THIS, SDL_Surface *surface)
+{
+	return(0);
+}
+
+static void OFFSCREEN_UnlockHWSurface(_THIS, SDL_Surface *surface)
+{
+	return;
+}
+
+/* Each update is a frame; save it if we've been asked to */
+static void OFFSCREEN_UpdateRects(_THIS, int numrects, SDL_Rect *rects)
+{
+	char file[1024];
+
+	if ( ! this->screen || ! this->screen->pixels ) {
+		return;
+	}
+	++this->hidden->frames;
+	if ( this->hidden->dump_prefix ) {
+		SDL_snprintf(file, sizeof(file), "%s%05u.bmp",
+		             this->hidden->dump_prefix,
+		             (unsigned int)this->hidden->frames);
+		SDL_SaveBMP(this->screen, file);
+	}
+}
+
+static int OFFSCREEN_SetColors(_THIS, int firstcolor, int ncolors, SDL_Color *colors)
+{
+	/* The palette is kept in the screen's format, which is all we need */
+	return(1);
+}
+
+/* Note:  If we are terminated, this could be called in the middle of
+   another SDL video routine -- notably UpdateRects.
+*/
+static void OFFSCREEN_VideoQuit(_THIS)
+{
+	if ( this->screen && this->screen->pixels == this->hidden->buffer ) {
+		this->screen->pixels = NULL;
+	}
+	if ( this->hidden->buffer ) {
+		SDL_free(this->hidden->buffer);
+		this->hidden->buffer = NULL;
+	}
+	if ( this->hidden->dump_prefix ) {
+		SDL_free(this->hidden->dump_prefix);
+		this->hidden->dump_prefix = NULL;
+	}
+}
@@ -0,0 +1,770 @@
+/*
+  SDL_mixer:  An audio mixer library based on the SDL library
+  Copyright (C) 1997-2012 Sam Lantinga <slouken@libsdl.org>
+
+  This software is provided 'as-is', without any express or implied
+  warranty.  In no event will the authors be held liable for any damages
+  arising from the use of this software.
+
+  Permission is granted to anyone to use this software for any purpose,
+  including commercial applications, and to alter it and redistribute it
+  freely, subject to the following restrictions:
+
+  1. The origin of this software must not be misrepresented; you must not
+     claim that you wrote the original software. If you use this software
+     in a product, an acknowledgment in the product documentation would be
+     appreciated but is not required.
+  2. Altered source versions must be plainly marked as such, and must not be
+     misrepresented as being the original software.
+  3. This notice may not be removed or altered from any source distribution.
+
+  Binaural positioning for headphones: each channel is convolved with the
+  head-related impulse responses of its direction, using the effect
+  callback API like the other internal effects.
+*/
+
+/* $Id$ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "SDL.h"
+#include "SDL_mixer.h"
+#include "SDL_endian.h"
+#include "SDL_cpuinfo.h"
+
+#define __MIX_INTERNAL_EFFECT__
+#include "effects_internal.h"
+
+#if (defined(__GNUC__) && defined(__SSE__)) || \
+    (defined(_MSC_VER) && (_MSC_VER >= 1300) && \
+     (defined(_M_IX86) || defined(_M_X64)))
+#define MIX_SSE_BINAURAL	1
+#include <xmmintrin.h>
+#endif
+
+#ifndef M_PI
+#define M_PI	3.14159265358979323846
+#endif
+
+#define BINAURAL_MAX_TAPS	256	/* longest response kept, in frames */
+#define BINAURAL_BLOCK	256	/* frames convolved at a time */
+#define BINAURAL_HISTORY	(BINAURAL_MAX_TAPS - 1 + BINAURAL_BLOCK)
+
+/* Spherical head model constants, in meters and meters per second */
+#define HEAD_RADIUS	0.0875
+#define SPEED_OF_SOUND	343.0
+
+
+/*
+ * A set of head-related impulse responses, one pair per direction. The
+ *  responses are stored time-reversed and zero-padded at the front to a
+ *  multiple of four taps, left ear then right ear, so that a dot product
+ *  with the latest input frames gives the next output frame.
+ */
+typedef struct
+{
+    int taps;
+    int count;
+    float *dir;     /* unit vector of each direction: right, front, up */
+    float *level;   /* broadband gain of each ear, used for panning */
+    float *ir;
+} hrtf_set;
+
+/* How a voice is rendered: convolved with a response pair and scaled by
+ *  the gains, or when there's no pair just panned by the gains.
+ */
+typedef struct
+{
+    const float *ir;
+    float left;
+    float right;
+} binaural_filter;
+
+typedef struct _Eff_binauralargs
+{
+    int entry;          /* response pair nearest the direction */
+    Uint8 distance;
+    int started;        /* audio has gone through; fade filter changes */
+    int fading;         /* crossfade from prev to cur over the next buffer */
+    binaural_filter cur;
+    binaural_filter prev;
+    float history[BINAURAL_HISTORY];
+} binaural_args;
+
+static hrtf_set *hrtf = NULL;
+static binaural_args **bin_args_array = NULL;
+static int binaural_channels = 0;
+static int binaural_budget = 32;
+
+
+static void free_hrtf(hrtf_set *set)
+{
+    if (set) {
+        SDL_free(set->dir);
+        SDL_free(set->level);
+        SDL_free(set->ir);
+        SDL_free(set);
+    }
+}
+
+static hrtf_set *alloc_hrtf(int count, int taps)
+{
+    hrtf_set *set = (hrtf_set *) SDL_malloc(sizeof (hrtf_set));
+
+    if (set == NULL) {
+        Mix_SetError("Out of memory");
+        return(NULL);
+    }
+    set->count = count;
+    set->taps = (taps + 3) & ~3;
+    set->dir = (float *) SDL_malloc(count * 3 * sizeof (float));
+    set->level = (float *) SDL_malloc(count * 2 * sizeof (float));
+    set->ir = (float *) SDL_malloc(count * 2 * set->taps * sizeof (float));
+    if (!set->dir || !set->level || !set->ir) {
+        free_hrtf(set);
+        Mix_SetError("Out of memory");
+        return(NULL);
+    }
+    memset(set->ir, '\0', count * 2 * set->taps * sizeof (float));
+    return(set);
+}
+
+/* Azimuth is clockwise from straight ahead, elevation up from level */
+static void set_direction(float *v, int azimuth, int elevation)
+{
+    double az = azimuth * M_PI / 180.0;
+    double el = elevation * M_PI / 180.0;
+
+    v[0] = (float) (sin(az) * cos(el));
+    v[1] = (float) (cos(az) * cos(el));
+    v[2] = (float) sin(el);
+}
+
+/* Store a response for one ear of an entry, reversed, and its level */
+static void store_response(hrtf_set *set, int entry, int ear,
+                           const float *h, int taps)
+{
+    float *ir = set->ir + (entry * 2 + ear) * set->taps;
+    double energy = 0.0;
+    int i;
+
+    for (i = 0; i < taps; i++) {
+        ir[set->taps - 1 - i] = h[i];
+        energy += h[i] * h[i];
+    }
+    set->level[entry * 2 + ear] = (float) sqrt(energy);
+}
+
+
+/*
+ * Apply the first order shelf (alpha * s + w) / (s + w) to a response in
+ *  place. It passes frequencies below w and scales those well above it by
+ *  alpha; Brown and Duda model the shadow of the head with it.
+ */
+static void shelve(float *h, int n, double alpha, double w, double rate)
+{
+    double k = 2.0 * rate;
+    double b0 = alpha * k + w, b1 = w - alpha * k;
+    double a0 = k + w, a1 = w - k;
+    double x1 = 0.0, y1 = 0.0;
+    int i;
+
+    for (i = 0; i < n; i++) {
+        double x = h[i];
+        double y = (b0 * x + b1 * x1 - a1 * y1) / a0;
+        x1 = x;
+        y1 = y;
+        h[i] = (float) y;
+    }
+}
+
+/*
+ * Response of the ear on the given side (-1 left, 1 right) of a spherical
+ *  head: the delay around the head, its shadow, and a little extra high
+ *  frequency loss for sources behind the listener, which a sphere alone
+ *  would not tell apart from those in front.
+ */
+static void model_ear(float *h, int taps, const float *v, int side,
+                      double rate)
+{
+    double cosine = side * v[0];
+    double theta, delay, alpha, pos;
+    int i;
+
+    if (cosine > 1.0) cosine = 1.0;
+    if (cosine < -1.0) cosine = -1.0;
+    theta = acos(cosine);
+
+    if (theta < M_PI / 2) {
+        delay = HEAD_RADIUS / SPEED_OF_SOUND * (1.0 - cosine);
+    } else {
+        delay = HEAD_RADIUS / SPEED_OF_SOUND * (theta - M_PI / 2 + 1.0);
+    }
+    pos = 1.0 + delay * rate;
+    i = (int) pos;
+
+    memset(h, '\0', taps * sizeof (float));
+    h[i] = (float) (1.0 - (pos - i));
+    h[i + 1] = (float) (pos - i);
+
+    alpha = 1.05 + 0.95 * cos(theta * 180.0 / 150.0);
+    shelve(h, taps, alpha, 2.0 * SPEED_OF_SOUND / HEAD_RADIUS, rate);
+    if (v[1] < 0.0f) {
+        shelve(h, taps, 1.0 + 0.5 * v[1], 2.0 * M_PI * 4000.0, rate);
+    }
+}
+
+/* Build responses from the spherical head model, every 15 degrees */
+static hrtf_set *build_model(int rate)
+{
+    float h[BINAURAL_MAX_TAPS];
+    hrtf_set *set;
+    int taps, az, el, entry = 0;
+
+    taps = (int) (HEAD_RADIUS / SPEED_OF_SOUND * (M_PI / 2 + 1.0) * rate)
+         + 3 + rate / 1000;
+    if (taps > BINAURAL_MAX_TAPS) {
+        taps = BINAURAL_MAX_TAPS;
+    }
+
+    set = alloc_hrtf(24 * 10, taps);
+    if (set == NULL) {
+        return(NULL);
+    }
+    for (el = -45; el <= 90; el += 15) {
+        for (az = 0; az < 360; az += 15, entry++) {
+            float *v = set->dir + entry * 3;
+            set_direction(v, az, el);
+            model_ear(h, taps, v, -1, rate);
+            store_response(set, entry, 0, h, taps);
+            model_ear(h, taps, v, 1, rate);
+            store_response(set, entry, 1, h, taps);
+        }
+    }
+    return(set);
+}
+
+
+/*
+ * Read a set of responses, resampling them to the output rate. The file
+ *  holds "HRIR", the sample rate (32 bits), the taps and the number of
+ *  directions (16 bits each), then for every direction its azimuth and
+ *  elevation in degrees followed by the left and right responses, all
+ *  signed 16-bit little endian.
+ */
+static hrtf_set *load_hrtf(SDL_RWops *src, int rate)
+{
+    char magic[4];
+    Uint32 src_rate;
+    int taps, count, out_taps, entry, ear, i;
+    Sint16 *raw = NULL;
+    float h[BINAURAL_MAX_TAPS];
+    hrtf_set *set = NULL;
+
+    if (SDL_RWread(src, magic, sizeof (magic), 1) != 1 ||
+        memcmp(magic, "HRIR", 4) != 0) {
+        Mix_SetError("Not an HRIR file");
+        return(NULL);
+    }
+    src_rate = SDL_ReadLE32(src);
+    taps = SDL_ReadLE16(src);
+    count = SDL_ReadLE16(src);
+    if (src_rate == 0 || taps == 0 || count == 0) {
+        Mix_SetError("Corrupt HRIR file");
+        return(NULL);
+    }
+
+    out_taps = (int) (((double) taps * rate) / src_rate + 0.5);
+    if (out_taps > BINAURAL_MAX_TAPS) {
+        out_taps = BINAURAL_MAX_TAPS;
+    } else if (out_taps < 1) {
+        out_taps = 1;
+    }
+
+    raw = (Sint16 *) SDL_malloc((2 + 2 * taps) * sizeof (Sint16));
+    set = alloc_hrtf(count, out_taps);
+    if (raw == NULL || set == NULL) {
+        if (set == NULL) {
+            Mix_SetError("Out of memory");
+        }
+        SDL_free(raw);
+        free_hrtf(set);
+        return(NULL);
+    }
+
+    for (entry = 0; entry < count; entry++) {
+        if (SDL_RWread(src, raw, (2 + 2 * taps) * sizeof (Sint16), 1) != 1) {
+            Mix_SetError("Corrupt HRIR file");
+            SDL_free(raw);
+            free_hrtf(set);
+            return(NULL);
+        }
+        for (i = 0; i < 2 + 2 * taps; i++) {
+            raw[i] = (Sint16) SDL_SwapLE16(raw[i]);
+        }
+        set_direction(set->dir + entry * 3, raw[0], raw[1]);
+
+        for (ear = 0; ear < 2; ear++) {
+            const Sint16 *in = raw + 2 + ear * taps;
+            double scale = (double) src_rate / rate / 32768.0;
+            for (i = 0; i < out_taps; i++) {
+                double pos = ((double) i * src_rate) / rate;
+                int j = (int) pos;
+                double frac = pos - j;
+                double a = (j < taps) ? in[j] : 0.0;
+                double b = (j + 1 < taps) ? in[j + 1] : 0.0;
+                h[i] = (float) ((a + (b - a) * frac) * scale);
+            }
+            store_response(set, entry, ear, h, out_taps);
+        }
+    }
+
+    SDL_free(raw);
+    return(set);
+}
+
+
+/* Find the response pair whose direction is closest to (v) */
+static int nearest_entry(const hrtf_set *set, const float *v)
+{
+    float best = -2.0f;
+    int i, entry = 0;
+
+    for (i = 0; i < set->count; i++) {
+        const float *d = set->dir + i * 3;
+        float dot = v[0] * d[0] + v[1] * d[1] + v[2] * d[2];
+        if (dot > best) {
+            best = dot;
+            entry = i;
+        }
+    }
+    return(entry);
+}
+
+
+/*
+ * Pick how each voice is rendered. Voices are convolved nearest first, as
+ *  many as the budget allows; the rest are panned by the levels of their
+ *  response pair, so they keep their loudness and side but cost almost
+ *  nothing. Changes are crossfaded over the next buffer when (fade) is set.
+ *  MAKE SURE you hold the audio lock (SDL_LockAudio()) before calling this!
+ */
+static void update_voices(int fade)
+{
+    int i, j;
+
+    if (hrtf == NULL) {
+        return;
+    }
+
+    for (i = 0; i < binaural_channels; i++) {
+        binaural_args *args = bin_args_array[i];
+        binaural_filter f;
+        float gain;
+        int rank = 0;
+
+        if (args == NULL) {
+            continue;
+        }
+        for (j = 0; j < binaural_channels; j++) {
+            binaural_args *other = bin_args_array[j];
+            if (other != NULL && (other->distance < args->distance ||
+                (other->distance == args->distance && j < i))) {
+                rank++;
+            }
+        }
+
+        gain = ((float) (255 - args->distance)) / 255.0f;
+        if (rank < binaural_budget) {
+            f.ir = hrtf->ir + args->entry * 2 * hrtf->taps;
+            f.left = f.right = gain;
+        } else {
+            f.ir = NULL;
+            f.left = hrtf->level[args->entry * 2] * gain;
+            f.right = hrtf->level[args->entry * 2 + 1] * gain;
+        }
+
+        if (f.ir == args->cur.ir && f.left == args->cur.left &&
+            f.right == args->cur.right) {
+            continue;
+        }
+        if (!fade || !args->started) {
+            args->fading = 0;
+        } else if (!args->fading) {
+            args->prev = args->cur;
+            args->fading = 1;
+        }
+        args->cur = f;
+    }
+}
+
+
+#ifdef MIX_SSE_BINAURAL
+static void convolve_sse(const float *ir, int taps, const float *x, int n,
+                         float *left, float *right)
+{
+    const float *irr = ir + taps;
+    int i, k;
+
+    for (i = 0; i < n; i++, x++) {
+        __m128 l = _mm_setzero_ps();
+        __m128 r = _mm_setzero_ps();
+        for (k = 0; k < taps; k += 4) {
+            __m128 v = _mm_loadu_ps(x + k);
+            l = _mm_add_ps(l, _mm_mul_ps(v, _mm_loadu_ps(ir + k)));
+            r = _mm_add_ps(r, _mm_mul_ps(v, _mm_loadu_ps(irr + k)));
+        }
+        l = _mm_add_ps(l, _mm_movehl_ps(l, l));
+        r = _mm_add_ps(r, _mm_movehl_ps(r, r));
+        l = _mm_add_ss(l, _mm_shuffle_ps(l, l, 1));
+        r = _mm_add_ss(r, _mm_shuffle_ps(r, r, 1));
+        _mm_store_ss(left + i, l);
+        _mm_store_ss(right + i, r);
+    }
+}
+#endif
+
+static void convolve(const float *ir, int taps, const float *x, int n,
+                     float *left, float *right)
+{
+    const float *irr = ir + taps;
+    int i, k;
+
+#ifdef MIX_SSE_BINAURAL
+    if (SDL_HasSSE()) {
+        convolve_sse(ir, taps, x, n, left, right);
+        return;
+    }
+#endif
+
+    for (i = 0; i < n; i++, x++) {
+        float l = 0.0f, r = 0.0f;
+        for (k = 0; k < taps; k++) {
+            l += x[k] * ir[k];
+            r += x[k] * irr[k];
+        }
+        left[i] = l;
+        right[i] = r;
+    }
+}
+
+/* Render (n) frames of a voice from its history with one filter */
+static void render(const binaural_filter *f, const float *history, int n,
+                   float *left, float *right)
+{
+    int i;
+
+    if (f->ir == NULL) {
+        const float *x = history + BINAURAL_MAX_TAPS - 1;
+        for (i = 0; i < n; i++) {
+            left[i] = x[i] * f->left;
+            right[i] = x[i] * f->right;
+        }
+        return;
+    }
+
+    convolve(f->ir, hrtf->taps, history + BINAURAL_MAX_TAPS - hrtf->taps,
+             n, left, right);
+    for (i = 0; i < n; i++) {
+        left[i] *= f->left;
+        right[i] *= f->right;
+    }
+}
+
+static __inline__ Sint16 clamp_s16(float v)
+{
+    if (v > 32767.0f) {
+        return(32767);
+    } else if (v < -32768.0f) {
+        return(-32768);
+    }
+    return((Sint16) v);
+}
+
+/* Render a voice over a buffer of stereo, either signed 16-bit or float */
+static void binaural_run(binaural_args *args, void *stream, int frames,
+                         int is_float)
+{
+    Sint16 *ptr = (Sint16 *) stream;
+    float *fptr = (float *) stream;
+    float *x = args->history + BINAURAL_MAX_TAPS - 1;
+    float left[BINAURAL_BLOCK], right[BINAURAL_BLOCK];
+    float prev_left[BINAURAL_BLOCK], prev_right[BINAURAL_BLOCK];
+    int done, n, i;
+
+    for (done = 0; done < frames; done += n) {
+        n = frames - done;
+        if (n > BINAURAL_BLOCK) {
+            n = BINAURAL_BLOCK;
+        }
+
+        /* the voice is positioned as a point, so fold it down to mono */
+        if (is_float) {
+            for (i = 0; i < n; i++) {
+                x[i] = (fptr[i * 2] + fptr[i * 2 + 1]) * 0.5f;
+            }
+        } else {
+            for (i = 0; i < n; i++) {
+                x[i] = (ptr[i * 2] + ptr[i * 2 + 1]) * 0.5f;
+            }
+        }
+
+        render(&args->cur, args->history, n, left, right);
+        if (args->fading) {
+            float step = 1.0f / frames;
+            float t = (done + 1) * step;
+            render(&args->prev, args->history, n, prev_left, prev_right);
+            for (i = 0; i < n; i++, t += step) {
+                left[i] = prev_left[i] + (left[i] - prev_left[i]) * t;
+                right[i] = prev_right[i] + (right[i] - prev_right[i]) * t;
+            }
+        }
+
+        if (is_float) {
+            for (i = 0; i < n; i++) {
+                *(fptr++) = left[i];
+                *(fptr++) = right[i];
+            }
+        } else {
+            for (i = 0; i < n; i++) {
+                *(ptr++) = clamp_s16(left[i]);
+                *(ptr++) = clamp_s16(right[i]);
+            }
+        }
+
+        memmove(args->history, args->history + n,
+                (BINAURAL_MAX_TAPS - 1) * sizeof (float));
+    }
+
+    args->started = 1;
+    args->fading = 0;
+}
+
+static void _Eff_binaural_s16(int chan, void *stream, int len, void *udata)
+{
+    binaural_run((binaural_args *) udata, stream,
+                 len / (2 * sizeof (Sint16)), 0);
+}
+
+static void _Eff_binaural_f32(int chan, void *stream, int len, void *udata)
+{
+    binaural_run((binaural_args *) udata, stream,
+                 len / (2 * sizeof (float)), 1);
+}
+
+
+/* This frees the voice and gives its place in the budget to another. */
+static void _Eff_BinauralDone(int channel, void *udata)
+{
+    if (channel >= 0 && channel < binaural_channels &&
+        bin_args_array[channel] == udata) {
+        bin_args_array[channel] = NULL;
+    }
+    SDL_free(udata);
+    update_voices(1);
+}
+
+void _Eff_BinauralDeinit(void)
+{
+    int i;
+    for (i = 0; i < binaural_channels; i++) {
+        SDL_free(bin_args_array[i]);
+    }
+
+    binaural_channels = 0;
+
+    SDL_free(bin_args_array);
+    bin_args_array = NULL;
+    free_hrtf(hrtf);
+    hrtf = NULL;
+}
+
+
+/* MAKE SURE you hold the audio lock (SDL_LockAudio()) before calling this! */
+static binaural_args *get_binaural_arg(int channel, Mix_EffectFunc_t f)
+{
+    binaural_args *args;
+    void *rc;
+    int i;
+
+    if (channel >= binaural_channels) {
+        rc = SDL_realloc(bin_args_array, (channel + 1) * sizeof (binaural_args *));
+        if (rc == NULL) {
+            Mix_SetError("Out of memory");
+            return(NULL);
+        }
+        bin_args_array = (binaural_args **) rc;
+        for (i = binaural_channels; i <= channel; i++) {
+            bin_args_array[i] = NULL;
+        }
+        binaural_channels = channel + 1;
+    }
+
+    if (bin_args_array[channel] == NULL) {
+        args = (binaural_args *) SDL_malloc(sizeof (binaural_args));
+        if (args == NULL) {
+            Mix_SetError("Out of memory");
+            return(NULL);
+        }
+        memset(args, '\0', sizeof (binaural_args));
+        args->distance = 255;
+        if (!_Mix_RegisterEffect_locked(channel, f,
+                                        _Eff_BinauralDone, (void *) args)) {
+            SDL_free(args);
+            return(NULL);
+        }
+        bin_args_array[channel] = args;
+    }
+
+    return(bin_args_array[channel]);
+}
+
+
+/* With the mixer queueing commands, this runs in the audio callback */
+static void set_binaural_queued(int channel, int azimuth, int packed)
+{
+    int distance = packed & 0xFF;
+    Mix_SetBinaural(channel, (Sint16) azimuth,
+                    (Sint16) ((packed - distance) / 256), (Uint8) distance);
+}
+
+int Mix_SetBinaural(int channel, Sint16 azimuth, Sint16 elevation, Uint8 distance)
+{
+    binaural_args *args;
+    Mix_EffectFunc_t f;
+    float v[3];
+    Uint16 format;
+    int channels, rate;
+    int retval = 1;
+    int queued;
+
+    if (!Mix_QuerySpec(&rate, &format, &channels)) {
+        Mix_SetError("Audio device hasn't been opened");
+        return(0);
+    }
+
+    /* there are no headphones to render for, so use the speakers. */
+    if (channels != 2) {
+        return(Mix_SetPosition(channel, azimuth, distance));
+    }
+
+    if (format == AUDIO_S16SYS) {
+        f = _Eff_binaural_s16;
+    } else if (format == AUDIO_F32SYS) {
+        f = _Eff_binaural_f32;
+    } else {
+        Mix_SetError("Unsupported audio format");
+        return(0);
+    }
+    if (channel < 0) {
+        Mix_SetError("Invalid channel number");
+        return(0);
+    }
+
+    queued = _Mix_QueueCall(set_binaural_queued, channel, azimuth,
+                            elevation * 256 + distance);
+    if (queued)
+        return(queued > 0);
+
+    azimuth = ((azimuth % 360) + 360) % 360;
+    if (elevation > 90) {
+        elevation = 90;
+    } else if (elevation < -90) {
+        elevation = -90;
+    }
+
+    SDL_LockAudio();
+
+        /* it's a no-op; unregister the effect, if it's registered. */
+    if (!azimuth && !elevation && !distance) {
+        if (channel < binaural_channels && bin_args_array[channel]) {
+            retval = _Mix_UnregisterEffect_locked(channel, f);
+        }
+        SDL_UnlockAudio();
+        return(retval);
+    }
+
+    if (hrtf == NULL) {
+        hrtf = build_model(rate);
+    }
+    args = hrtf ? get_binaural_arg(channel, f) : NULL;
+    if (!args) {
+        SDL_UnlockAudio();
+        return(0);
+    }
+
+    set_direction(v, azimuth, elevation);
+    args->entry = nearest_entry(hrtf, v);
+    args->distance = distance;
+    update_voices(1);
+
+    SDL_UnlockAudio();
+    return(retval);
+}
+
+
+int Mix_SetBinauralBudget(int voices)
+{
+    int prev = binaural_budget;
+
+    if (voices >= 0) {
+        SDL_LockAudio();
+        binaural_budget = voices;
+        update_voices(1);
+        SDL_UnlockAudio();
+    }
+    return(prev);
+}
+
+
+int Mix_LoadHRTF_RW(SDL_RWops *src, int freesrc)
+{
+    hrtf_set *set, *old;
+    int rate;
+
+    if (src == NULL) {
+        return(0);
+    }
+    if (!Mix_QuerySpec(&rate, NULL, NULL)) {
+        Mix_SetError("Audio device hasn't been opened");
+        if (freesrc) {
+            SDL_RWclose(src);
+        }
+        return(0);
+    }
+
+    set = load_hrtf(src, rate);
+    if (freesrc) {
+        SDL_RWclose(src);
+    }
+    if (set == NULL) {
+        return(0);
+    }
+
+    /* playing voices jump to the new set, since the old one goes away */
+    SDL_LockAudio();
+    old = hrtf;
+    hrtf = set;
+    if (old != NULL) {
+        int i;
+        for (i = 0; i < binaural_channels; i++) {
+            binaural_args *args = bin_args_array[i];
+            if (args != NULL) {
+                args->entry = nearest_entry(set, old->dir + args->entry * 3);
+                args->fading = 0;
+            }
+        }
+    }
+    update_voices(0);
+    SDL_UnlockAudio();
+
+    free_hrtf(old);
+    return(1);
+}
+
+
+/* end of effect_binaural.c ... */
+
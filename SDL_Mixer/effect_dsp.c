@@ -0,0 +1,1245 @@
+/*
+  SDL_mixer:  An audio mixer library based on the SDL library
+  Copyright (C) 1997-2012 Sam Lantinga <slouken@libsdl.org>
+
+  This software is provided 'as-is', without any express or implied
+  warranty.  In no event will the authors be held liable for any damages
+  arising from the use of this software.
+
+  Permission is granted to anyone to use this software for any purpose,
+  including commercial applications, and to alter it and redistribute it
+  freely, subject to the following restrictions:
+
+  1. The origin of this software must not be misrepresented; you must not
+     claim that you wrote the original software. If you use this software
+     in a product, an acknowledgment in the product documentation would be
+     appreciated but is not required.
+  2. Altered source versions must be plainly marked as such, and must not be
+     misrepresented as being the original software.
+  3. This notice may not be removed or altered from any source distribution.
+
+  Signal processing effects: reverb, filters and a limiter. They use the
+  effect callback API like the other internal effects, and work in floats
+  so nothing is clipped until the result is written back. As posteffects
+  in accumulated mixing, they work on the 32-bit sums before the final clip.
+*/
+
+/* $Id$ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "SDL.h"
+#include "SDL_mixer.h"
+#include "SDL_cpuinfo.h"
+
+#define __MIX_INTERNAL_EFFECT__
+#include "effects_internal.h"
+
+#if (defined(__GNUC__) && defined(__SSE__)) || \
+    (defined(_MSC_VER) && (_MSC_VER >= 1300) && \
+     (defined(_M_IX86) || defined(_M_X64)))
+#define MIX_SSE_DSP	1
+#include <xmmintrin.h>
+#endif
+
+#ifndef M_PI
+#define M_PI	3.14159265358979323846
+#endif
+
+#define DSP_BLOCK	256	/* frames converted to floats at a time */
+#define DSP_MAX_CHANNELS	6
+#define DSP_DENORMAL	1e-18f	/* keeps decaying feedback out of denormals */
+
+enum {
+    DSP_REVERB,
+    DSP_FILTER,
+    DSP_LIMITER,
+    DSP_TYPES
+};
+
+typedef struct _Eff_dsphead dsp_head;
+typedef void (*dsp_kernel)(dsp_head *head, float *buf, int frames);
+
+/* Every effect's arguments start with this */
+struct _Eff_dsphead
+{
+    int type;
+    int channels;
+    int rate;
+    float full_scale;   /* 32767 for 16-bit output, 1 for float */
+    Mix_EffectFunc_t callback;
+    dsp_kernel kernel;
+};
+
+static void **dsp_args_array[DSP_TYPES];
+static void *dsp_args_global[DSP_TYPES];
+static int dsp_channels[DSP_TYPES];
+
+
+/* Convert a signed 16-bit buffer to floats a block at a time, run the
+ *  effect over it, and clip it on the way back.
+ */
+static void dsp_s16(dsp_head *head, Sint16 *ptr, int samples)
+{
+    float buf[DSP_BLOCK * DSP_MAX_CHANNELS];
+    int frames = samples / head->channels;
+    int n, i;
+
+    while (frames > 0) {
+        n = (frames < DSP_BLOCK) ? frames : DSP_BLOCK;
+        for (i = 0; i < n * head->channels; i++) {
+            buf[i] = ptr[i];
+        }
+        head->kernel(head, buf, n);
+        for (i = 0; i < n * head->channels; i++) {
+            float v = buf[i];
+            if (v > 32767.0f) {
+                ptr[i] = 32767;
+            } else if (v < -32768.0f) {
+                ptr[i] = -32768;
+            } else {
+                ptr[i] = (Sint16) v;
+            }
+        }
+        ptr += n * head->channels;
+        frames -= n;
+    }
+}
+
+/* Float output runs the effect on the buffer as it is, unclipped */
+static void dsp_f32(dsp_head *head, float *ptr, int samples)
+{
+    int frames = samples / head->channels;
+    int n;
+
+    while (frames > 0) {
+        n = (frames < DSP_BLOCK) ? frames : DSP_BLOCK;
+        head->kernel(head, ptr, n);
+        ptr += n * head->channels;
+        frames -= n;
+    }
+}
+
+/* The same over the mixer's 32-bit sums, which are left unclipped */
+static void dsp_s32(dsp_head *head, Sint32 *ptr, int samples)
+{
+    float buf[DSP_BLOCK * DSP_MAX_CHANNELS];
+    int frames = samples / head->channels;
+    int n, i;
+
+    while (frames > 0) {
+        n = (frames < DSP_BLOCK) ? frames : DSP_BLOCK;
+        for (i = 0; i < n * head->channels; i++) {
+            buf[i] = (float) ptr[i];
+        }
+        head->kernel(head, buf, n);
+        for (i = 0; i < n * head->channels; i++) {
+            float v = buf[i];
+            if (v > 2147483520.0f) {
+                ptr[i] = 0x7FFFFF80;
+            } else if (v < -2147483520.0f) {
+                ptr[i] = -0x7FFFFF80;
+            } else {
+                ptr[i] = (Sint32) v;
+            }
+        }
+        ptr += n * head->channels;
+        frames -= n;
+    }
+}
+
+
+#ifdef MIX_SSE_DSP
+/* Frames of up to four channels go in one vector, unused lanes zeroed */
+static __inline__ __m128 load_frame(const float *p, int channels)
+{
+    switch (channels) {
+        case 1:
+            return _mm_load_ss(p);
+        case 2:
+            return _mm_loadl_pi(_mm_setzero_ps(), (const __m64 *) p);
+        case 3:
+            return _mm_setr_ps(p[0], p[1], p[2], 0.0f);
+        default:
+            return _mm_loadu_ps(p);
+    }
+}
+
+static __inline__ void store_frame(float *p, __m128 v, int channels)
+{
+    float tmp[4];
+
+    switch (channels) {
+        case 1:
+            _mm_store_ss(p, v);
+            break;
+        case 2:
+            _mm_storel_pi((__m64 *) p, v);
+            break;
+        case 3:
+            _mm_storeu_ps(tmp, v);
+            p[0] = tmp[0];
+            p[1] = tmp[1];
+            p[2] = tmp[2];
+            break;
+        default:
+            _mm_storeu_ps(p, v);
+            break;
+    }
+}
+#endif
+
+
+/*
+ * Reverb: a four line feedback delay network with a Hadamard feedback
+ *  matrix, fed with the channels' average through two Schroeder allpass
+ *  diffusers. Each line has a one pole lowpass in its feedback for
+ *  damping, and its gain is set so the lines all decay at the same rate.
+ */
+
+#define REVERB_LINES	4
+
+static const float reverb_line_ms[REVERB_LINES] = { 29.7f, 37.1f, 41.1f, 43.7f };
+static const float reverb_allpass_ms[2] = { 5.0f, 1.7f };
+#define REVERB_ALLPASS_GAIN	0.7f
+
+typedef struct _Eff_reverbargs
+{
+    dsp_head head;
+    float *line[REVERB_LINES];
+    int size[REVERB_LINES];     /* length of each line at the largest room */
+    int len[REVERB_LINES];
+    int pos[REVERB_LINES];
+    float gain[REVERB_LINES];
+    float lp[REVERB_LINES];
+    float *allpass[2];
+    int allpass_len[2];
+    int allpass_pos[2];
+    float damp;
+    float wet;
+} reverb_args;
+
+static __inline__ float reverb_input(reverb_args *args, const float *x)
+{
+    float in = 0.0f;
+    int c, k;
+
+    for (c = 0; c < args->head.channels; c++) {
+        in += x[c];
+    }
+    in = in * 0.5f / args->head.channels;
+
+    for (k = 0; k < 2; k++) {
+        float *d = args->allpass[k] + args->allpass_pos[k];
+        float out = *d - REVERB_ALLPASS_GAIN * in;
+        *d = in + REVERB_ALLPASS_GAIN * out + DSP_DENORMAL;
+        if (++args->allpass_pos[k] == args->allpass_len[k]) {
+            args->allpass_pos[k] = 0;
+        }
+        in = out;
+    }
+    return(in);
+}
+
+static __inline__ float reverb_tap(reverb_args *args, int i)
+{
+    int rd = args->pos[i] - args->len[i];
+    if (rd < 0) {
+        rd += args->size[i];
+    }
+    return(args->line[i][rd]);
+}
+
+static __inline__ void reverb_feed(reverb_args *args, int i, float v)
+{
+    args->line[i][args->pos[i]] = v + DSP_DENORMAL;
+    if (++args->pos[i] == args->size[i]) {
+        args->pos[i] = 0;
+    }
+}
+
+static void reverb_kernel(dsp_head *head, float *buf, int frames)
+{
+    reverb_args *args = (reverb_args *) head;
+    int channels = head->channels;
+    float lp[REVERB_LINES], y[REVERB_LINES];
+    float damp = args->damp, wet = args->wet;
+    int f, i, c;
+
+    memcpy(lp, args->lp, sizeof (lp));
+    for (f = 0; f < frames; f++, buf += channels) {
+        float in = reverb_input(args, buf);
+        float s0, s1, s2, s3;
+
+        for (i = 0; i < REVERB_LINES; i++) {
+            float v = reverb_tap(args, i);
+            lp[i] = v + damp * (lp[i] - v);
+        }
+        s0 = lp[0] + lp[1];
+        s1 = lp[0] - lp[1];
+        s2 = lp[2] + lp[3];
+        s3 = lp[2] - lp[3];
+        y[0] = (s0 + s2) * 0.5f;
+        y[1] = (s1 + s3) * 0.5f;
+        y[2] = (s0 - s2) * 0.5f;
+        y[3] = (s1 - s3) * 0.5f;
+        for (i = 0; i < REVERB_LINES; i++) {
+            reverb_feed(args, i, in + args->gain[i] * y[i]);
+        }
+
+        for (c = 0; c < channels; c++) {
+            buf[c] += wet * lp[c & 3];
+        }
+    }
+    memcpy(args->lp, lp, sizeof (lp));
+}
+
+#ifdef MIX_SSE_DSP
+static void reverb_kernel_sse(dsp_head *head, float *buf, int frames)
+{
+    reverb_args *args = (reverb_args *) head;
+    int channels = head->channels;
+    const __m128 half = _mm_set1_ps(0.5f);
+    const __m128 flip1 = _mm_setr_ps(1.0f, -1.0f, 1.0f, -1.0f);
+    const __m128 flip2 = _mm_setr_ps(1.0f, 1.0f, -1.0f, -1.0f);
+    __m128 lp = _mm_loadu_ps(args->lp);
+    __m128 gain = _mm_loadu_ps(args->gain);
+    __m128 damp = _mm_set1_ps(args->damp);
+    __m128 wet = _mm_set1_ps(args->wet);
+    float y[REVERB_LINES];
+    int f, i, c;
+
+    for (f = 0; f < frames; f++, buf += channels) {
+        __m128 in = _mm_set1_ps(reverb_input(args, buf));
+        __m128 v = _mm_setr_ps(reverb_tap(args, 0), reverb_tap(args, 1),
+                               reverb_tap(args, 2), reverb_tap(args, 3));
+        __m128 s, out;
+
+        lp = _mm_add_ps(v, _mm_mul_ps(damp, _mm_sub_ps(lp, v)));
+
+        /* the Hadamard matrix as two butterfly stages */
+        s = _mm_add_ps(_mm_mul_ps(lp, flip1),
+                       _mm_shuffle_ps(lp, lp, _MM_SHUFFLE(2, 3, 0, 1)));
+        s = _mm_add_ps(_mm_mul_ps(s, flip2),
+                       _mm_shuffle_ps(s, s, _MM_SHUFFLE(1, 0, 3, 2)));
+        _mm_storeu_ps(y, _mm_add_ps(in, _mm_mul_ps(gain, _mm_mul_ps(s, half))));
+        for (i = 0; i < REVERB_LINES; i++) {
+            reverb_feed(args, i, y[i]);
+        }
+
+        out = _mm_mul_ps(wet, lp);
+        if (channels <= 4) {
+            store_frame(buf, _mm_add_ps(load_frame(buf, channels), out), channels);
+        } else {
+            _mm_storeu_ps(y, out);
+            for (c = 0; c < channels; c++) {
+                buf[c] += y[c & 3];
+            }
+        }
+    }
+    _mm_storeu_ps(args->lp, lp);
+}
+#endif
+
+static int reverb_args_size(int rate)
+{
+    int i, size = sizeof (reverb_args);
+
+    for (i = 0; i < REVERB_LINES; i++) {
+        size += ((int) (reverb_line_ms[i] * rate / 1000) + 1) * sizeof (float);
+    }
+    for (i = 0; i < 2; i++) {
+        size += ((int) (reverb_allpass_ms[i] * rate / 1000) + 1) * sizeof (float);
+    }
+    return(size);
+}
+
+static void init_reverb_args(reverb_args *args)
+{
+    float *p = (float *) (args + 1);
+    int i;
+
+    for (i = 0; i < REVERB_LINES; i++) {
+        args->size[i] = (int) (reverb_line_ms[i] * args->head.rate / 1000) + 1;
+        args->line[i] = p;
+        p += args->size[i];
+    }
+    for (i = 0; i < 2; i++) {
+        args->allpass_len[i] = (int) (reverb_allpass_ms[i] * args->head.rate / 1000) + 1;
+        args->allpass[i] = p;
+        p += args->allpass_len[i];
+    }
+}
+
+/* Room sizes go from a quarter of the longest lines up, and decay times
+ *  from 0.2 seconds up to 4.
+ */
+static void set_reverb_args(reverb_args *args, Uint8 room, Uint8 damping, Uint8 wet)
+{
+    float scale = 0.25f + 0.75f * room / 255.0f;
+    float rt60 = 0.2f + 3.8f * room / 255.0f;
+    int i;
+
+    for (i = 0; i < REVERB_LINES; i++) {
+        args->len[i] = (int) (args->size[i] * scale);
+        if (args->len[i] < 1) {
+            args->len[i] = 1;
+        }
+        args->gain[i] = (float) pow(10.0, -3.0 * args->len[i] /
+                                    (rt60 * args->head.rate));
+    }
+    args->damp = 0.9f * damping / 255.0f;
+    args->wet = wet / 255.0f;
+}
+
+
+/*
+ * Filters: up to MIX_FILTER_BANDS biquads in series, in transposed direct
+ *  form II, with coefficients from Robert Bristow-Johnson's cookbook.
+ *  The SSE kernel runs the channels of a frame side by side.
+ */
+
+typedef struct
+{
+    Mix_FilterType type;
+    float b0, b1, b2, a1, a2;
+    float z1[8];    /* DSP_MAX_CHANNELS, in whole vectors */
+    float z2[8];
+} filter_band;
+
+typedef struct _Eff_filterargs
+{
+    dsp_head head;
+    filter_band band[MIX_FILTER_BANDS];
+} filter_args;
+
+static void filter_kernel(dsp_head *head, float *buf, int frames)
+{
+    filter_args *args = (filter_args *) head;
+    int channels = head->channels;
+    int b, f, c;
+
+    for (b = 0; b < MIX_FILTER_BANDS; b++) {
+        filter_band *band = &args->band[b];
+        float *p = buf;
+
+        if (band->type == MIX_FILTER_NONE) {
+            continue;
+        }
+        for (f = 0; f < frames; f++) {
+            for (c = 0; c < channels; c++, p++) {
+                float x = *p + DSP_DENORMAL;
+                float y = band->b0 * x + band->z1[c];
+                band->z1[c] = band->b1 * x - band->a1 * y + band->z2[c];
+                band->z2[c] = band->b2 * x - band->a2 * y;
+                *p = y;
+            }
+        }
+    }
+}
+
+#ifdef MIX_SSE_DSP
+static void filter_kernel_sse(dsp_head *head, float *buf, int frames)
+{
+    filter_args *args = (filter_args *) head;
+    int channels = head->channels;
+    const __m128 denormal = _mm_set1_ps(DSP_DENORMAL);
+    int b, f;
+
+    for (b = 0; b < MIX_FILTER_BANDS; b++) {
+        filter_band *band = &args->band[b];
+        __m128 b0 = _mm_set1_ps(band->b0);
+        __m128 b1 = _mm_set1_ps(band->b1);
+        __m128 b2 = _mm_set1_ps(band->b2);
+        __m128 a1 = _mm_set1_ps(band->a1);
+        __m128 a2 = _mm_set1_ps(band->a2);
+        __m128 z1 = _mm_loadu_ps(band->z1);
+        __m128 z2 = _mm_loadu_ps(band->z2);
+        __m128 z1h = _mm_loadu_ps(band->z1 + 4);
+        __m128 z2h = _mm_loadu_ps(band->z2 + 4);
+        float *p = buf;
+
+        if (band->type == MIX_FILTER_NONE) {
+            continue;
+        }
+        for (f = 0; f < frames; f++, p += channels) {
+            __m128 x = _mm_add_ps(load_frame(p, channels), denormal);
+            __m128 y = _mm_add_ps(_mm_mul_ps(b0, x), z1);
+            z1 = _mm_add_ps(_mm_sub_ps(_mm_mul_ps(b1, x), _mm_mul_ps(a1, y)), z2);
+            z2 = _mm_sub_ps(_mm_mul_ps(b2, x), _mm_mul_ps(a2, y));
+            store_frame(p, y, channels);
+
+            /* channels past the fourth take a second vector */
+            if (channels > 4) {
+                x = _mm_add_ps(load_frame(p + 4, channels - 4), denormal);
+                y = _mm_add_ps(_mm_mul_ps(b0, x), z1h);
+                z1h = _mm_add_ps(_mm_sub_ps(_mm_mul_ps(b1, x), _mm_mul_ps(a1, y)), z2h);
+                z2h = _mm_sub_ps(_mm_mul_ps(b2, x), _mm_mul_ps(a2, y));
+                store_frame(p + 4, y, channels - 4);
+            }
+        }
+        _mm_storeu_ps(band->z1, z1);
+        _mm_storeu_ps(band->z2, z2);
+        _mm_storeu_ps(band->z1 + 4, z1h);
+        _mm_storeu_ps(band->z2 + 4, z2h);
+    }
+}
+#endif
+
+static void set_filter_band(filter_band *band, int rate, Mix_FilterType type,
+                            int frequency, float q, float gain)
+{
+    double w0, cw, alpha, A, sa, a0;
+    double b0 = 1.0, b1 = 0.0, b2 = 0.0, a1 = 0.0, a2 = 0.0;
+
+    if (frequency < 1) {
+        frequency = 1;
+    } else if (frequency > rate / 2 - 1) {
+        frequency = rate / 2 - 1;
+    }
+    if (q <= 0.0f) {
+        q = 0.7071f;
+    }
+    w0 = 2.0 * M_PI * frequency / rate;
+    cw = cos(w0);
+    alpha = sin(w0) / (2.0 * q);
+    A = pow(10.0, gain / 40.0);
+    sa = 2.0 * sqrt(A) * alpha;
+    a0 = 1.0 + alpha;
+
+    switch (type) {
+        case MIX_FILTER_LOWPASS:
+            b0 = b2 = (1.0 - cw) / 2.0;
+            b1 = 1.0 - cw;
+            a1 = -2.0 * cw;
+            a2 = 1.0 - alpha;
+            break;
+        case MIX_FILTER_HIGHPASS:
+            b0 = b2 = (1.0 + cw) / 2.0;
+            b1 = -(1.0 + cw);
+            a1 = -2.0 * cw;
+            a2 = 1.0 - alpha;
+            break;
+        case MIX_FILTER_BANDPASS:
+            b0 = alpha;
+            b2 = -alpha;
+            a1 = -2.0 * cw;
+            a2 = 1.0 - alpha;
+            break;
+        case MIX_FILTER_NOTCH:
+            b0 = b2 = 1.0;
+            b1 = a1 = -2.0 * cw;
+            a2 = 1.0 - alpha;
+            break;
+        case MIX_FILTER_PEAKING:
+            b0 = 1.0 + alpha * A;
+            b1 = a1 = -2.0 * cw;
+            b2 = 1.0 - alpha * A;
+            a0 = 1.0 + alpha / A;
+            a2 = 1.0 - alpha / A;
+            break;
+        case MIX_FILTER_LOWSHELF:
+            b0 = A * ((A + 1.0) - (A - 1.0) * cw + sa);
+            b1 = 2.0 * A * ((A - 1.0) - (A + 1.0) * cw);
+            b2 = A * ((A + 1.0) - (A - 1.0) * cw - sa);
+            a0 = (A + 1.0) + (A - 1.0) * cw + sa;
+            a1 = -2.0 * ((A - 1.0) + (A + 1.0) * cw);
+            a2 = (A + 1.0) + (A - 1.0) * cw - sa;
+            break;
+        case MIX_FILTER_HIGHSHELF:
+            b0 = A * ((A + 1.0) + (A - 1.0) * cw + sa);
+            b1 = -2.0 * A * ((A - 1.0) + (A + 1.0) * cw);
+            b2 = A * ((A + 1.0) + (A - 1.0) * cw - sa);
+            a0 = (A + 1.0) - (A - 1.0) * cw + sa;
+            a1 = 2.0 * ((A - 1.0) - (A + 1.0) * cw);
+            a2 = (A + 1.0) - (A - 1.0) * cw - sa;
+            break;
+        default:
+            a0 = 1.0;
+            break;
+    }
+
+    /* a band coming back on starts from rest */
+    if (band->type == MIX_FILTER_NONE) {
+        memset(band->z1, '\0', sizeof (band->z1));
+        memset(band->z2, '\0', sizeof (band->z2));
+    }
+    band->type = type;
+    band->b0 = (float) (b0 / a0);
+    band->b1 = (float) (b1 / a0);
+    band->b2 = (float) (b2 / a0);
+    band->a1 = (float) (a1 / a0);
+    band->a2 = (float) (a2 / a0);
+}
+
+
+/*
+ * Limiter: the audio is delayed by the look-ahead, and the gain each frame
+ *  needs to stay under the ceiling is held over the look-ahead with a
+ *  sliding minimum, released exponentially, then averaged over the
+ *  look-ahead. Every gain averaged into the one a peak leaves with is low
+ *  enough for that peak, so it never overshoots, and the gain ramps down
+ *  smoothly across the look-ahead instead of jumping.
+ */
+
+typedef struct _Eff_limiterargs
+{
+    dsp_head head;
+    int lookahead;      /* frames of delay */
+    float ceiling;
+    float release;      /* how much of the gain reduction is kept each frame */
+    float env;
+    double sum;         /* of the window of gains being averaged */
+    Uint32 frame;
+    float *delay;       /* lookahead frames */
+    int delay_pos;
+    float *window;      /* lookahead + 1 gains */
+    int window_pos;
+    Uint32 *min_frame;  /* the sliding minimum's candidates, a ring of */
+    float *min_gain;    /*  lookahead + 2 with the smallest gain first */
+    int min_first;
+    int min_count;
+} limiter_args;
+
+static __inline__ float limiter_gain(limiter_args *args, float peak)
+{
+    int span = args->lookahead + 2;
+    float req = (peak > args->ceiling) ? args->ceiling / peak : 1.0f;
+    int last;
+
+    while (args->min_count > 0) {
+        last = (args->min_first + args->min_count - 1) % span;
+        if (args->min_gain[last] < req) {
+            break;
+        }
+        args->min_count--;
+    }
+    last = (args->min_first + args->min_count) % span;
+    args->min_frame[last] = args->frame;
+    args->min_gain[last] = req;
+    args->min_count++;
+    if ((Uint32) (args->frame - args->min_frame[args->min_first]) > (Uint32) args->lookahead) {
+        args->min_first = (args->min_first + 1) % span;
+        args->min_count--;
+    }
+    args->frame++;
+
+    args->env = 1.0f - (1.0f - args->env) * args->release;
+    if (args->env > args->min_gain[args->min_first]) {
+        args->env = args->min_gain[args->min_first];
+    }
+
+    args->sum += args->env - args->window[args->window_pos];
+    args->window[args->window_pos] = args->env;
+    if (++args->window_pos > args->lookahead) {
+        int i;
+        args->window_pos = 0;
+        args->sum = 0.0;    /* don't let rounding build up */
+        for (i = 0; i <= args->lookahead; i++) {
+            args->sum += args->window[i];
+        }
+    }
+    return((float) (args->sum / (args->lookahead + 1)));
+}
+
+static void limiter_kernel(dsp_head *head, float *buf, int frames)
+{
+    limiter_args *args = (limiter_args *) head;
+    int channels = head->channels;
+    int f, c;
+
+    for (f = 0; f < frames; f++, buf += channels) {
+        float *d = args->delay + args->delay_pos * channels;
+        float peak = 0.0f, gain;
+
+        for (c = 0; c < channels; c++) {
+            float a = (float) fabs(buf[c]);
+            if (a > peak) {
+                peak = a;
+            }
+        }
+        gain = limiter_gain(args, peak);
+        for (c = 0; c < channels; c++) {
+            float x = buf[c];
+            buf[c] = d[c] * gain;
+            d[c] = x;
+        }
+        if (++args->delay_pos == args->lookahead) {
+            args->delay_pos = 0;
+        }
+    }
+}
+
+#ifdef MIX_SSE_DSP
+static void limiter_kernel_sse(dsp_head *head, float *buf, int frames)
+{
+    limiter_args *args = (limiter_args *) head;
+    int channels = head->channels;
+    const __m128 sign = _mm_set1_ps(-0.0f);
+    int f;
+
+    for (f = 0; f < frames; f++, buf += channels) {
+        float *d = args->delay + args->delay_pos * channels;
+        __m128 x = load_frame(buf, channels);
+        __m128 m = _mm_andnot_ps(sign, x);
+        __m128 xh = _mm_setzero_ps();
+        __m128 gain;
+        float peak;
+
+        /* channels past the fourth take a second vector */
+        if (channels > 4) {
+            xh = load_frame(buf + 4, channels - 4);
+            m = _mm_max_ps(m, _mm_andnot_ps(sign, xh));
+        }
+        m = _mm_max_ps(m, _mm_movehl_ps(m, m));
+        m = _mm_max_ss(m, _mm_shuffle_ps(m, m, 1));
+        _mm_store_ss(&peak, m);
+
+        gain = _mm_set1_ps(limiter_gain(args, peak));
+        store_frame(buf, _mm_mul_ps(load_frame(d, channels), gain), channels);
+        store_frame(d, x, channels);
+        if (channels > 4) {
+            store_frame(buf + 4, _mm_mul_ps(load_frame(d + 4, channels - 4), gain),
+                        channels - 4);
+            store_frame(d + 4, xh, channels - 4);
+        }
+        if (++args->delay_pos == args->lookahead) {
+            args->delay_pos = 0;
+        }
+    }
+}
+#endif
+
+static void free_limiter_buffers(limiter_args *args)
+{
+    SDL_free(args->delay);
+    SDL_free(args->window);
+    SDL_free(args->min_frame);
+    SDL_free(args->min_gain);
+    args->delay = NULL;
+    args->window = NULL;
+    args->min_frame = NULL;
+    args->min_gain = NULL;
+}
+
+/* (Re)start the limiter with a look-ahead, flushing what it held */
+static int set_limiter_lookahead(limiter_args *args, int lookahead)
+{
+    int i;
+
+    free_limiter_buffers(args);
+    args->lookahead = lookahead;
+    args->delay = (float *) SDL_malloc(lookahead * args->head.channels * sizeof (float));
+    args->window = (float *) SDL_malloc((lookahead + 1) * sizeof (float));
+    args->min_frame = (Uint32 *) SDL_malloc((lookahead + 2) * sizeof (Uint32));
+    args->min_gain = (float *) SDL_malloc((lookahead + 2) * sizeof (float));
+    if (!args->delay || !args->window || !args->min_frame || !args->min_gain) {
+        free_limiter_buffers(args);
+        args->lookahead = 0;
+        Mix_SetError("Out of memory");
+        return(0);
+    }
+
+    memset(args->delay, '\0', lookahead * args->head.channels * sizeof (float));
+    for (i = 0; i <= lookahead; i++) {
+        args->window[i] = 1.0f;
+    }
+    args->sum = lookahead + 1;
+    args->env = 1.0f;
+    args->delay_pos = 0;
+    args->window_pos = 0;
+    args->min_first = 0;
+    args->min_count = 0;
+    return(1);
+}
+
+
+/*
+ * Registration. Each effect has a callback for channels and posteffects
+ *  in each output format, and one for the 32-bit sums that the mixer uses
+ *  on posteffects when it can.
+ */
+
+static void _Eff_reverb(int chan, void *stream, int len, void *udata)
+{
+    dsp_s16((dsp_head *) udata, (Sint16 *) stream, len / 2);
+}
+
+static void _Eff_reverb_f32(int chan, void *stream, int len, void *udata)
+{
+    dsp_f32((dsp_head *) udata, (float *) stream, len / 4);
+}
+
+static void _Eff_reverb_wide(int chan, Sint32 *sum, int samples, void *udata)
+{
+    dsp_s32((dsp_head *) udata, sum, samples);
+}
+
+static void _Eff_filter(int chan, void *stream, int len, void *udata)
+{
+    dsp_s16((dsp_head *) udata, (Sint16 *) stream, len / 2);
+}
+
+static void _Eff_filter_f32(int chan, void *stream, int len, void *udata)
+{
+    dsp_f32((dsp_head *) udata, (float *) stream, len / 4);
+}
+
+static void _Eff_filter_wide(int chan, Sint32 *sum, int samples, void *udata)
+{
+    dsp_s32((dsp_head *) udata, sum, samples);
+}
+
+static void _Eff_limiter(int chan, void *stream, int len, void *udata)
+{
+    dsp_s16((dsp_head *) udata, (Sint16 *) stream, len / 2);
+}
+
+static void _Eff_limiter_f32(int chan, void *stream, int len, void *udata)
+{
+    dsp_f32((dsp_head *) udata, (float *) stream, len / 4);
+}
+
+static void _Eff_limiter_wide(int chan, Sint32 *sum, int samples, void *udata)
+{
+    dsp_s32((dsp_head *) udata, sum, samples);
+}
+
+static const struct {
+    Mix_EffectFunc_t callback;
+    Mix_EffectFunc_t callback_f32;
+    _Mix_WideEffectFunc wide;
+    dsp_kernel kernel;
+#ifdef MIX_SSE_DSP
+    dsp_kernel kernel_sse;
+#endif
+} dsp_effects[DSP_TYPES] = {
+#ifdef MIX_SSE_DSP
+    { _Eff_reverb, _Eff_reverb_f32, _Eff_reverb_wide, reverb_kernel, reverb_kernel_sse },
+    { _Eff_filter, _Eff_filter_f32, _Eff_filter_wide, filter_kernel, filter_kernel_sse },
+    { _Eff_limiter, _Eff_limiter_f32, _Eff_limiter_wide, limiter_kernel, limiter_kernel_sse }
+#else
+    { _Eff_reverb, _Eff_reverb_f32, _Eff_reverb_wide, reverb_kernel },
+    { _Eff_filter, _Eff_filter_f32, _Eff_filter_wide, filter_kernel },
+    { _Eff_limiter, _Eff_limiter_f32, _Eff_limiter_wide, limiter_kernel }
+#endif
+};
+
+
+static void **get_dsp_slot(int type, int channel)
+{
+    void *rc;
+    int i;
+
+    if (channel < 0) {
+        return(&dsp_args_global[type]);
+    }
+
+    if (channel >= dsp_channels[type]) {
+        rc = SDL_realloc(dsp_args_array[type], (channel + 1) * sizeof (void *));
+        if (rc == NULL) {
+            Mix_SetError("Out of memory");
+            return(NULL);
+        }
+        dsp_args_array[type] = (void **) rc;
+        for (i = dsp_channels[type]; i <= channel; i++) {
+            dsp_args_array[type][i] = NULL;
+        }
+        dsp_channels[type] = channel + 1;
+    }
+    return(&dsp_args_array[type][channel]);
+}
+
+/* This frees the callback-specific data, wherever it was kept. */
+static void _Eff_DSPDone(int channel, void *udata)
+{
+    dsp_head *head = (dsp_head *) udata;
+
+    if (channel < 0) {
+        if (dsp_args_global[head->type] == udata) {
+            dsp_args_global[head->type] = NULL;
+        }
+    } else if (channel < dsp_channels[head->type] &&
+               dsp_args_array[head->type][channel] == udata) {
+        dsp_args_array[head->type][channel] = NULL;
+    }
+
+    if (head->type == DSP_LIMITER) {
+        free_limiter_buffers((limiter_args *) head);
+    }
+    SDL_free(udata);
+}
+
+void _Eff_DSPDeinit(void)
+{
+    int type;
+
+    for (type = 0; type < DSP_TYPES; type++) {
+        SDL_free(dsp_args_array[type]);
+        dsp_args_array[type] = NULL;
+        dsp_channels[type] = 0;
+    }
+}
+
+/* Find an effect's arguments on a channel, registering it with (size)
+ *  bytes of zeroed arguments if it's not there yet. (created) says which.
+ *  MAKE SURE you hold the audio lock (SDL_LockAudio()) before calling this!
+ */
+static dsp_head *get_dsp_args(int type, int channel, int size, int *created)
+{
+    void **slot = get_dsp_slot(type, channel);
+    dsp_head *head;
+    Uint16 format;
+
+    *created = 0;
+    if (slot == NULL) {
+        return(NULL);
+    }
+    if (*slot != NULL) {
+        return((dsp_head *) *slot);
+    }
+
+    head = (dsp_head *) SDL_malloc(size);
+    if (head == NULL) {
+        Mix_SetError("Out of memory");
+        return(NULL);
+    }
+    memset(head, '\0', size);
+    head->type = type;
+    Mix_QuerySpec(&head->rate, &format, &head->channels);
+    if (format == AUDIO_F32SYS) {
+        head->full_scale = 1.0f;
+        head->callback = dsp_effects[type].callback_f32;
+    } else {
+        head->full_scale = 32767.0f;
+        head->callback = dsp_effects[type].callback;
+    }
+    head->kernel = dsp_effects[type].kernel;
+#ifdef MIX_SSE_DSP
+    if (SDL_HasSSE()) {
+        head->kernel = dsp_effects[type].kernel_sse;
+    }
+#endif
+    if (!_Mix_RegisterEffect_locked(channel, head->callback,
+                                    _Eff_DSPDone, head)) {
+        SDL_free(head);
+        return(NULL);
+    }
+    _Mix_SetEffectWide(channel, head->callback, dsp_effects[type].wide);
+    *slot = head;
+    *created = 1;
+    return(head);
+}
+
+/* MAKE SURE you hold the audio lock (SDL_LockAudio()) before calling this! */
+static int remove_dsp_args(int type, int channel)
+{
+    void **slot = get_dsp_slot(type, channel);
+
+    if (slot == NULL || *slot == NULL) {
+        return(1);
+    }
+    return(_Mix_UnregisterEffect_locked(channel, ((dsp_head *) *slot)->callback));
+}
+
+static int check_dsp_format(void)
+{
+    Uint16 format;
+    int channels;
+
+    if (!Mix_QuerySpec(NULL, &format, &channels)) {
+        Mix_SetError("Audio device hasn't been opened");
+        return(0);
+    }
+    if ((format != AUDIO_S16SYS && format != AUDIO_F32SYS) ||
+        channels > DSP_MAX_CHANNELS) {
+        Mix_SetError("Unsupported audio format");
+        return(0);
+    }
+    return(1);
+}
+
+
+int Mix_SetReverb(int channel, Uint8 room, Uint8 damping, Uint8 wet)
+{
+    reverb_args *args;
+    int created, rate;
+    int retval = 1;
+
+    if (!check_dsp_format()) {
+        return(0);
+    }
+    Mix_QuerySpec(&rate, NULL, NULL);
+
+    SDL_LockAudio();
+    if (!wet) {
+        retval = remove_dsp_args(DSP_REVERB, channel);
+    } else {
+        args = (reverb_args *) get_dsp_args(DSP_REVERB, channel,
+                                            reverb_args_size(rate), &created);
+        if (args == NULL) {
+            retval = 0;
+        } else {
+            if (created) {
+                init_reverb_args(args);
+            }
+            set_reverb_args(args, room, damping, wet);
+        }
+    }
+    SDL_UnlockAudio();
+    return(retval);
+}
+
+
+int Mix_SetFilter(int channel, int band, Mix_FilterType type,
+                  int frequency, float q, float gain)
+{
+    filter_args *args;
+    int created, i;
+    int retval = 1;
+
+    if (!check_dsp_format()) {
+        return(0);
+    }
+    if (band < 0 || band >= MIX_FILTER_BANDS) {
+        Mix_SetError("Invalid filter band");
+        return(0);
+    }
+    if ((int) type < MIX_FILTER_NONE || (int) type > MIX_FILTER_HIGHSHELF) {
+        Mix_SetError("Invalid filter type");
+        return(0);
+    }
+
+    SDL_LockAudio();
+    if (type == MIX_FILTER_NONE) {
+        void **slot = get_dsp_slot(DSP_FILTER, channel);
+        if (slot != NULL && *slot != NULL) {
+            args = (filter_args *) *slot;
+            args->band[band].type = MIX_FILTER_NONE;
+
+                /* it's a no-op; unregister the effect. */
+            for (i = 0; i < MIX_FILTER_BANDS; i++) {
+                if (args->band[i].type != MIX_FILTER_NONE) {
+                    break;
+                }
+            }
+            if (i == MIX_FILTER_BANDS) {
+                retval = remove_dsp_args(DSP_FILTER, channel);
+            }
+        }
+    } else {
+        args = (filter_args *) get_dsp_args(DSP_FILTER, channel,
+                                            sizeof (filter_args), &created);
+        if (args == NULL) {
+            retval = 0;
+        } else {
+            set_filter_band(&args->band[band], args->head.rate, type,
+                            frequency, q, gain);
+        }
+    }
+    SDL_UnlockAudio();
+    return(retval);
+}
+
+
+int Mix_SetLimiter(int channel, float ceiling, int lookahead, int release)
+{
+    limiter_args *args;
+    int created, frames;
+    int retval = 1;
+
+    if (!check_dsp_format()) {
+        return(0);
+    }
+
+    SDL_LockAudio();
+    if (lookahead < 0) {
+        retval = remove_dsp_args(DSP_LIMITER, channel);
+    } else {
+        args = (limiter_args *) get_dsp_args(DSP_LIMITER, channel,
+                                             sizeof (limiter_args), &created);
+        if (args == NULL) {
+            retval = 0;
+        } else {
+            frames = lookahead * args->head.rate / 1000;
+            if (frames < 1) {
+                frames = 1;
+            }
+            if (frames != args->lookahead &&
+                !set_limiter_lookahead(args, frames)) {
+                _Mix_UnregisterEffect_locked(channel, args->head.callback);
+                retval = 0;
+            } else {
+                args->ceiling = (float) (args->head.full_scale *
+                                         pow(10.0, ceiling / 20.0));
+                if (release > 0) {
+                    args->release = (float) exp(-1000.0 / ((double) release * args->head.rate));
+                } else {
+                    args->release = 0.0f;
+                }
+            }
+        }
+    }
+    SDL_UnlockAudio();
+    return(retval);
+}
+
+
+#ifdef TEST_MAIN
+
+#include <time.h>
+
+/* Run each effect's C and SSE kernels over the same noisy sine, loud
+   enough to keep the limiter busy, check that they come out the same,
+   and time them.
+*/
+
+#define TEST_RATE	44100
+#define TEST_FRAMES	4096
+
+static float test_in[TEST_FRAMES * DSP_MAX_CHANNELS];
+static float test_out[2][TEST_FRAMES * DSP_MAX_CHANNELS];
+
+static dsp_head *NewArgs(int type, int channels, dsp_kernel kernel)
+{
+    dsp_head *head;
+    int size;
+
+    switch (type) {
+        case DSP_REVERB:
+            size = reverb_args_size(TEST_RATE);
+            break;
+        case DSP_FILTER:
+            size = sizeof (filter_args);
+            break;
+        default:
+            size = sizeof (limiter_args);
+            break;
+    }
+    head = (dsp_head *) SDL_malloc(size);
+    memset(head, '\0', size);
+    head->type = type;
+    head->channels = channels;
+    head->rate = TEST_RATE;
+    head->full_scale = 32767.0f;
+    head->kernel = kernel;
+
+    switch (type) {
+        case DSP_REVERB:
+            init_reverb_args((reverb_args *) head);
+            set_reverb_args((reverb_args *) head, 200, 100, 128);
+            break;
+        case DSP_FILTER: {
+            filter_args *args = (filter_args *) head;
+            set_filter_band(&args->band[0], TEST_RATE, MIX_FILTER_HIGHPASS, 40, 0.7071f, 0.0f);
+            set_filter_band(&args->band[1], TEST_RATE, MIX_FILTER_PEAKING, 1000, 1.0f, 6.0f);
+            set_filter_band(&args->band[2], TEST_RATE, MIX_FILTER_HIGHSHELF, 6000, 0.7071f, -3.0f);
+            set_filter_band(&args->band[3], TEST_RATE, MIX_FILTER_LOWPASS, 16000, 0.7071f, 0.0f);
+            break;
+        }
+        default: {
+            limiter_args *args = (limiter_args *) head;
+            set_limiter_lookahead(args, 5 * TEST_RATE / 1000);
+            args->ceiling = (float) (head->full_scale * pow(10.0, -1.0 / 20.0));
+            args->release = (float) exp(-1000.0 / (50.0 * TEST_RATE));
+            break;
+        }
+    }
+    return(head);
+}
+
+static void FreeArgs(dsp_head *head)
+{
+    if (head->type == DSP_LIMITER) {
+        free_limiter_buffers((limiter_args *) head);
+    }
+    SDL_free(head);
+}
+
+/* Samples a second through (kernel), leaving the last run in (out) */
+static double TimeKernel(int type, int channels, dsp_kernel kernel, float *out)
+{
+    dsp_head *head = NewArgs(type, channels, kernel);
+    int samples = TEST_FRAMES * channels;
+    clock_t start;
+    int runs = 0;
+
+    start = clock();
+    do {
+        memcpy(out, test_in, samples * sizeof (float));
+        dsp_f32(head, out, samples);
+        ++runs;
+    } while (clock() - start < CLOCKS_PER_SEC / 4);
+    FreeArgs(head);
+    return((double) samples * runs * CLOCKS_PER_SEC / (clock() - start));
+}
+
+/* The same input through fresh C and SSE kernels should match exactly */
+static int CompareKernels(int type, int channels)
+{
+#ifdef MIX_SSE_DSP
+    dsp_head *head[2];
+    int samples = TEST_FRAMES * channels;
+    int same, pass, i;
+
+    head[0] = NewArgs(type, channels, dsp_effects[type].kernel);
+    head[1] = NewArgs(type, channels, dsp_effects[type].kernel_sse);
+    same = 1;
+    /* a second pass carries the effects' state over */
+    for (pass = 0; pass < 2; pass++) {
+        for (i = 0; i < 2; i++) {
+            memcpy(test_out[i], test_in, samples * sizeof (float));
+            dsp_f32(head[i], test_out[i], samples);
+        }
+        if (memcmp(test_out[0], test_out[1], samples * sizeof (float)) != 0) {
+            same = 0;
+        }
+    }
+    FreeArgs(head[0]);
+    FreeArgs(head[1]);
+    return(same);
+#else
+    return(1);
+#endif
+}
+
+int main(int argc, char *argv[])
+{
+    static const char *names[DSP_TYPES] = { "reverb", "filter", "limiter" };
+    static const int channels[] = { 1, 2, 4, 6 };
+    int type, c, i;
+
+    srand(1);
+    for (i = 0; i < TEST_FRAMES * DSP_MAX_CHANNELS; i++) {
+        test_in[i] = (float) (30000.0 * sin(2.0 * M_PI * 440.0 * (i / 2) / TEST_RATE) +
+                              6000.0 * (rand() - RAND_MAX / 2) / RAND_MAX);
+    }
+
+    for (type = 0; type < DSP_TYPES; type++) {
+        for (c = 0; c < (int) (sizeof (channels) / sizeof (channels[0])); c++) {
+            printf("%-8s %d channels: C %6.1f Msamples/s", names[type], channels[c],
+                   TimeKernel(type, channels[c], dsp_effects[type].kernel,
+                              test_out[0]) / 1e6);
+#ifdef MIX_SSE_DSP
+            if (SDL_HasSSE()) {
+                printf(", SSE %6.1f Msamples/s, %s",
+                       TimeKernel(type, channels[c], dsp_effects[type].kernel_sse,
+                                  test_out[1]) / 1e6,
+                       CompareKernels(type, channels[c]) ? "identical" : "failed");
+            } else {
+                printf(", SSE not available");
+            }
+#endif
+            printf("\n");
+        }
+    }
+    return(0);
+}
+
+#endif /* TEST_MAIN */
+
+/* end of effect_dsp.c ... */
+
@@ -1129,6 +1129,123 @@ static void _Eff_position_s16msb_c6(int chan, void *stream, int len, void *udata
     }
 }
 
+static void _Eff_position_f32sys(int chan, void *stream, int len, void *udata)
+{
+    /* 32 bits float (native) * 2 channels, nothing to clip. */
+    volatile position_args *args = (volatile position_args *) udata;
+    float *ptr = (float *) stream;
+    const float l = args->left_f * args->distance_f;
+    const float r = args->right_f * args->distance_f;
+    int i;
+
+    for (i = 0; i < len; i += sizeof (float) * 2) {
+        float swapl = ptr[0] * l;
+        float swapr = ptr[1] * r;
+        if (args->room_angle == 180) {
+            *(ptr++) = swapr;
+            *(ptr++) = swapl;
+        }
+        else {
+            *(ptr++) = swapl;
+            *(ptr++) = swapr;
+        }
+    }
+}
+
+static void _Eff_position_f32sys_c4(int chan, void *stream, int len, void *udata)
+{
+    /* 32 bits float (native) * 4 channels. */
+    volatile position_args *args = (volatile position_args *) udata;
+    float *ptr = (float *) stream;
+    const float d = args->distance_f;
+    int i;
+
+    for (i = 0; i < len; i += sizeof (float) * 4) {
+        float swapl = ptr[0] * args->left_f * d;
+        float swapr = ptr[1] * args->right_f * d;
+        float swaplr = ptr[2] * args->left_rear_f * d;
+        float swaprr = ptr[3] * args->right_rear_f * d;
+        switch (args->room_angle) {
+            case 0:
+                *(ptr++) = swapl;
+                *(ptr++) = swapr;
+                *(ptr++) = swaplr;
+                *(ptr++) = swaprr;
+                break;
+            case 90:
+                *(ptr++) = swapr;
+                *(ptr++) = swaprr;
+                *(ptr++) = swapl;
+                *(ptr++) = swaplr;
+                break;
+            case 180:
+                *(ptr++) = swaprr;
+                *(ptr++) = swaplr;
+                *(ptr++) = swapr;
+                *(ptr++) = swapl;
+                break;
+            case 270:
+                *(ptr++) = swaplr;
+                *(ptr++) = swapl;
+                *(ptr++) = swaprr;
+                *(ptr++) = swapr;
+                break;
+        }
+    }
+}
+
+static void _Eff_position_f32sys_c6(int chan, void *stream, int len, void *udata)
+{
+    /* 32 bits float (native) * 6 channels. */
+    volatile position_args *args = (volatile position_args *) udata;
+    float *ptr = (float *) stream;
+    const float d = args->distance_f;
+    int i;
+
+    for (i = 0; i < len; i += sizeof (float) * 6) {
+        float swapl = ptr[0] * args->left_f * d;
+        float swapr = ptr[1] * args->right_f * d;
+        float swaplr = ptr[2] * args->left_rear_f * d;
+        float swaprr = ptr[3] * args->right_rear_f * d;
+        float swapce = ptr[4] * args->center_f * d;
+        float swapwf = ptr[5] * args->lfe_f * d;
+        switch (args->room_angle) {
+            case 0:
+                *(ptr++) = swapl;
+                *(ptr++) = swapr;
+                *(ptr++) = swaplr;
+                *(ptr++) = swaprr;
+                *(ptr++) = swapce;
+                *(ptr++) = swapwf;
+                break;
+            case 90:
+                *(ptr++) = swapr;
+                *(ptr++) = swaprr;
+                *(ptr++) = swapl;
+                *(ptr++) = swaplr;
+                *(ptr++) = swapr/2 + swaprr/2;
+                *(ptr++) = swapwf;
+                break;
+            case 180:
+                *(ptr++) = swaprr;
+                *(ptr++) = swaplr;
+                *(ptr++) = swapr;
+                *(ptr++) = swapl;
+                *(ptr++) = swaprr/2 + swaplr/2;
+                *(ptr++) = swapwf;
+                break;
+            case 270:
+                *(ptr++) = swaplr;
+                *(ptr++) = swapl;
+                *(ptr++) = swaprr;
+                *(ptr++) = swapr;
+                *(ptr++) = swapl/2 + swaplr/2;
+                *(ptr++) = swapwf;
+                break;
+        }
+    }
+}
+
 static void init_position_args(position_args *args)
 {
     memset(args, '\0', sizeof (position_args));
@@ -1283,6 +1400,21 @@ static Mix_EffectFunc_t get_position_effect_func(Uint16 format, int channels)
 	    }
             break;
 
+        case AUDIO_F32SYS:
+	    switch (channels) {
+		    case 1:
+		    case 2:
+            		f = _Eff_position_f32sys;
+	    		break;
+	    	    case 4:
+            		f = _Eff_position_f32sys_c4;
+	    		break;
+	    	    case 6:
+            		f = _Eff_position_f32sys_c6;
+	    		break;
+	    }
+            break;
+
         default:
             Mix_SetError("Unsupported audio format");
     }
@@ -1421,8 +1553,104 @@ static void set_amplitudes(int channels, int angle, int room_angle)
     speaker_amplitude[5] = 255;
 }
 
+/* Speaker k of the position effect gets input a, scaled by ga, plus input
+ *  b scaled by gb, as the _Eff_position_s16* functions compute them.
+ */
+static void set_speaker(_Mix_SpeakerGains *g, int k, int a, float ga, int b, float gb)
+{
+    g->src[k][0] = (Uint8) a;
+    g->gain[k][0] = (Sint16) (ga * 32767.0f);
+    g->src[k][1] = (Uint8) b;
+    g->gain[k][1] = (Sint16) (gb * 32767.0f);
+}
+
+/* Hand a channel's position to the mixer as gains, so it's applied as
+ *  the channel is mixed instead of as a pass of its own.  The mixer
+ *  falls back to the effect callback where it can't.
+ */
+static void set_position_gains(int channel, Mix_EffectFunc_t f, position_args *args)
+{
+    _Mix_SpeakerGains g;
+    float d = args->distance_f;
+    float l = args->left_f * d, r = args->right_f * d;
+    float lr = args->left_rear_f * d, rr = args->right_rear_f * d;
+
+    memset(&g, '\0', sizeof (g));
+    switch (args->channels) {
+        case 1:
+            set_speaker(&g, 0, 0, d, 0, 0.0f);
+            break;
+
+        case 2:
+            if (args->room_angle == 180) {
+                set_speaker(&g, 0, 1, r, 0, 0.0f);
+                set_speaker(&g, 1, 0, l, 0, 0.0f);
+            } else {
+                set_speaker(&g, 0, 0, l, 0, 0.0f);
+                set_speaker(&g, 1, 1, r, 0, 0.0f);
+            }
+            break;
+
+        case 4:
+        case 6:
+            switch (args->room_angle) {
+                case 0:
+                    set_speaker(&g, 0, 0, l, 0, 0.0f);
+                    set_speaker(&g, 1, 1, r, 0, 0.0f);
+                    set_speaker(&g, 2, 2, lr, 0, 0.0f);
+                    set_speaker(&g, 3, 3, rr, 0, 0.0f);
+                    set_speaker(&g, 4, 4, args->center_f * d, 0, 0.0f);
+                    break;
+                case 90:
+                    set_speaker(&g, 0, 1, r, 0, 0.0f);
+                    set_speaker(&g, 1, 3, rr, 0, 0.0f);
+                    set_speaker(&g, 2, 0, l, 0, 0.0f);
+                    set_speaker(&g, 3, 2, lr, 0, 0.0f);
+                    set_speaker(&g, 4, 1, r / 2, 3, rr / 2);
+                    break;
+                case 180:
+                    set_speaker(&g, 0, 3, rr, 0, 0.0f);
+                    set_speaker(&g, 1, 2, lr, 0, 0.0f);
+                    set_speaker(&g, 2, 1, r, 0, 0.0f);
+                    set_speaker(&g, 3, 0, l, 0, 0.0f);
+                    set_speaker(&g, 4, 3, rr / 2, 2, lr / 2);
+                    break;
+                case 270:
+                    set_speaker(&g, 0, 2, lr, 0, 0.0f);
+                    set_speaker(&g, 1, 0, l, 0, 0.0f);
+                    set_speaker(&g, 2, 3, rr, 0, 0.0f);
+                    set_speaker(&g, 3, 1, r, 0, 0.0f);
+                    set_speaker(&g, 4, 0, l / 2, 2, lr / 2);
+                    break;
+            }
+            set_speaker(&g, 5, 5, args->lfe_f * d, 0, 0.0f);
+            break;
+
+        default:
+            return;
+    }
+
+    _Mix_SetEffectGains(channel, f, &g);
+}
+
 int Mix_SetPosition(int channel, Sint16 angle, Uint8 distance);
 
+/* With the mixer queueing commands, these run in the audio callback */
+static void set_panning_queued(int channel, int left, int right)
+{
+    Mix_SetPanning(channel, (Uint8) left, (Uint8) right);
+}
+
+static void set_distance_queued(int channel, int distance, int unused)
+{
+    Mix_SetDistance(channel, (Uint8) distance);
+}
+
+static void set_position_queued(int channel, int angle, int distance)
+{
+    Mix_SetPosition(channel, (Sint16) angle, (Uint8) distance);
+}
+
 int Mix_SetPanning(int channel, Uint8 left, Uint8 right)
 {
     Mix_EffectFunc_t f = NULL;
@@ -1430,6 +1658,7 @@ int Mix_SetPanning(int channel, Uint8 left, Uint8 right)
     Uint16 format;
     position_args *args = NULL;
     int retval = 1;
+    int queued;
 
     Mix_QuerySpec(NULL, &format, &channels);
 
@@ -1453,6 +1682,10 @@ int Mix_SetPanning(int channel, Uint8 left, Uint8 right)
     if (f == NULL)
         return(0);
 
+    queued = _Mix_QueueCall(set_panning_queued, channel, left, right);
+    if (queued)
+        return(queued > 0);
+
     SDL_LockAudio();
     args = get_position_arg(channel);
     if (!args) {
@@ -1482,6 +1715,7 @@ int Mix_SetPanning(int channel, Uint8 left, Uint8 right)
         args->in_use = 1;
         retval=_Mix_RegisterEffect_locked(channel, f, _Eff_PositionDone, (void*)args);
     }
+    set_position_gains(channel, f, args);
 
     SDL_UnlockAudio();
     return(retval);
@@ -1495,12 +1729,17 @@ int Mix_SetDistance(int channel, Uint8 distance)
     position_args *args = NULL;
     int channels;
     int retval = 1;
+    int queued;
 
     Mix_QuerySpec(NULL, &format, &channels);
     f = get_position_effect_func(format, channels);
     if (f == NULL)
         return(0);
 
+    queued = _Mix_QueueCall(set_distance_queued, channel, distance, 0);
+    if (queued)
+        return(queued > 0);
+
     SDL_LockAudio();
     args = get_position_arg(channel);
     if (!args) {
@@ -1528,6 +1767,7 @@ int Mix_SetDistance(int channel, Uint8 distance)
         args->in_use = 1;
         retval = _Mix_RegisterEffect_locked(channel, f, _Eff_PositionDone, (void *) args);
     }
+    set_position_gains(channel, f, args);
 
     SDL_UnlockAudio();
     return(retval);
@@ -1542,12 +1782,17 @@ int Mix_SetPosition(int channel, Sint16 angle, Uint8 distance)
     position_args *args = NULL;
     Sint16 room_angle = 0;
     int retval = 1;
+    int queued;
 
     Mix_QuerySpec(NULL, &format, &channels);
     f = get_position_effect_func(format, channels);
     if (f == NULL)
         return(0);
 
+    queued = _Mix_QueueCall(set_position_queued, channel, angle, distance);
+    if (queued)
+        return(queued > 0);
+
     angle = SDL_abs(angle) % 360;  /* make angle between 0 and 359. */
 
     SDL_LockAudio();
@@ -1609,6 +1854,7 @@ int Mix_SetPosition(int channel, Sint16 angle, Uint8 distance)
         args->in_use = 1;
         retval = _Mix_RegisterEffect_locked(channel, f, _Eff_PositionDone, (void *) args);
     }
+    set_position_gains(channel, f, args);
 
     SDL_UnlockAudio();
     return(retval);
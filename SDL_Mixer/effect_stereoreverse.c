@@ -55,6 +55,21 @@
  * Stereo reversal effect...this one's pretty straightforward...
  */
 
+static void _Eff_reversestereo32(int chan, void *stream, int len, void *udata)
+{
+    /* 32 bits * 2 channels. */
+    Uint32 *ptr = (Uint32 *) stream;
+    Uint32 tmp;
+    int i;
+
+    for (i = 0; i < len; i += sizeof (Uint32) * 2, ptr += 2) {
+        tmp = ptr[0];
+        ptr[0] = ptr[1];
+        ptr[1] = tmp;
+    }
+}
+
+
 static void _Eff_reversestereo16(int chan, void *stream, int len, void *udata)
 {
     /* 16 bits * 2 channels. */
@@ -96,7 +111,9 @@ int Mix_SetReverseStereo(int channel, int flip)
     Mix_QuerySpec(NULL, &format, &channels);
 
     if (channels == 2) {
-        if ((format & 0xFF) == 16)
+        if ((format & 0xFF) == 32)
+            f = _Eff_reversestereo32;
+        else if ((format & 0xFF) == 16)
             f = _Eff_reversestereo16;
         else if ((format & 0xFF) == 8)
             f = _Eff_reversestereo8;
@@ -33,10 +33,18 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include "SDL_mixer.h"
+#include "SDL_cpuinfo.h"
 
 #define __MIX_INTERNAL_EFFECT__
 #include "effects_internal.h"
 
+#if (defined(__GNUC__) && defined(__SSE2__)) || \
+    (defined(_MSC_VER) && (_MSC_VER >= 1300) && \
+     (defined(_M_IX86) || defined(_M_X64)) && !defined(_XBOX))
+#define MIX_SSE2_GAINS	1
+#include <emmintrin.h>
+#endif
+
 /* Should we favor speed over memory usage and/or quality of output? */
 int _Mix_effects_max_speed = 0;
 
@@ -49,6 +57,8 @@ void _Mix_InitEffects(void)
 void _Mix_DeinitEffects(void)
 {
     _Eff_PositionDeinit();
+    _Eff_BinauralDeinit();
+    _Eff_DSPDeinit();
 }
 
 
@@ -120,5 +130,197 @@ void *_Eff_build_volume_table_s8(void)
 }
 
 
+/* Scale a buffer of samples in place by a volume that moves linearly from
+ *  'from' at the first frame to 'to' at the end, both 0 to MIX_MAX_VOLUME.
+ *  The volume is kept in 16.16 fixed point so that each frame gets its own,
+ *  and applied to the samples as 1/256ths.
+ */
+void _Mix_RampVolume(Uint16 format, int channels, Uint8 *buf, int len,
+                     int from, int to)
+{
+    int frames, i;
+    Sint32 gain, step;
+
+    frames = len / (((format & 0xFF) / 8) * channels);
+    if (frames <= 0) {
+        return;
+    }
+    gain = from << 16;
+    step = ((to - from) << 16) / frames;
+
+    switch (format) {
+        case AUDIO_U8:
+            while (frames--) {
+                for (i = 0; i < channels; i++, buf++) {
+                    *buf = (Uint8)(((((Sint32)*buf - 128) * (gain >> 8)) >> 15) + 128);
+                }
+                gain += step;
+            }
+            break;
+
+        case AUDIO_S8:
+            while (frames--) {
+                for (i = 0; i < channels; i++, buf++) {
+                    *buf = (Uint8)((*(Sint8 *)buf * (gain >> 8)) >> 15);
+                }
+                gain += step;
+            }
+            break;
+
+        case AUDIO_S16LSB:
+        case AUDIO_S16MSB:
+        case AUDIO_U16LSB:
+        case AUDIO_U16MSB: {
+            int lsb = (format == AUDIO_S16LSB || format == AUDIO_U16LSB);
+            Sint32 bias = (format & 0x8000) ? 0 : 32768;
+            while (frames--) {
+                for (i = 0; i < channels; i++, buf += 2) {
+                    Sint32 sample;
+                    if (lsb) {
+                        sample = (buf[1] << 8) | buf[0];
+                    } else {
+                        sample = (buf[0] << 8) | buf[1];
+                    }
+                    if (!bias) {
+                        sample = (Sint16)sample;
+                    } else {
+                        sample -= bias;
+                    }
+                    sample = ((sample * (gain >> 8)) >> 15) + bias;
+                    if (lsb) {
+                        buf[0] = sample & 0xFF;
+                        buf[1] = (sample >> 8) & 0xFF;
+                    } else {
+                        buf[1] = sample & 0xFF;
+                        buf[0] = (sample >> 8) & 0xFF;
+                    }
+                }
+                gain += step;
+            }
+        }
+        break;
+
+        case AUDIO_F32SYS: {
+            float *fbuf = (float *) buf;
+            while (frames--) {
+                float g = (float) (gain >> 8) * (1.0f / 32768.0f);
+                for (i = 0; i < channels; i++) {
+                    *fbuf++ *= g;
+                }
+                gain += step;
+            }
+        }
+        break;
+    }
+}
+
+
+
+/* Scale eight samples by their gains and add them to the sums or, with
+ *  saturation, to the stream.  Stereo taps may swap the channels.
+ */
+#if MIX_SSE2_GAINS
+static int mix_gains_sse2(const Sint16 *src, int samples, __m128i gains,
+                          int swap, Sint16 *dst, Sint32 *sum)
+{
+    int n;
+
+    for (n = samples & ~7; n; n -= 8) {
+        __m128i s = _mm_loadu_si128((const __m128i *) src);
+        __m128i lo, hi, p0, p1;
+
+        if (swap) {
+            s = _mm_shufflelo_epi16(s, _MM_SHUFFLE(2, 3, 0, 1));
+            s = _mm_shufflehi_epi16(s, _MM_SHUFFLE(2, 3, 0, 1));
+        }
+        lo = _mm_mullo_epi16(s, gains);
+        hi = _mm_mulhi_epi16(s, gains);
+        p0 = _mm_srai_epi32(_mm_unpacklo_epi16(lo, hi), 15);
+        p1 = _mm_srai_epi32(_mm_unpackhi_epi16(lo, hi), 15);
+        if (sum) {
+            _mm_storeu_si128((__m128i *) sum,
+                _mm_add_epi32(_mm_loadu_si128((__m128i *) sum), p0));
+            _mm_storeu_si128((__m128i *) (sum + 4),
+                _mm_add_epi32(_mm_loadu_si128((__m128i *) (sum + 4)), p1));
+            sum += 8;
+        } else {
+            _mm_storeu_si128((__m128i *) dst,
+                _mm_adds_epi16(_mm_loadu_si128((__m128i *) dst),
+                               _mm_packs_epi32(p0, p1)));
+            dst += 8;
+        }
+        src += 8;
+    }
+    return(samples & ~7);
+}
+#endif
+
+/* Mix frames of signed 16-bit native audio through a channel's speaker
+ *  gains, with the volume moving from 'from' to 'to' (0 to
+ *  MIX_MAX_VOLUME) as in _Mix_RampVolume().  The result is added to the
+ *  32-bit sums if there are any, or else to the stream with clipping.
+ */
+void _Mix_MixSpeakerGains(const _Mix_SpeakerGains *g, int channels,
+                          const Sint16 *src, int frames, int from, int to,
+                          Sint16 *dst, Sint32 *sum)
+{
+    Sint32 gain, step, sample, g0[6], g1[6];
+    int i, k;
+
+    if (frames <= 0) {
+        return;
+    }
+    gain = from << 16;
+    step = ((to - from) << 16) / frames;
+
+    /* Whole vectors of steady mono or stereo go to SSE2 */
+#if MIX_SSE2_GAINS
+    if (from == to && channels <= 2 && SDL_HasSSE2()) {
+        Sint16 v0 = (Sint16) ((g->gain[0][0] * (gain >> 8)) >> 15);
+        Sint16 v1 = (channels == 2) ?
+                    (Sint16) ((g->gain[1][0] * (gain >> 8)) >> 15) : v0;
+        int swap = (channels == 2 && g->src[0][0] == 1);
+        int done = mix_gains_sse2(src, frames * channels,
+                                  _mm_set_epi16(v1, v0, v1, v0, v1, v0, v1, v0),
+                                  swap, dst, sum);
+        src += done;
+        if (sum) {
+            sum += done;
+        } else {
+            dst += done;
+        }
+        frames -= done / channels;
+    }
+#endif
+
+    for (i = 0; i < frames; i++) {
+        if (i == 0 || step) {
+            for (k = 0; k < channels; k++) {
+                g0[k] = (g->gain[k][0] * (gain >> 8)) >> 15;
+                g1[k] = (g->gain[k][1] * (gain >> 8)) >> 15;
+            }
+            gain += step;
+        }
+        for (k = 0; k < channels; k++) {
+            sample = (src[g->src[k][0]] * g0[k]) >> 15;
+            if (g1[k]) {
+                sample += (src[g->src[k][1]] * g1[k]) >> 15;
+            }
+            if (sum) {
+                *sum++ += sample;
+            } else {
+                sample += *dst;
+                if (sample > 32767) {
+                    sample = 32767;
+                } else if (sample < -32768) {
+                    sample = -32768;
+                }
+                *dst++ = (Sint16) sample;
+            }
+        }
+        src += channels;
+    }
+}
+
 /* end of effects.c ... */
 
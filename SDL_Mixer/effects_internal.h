@@ -42,12 +42,40 @@ void *_Eff_build_volume_table_s8(void);
 
 void _Mix_InitEffects(void);
 void _Mix_DeinitEffects(void);
+void _Mix_RampVolume(Uint16 format, int channels, Uint8 *buf, int len,
+                     int from, int to);
+
+/* Gains applied to a signed 16-bit channel while it is mixed, in place of
+ *  an effect pass.  Speaker k gets in[src[k][0]] * gain[k][0] plus
+ *  in[src[k][1]] * gain[k][1], with the gains in 1/32768ths.
+ */
+typedef struct
+{
+    Uint8 src[6][2];
+    Sint16 gain[6][2];
+} _Mix_SpeakerGains;
+
+void _Mix_MixSpeakerGains(const _Mix_SpeakerGains *g, int channels,
+                          const Sint16 *src, int frames, int from, int to,
+                          Sint16 *dst, Sint32 *sum);
+int _Mix_SetEffectGains(int channel, Mix_EffectFunc_t f,
+                        const _Mix_SpeakerGains *gains);
 void _Eff_PositionDeinit(void);
+void _Eff_BinauralDeinit(void);
+void _Eff_DSPDeinit(void);
+
+/* A posteffect's variant for the mixer's 32-bit sums, (samples) of them */
+typedef void (*_Mix_WideEffectFunc)(int chan, Sint32 *sum, int samples,
+                                    void *udata);
+int _Mix_SetEffectWide(int channel, Mix_EffectFunc_t f,
+                       _Mix_WideEffectFunc wide);
 
 int _Mix_RegisterEffect_locked(int channel, Mix_EffectFunc_t f,
                                Mix_EffectDone_t d, void *arg);
 int _Mix_UnregisterEffect_locked(int channel, Mix_EffectFunc_t f);
 int _Mix_UnregisterAllEffects_locked(int channel);
+int _Mix_QueueCall(void (*call)(int channel, int arg1, int arg2),
+                   int channel, int arg1, int arg2);
 
 
 /* Set up for C function definitions, even when using C++ */
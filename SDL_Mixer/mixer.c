@@ -26,6 +26,7 @@
 #include <string.h>
 
 #include "SDL_mutex.h"
+#include "SDL_thread.h"
 #include "SDL_endian.h"
 #include "SDL_timer.h"
 
@@ -42,6 +43,30 @@
 #define __MIX_INTERNAL_EFFECT__
 #include "effects_internal.h"
 
+/* Compare-and-swap for the command queue */
+#if defined(__GNUC__)
+#define MIX_CAS(p, o, n)	__sync_bool_compare_and_swap((p), (o), (n))
+#define MIX_BARRIER()		__sync_synchronize()
+#elif defined(_MSC_VER)
+#if defined(_XBOX)
+#include <xtl.h>
+#else
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#endif
+#define MIX_CAS(p, o, n)	\
+	(InterlockedCompareExchange((LONG volatile *)(p), (LONG)(n), (LONG)(o)) == (LONG)(o))
+/* Volatile accesses don't order anything before VC 8.0, and this builds
+   with 7.1, so fence with an interlocked exchange instead. */
+static LONG volatile mix_fence;
+#define MIX_BARRIER()		InterlockedExchange(&mix_fence, 0)
+#else
+/* No compare-and-swap, so callers queueing commands share a mutex instead */
+#define MIX_CAS(p, o, n)	mix_cas((p), (o), (n))
+#define MIX_BARRIER()
+#define MIX_CAS_MUTEX
+#endif
+
 /* Magic numbers for various audio file formats */
 #define RIFF		0x46464952		/* "RIFF" */
 #define WAVE		0x45564157		/* "WAVE" */
@@ -58,6 +83,9 @@ typedef struct _Mix_effectinfo
 	Mix_EffectFunc_t callback;
 	Mix_EffectDone_t done_callback;
 	void *udata;
+	int fused;		/* applied by gains while mixing, if last */
+	_Mix_SpeakerGains gains;
+	_Mix_WideEffectFunc wide;	/* posteffect on the 32-bit sums, or NULL */
 	struct _Mix_effectinfo *next;
 } effect_info;
 
@@ -67,6 +95,7 @@ static struct _Mix_Channel {
 	int paused;
 	Uint8 *samples;
 	int volume;
+	int mix_volume;		/* volume mixed at the end of the last buffer, or -1 */
 	int looping;
 	int tag;
 	Uint32 expire;
@@ -77,6 +106,12 @@ static struct _Mix_Channel {
 	Uint32 fade_length;
 	Uint32 ticks_fade;
 	effect_info *effects;
+	volatile Uint32 claimed;	/* picked for a queued -1 command */
+	int group;		/* index in mix_groups, or -1 if untagged */
+	int listed;		/* on the playing lists (1), the free lists (0) or none (-1) */
+	struct {
+		int prev, next;
+	} link[2];		/* in mix_all, and in the channel's group */
 } *mix_channel = NULL;
 
 static effect_info *posteffects = NULL;
@@ -84,6 +119,108 @@ static effect_info *posteffects = NULL;
 static int num_channels;
 static int reserved_channels = 0;
 
+/* The channels, and each group of them, are kept on intrusive lists so
+   that finding a free channel or a group's oldest sound doesn't mean
+   scanning them all.  Free channels are taken most recently freed first,
+   and playing ones are kept in the order they started.
+   The lists are only changed with the audio locked.
+ */
+typedef struct {
+	int tag;
+	int count;		/* channels in the group */
+	int free;		/* first free channel, or -1 */
+	int reserved_free;	/* first free reserved channel, in mix_all only */
+	int oldest, newest;	/* playing channels, or -1 */
+} mix_group;
+
+static mix_group mix_all;
+static mix_group *mix_groups = NULL;
+static int num_groups = 0;
+static int *group_hash = NULL;	/* index in mix_groups + 1, or 0 if empty */
+static int group_hash_size = 0;	/* a power of two, at least twice num_groups */
+
+/* Rate conversion quality for SDL_BuildAudioCVT() */
+static int resample_quality = SDL_AUDIO_RESAMPLE_SINC;
+
+/* MIX_MIXING_ACCUMULATED sums the channels here, one Sint32 per sample */
+static Mix_MixingMode mixing_mode = MIX_MIXING_CLIPPED;
+static Sint32 *mix_accum = NULL;
+static Sint32 *mix_accum_pos = NULL;	/* the sums for the piece being mixed */
+static int mix_accum_len = 0;
+static int mix_accumulating = 0;
+
+/* Channel audio is copied here to ramp its volume across a buffer */
+static Uint8 *mix_ramp_buf = NULL;
+
+/* With Mix_QueueCommands() on, the channel and effect functions called
+   outside the audio callback don't take the audio lock.  They put
+   commands on a bounded lock-free queue instead, which the callback runs
+   at the start of the next buffer.  Any number of threads can queue.
+   Each cell's seq says whether it's free for the command at a position
+   (seq == pos) or holds it (seq == pos + 1).
+   Timed commands wait in mix_scheduled, sorted by the sample frame they
+   are due at, and the channels are mixed in pieces between them.
+ */
+#define MIX_COMMAND_QUEUE_SIZE	256	/* a power of two */
+
+enum {
+	MIX_CMD_PLAY,
+	MIX_CMD_HALT,
+	MIX_CMD_EXPIRE,
+	MIX_CMD_FADE_OUT,
+	MIX_CMD_VOLUME,
+	MIX_CMD_PAUSE,
+	MIX_CMD_RESUME,
+	MIX_CMD_REGISTER_EFFECT,
+	MIX_CMD_UNREGISTER_EFFECT,
+	MIX_CMD_UNREGISTER_ALL,
+	MIX_CMD_CALL
+};
+
+typedef struct {
+	int type;
+	int timed;
+	Uint32 when;		/* sample frame on the mix clock */
+	int channel;
+	int claimed;		/* the channel was claimed for this command */
+	Mix_Chunk *chunk;
+	int loops, ms, ticks;	/* or volume in ms */
+	Mix_EffectFunc_t effect;
+	Mix_EffectDone_t effect_done;
+	void *udata;
+	void (*call)(int channel, int arg1, int arg2);
+} mix_command;
+
+typedef struct {
+	volatile Uint32 seq;
+	mix_command cmd;
+} mix_command_cell;
+
+static mix_command_cell *mix_commands = NULL;
+static volatile Uint32 command_enqueue_pos = 0;
+static Uint32 command_dequeue_pos = 0;
+static volatile int command_queueing = 0;
+static mix_command *mix_scheduled = NULL;
+static int num_scheduled = 0;
+static volatile Uint32 mix_clock = 0;	/* sample frames mixed */
+static volatile Uint32 mix_audio_thread = 0;
+#ifdef MIX_CAS_MUTEX
+static SDL_mutex *command_mutex = NULL;
+
+static int mix_cas(volatile Uint32 *p, Uint32 o, Uint32 n)
+{
+	int swapped = 0;
+
+	SDL_mutexP(command_mutex);
+	if ( *p == o ) {
+		*p = n;
+		swapped = 1;
+	}
+	SDL_mutexV(command_mutex);
+	return(swapped);
+}
+#endif
+
 
 /* Support for hooking into the mixer callback system */
 static void (*mix_postmix)(void *udata, Uint8 *stream, int len) = NULL;
@@ -102,6 +239,23 @@ extern void music_mixer(void *udata, Uint8 *stream, int len);
 static void (*mix_music)(void *udata, Uint8 *stream, int len) = music_mixer;
 static void *music_data = NULL;
 
+/* Streamed chunks decode their source with the music players */
+extern Mix_Music *music_stream_open(SDL_RWops *src, int freesrc);
+extern void music_stream_rewind(Mix_Music *music);
+extern int music_stream_read(Mix_Music *music, Uint8 *buf, int len);
+extern void music_stream_close(Mix_Music *music);
+
+/* A streamed chunk holds no samples, just its decoder and room for one
+   callback's worth of decoded audio.  It plays on one channel at a time.
+ */
+#define MIX_CHUNK_STREAMED	2
+
+typedef struct {
+	Mix_Chunk chunk;
+	Mix_Music *music;
+	Uint8 *buf;
+} stream_chunk;
+
 /* rcg06042009 report available decoders at runtime. */
 static const char **chunk_decoders = NULL;
 static int num_decoders = 0;
@@ -254,12 +408,473 @@ static void _Mix_channel_done_playing(int channel)
 }
 
 
+/* Find the group with a tag, creating it if asked to */
+static int find_group(int tag, int create)
+{
+	int i, mask = group_hash_size - 1;
+
+	if ( group_hash_size ) {
+		i = (int)(((Uint32)tag * 0x9E3779B1) >> 8) & mask;
+		while ( group_hash[i] ) {
+			if ( mix_groups[group_hash[i] - 1].tag == tag ) {
+				return(group_hash[i] - 1);
+			}
+			i = (i + 1) & mask;
+		}
+	}
+	if ( ! create ) {
+		return(-1);
+	}
+
+	if ( (num_groups + 1) * 2 > group_hash_size ) {
+		int size = group_hash_size ? group_hash_size * 2 : 16;
+		int *hash = (int *)SDL_calloc(size, sizeof(int));
+		mix_group *groups = (mix_group *)SDL_realloc(mix_groups, (size / 2) * sizeof(mix_group));
+		if ( hash == NULL || groups == NULL ) {
+			if ( groups ) {
+				mix_groups = groups;
+			}
+			SDL_free(hash);
+			Mix_SetError("Out of memory");
+			return(-1);
+		}
+		mix_groups = groups;
+		SDL_free(group_hash);
+		group_hash = hash;
+		group_hash_size = size;
+		mask = size - 1;
+		for ( i = 0; i < num_groups; ++i ) {
+			int h = (int)(((Uint32)mix_groups[i].tag * 0x9E3779B1) >> 8) & mask;
+			while ( group_hash[h] ) {
+				h = (h + 1) & mask;
+			}
+			group_hash[h] = i + 1;
+		}
+	}
+
+	mix_groups[num_groups].tag = tag;
+	mix_groups[num_groups].count = 0;
+	mix_groups[num_groups].free = -1;
+	mix_groups[num_groups].reserved_free = -1;
+	mix_groups[num_groups].oldest = -1;
+	mix_groups[num_groups].newest = -1;
+	i = (int)(((Uint32)tag * 0x9E3779B1) >> 8) & mask;
+	while ( group_hash[i] ) {
+		i = (i + 1) & mask;
+	}
+	group_hash[i] = num_groups + 1;
+	return(num_groups++);
+}
+
+/* The group a channel is in for each set of lists, if any */
+static mix_group *channel_group(int which, int set)
+{
+	if ( set == 0 ) {
+		return(&mix_all);
+	}
+	if ( mix_channel[which].group < 0 ) {
+		return(NULL);
+	}
+	return(&mix_groups[mix_channel[which].group]);
+}
+
+static int *channel_free_list(mix_group *group, int which, int set)
+{
+	if ( set == 0 && which < reserved_channels ) {
+		return(&group->reserved_free);
+	}
+	return(&group->free);
+}
+
+static void channel_unlink(int which, int set, int *head, int *tail)
+{
+	int prev = mix_channel[which].link[set].prev;
+	int next = mix_channel[which].link[set].next;
+
+	if ( prev >= 0 ) {
+		mix_channel[prev].link[set].next = next;
+	} else {
+		*head = next;
+	}
+	if ( next >= 0 ) {
+		mix_channel[next].link[set].prev = prev;
+	} else if ( tail ) {
+		*tail = prev;
+	}
+}
+
+/* Put a playing channel after the last one that started before it, which
+   is the newest unless its group just changed.
+ */
+static void channel_link_playing(int which, int set, int *head, int *tail)
+{
+	int prev = *tail, next;
+
+	while ( prev >= 0 &&
+	        (Sint32)(mix_channel[prev].start_time - mix_channel[which].start_time) > 0 ) {
+		prev = mix_channel[prev].link[set].prev;
+	}
+	next = (prev >= 0) ? mix_channel[prev].link[set].next : *head;
+	mix_channel[which].link[set].prev = prev;
+	mix_channel[which].link[set].next = next;
+	if ( prev >= 0 ) {
+		mix_channel[prev].link[set].next = which;
+	} else {
+		*head = which;
+	}
+	if ( next >= 0 ) {
+		mix_channel[next].link[set].prev = which;
+	} else {
+		*tail = which;
+	}
+}
+
+static void channel_link_free(int which, int set, int *head)
+{
+	mix_channel[which].link[set].prev = -1;
+	mix_channel[which].link[set].next = *head;
+	if ( *head >= 0 ) {
+		mix_channel[*head].link[set].prev = which;
+	}
+	*head = which;
+}
+
+/* Take a channel off one of its lists */
+static void channel_delist_set(int which, int set)
+{
+	mix_group *group = channel_group(which, set);
+
+	if ( group == NULL ) {
+		return;
+	}
+	if ( mix_channel[which].listed > 0 ) {
+		channel_unlink(which, set, &group->oldest, &group->newest);
+	} else if ( mix_channel[which].listed == 0 ) {
+		channel_unlink(which, set, channel_free_list(group, which, set), NULL);
+	}
+}
+
+/* Put a channel on one of the free or playing lists, as it is */
+static void channel_enlist_set(int which, int set)
+{
+	mix_group *group = channel_group(which, set);
+
+	if ( group == NULL ) {
+		return;
+	}
+	if ( mix_channel[which].listed > 0 ) {
+		channel_link_playing(which, set, &group->oldest, &group->newest);
+	} else if ( mix_channel[which].listed == 0 ) {
+		channel_link_free(which, set, channel_free_list(group, which, set));
+	}
+}
+
+static void channel_delist(int which)
+{
+	channel_delist_set(which, 0);
+	channel_delist_set(which, 1);
+	mix_channel[which].listed = -1;
+}
+
+static void channel_enlist(int which)
+{
+	mix_channel[which].listed = (mix_channel[which].playing > 0);
+	channel_enlist_set(which, 0);
+	channel_enlist_set(which, 1);
+}
+
+/* Move a channel that has started or stopped to the right lists */
+static void channel_relist(int which)
+{
+	if ( mix_channel[which].listed != (mix_channel[which].playing > 0) ) {
+		channel_delist(which);
+		channel_enlist(which);
+	}
+}
+
+/* Put all the channels back on their lists, after they're reallocated or
+   the reserved channels change.  The lowest free channels come first.
+ */
+static void rebuild_channel_lists(void)
+{
+	int i;
+
+	mix_all.tag = -1;
+	mix_all.count = num_channels;
+	mix_all.free = mix_all.reserved_free = -1;
+	mix_all.oldest = mix_all.newest = -1;
+	for ( i = 0; i < num_groups; ++i ) {
+		mix_groups[i].count = 0;
+		mix_groups[i].free = mix_groups[i].reserved_free = -1;
+		mix_groups[i].oldest = mix_groups[i].newest = -1;
+	}
+	for ( i = num_channels - 1; i >= 0; --i ) {
+		if ( mix_channel[i].group >= 0 ) {
+			++mix_groups[mix_channel[i].group].count;
+		}
+		channel_enlist(i);
+	}
+}
+
+/* Whether a call should run now rather than be queued */
+static int command_direct(void)
+{
+	return(!command_queueing || SDL_ThreadID() == mix_audio_thread);
+}
+
+/* Put a command on the queue, from any thread */
+static int push_command(const mix_command *cmd)
+{
+	mix_command_cell *cell;
+	Uint32 pos = command_enqueue_pos;
+	Sint32 diff;
+
+	for ( ;; ) {
+		cell = &mix_commands[pos & (MIX_COMMAND_QUEUE_SIZE - 1)];
+		diff = (Sint32)(cell->seq - pos);
+		if ( diff == 0 ) {
+			if ( MIX_CAS(&command_enqueue_pos, pos, pos + 1) ) {
+				break;
+			}
+		} else if ( diff < 0 ) {
+			Mix_SetError("Command queue is full");
+			return(0);
+		}
+		pos = command_enqueue_pos;
+	}
+	cell->cmd = *cmd;
+	MIX_BARRIER();
+	cell->seq = pos + 1;
+	return(1);
+}
+
+/* Take the next command off the queue, with the audio locked */
+static int pop_command(mix_command *cmd)
+{
+	mix_command_cell *cell;
+	Uint32 pos = command_dequeue_pos;
+
+	cell = &mix_commands[pos & (MIX_COMMAND_QUEUE_SIZE - 1)];
+	if ( (Sint32)(cell->seq - (pos + 1)) < 0 ) {
+		return(0);
+	}
+	MIX_BARRIER();
+	*cmd = cell->cmd;
+	MIX_BARRIER();
+	cell->seq = pos + MIX_COMMAND_QUEUE_SIZE;
+	command_dequeue_pos = pos + 1;
+	return(1);
+}
+
+/* Pick a free channel for -1 without the audio lock.  The claim keeps
+   other callers off it until its command has run.
+ */
+static int claim_channel(void)
+{
+	int i;
+
+	for ( i = reserved_channels; i < num_channels; ++i ) {
+		if ( !mix_channel[i].claimed && mix_channel[i].playing <= 0 &&
+		     MIX_CAS(&mix_channel[i].claimed, 0, 1) ) {
+			MIX_BARRIER();
+			/* It may have started while we claimed it */
+			if ( mix_channel[i].playing <= 0 ) {
+				return(i);
+			}
+			mix_channel[i].claimed = 0;
+		}
+	}
+	return(-1);
+}
+
+/* The free channel for -1 when running a call, skipping any claimed */
+static int free_channel(void)
+{
+	int which;
+
+	for ( which = mix_all.free; which >= 0;
+	      which = mix_channel[which].link[0].next ) {
+		if ( MIX_CAS(&mix_channel[which].claimed, 0, 1) ) {
+			break;
+		}
+	}
+	return(which);
+}
+
+static void release_channel(int which)
+{
+	MIX_BARRIER();
+	mix_channel[which].claimed = 0;
+}
+
+static void run_command(mix_command *cmd)
+{
+	switch (cmd->type) {
+		case MIX_CMD_PLAY:
+			if ( cmd->ms > 0 ) {
+				Mix_FadeInChannelTimed(cmd->channel, cmd->chunk,
+				                       cmd->loops, cmd->ms, cmd->ticks);
+			} else {
+				Mix_PlayChannelTimed(cmd->channel, cmd->chunk,
+				                     cmd->loops, cmd->ticks);
+			}
+			if ( cmd->claimed ) {
+				release_channel(cmd->channel);
+			}
+			break;
+		case MIX_CMD_HALT:
+			Mix_HaltChannel(cmd->channel);
+			break;
+		case MIX_CMD_EXPIRE:
+			Mix_ExpireChannel(cmd->channel, cmd->ticks);
+			break;
+		case MIX_CMD_FADE_OUT:
+			Mix_FadeOutChannel(cmd->channel, cmd->ms);
+			break;
+		case MIX_CMD_VOLUME:
+			Mix_Volume(cmd->channel, cmd->ms);
+			break;
+		case MIX_CMD_PAUSE:
+			Mix_Pause(cmd->channel);
+			break;
+		case MIX_CMD_RESUME:
+			Mix_Resume(cmd->channel);
+			break;
+		case MIX_CMD_REGISTER_EFFECT:
+			Mix_RegisterEffect(cmd->channel, cmd->effect,
+			                   cmd->effect_done, cmd->udata);
+			break;
+		case MIX_CMD_UNREGISTER_EFFECT:
+			Mix_UnregisterEffect(cmd->channel, cmd->effect);
+			break;
+		case MIX_CMD_UNREGISTER_ALL:
+			Mix_UnregisterAllEffects(cmd->channel);
+			break;
+		case MIX_CMD_CALL:
+			cmd->call(cmd->channel, cmd->loops, cmd->ms);
+			break;
+	}
+}
+
+/* Keep a timed command until it's due.  If there's no room it runs now. */
+static void schedule_command(mix_command *cmd)
+{
+	int i;
+
+	if ( num_scheduled == MIX_COMMAND_QUEUE_SIZE ) {
+		run_command(cmd);
+		return;
+	}
+	for ( i = num_scheduled; i > 0; --i ) {
+		if ( (Sint32)(mix_scheduled[i-1].when - cmd->when) <= 0 ) {
+			break;
+		}
+		mix_scheduled[i] = mix_scheduled[i-1];
+	}
+	mix_scheduled[i] = *cmd;
+	++num_scheduled;
+}
+
+/* Run the queued commands, with the audio locked.  Whoever holds the
+   lock runs the calls the commands make directly.
+ */
+static void run_commands(void)
+{
+	mix_command cmd;
+	Uint32 thread = mix_audio_thread;
+
+	if ( mix_commands == NULL ) {
+		return;
+	}
+	mix_audio_thread = SDL_ThreadID();
+	while ( pop_command(&cmd) ) {
+		if ( cmd.timed && (Sint32)(cmd.when - mix_clock) > 0 ) {
+			schedule_command(&cmd);
+		} else {
+			run_command(&cmd);
+		}
+	}
+	mix_audio_thread = thread;
+}
+
+/* Run the scheduled commands due by a sample frame */
+static void run_scheduled(Uint32 when)
+{
+	mix_command cmd;
+
+	while ( num_scheduled > 0 &&
+	        (Sint32)(mix_scheduled[0].when - when) <= 0 ) {
+		cmd = mix_scheduled[0];
+		--num_scheduled;
+		memmove(mix_scheduled, mix_scheduled + 1, num_scheduled * sizeof(mix_command));
+		run_command(&cmd);
+	}
+}
+
+/* Queue a command for the callback, or say that it should run now.
+   Returns 1 if the command was queued, 0 if the caller should run it,
+   or -1 if the queue is full.
+ */
+static int queue_command(mix_command *cmd)
+{
+	if ( command_direct() ) {
+		return(0);
+	}
+	cmd->timed = 0;
+	cmd->claimed = 0;
+	return(push_command(cmd) ? 1 : -1);
+}
+
+/* Run what's queued and stop queueing, before changing the channels */
+static int suspend_commands(void)
+{
+	int queueing = command_queueing;
+
+	SDL_LockAudio();
+	command_queueing = 0;
+	run_commands();
+	SDL_UnlockAudio();
+	return(queueing);
+}
+
+/* Let a call from one of the effects run in the callback */
+int _Mix_QueueCall(void (*call)(int channel, int arg1, int arg2),
+                   int channel, int arg1, int arg2)
+{
+	mix_command cmd;
+
+	cmd.type = MIX_CMD_CALL;
+	cmd.channel = channel;
+	cmd.call = call;
+	cmd.loops = arg1;
+	cmd.ms = arg2;
+	return(queue_command(&cmd));
+}
+
+/* The gains of a channel's last effect, if it can be mixed in with them */
+static const _Mix_SpeakerGains *channel_gains(int which)
+{
+	effect_info *e = mix_channel[which].effects;
+
+	if (e == NULL) {
+		return(NULL);
+	}
+	while (e->next != NULL) {
+		e = e->next;
+	}
+	return(e->fused ? &e->gains : NULL);
+}
+
 static void *Mix_DoEffects(int chan, void *snd, int len)
 {
 	int posteffect = (chan == MIX_CHANNEL_POST);
 	effect_info *e = ((posteffect) ? posteffects : mix_channel[chan].effects);
 	void *buf = snd;
 
+	/* A last effect with gains is applied while mixing, not here */
+	if (e != NULL && e->next == NULL && e->fused) {
+		e = NULL;
+	}
 	if (e != NULL) {    /* are there any registered effects? */
 		/* if this is the postmix, we can just overwrite the original. */
 		if (!posteffect) {
@@ -271,7 +886,7 @@ static void *Mix_DoEffects(int chan, void *snd, int len)
 		}
 
 		for (; e != NULL; e = e->next) {
-			if (e->callback != NULL) {
+			if (e->callback != NULL && !(e->fused && e->next == NULL)) {
 				e->callback(chan, buf, len, e->udata);
 			}
 		}
@@ -282,45 +897,228 @@ static void *Mix_DoEffects(int chan, void *snd, int len)
 }
 
 
-/* Mixing function */
-static void mix_channels(void *udata, Uint8 *stream, int len)
+/* Add len bytes of channel audio to the 32-bit sums, scaling each
+   sample by volume the same way SDL_MixAudio() does */
+static void accumulate_chunk(Sint32 *sum, const Uint8 *src, int len, int volume)
 {
-	Uint8 *mix_input;
-	int i, mixable, volume = SDL_MIX_MAXVOLUME;
-	Uint32 sdl_ticks;
+	switch (mixer.format) {
+		case AUDIO_U8:
+			while ( len-- ) {
+				*sum++ += ((*src++ - 128) * volume) / SDL_MIX_MAXVOLUME;
+			}
+			break;
 
-#if SDL_VERSION_ATLEAST(1, 3, 0)
-	/* Need to initialize the stream in SDL 1.3+ */
-	memset(stream, mixer.silence, len);
-#endif
+		case AUDIO_S8: {
+			const Sint8 *src8 = (const Sint8 *)src;
+			while ( len-- ) {
+				*sum++ += (*src8++ * volume) / SDL_MIX_MAXVOLUME;
+			}
+		}
+		break;
+
+		case AUDIO_S16LSB:
+			len /= 2;
+			while ( len-- ) {
+				Sint16 sample = (Sint16)((src[1] << 8) | src[0]);
+				*sum++ += (sample * volume) / SDL_MIX_MAXVOLUME;
+				src += 2;
+			}
+			break;
 
-	/* Mix the music (must be done before the channels are added) */
-	if ( music_active || (mix_music != music_mixer) ) {
-		mix_music(music_data, stream, len);
+		case AUDIO_S16MSB:
+			len /= 2;
+			while ( len-- ) {
+				Sint16 sample = (Sint16)((src[0] << 8) | src[1]);
+				*sum++ += (sample * volume) / SDL_MIX_MAXVOLUME;
+				src += 2;
+			}
+			break;
+	}
+}
+
+/* Move signed 16-bit native audio, the music, from the stream into the
+   sums so that posteffects see everything before it is clipped */
+static void accumulate_fold(Uint8 *stream, Sint32 *sum, int len)
+{
+	Sint16 *src = (Sint16 *)stream;
+
+	len /= 2;
+	while ( len-- ) {
+		*sum++ += *src;
+		*src++ = 0;
+	}
+}
+
+/* Add the sums to the stream and clip, once for all the channels */
+static void accumulate_finish(Uint8 *stream, const Sint32 *sum, int len)
+{
+	Sint32 sample;
+
+	switch (mixer.format) {
+		case AUDIO_U8:
+			/* 0xFE, not 0xFF, as in SDL_MixAudio() */
+			while ( len-- ) {
+				sample = *stream + *sum++;
+				if ( sample < 0 ) {
+					sample = 0;
+				} else if ( sample > 0xFE ) {
+					sample = 0xFE;
+				}
+				*stream++ = (Uint8)sample;
+			}
+			break;
+
+		case AUDIO_S8:
+			while ( len-- ) {
+				sample = *(Sint8 *)stream + *sum++;
+				if ( sample < -128 ) {
+					sample = -128;
+				} else if ( sample > 127 ) {
+					sample = 127;
+				}
+				*stream++ = (Uint8)sample;
+			}
+			break;
+
+		case AUDIO_S16LSB:
+			len /= 2;
+			while ( len-- ) {
+				sample = (Sint16)((stream[1] << 8) | stream[0]) + *sum++;
+				if ( sample < -32768 ) {
+					sample = -32768;
+				} else if ( sample > 32767 ) {
+					sample = 32767;
+				}
+				stream[0] = sample & 0xFF;
+				stream[1] = (sample >> 8) & 0xFF;
+				stream += 2;
+			}
+			break;
+
+		case AUDIO_S16MSB:
+			len /= 2;
+			while ( len-- ) {
+				sample = (Sint16)((stream[0] << 8) | stream[1]) + *sum++;
+				if ( sample < -32768 ) {
+					sample = -32768;
+				} else if ( sample > 32767 ) {
+					sample = 32767;
+				}
+				stream[1] = sample & 0xFF;
+				stream[0] = (sample >> 8) & 0xFF;
+				stream += 2;
+			}
+			break;
+	}
+}
+
+/* Mix a piece of a channel into the stream at byte offset index */
+static void mix_chunk(Uint8 *stream, int index, const Uint8 *src, int len, int volume)
+{
+	if ( mix_accumulating ) {
+		int size = (mixer.format & 0xFF) / 8;
+		accumulate_chunk(mix_accum_pos + index / size, src, len, volume);
+	} else {
+		SDL_MixAudio(stream + index, src, len, volume);
+	}
+}
+
+/* Mix a piece of a channel into the stream at byte offset index, with
+   the volume moving from 'from' at the start of the len byte buffer to
+   'to' at its end, so volume changes and fades don't step.  Any gains
+   are applied on the way.
+ */
+static void mix_chunk_ramp(Uint8 *stream, int index, const Uint8 *src, int mixable,
+                           int len, int from, int to, const _Mix_SpeakerGains *gains)
+{
+	int v0, v1;
+
+	if ( gains ) {
+		v0 = from + ((to - from) * index) / len;
+		v1 = from + ((to - from) * (index + mixable)) / len;
+		_Mix_MixSpeakerGains(gains, mixer.channels, (const Sint16 *)src,
+		                     mixable / (2 * mixer.channels), v0, v1,
+		                     (Sint16 *)(stream + index),
+		                     mix_accumulating ? mix_accum_pos + index / 2 : NULL);
+		return;
+	}
+	if ( from == to || mix_ramp_buf == NULL ) {
+		mix_chunk(stream, index, src, mixable, to);
+		return;
+	}
+	v0 = from + ((to - from) * index) / len;
+	v1 = from + ((to - from) * (index + mixable)) / len;
+	memcpy(mix_ramp_buf, src, mixable);
+	_Mix_RampVolume(mixer.format, mixer.channels, mix_ramp_buf, mixable, v0, v1);
+	mix_chunk(stream, index, mix_ramp_buf, mixable, SDL_MIX_MAXVOLUME);
+}
+
+/* Decode and mix a channel playing a streamed chunk */
+static void mix_stream_channel(Uint8 *stream, int which, int len, int from, int volume)
+{
+	stream_chunk *sc = (stream_chunk *)mix_channel[which].chunk;
+	Uint8 *mix_input;
+	int index = 0, got, rewound = 0;
+
+	while ( index < len ) {
+		got = music_stream_read(sc->music, sc->buf, len - index);
+		if ( got > 0 ) {
+			mix_input = Mix_DoEffects(which, sc->buf, got);
+			mix_chunk_ramp(stream, index, mix_input, got, len, from, volume,
+			               channel_gains(which));
+			if (mix_input != sc->buf)
+				SDL_free(mix_input);
+			index += got;
+			rewound = 0;
+		}
+		if ( index < len ) {
+			/* The source ran out, loop it or we're done */
+			if ( ! mix_channel[which].looping || rewound ) {
+				mix_channel[which].playing = 0;
+				mix_channel[which].looping = 0;
+				channel_relist(which);
+				_Mix_channel_done_playing(which);
+				break;
+			}
+			--mix_channel[which].looping;
+			music_stream_rewind(sc->music);
+			rewound = 1;
+		}
 	}
+}
+
+/* Mix the playing channels into a piece of the stream */
+static void mix_channels_some(Uint8 *stream, int len)
+{
+	Uint8 *mix_input;
+	int i, mixable, volume = SDL_MIX_MAXVOLUME, from, fade_done;
+	Uint32 sdl_ticks, buffer_ms;
 
-	/* Mix any playing channels... */
 	sdl_ticks = SDL_GetTicks();
+	buffer_ms = (len / (((mixer.format & 0xFF) / 8) * mixer.channels)) * 1000 / mixer.freq;
 	for ( i=0; i<num_channels; ++i ) {
 		if( ! mix_channel[i].paused ) {
+			fade_done = 0;
 			if ( mix_channel[i].expire > 0 && mix_channel[i].expire < sdl_ticks ) {
 				/* Expiration delay for that channel is reached */
 				mix_channel[i].playing = 0;
 				mix_channel[i].looping = 0;
 				mix_channel[i].fading = MIX_NO_FADING;
 				mix_channel[i].expire = 0;
+				channel_relist(i);
 				_Mix_channel_done_playing(i);
 			} else if ( mix_channel[i].fading != MIX_NO_FADING ) {
-				Uint32 ticks = sdl_ticks - mix_channel[i].ticks_fade;
-				if( ticks > mix_channel[i].fade_length ) {
-				    Mix_Volume(i, mix_channel[i].fade_volume_reset); /* Restore the volume */
+				/* Aim for the volume due at the end of this buffer */
+				Uint32 ticks = sdl_ticks + buffer_ms - mix_channel[i].ticks_fade;
+				if( ticks >= mix_channel[i].fade_length ) {
 					if( mix_channel[i].fading == MIX_FADING_OUT ) {
-						mix_channel[i].playing = 0;
-						mix_channel[i].looping = 0;
-						mix_channel[i].expire = 0;
-						_Mix_channel_done_playing(i);
+						/* Ramp down to silence, then stop */
+						mix_channel[i].volume = 0;
+						fade_done = 1;
+					} else {
+						Mix_Volume(i, mix_channel[i].fade_volume_reset); /* Restore the volume */
+						mix_channel[i].fading = MIX_NO_FADING;
 					}
-					mix_channel[i].fading = MIX_NO_FADING;
 				} else {
 					if( mix_channel[i].fading == MIX_FADING_OUT ) {
 						Mix_Volume(i, (mix_channel[i].fade_volume * (mix_channel[i].fade_length-ticks))
@@ -331,18 +1129,29 @@ static void mix_channels(void *udata, Uint8 *stream, int len)
 				}
 			}
 			if ( mix_channel[i].playing > 0 ) {
+				volume = (mix_channel[i].volume*mix_channel[i].chunk->volume) / MIX_MAX_VOLUME;
+				from = mix_channel[i].mix_volume;
+				if ( from < 0 ) {
+					from = volume;
+				}
+				mix_channel[i].mix_volume = volume;
+			}
+			if ( mix_channel[i].playing > 0 &&
+			     mix_channel[i].chunk->allocated == MIX_CHUNK_STREAMED ) {
+				mix_stream_channel(stream, i, len, from, volume);
+			} else if ( mix_channel[i].playing > 0 ) {
+				const _Mix_SpeakerGains *gains = channel_gains(i);
 				int index = 0;
 				int remaining = len;
 				while (mix_channel[i].playing > 0 && index < len) {
 					remaining = len - index;
-					volume = (mix_channel[i].volume*mix_channel[i].chunk->volume) / MIX_MAX_VOLUME;
 					mixable = mix_channel[i].playing;
 					if ( mixable > remaining ) {
 						mixable = remaining;
 					}
 
 					mix_input = Mix_DoEffects(i, mix_channel[i].samples, mixable);
-					SDL_MixAudio(stream+index,mix_input,mixable,volume);
+					mix_chunk_ramp(stream, index, mix_input, mixable, len, from, volume, gains);
 					if (mix_input != mix_channel[i].samples)
 						SDL_free(mix_input);
 
@@ -352,6 +1161,7 @@ static void mix_channels(void *udata, Uint8 *stream, int len)
 
 					/* rcg06072001 Alert app if channel is done playing. */
 					if (!mix_channel[i].playing && !mix_channel[i].looping) {
+						channel_relist(i);
 						_Mix_channel_done_playing(i);
 					}
 				}
@@ -365,33 +1175,124 @@ static void mix_channels(void *udata, Uint8 *stream, int len)
 						remaining = alen;
 					}
 
-					mix_input = Mix_DoEffects(i, mix_channel[i].chunk->abuf, remaining);
-					SDL_MixAudio(stream+index, mix_input, remaining, volume);
-					if (mix_input != mix_channel[i].chunk->abuf)
-						SDL_free(mix_input);
+					mix_input = Mix_DoEffects(i, mix_channel[i].chunk->abuf, remaining);
+					mix_chunk_ramp(stream, index, mix_input, remaining, len, from, volume, gains);
+					if (mix_input != mix_channel[i].chunk->abuf)
+						SDL_free(mix_input);
+
+					--mix_channel[i].looping;
+					mix_channel[i].samples = mix_channel[i].chunk->abuf + remaining;
+					mix_channel[i].playing = mix_channel[i].chunk->alen - remaining;
+					index += remaining;
+				}
+				if ( ! mix_channel[i].playing && mix_channel[i].looping ) {
+					--mix_channel[i].looping;
+					mix_channel[i].samples = mix_channel[i].chunk->abuf;
+					mix_channel[i].playing = mix_channel[i].chunk->alen;
+				}
+			}
+			if ( fade_done ) {
+				Mix_Volume(i, mix_channel[i].fade_volume_reset); /* Restore the volume */
+				if ( mix_channel[i].playing > 0 || mix_channel[i].looping ) {
+					mix_channel[i].playing = 0;
+					mix_channel[i].looping = 0;
+					channel_relist(i);
+					_Mix_channel_done_playing(i);
+				}
+				mix_channel[i].expire = 0;
+				mix_channel[i].fading = MIX_NO_FADING;
+			}
+			channel_relist(i);
+		}
+	}
+}
+
+/* Mix one buffer, at most mixer.size bytes */
+static void mix_channels_buffer(Uint8 *stream, int len)
+{
+	int frame_size = ((mixer.format & 0xFF) / 8) * mixer.channels;
+	int index, next;
+	Sint32 due;
+	effect_info *e;
+
+#if SDL_VERSION_ATLEAST(1, 3, 0)
+	/* Need to initialize the stream in SDL 1.3+ */
+	memset(stream, mixer.silence, len);
+#endif
+
+	/* Calls made from here on run directly, and queued ones run now */
+	mix_audio_thread = SDL_ThreadID();
+	run_commands();
 
-					--mix_channel[i].looping;
-					mix_channel[i].samples = mix_channel[i].chunk->abuf + remaining;
-					mix_channel[i].playing = mix_channel[i].chunk->alen - remaining;
-					index += remaining;
-				}
-				if ( ! mix_channel[i].playing && mix_channel[i].looping ) {
-					--mix_channel[i].looping;
-					mix_channel[i].samples = mix_channel[i].chunk->abuf;
-					mix_channel[i].playing = mix_channel[i].chunk->alen;
-				}
+	/* Mix the music (must be done before the channels are added) */
+	if ( music_active || (mix_music != music_mixer) ) {
+		mix_music(music_data, stream, len);
+	}
+
+	/* Sum the channels in 32 bits if asked to and the buffer fits */
+	mix_accumulating = ( mixing_mode == MIX_MIXING_ACCUMULATED && mix_accum &&
+	                     len / ((mixer.format & 0xFF) / 8) <= mix_accum_len );
+	if ( mix_accumulating ) {
+		memset(mix_accum, 0, (len / ((mixer.format & 0xFF) / 8)) * sizeof(Sint32));
+	}
+
+	/* Mix any playing channels, stopping at the sample frames where
+	   scheduled commands are due */
+	run_scheduled(mix_clock);
+	for ( index = 0; index < len; index = next ) {
+		next = len;
+		if ( num_scheduled > 0 ) {
+			due = (Sint32)(mix_scheduled[0].when - mix_clock);
+			if ( due < len / frame_size ) {
+				next = due * frame_size;
+			}
+		}
+		if ( mix_accumulating ) {
+			mix_accum_pos = mix_accum + index / ((mixer.format & 0xFF) / 8);
+		}
+		mix_channels_some(stream + index, next - index);
+		run_scheduled(mix_clock + next / frame_size);
+	}
+	mix_clock += len / frame_size;
+
+	/* Posteffects that can work on the 32-bit sums get them before they
+	   are clipped, up to the first one that can't */
+	e = posteffects;
+	if ( mix_accumulating ) {
+		if ( e != NULL && e->wide != NULL ) {
+			accumulate_fold(stream, mix_accum, len);
+			for ( ; e != NULL && e->wide != NULL; e = e->next ) {
+				e->wide(MIX_CHANNEL_POST, mix_accum, len / 2, e->udata);
 			}
 		}
+		accumulate_finish(stream, mix_accum, len);
+		mix_accumulating = 0;
 	}
 
 	/* rcg06122001 run posteffects... */
-	Mix_DoEffects(MIX_CHANNEL_POST, stream, len);
+	for ( ; e != NULL; e = e->next ) {
+		if ( e->callback != NULL ) {
+			e->callback(MIX_CHANNEL_POST, stream, len, e->udata);
+		}
+	}
 
 	if ( mix_postmix ) {
 		mix_postmix(mix_postmix_data, stream, len);
 	}
 }
 
+/* Mixing function */
+static void mix_channels(void *udata, Uint8 *stream, int len)
+{
+	/* SDL converting the rate of a float mix may ask for more */
+	while ( len > (int)mixer.size ) {
+		mix_channels_buffer(stream, mixer.size);
+		stream += mixer.size;
+		len -= mixer.size;
+	}
+	mix_channels_buffer(stream, len);
+}
+
 #if 0
 static void PrintFormat(char *title, SDL_AudioSpec *fmt)
 {
@@ -428,8 +1329,17 @@ int Mix_OpenAudio(int frequency, Uint16 format, int nchannels, int chunksize)
 	desired.callback = mix_channels;
 	desired.userdata = NULL;
 
-	/* Accept nearly any audio format */
-	if ( SDL_OpenAudio(&desired, &mixer) < 0 ) {
+	/* Accept nearly any audio format.  A float mix stays float through
+	   the channels, music and effects, and SDL converts it once for the
+	   device, whatever that takes.
+	 */
+	if ( (format & 0xFF) == 32 ) {
+		desired.format = AUDIO_F32SYS;
+		if ( SDL_OpenAudio(&desired, NULL) < 0 ) {
+			return(-1);
+		}
+		mixer = desired;
+	} else if ( SDL_OpenAudio(&desired, &mixer) < 0 ) {
 		return(-1);
 	}
 #if 0
@@ -445,12 +1355,29 @@ int Mix_OpenAudio(int frequency, Uint16 format, int nchannels, int chunksize)
 	num_channels = MIX_CHANNELS;
 	mix_channel = (struct _Mix_Channel *) SDL_malloc(num_channels * sizeof(struct _Mix_Channel));
 
+	/* Room for one callback's worth of 32-bit sums, if they can be used */
+	switch (mixer.format) {
+		case AUDIO_U8:
+		case AUDIO_S8:
+		case AUDIO_S16LSB:
+		case AUDIO_S16MSB:
+			mix_accum_len = mixer.size / ((mixer.format & 0xFF) / 8);
+			mix_accum = (Sint32 *) SDL_malloc(mix_accum_len * sizeof(Sint32));
+			break;
+		default:
+			mix_accum_len = 0;
+			mix_accum = NULL;
+			break;
+	}
+	mix_ramp_buf = (Uint8 *) SDL_malloc(mixer.size);
+
 	/* Clear out the audio channels */
 	for ( i=0; i<num_channels; ++i ) {
 		mix_channel[i].chunk = NULL;
 		mix_channel[i].playing = 0;
 		mix_channel[i].looping = 0;
 		mix_channel[i].volume = SDL_MIX_MAXVOLUME;
+		mix_channel[i].mix_volume = -1;
 		mix_channel[i].fade_volume = SDL_MIX_MAXVOLUME;
 		mix_channel[i].fade_volume_reset = SDL_MIX_MAXVOLUME;
 		mix_channel[i].fading = MIX_NO_FADING;
@@ -458,7 +1385,29 @@ int Mix_OpenAudio(int frequency, Uint16 format, int nchannels, int chunksize)
 		mix_channel[i].expire = 0;
 		mix_channel[i].effects = NULL;
 		mix_channel[i].paused = 0;
+		mix_channel[i].claimed = 0;
+		mix_channel[i].group = -1;
+	}
+	rebuild_channel_lists();
+
+	mix_commands = (mix_command_cell *) SDL_malloc(MIX_COMMAND_QUEUE_SIZE * sizeof(mix_command_cell));
+	mix_scheduled = (mix_command *) SDL_malloc(MIX_COMMAND_QUEUE_SIZE * sizeof(mix_command));
+#ifdef MIX_CAS_MUTEX
+	command_mutex = SDL_CreateMutex();
+#endif
+	if ( mix_commands == NULL || mix_scheduled == NULL ) {
+		SDL_free(mix_commands);
+		mix_commands = NULL;
+		SDL_free(mix_scheduled);
+		mix_scheduled = NULL;
+	} else {
+		for ( i = 0; i < MIX_COMMAND_QUEUE_SIZE; ++i ) {
+			mix_commands[i].seq = i;
+		}
 	}
+	command_enqueue_pos = command_dequeue_pos = 0;
+	num_scheduled = 0;
+	mix_clock = 0;
 	Mix_VolumeMusic(SDL_MIX_MAXVOLUME);
 
 	_Mix_InitEffects();
@@ -485,9 +1434,12 @@ int Mix_OpenAudio(int frequency, Uint16 format, int nchannels, int chunksize)
  */
 int Mix_AllocateChannels(int numchans)
 {
+	int queueing;
+
 	if ( numchans<0 || numchans==num_channels )
 		return(num_channels);
 
+	queueing = suspend_commands();
 	if ( numchans < num_channels ) {
 		/* Stop the affected channels */
 		int i;
@@ -506,6 +1458,7 @@ int Mix_AllocateChannels(int numchans)
 			mix_channel[i].playing = 0;
 			mix_channel[i].looping = 0;
 			mix_channel[i].volume = SDL_MIX_MAXVOLUME;
+			mix_channel[i].mix_volume = -1;
 			mix_channel[i].fade_volume = SDL_MIX_MAXVOLUME;
 			mix_channel[i].fade_volume_reset = SDL_MIX_MAXVOLUME;
 			mix_channel[i].fading = MIX_NO_FADING;
@@ -513,13 +1466,40 @@ int Mix_AllocateChannels(int numchans)
 			mix_channel[i].expire = 0;
 			mix_channel[i].effects = NULL;
 			mix_channel[i].paused = 0;
+			mix_channel[i].claimed = 0;
+			mix_channel[i].group = -1;
 		}
 	}
 	num_channels = numchans;
+	rebuild_channel_lists();
 	SDL_UnlockAudio();
+	command_queueing = queueing;
 	return(num_channels);
 }
 
+/* Choose whether the channels are clipped one by one or summed first */
+Mix_MixingMode Mix_SetMixingMode(Mix_MixingMode mode)
+{
+	Mix_MixingMode prev;
+
+	SDL_LockAudio();
+	prev = mixing_mode;
+	mixing_mode = mode;
+	SDL_UnlockAudio();
+	return(prev);
+}
+
+/* Set the rate conversion quality for sounds and music loaded from now on */
+int Mix_SetResampleQuality(int quality)
+{
+	int prev = resample_quality;
+
+	if ( quality >= 0 ) {
+		resample_quality = quality;
+	}
+	return(prev);
+}
+
 /* Return the actual mixer parameters */
 int Mix_QuerySpec(int *frequency, Uint16 *format, int *channels)
 {
@@ -636,6 +1616,7 @@ Mix_Chunk *Mix_LoadWAV_RW(SDL_RWops *src, int freesrc)
 			SDL_free(chunk);
 			return(NULL);
 		}
+		wavecvt.rate_quality = Mix_SetResampleQuality(-1);
 		samplesize = ((wavespec.format & 0xFF)/8)*wavespec.channels;
 		wavecvt.len = chunk->alen & ~(samplesize-1);
 		wavecvt.buf = (Uint8 *)SDL_calloc(1, wavecvt.len*wavecvt.len_mult);
@@ -665,6 +1646,54 @@ Mix_Chunk *Mix_LoadWAV_RW(SDL_RWops *src, int freesrc)
 	return(chunk);
 }
 
+/* Open a sound file to be decoded as it plays, instead of all at once */
+Mix_Chunk *Mix_StreamWAV_RW(SDL_RWops *src, int freesrc)
+{
+	stream_chunk *sc;
+
+	if ( ! src ) {
+		SDL_SetError("Mix_StreamWAV_RW with NULL src");
+		return(NULL);
+	}
+
+	/* Make sure audio has been opened */
+	if ( ! audio_opened ) {
+		SDL_SetError("Audio device hasn't been opened");
+		if ( freesrc ) {
+			SDL_RWclose(src);
+		}
+		return(NULL);
+	}
+
+	sc = (stream_chunk *)SDL_calloc(1, sizeof(*sc));
+	if ( sc ) {
+		sc->buf = (Uint8 *)SDL_malloc(mixer.size);
+	}
+	if ( sc == NULL || sc->buf == NULL ) {
+		SDL_SetError("Out of memory");
+		if ( sc ) {
+			SDL_free(sc);
+		}
+		if ( freesrc ) {
+			SDL_RWclose(src);
+		}
+		return(NULL);
+	}
+
+	sc->music = music_stream_open(src, freesrc);
+	if ( sc->music == NULL ) {
+		SDL_free(sc->buf);
+		SDL_free(sc);
+		return(NULL);
+	}
+	sc->chunk.allocated = MIX_CHUNK_STREAMED;
+	sc->chunk.abuf = NULL;
+	sc->chunk.alen = 0;
+	sc->chunk.volume = MIX_MAX_VOLUME;
+
+	return(&sc->chunk);
+}
+
 /* Load a wave file of the mixer format from a memory buffer */
 Mix_Chunk *Mix_QuickLoad_WAV(Uint8 *mem)
 {
@@ -734,19 +1763,38 @@ void Mix_FreeChunk(Mix_Chunk *chunk)
 
 	/* Caution -- if the chunk is playing, the mixer will crash */
 	if ( chunk ) {
-		/* Guarantee that this chunk isn't playing */
+		/* Guarantee that this chunk isn't playing, or about to */
 		SDL_LockAudio();
+		run_commands();
+		for ( i=0; i<num_scheduled; ) {
+			if ( mix_scheduled[i].type == MIX_CMD_PLAY &&
+			     mix_scheduled[i].chunk == chunk ) {
+				if ( mix_scheduled[i].claimed ) {
+					release_channel(mix_scheduled[i].channel);
+				}
+				--num_scheduled;
+				memmove(mix_scheduled + i, mix_scheduled + i + 1,
+				        (num_scheduled - i) * sizeof(mix_command));
+			} else {
+				++i;
+			}
+		}
 		if ( mix_channel ) {
 			for ( i=0; i<num_channels; ++i ) {
 				if ( chunk == mix_channel[i].chunk ) {
 					mix_channel[i].playing = 0;
 					mix_channel[i].looping = 0;
+					channel_relist(i);
 				}
 			}
 		}
 		SDL_UnlockAudio();
 		/* Actually free the chunk */
-		if ( chunk->allocated ) {
+		if ( chunk->allocated == MIX_CHUNK_STREAMED ) {
+			stream_chunk *sc = (stream_chunk *)chunk;
+			music_stream_close(sc->music);
+			SDL_free(sc->buf);
+		} else if ( chunk->allocated ) {
 			SDL_free(chunk->abuf);
 		}
 		SDL_free(chunk);
@@ -804,7 +1852,12 @@ int Mix_ReserveChannels(int num)
 {
 	if (num > num_channels)
 		num = num_channels;
-	reserved_channels = num;
+	SDL_LockAudio();
+	if ( num != reserved_channels ) {
+		reserved_channels = num;
+		rebuild_channel_lists();
+	}
+	SDL_UnlockAudio();
 	return num;
 }
 
@@ -812,21 +1865,108 @@ static int checkchunkintegral(Mix_Chunk *chunk)
 {
 	int frame_width = 1;
 
-	if ((mixer.format & 0xFF) == 16) frame_width = 2;
-	frame_width *= mixer.channels;
+	if (chunk->allocated == MIX_CHUNK_STREAMED) return 1;
+	frame_width = ((mixer.format & 0xFF) / 8) * mixer.channels;
 	while (chunk->alen % frame_width) chunk->alen--;
 	return chunk->alen;
 }
 
+/* Check that a streamed chunk isn't playing on a channel besides which */
+static int chunk_available(int which, Mix_Chunk *chunk)
+{
+	int i;
+
+	if ( chunk->allocated == MIX_CHUNK_STREAMED ) {
+		for ( i=0; i<num_channels; ++i ) {
+			if ( i != which && mix_channel[i].chunk == chunk &&
+			     mix_channel[i].playing > 0 ) {
+				Mix_SetError("Streamed chunk is already playing");
+				return(0);
+			}
+		}
+	}
+	return(1);
+}
+
+/* Start a chunk from the top on a channel, called with the audio locked.
+   Streamed chunks count as 1 byte left to play until their source runs
+   out.
+ */
+static void start_chunk(int which, Mix_Chunk *chunk)
+{
+	if ( chunk->allocated == MIX_CHUNK_STREAMED ) {
+		music_stream_rewind(((stream_chunk *)chunk)->music);
+		mix_channel[which].samples = NULL;
+		mix_channel[which].playing = 1;
+	} else {
+		mix_channel[which].samples = chunk->abuf;
+		mix_channel[which].playing = chunk->alen;
+	}
+	mix_channel[which].mix_volume = -1;
+}
+
+/* Queue a command to run at a sample frame, whether or not calls are
+   being queued */
+static int push_timed(mix_command *cmd, Uint32 when)
+{
+	if ( mix_commands == NULL ) {
+		Mix_SetError("Audio device hasn't been opened");
+		return(0);
+	}
+	cmd->timed = 1;
+	cmd->when = when;
+	return(push_command(cmd));
+}
+
+/* Queue playing a chunk.  A channel for -1 is picked now, so that the
+   caller knows which one it'll be.
+ */
+static int queue_play(int which, Mix_Chunk *chunk, int loops, int ms, int ticks,
+                      int timed, Uint32 when)
+{
+	mix_command cmd;
+	int queued;
+
+	cmd.claimed = 0;
+	if ( which == -1 ) {
+		/* The command releases the channel once it has run */
+		which = claim_channel();
+		if ( which < 0 ) {
+			Mix_SetError("No free channels available");
+			return(-1);
+		}
+		cmd.claimed = 1;
+	}
+	cmd.type = MIX_CMD_PLAY;
+	cmd.channel = which;
+	cmd.chunk = chunk;
+	cmd.loops = loops;
+	cmd.ms = ms;
+	cmd.ticks = ticks;
+	if ( timed ) {
+		queued = push_timed(&cmd, when);
+	} else {
+		cmd.timed = 0;
+		queued = push_command(&cmd);
+	}
+	if ( !queued ) {
+		if ( cmd.claimed ) {
+			release_channel(which);
+		}
+		return(-1);
+	}
+	return(which);
+}
+
 /* Play an audio chunk on a specific channel.
-   If the specified channel is -1, play on the first free channel.
+   If the specified channel is -1, play on a free channel.
    'ticks' is the number of milliseconds at most to play the sample, or -1
    if there is no limit.
    Returns which channel was used to play the sound.
 */
 int Mix_PlayChannelTimed(int which, Mix_Chunk *chunk, int loops, int ticks)
 {
-	int i;
+	int claimed = 0;
 
 	/* Don't play null pointers :-) */
 	if ( chunk == NULL ) {
@@ -837,37 +1977,47 @@ int Mix_PlayChannelTimed(int which, Mix_Chunk *chunk, int loops, int ticks)
 		Mix_SetError("Tried to play a chunk with a bad frame");
 		return(-1);
 	}
+	if ( !command_direct() ) {
+		return(queue_play(which, chunk, loops, 0, ticks, 0, 0));
+	}
 
 	/* Lock the mixer while modifying the playing channels */
 	SDL_LockAudio();
 	{
-		/* If which is -1, play on the first free channel */
+		/* If which is -1, play on a free channel */
 		if ( which == -1 ) {
-			for ( i=reserved_channels; i<num_channels; ++i ) {
-				if ( mix_channel[i].playing <= 0 )
-					break;
-			}
-			if ( i == num_channels ) {
+			which = free_channel();
+			if ( which < 0 ) {
 				Mix_SetError("No free channels available");
-				which = -1;
-			} else {
-				which = i;
 			}
+			claimed = 1;
 		}
 
 		/* Queue up the audio data for this channel */
 		if ( which >= 0 && which < num_channels ) {
 			Uint32 sdl_ticks = SDL_GetTicks();
+			if ( !chunk_available(which, chunk) ) {
+				if ( claimed ) {
+					release_channel(which);
+				}
+				SDL_UnlockAudio();
+				return(-1);
+			}
 			if (Mix_Playing(which))
 				_Mix_channel_done_playing(which);
-			mix_channel[which].samples = chunk->abuf;
-			mix_channel[which].playing = chunk->alen;
+			start_chunk(which, chunk);
 			mix_channel[which].looping = loops;
 			mix_channel[which].chunk = chunk;
 			mix_channel[which].paused = 0;
 			mix_channel[which].fading = MIX_NO_FADING;
 			mix_channel[which].start_time = sdl_ticks;
 			mix_channel[which].expire = (ticks>0) ? (sdl_ticks + ticks) : 0;
+			/* It's the newest sound now, even if it was already playing */
+			channel_delist(which);
+			channel_enlist(which);
+			if ( claimed ) {
+				release_channel(which);
+			}
 		}
 	}
 	SDL_UnlockAudio();
@@ -879,8 +2029,19 @@ int Mix_PlayChannelTimed(int which, Mix_Chunk *chunk, int loops, int ticks)
 /* Change the expiration delay for a channel */
 int Mix_ExpireChannel(int which, int ticks)
 {
+	mix_command cmd;
 	int status = 0;
 
+	cmd.type = MIX_CMD_EXPIRE;
+	cmd.channel = which;
+	cmd.ticks = ticks;
+	switch (queue_command(&cmd)) {
+		case 1:
+			return((which == -1) ? num_channels : 1);
+		case -1:
+			return(0);
+	}
+
 	if ( which == -1 ) {
 		int i;
 		for ( i=0; i < num_channels; ++ i ) {
@@ -898,7 +2059,7 @@ int Mix_ExpireChannel(int which, int ticks)
 /* Fade in a sound on a channel, over ms milliseconds */
 int Mix_FadeInChannelTimed(int which, Mix_Chunk *chunk, int loops, int ms, int ticks)
 {
-	int i;
+	int claimed = 0;
 
 	/* Don't play null pointers :-) */
 	if ( chunk == NULL ) {
@@ -908,30 +2069,32 @@ int Mix_FadeInChannelTimed(int which, Mix_Chunk *chunk, int loops, int ms, int t
 		Mix_SetError("Tried to play a chunk with a bad frame");
 		return(-1);
 	}
+	if ( !command_direct() ) {
+		return(queue_play(which, chunk, loops, ms, ticks, 0, 0));
+	}
 
 	/* Lock the mixer while modifying the playing channels */
 	SDL_LockAudio();
 	{
-		/* If which is -1, play on the first free channel */
+		/* If which is -1, play on a free channel */
 		if ( which == -1 ) {
-			for ( i=reserved_channels; i<num_channels; ++i ) {
-				if ( mix_channel[i].playing <= 0 )
-					break;
-			}
-			if ( i == num_channels ) {
-				which = -1;
-			} else {
-				which = i;
-			}
+			which = free_channel();
+			claimed = 1;
 		}
 
 		/* Queue up the audio data for this channel */
 		if ( which >= 0 && which < num_channels ) {
 			Uint32 sdl_ticks = SDL_GetTicks();
+			if ( !chunk_available(which, chunk) ) {
+				if ( claimed ) {
+					release_channel(which);
+				}
+				SDL_UnlockAudio();
+				return(-1);
+			}
 			if (Mix_Playing(which))
 				_Mix_channel_done_playing(which);
-			mix_channel[which].samples = chunk->abuf;
-			mix_channel[which].playing = chunk->alen;
+			start_chunk(which, chunk);
 			mix_channel[which].looping = loops;
 			mix_channel[which].chunk = chunk;
 			mix_channel[which].paused = 0;
@@ -939,9 +2102,15 @@ int Mix_FadeInChannelTimed(int which, Mix_Chunk *chunk, int loops, int ms, int t
 			mix_channel[which].fade_volume = mix_channel[which].volume;
 			mix_channel[which].fade_volume_reset = mix_channel[which].volume;
 			mix_channel[which].volume = 0;
+			mix_channel[which].mix_volume = 0;
 			mix_channel[which].fade_length = (Uint32)ms;
 			mix_channel[which].start_time = mix_channel[which].ticks_fade = sdl_ticks;
 			mix_channel[which].expire = (ticks > 0) ? (sdl_ticks+ticks) : 0;
+			channel_delist(which);
+			channel_enlist(which);
+			if ( claimed ) {
+				release_channel(which);
+			}
 		}
 	}
 	SDL_UnlockAudio();
@@ -953,9 +2122,19 @@ int Mix_FadeInChannelTimed(int which, Mix_Chunk *chunk, int loops, int ms, int t
 /* Set volume of a particular channel */
 int Mix_Volume(int which, int volume)
 {
+	mix_command cmd;
 	int i;
 	int prev_volume = 0;
 
+	if ( volume >= 0 ) {
+		cmd.type = MIX_CMD_VOLUME;
+		cmd.channel = which;
+		cmd.ms = volume;
+		if ( queue_command(&cmd) ) {
+			/* Report the volume as it is until the callback sets it */
+			volume = -1;
+		}
+	}
 	if ( which == -1 ) {
 		for ( i=0; i<num_channels; ++i ) {
 			prev_volume += Mix_Volume(i, volume);
@@ -990,8 +2169,14 @@ int Mix_VolumeChunk(Mix_Chunk *chunk, int volume)
 /* Halt playing of a particular channel */
 int Mix_HaltChannel(int which)
 {
+	mix_command cmd;
 	int i;
 
+	cmd.type = MIX_CMD_HALT;
+	cmd.channel = which;
+	if ( queue_command(&cmd) ) {
+		return(0);
+	}
 	if ( which == -1 ) {
 		for ( i=0; i<num_channels; ++i ) {
 			Mix_HaltChannel(i);
@@ -1002,6 +2187,7 @@ int Mix_HaltChannel(int which)
 			_Mix_channel_done_playing(which);
 			mix_channel[which].playing = 0;
 			mix_channel[which].looping = 0;
+			channel_relist(which);
 		}
 		mix_channel[which].expire = 0;
 		if(mix_channel[which].fading != MIX_NO_FADING) /* Restore volume */
@@ -1028,8 +2214,19 @@ int Mix_HaltGroup(int tag)
 /* Fade out a channel and then stop it automatically */
 int Mix_FadeOutChannel(int which, int ms)
 {
+	mix_command cmd;
 	int status;
 
+	cmd.type = MIX_CMD_FADE_OUT;
+	cmd.channel = which;
+	cmd.ms = ms;
+	switch (queue_command(&cmd)) {
+		case 1:
+			return(1);
+		case -1:
+			return(0);
+	}
+
 	status = 0;
 	if ( audio_opened ) {
 		if ( which == -1 ) {
@@ -1073,6 +2270,70 @@ int Mix_FadeOutGroup(int tag, int ms)
 	return(status);
 }
 
+/* Send channel and effect calls made outside the audio callback through
+   the command queue, so they never wait on the audio lock */
+int Mix_QueueCommands(int on)
+{
+	int prev = command_queueing;
+
+	if ( on >= 0 ) {
+		if ( on && mix_commands == NULL ) {
+			Mix_SetError("Audio device hasn't been opened");
+			return(-1);
+		}
+		if ( !on && prev ) {
+			/* Don't let direct calls overtake queued ones */
+			suspend_commands();
+		}
+		command_queueing = (on != 0);
+	}
+	return(prev);
+}
+
+/* The number of sample frames mixed since the audio device was opened */
+Uint32 Mix_GetSampleClock(void)
+{
+	return(mix_clock);
+}
+
+/* Start a chunk at a sample frame on the mix clock */
+int Mix_FadeInChannelAt(int which, Mix_Chunk *chunk, int loops, int ms, int ticks,
+                        Uint32 when)
+{
+	if ( chunk == NULL ) {
+		Mix_SetError("Tried to play a NULL chunk");
+		return(-1);
+	}
+	if ( !checkchunkintegral(chunk)) {
+		Mix_SetError("Tried to play a chunk with a bad frame");
+		return(-1);
+	}
+	return(queue_play(which, chunk, loops, ms, ticks, 1, when));
+}
+
+/* Halt a channel at a sample frame on the mix clock */
+int Mix_HaltChannelAt(int which, Uint32 when)
+{
+	mix_command cmd;
+
+	cmd.type = MIX_CMD_HALT;
+	cmd.channel = which;
+	cmd.claimed = 0;
+	return(push_timed(&cmd, when) ? 0 : -1);
+}
+
+/* Start fading out a channel at a sample frame on the mix clock */
+int Mix_FadeOutChannelAt(int which, int ms, Uint32 when)
+{
+	mix_command cmd;
+
+	cmd.type = MIX_CMD_FADE_OUT;
+	cmd.channel = which;
+	cmd.ms = ms;
+	cmd.claimed = 0;
+	return(push_timed(&cmd, when));
+}
+
 Mix_Fading Mix_FadingChannel(int which)
 {
 	if ( which < 0 || which >= num_channels ) {
@@ -1128,6 +2389,8 @@ void Mix_CloseAudio(void)
 
 	if ( audio_opened ) {
 		if ( audio_opened == 1 ) {
+			suspend_commands();
+			num_scheduled = 0;
 			for (i = 0; i < num_channels; i++) {
 				Mix_UnregisterAllEffects(i);
 			}
@@ -1138,6 +2401,25 @@ void Mix_CloseAudio(void)
 			SDL_CloseAudio();
 			SDL_free(mix_channel);
 			mix_channel = NULL;
+			SDL_free(mix_accum);
+			mix_accum = NULL;
+			mix_accum_len = 0;
+			SDL_free(mix_ramp_buf);
+			mix_ramp_buf = NULL;
+			SDL_free(mix_groups);
+			mix_groups = NULL;
+			num_groups = 0;
+			SDL_free(group_hash);
+			group_hash = NULL;
+			group_hash_size = 0;
+			SDL_free(mix_commands);
+			mix_commands = NULL;
+			SDL_free(mix_scheduled);
+			mix_scheduled = NULL;
+#ifdef MIX_CAS_MUTEX
+			SDL_DestroyMutex(command_mutex);
+			command_mutex = NULL;
+#endif
 
 			/* rcg06042009 report available decoders at runtime. */
 			SDL_free(chunk_decoders);
@@ -1151,7 +2433,14 @@ void Mix_CloseAudio(void)
 /* Pause a particular channel (or all) */
 void Mix_Pause(int which)
 {
+	mix_command cmd;
 	Uint32 sdl_ticks = SDL_GetTicks();
+
+	cmd.type = MIX_CMD_PAUSE;
+	cmd.channel = which;
+	if ( queue_command(&cmd) ) {
+		return;
+	}
 	if ( which == -1 ) {
 		int i;
 
@@ -1170,8 +2459,14 @@ void Mix_Pause(int which)
 /* Resume a paused channel */
 void Mix_Resume(int which)
 {
+	mix_command cmd;
 	Uint32 sdl_ticks = SDL_GetTicks();
 
+	cmd.type = MIX_CMD_RESUME;
+	cmd.channel = which;
+	if ( queue_command(&cmd) ) {
+		return;
+	}
 	SDL_LockAudio();
 	if ( which == -1 ) {
 		int i;
@@ -1214,11 +2509,30 @@ int Mix_Paused(int which)
 /* Change the group of a channel */
 int Mix_GroupChannel(int which, int tag)
 {
-	if ( which < 0 || which > num_channels )
+	int group = -1;
+
+	if ( which < 0 || which >= num_channels )
 		return(0);
 
 	SDL_LockAudio();
+	if ( tag != -1 ) {
+		group = find_group(tag, 1);
+		if ( group < 0 ) {
+			SDL_UnlockAudio();
+			return(0);
+		}
+	}
+	/* Its place among all the channels stays the same */
+	channel_delist_set(which, 1);
+	if ( mix_channel[which].group >= 0 ) {
+		--mix_groups[mix_channel[which].group].count;
+	}
 	mix_channel[which].tag = tag;
+	mix_channel[which].group = group;
+	if ( group >= 0 ) {
+		++mix_groups[group].count;
+	}
+	channel_enlist_set(which, 1);
 	SDL_UnlockAudio();
 	return(1);
 }
@@ -1233,58 +2547,74 @@ int Mix_GroupChannels(int from, int to, int tag)
 	return(status);
 }
 
-/* Finds the first available channel in a group of channels */
+/* The lists for a tag, or NULL if no channels have it */
+static mix_group *tag_group(int tag)
+{
+	int group;
+
+	if ( tag == -1 ) {
+		return(&mix_all);
+	}
+	group = find_group(tag, 0);
+	return((group >= 0) ? &mix_groups[group] : NULL);
+}
+
+/* Finds an available channel in a group of channels */
 int Mix_GroupAvailable(int tag)
 {
-	int i;
-	for( i=0; i < num_channels; i ++ ) {
-		if ( ((tag == -1) || (tag == mix_channel[i].tag)) &&
-		                    (mix_channel[i].playing <= 0) )
-			return i;
+	mix_group *group;
+	int chan = -1;
+
+	SDL_LockAudio();
+	group = tag_group(tag);
+	if ( group ) {
+		chan = (group->reserved_free >= 0) ? group->reserved_free : group->free;
 	}
-	return(-1);
+	SDL_UnlockAudio();
+	return(chan);
 }
 
 int Mix_GroupCount(int tag)
 {
+	mix_group *group;
 	int count = 0;
-	int i;
-	for( i=0; i < num_channels; i ++ ) {
-		if ( mix_channel[i].tag==tag || tag==-1 )
-			++ count;
+
+	SDL_LockAudio();
+	group = tag_group(tag);
+	if ( group ) {
+		count = group->count;
 	}
+	SDL_UnlockAudio();
 	return(count);
 }
 
 /* Finds the "oldest" sample playing in a group of channels */
 int Mix_GroupOldest(int tag)
 {
+	mix_group *group;
 	int chan = -1;
-	Uint32 mintime = SDL_GetTicks();
-	int i;
-	for( i=0; i < num_channels; i ++ ) {
-		if ( (mix_channel[i].tag==tag || tag==-1) && mix_channel[i].playing > 0
-			 && mix_channel[i].start_time <= mintime ) {
-			mintime = mix_channel[i].start_time;
-			chan = i;
-		}
+
+	SDL_LockAudio();
+	group = tag_group(tag);
+	if ( group ) {
+		chan = group->oldest;
 	}
+	SDL_UnlockAudio();
 	return(chan);
 }
 
 /* Finds the "most recent" (i.e. last) sample playing in a group of channels */
 int Mix_GroupNewer(int tag)
 {
+	mix_group *group;
 	int chan = -1;
-	Uint32 maxtime = 0;
-	int i;
-	for( i=0; i < num_channels; i ++ ) {
-		if ( (mix_channel[i].tag==tag || tag==-1) && mix_channel[i].playing > 0
-			 && mix_channel[i].start_time >= maxtime ) {
-			maxtime = mix_channel[i].start_time;
-			chan = i;
-		}
+
+	SDL_LockAudio();
+	group = tag_group(tag);
+	if ( group ) {
+		chan = group->newest;
 	}
+	SDL_UnlockAudio();
 	return(chan);
 }
 
@@ -1321,6 +2651,8 @@ static int _Mix_register_effect(effect_info **e, Mix_EffectFunc_t f,
 	new_e->callback = f;
 	new_e->done_callback = d;
 	new_e->udata = arg;
+	new_e->fused = 0;
+	new_e->wide = NULL;
 	new_e->next = NULL;
 
 	/* add new effect to end of linked list... */
@@ -1422,7 +2754,23 @@ int _Mix_RegisterEffect_locked(int channel, Mix_EffectFunc_t f,
 int Mix_RegisterEffect(int channel, Mix_EffectFunc_t f,
 			Mix_EffectDone_t d, void *arg)
 {
+	mix_command cmd;
     int retval;
+
+	if (f == NULL) {
+		Mix_SetError("NULL effect callback");
+		return(0);
+	}
+	cmd.type = MIX_CMD_REGISTER_EFFECT;
+	cmd.channel = channel;
+	cmd.effect = f;
+	cmd.effect_done = d;
+	cmd.udata = arg;
+	retval = queue_command(&cmd);
+	if (retval) {
+		return(retval > 0);
+	}
+
 	SDL_LockAudio();
 	retval = _Mix_RegisterEffect_locked(channel, f, d, arg);
 	SDL_UnlockAudio();
@@ -1448,9 +2796,65 @@ int _Mix_UnregisterEffect_locked(int channel, Mix_EffectFunc_t f)
 	return _Mix_remove_effect(channel, e, f);
 }
 
+/* Let a channel effect be applied by gains as the channel is mixed, which
+   saves a pass over the audio when it's the last effect.  This is only
+   done for signed 16-bit native audio on up to 6 speakers.
+   MAKE SURE you hold the audio lock (SDL_LockAudio()) before calling this!
+ */
+int _Mix_SetEffectGains(int channel, Mix_EffectFunc_t f,
+                        const _Mix_SpeakerGains *gains)
+{
+	effect_info *e;
+
+	if (channel < 0 || channel >= num_channels ||
+	    mixer.format != AUDIO_S16SYS || mixer.channels > 6) {
+		return(0);
+	}
+	for (e = mix_channel[channel].effects; e != NULL; e = e->next) {
+		if (e->callback == f) {
+			e->gains = *gains;
+			e->fused = 1;
+			return(1);
+		}
+	}
+	return(0);
+}
+
+/* Let a posteffect work on the 32-bit sums, before they are clipped, when
+   the channels are accumulated.  The sums are signed 16-bit native audio
+   that hasn't been clipped, so only that format is supported.
+   MAKE SURE you hold the audio lock (SDL_LockAudio()) before calling this!
+ */
+int _Mix_SetEffectWide(int channel, Mix_EffectFunc_t f,
+                       _Mix_WideEffectFunc wide)
+{
+	effect_info *e;
+
+	if (channel != MIX_CHANNEL_POST || mixer.format != AUDIO_S16SYS) {
+		return(0);
+	}
+	for (e = posteffects; e != NULL; e = e->next) {
+		if (e->callback == f) {
+			e->wide = wide;
+			return(1);
+		}
+	}
+	return(0);
+}
+
 int Mix_UnregisterEffect(int channel, Mix_EffectFunc_t f)
 {
+	mix_command cmd;
 	int retval;
+
+	cmd.type = MIX_CMD_UNREGISTER_EFFECT;
+	cmd.channel = channel;
+	cmd.effect = f;
+	retval = queue_command(&cmd);
+	if (retval) {
+		return(retval > 0);
+	}
+
 	SDL_LockAudio();
 	retval = _Mix_UnregisterEffect_locked(channel, f);
 	SDL_UnlockAudio();
@@ -1477,7 +2881,16 @@ int _Mix_UnregisterAllEffects_locked(int channel)
 
 int Mix_UnregisterAllEffects(int channel)
 {
+	mix_command cmd;
 	int retval;
+
+	cmd.type = MIX_CMD_UNREGISTER_ALL;
+	cmd.channel = channel;
+	retval = queue_command(&cmd);
+	if (retval) {
+		return(retval > 0);
+	}
+
 	SDL_LockAudio();
 	retval = _Mix_UnregisterAllEffects_locked(channel);
 	SDL_UnlockAudio();
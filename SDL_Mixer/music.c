@@ -28,9 +28,14 @@
 #include "SDL_endian.h"
 #include "SDL_audio.h"
 #include "SDL_timer.h"
+#include "SDL_thread.h"
+#include "SDL_mutex.h"
 
 #include "SDL_mixer.h"
 
+#define __MIX_INTERNAL_EFFECT__
+#include "effects_internal.h"
+
 #ifdef CMD_MUSIC
 #include "music_cmd.h"
 #endif
@@ -139,6 +144,70 @@ static int native_midi_ok;
 /* Used to calculate fading steps */
 static int ms_per_step;
 
+/* Decode-ahead ring, filled by music_thread and drained by the audio
+   callback.  head is only written by the thread decoding into the ring
+   and tail only by the audio callback, so neither needs a lock.
+   To discard what's queued, the producer sets flush_pos to head and
+   bumps flush, and the callback skips ahead to it.
+ */
+typedef struct {
+	Uint8 *buf;
+	int size;			/* a power of two */
+	volatile Uint32 head;		/* bytes decoded */
+	volatile Uint32 tail;		/* bytes played */
+	volatile Uint32 flush_pos;
+	volatile int flush;
+	int flushed;
+	volatile int live;		/* music is playing, running dry is an underrun */
+	volatile int underruns;
+} MusicRing;
+
+/* Order the ring's data accesses against its head and tail updates.
+   MSVC only gives volatile accesses acquire and release semantics from
+   8.0 on, and this builds with 7.1, so there an interlocked exchange,
+   which neither the compiler nor the processor reorders, does it. */
+#if defined(__GNUC__)
+#define MUSIC_RING_BARRIER()	__sync_synchronize()
+#elif defined(_MSC_VER)
+#if defined(_XBOX)
+#include <xtl.h>
+#else
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#endif
+static LONG volatile music_ring_fence;
+#define MUSIC_RING_BARRIER()	InterlockedExchange(&music_ring_fence, 0)
+#else
+#define MUSIC_RING_BARRIER()
+#endif
+
+static int music_lookahead = 0;		/* ms, 0 decodes in the audio callback */
+static MusicRing * volatile music_ring = NULL;
+static Uint8 *music_chunk_buf = NULL;
+static int music_chunk_len = 0;
+static Uint8 music_silence = 0;
+static Uint16 music_format = 0;
+static int music_channels = 0;
+static SDL_mutex *music_mutex = NULL;
+static SDL_sem *music_sem = NULL;
+static SDL_Thread *music_thread = NULL;
+static int volatile music_thread_quit = 0;
+
+/* Music layers, streamed and mixed in along with the music.  A layer's
+   fading state is kept in its Mix_Music, as for the music.
+ */
+typedef struct {
+	Mix_Music *music;
+	int loops;
+	int volume;
+	int mix_volume;		/* volume after fading */
+} MusicLayer;
+
+static MusicLayer *music_layers = NULL;
+static int num_layers = 0;
+static Uint8 *music_layer_buf = NULL;	/* each layer is decoded here */
+static void (*layer_finished_hook)(int layer) = NULL;
+
 /* rcg06042009 report available decoders at runtime. */
 static const char **music_decoders = NULL;
 static int num_decoders = 0;
@@ -176,8 +245,290 @@ static void music_internal_initialize_volume(void);
 static void music_internal_volume(int volume);
 static int  music_internal_play(Mix_Music *music, double position);
 static int  music_internal_position(double position);
+static int  music_internal_seek(Mix_Music *music, double position);
 static int  music_internal_playing();
+static int  music_internal_active(Mix_Music *music);
 static void music_internal_halt(void);
+static void music_decode(void *udata, Uint8 *stream, int len);
+static void music_decode_some(void *udata, Uint8 *stream, int len);
+static int music_ring_decode(void);
+static int music_layers_playing(void);
+static void music_layers_mix(Uint8 *stream, int len);
+static int music_layer_of(Mix_Music *music);
+static void layer_internal_halt(int which);
+
+
+/* The music state is guarded by the audio lock when the music is decoded
+   in the audio callback, and by music_mutex alone when it's decoded ahead
+   on music_thread, so that slow API calls don't hold up the callback.
+   music_mutex is always taken first, which also keeps the mode fixed.
+ */
+static void music_lock(void)
+{
+	if ( music_mutex ) {
+		SDL_mutexP(music_mutex);
+	}
+	if ( !music_ring ) {
+		SDL_LockAudio();
+	}
+}
+
+static void music_unlock(void)
+{
+	if ( !music_ring ) {
+		SDL_UnlockAudio();
+	}
+	if ( music_mutex ) {
+		SDL_mutexV(music_mutex);
+	}
+}
+
+/* Drop any music decoded ahead, called with the music lock held.
+   The first buffer of whatever plays next is decoded straight away,
+   so that it starts without a gap.
+ */
+static void music_ring_flush(void)
+{
+	MusicRing *ring = music_ring;
+
+	if ( ring ) {
+		ring->flush_pos = ring->head;
+		++ring->flush;
+		ring->live = (music_playing || music_layers_playing());
+		music_ring_decode();
+	}
+}
+
+/* Bytes of music decoded ahead that are still to be played */
+static int music_ring_queued(MusicRing *ring)
+{
+	Uint32 tail = ring->tail;
+
+	if ( ring->flushed != ring->flush &&
+	     (Sint32)(ring->flush_pos - tail) > 0 ) {
+		tail = ring->flush_pos;
+	}
+	return (int)(ring->head - tail);
+}
+
+/* Copy decoded music out of the ring, from the audio callback */
+static void music_ring_read(Uint8 *stream, int len)
+{
+	MusicRing *ring = music_ring;
+	Uint32 tail = ring->tail;
+	int avail, pos, part;
+
+	if ( ring->flushed != ring->flush ) {
+		ring->flushed = ring->flush;
+		if ( (Sint32)(ring->flush_pos - tail) > 0 ) {
+			tail = ring->flush_pos;
+		}
+	}
+	avail = (int)(ring->head - tail);
+	if ( avail < len ) {
+		if ( ring->live ) {
+			++ring->underruns;
+		}
+		len = avail;
+	}
+
+	pos = (int)(tail & (ring->size - 1));
+	part = ring->size - pos;
+	if ( part > len ) {
+		part = len;
+	}
+	MUSIC_RING_BARRIER();
+	memcpy(stream, ring->buf + pos, part);
+	memcpy(stream + part, ring->buf, len - part);
+	MUSIC_RING_BARRIER();
+	ring->tail = tail + len;
+
+	SDL_SemPost(music_sem);
+}
+
+/* Decode another buffer of music into the ring if there's room for it,
+   called with the music lock held.  Returns 1 if anything was decoded.
+ */
+static int music_ring_decode(void)
+{
+	MusicRing *ring = music_ring;
+	int pos, part;
+
+	if ( !ring || (!music_playing && !music_layers_playing()) ||
+	     !music_active ||
+	     ring->size - (int)(ring->head - ring->tail) < music_chunk_len ) {
+		return(0);
+	}
+	memset(music_chunk_buf, music_silence, music_chunk_len);
+	music_decode(NULL, music_chunk_buf, music_chunk_len);
+	music_layers_mix(music_chunk_buf, music_chunk_len);
+
+	pos = (int)(ring->head & (ring->size - 1));
+	part = ring->size - pos;
+	if ( part > music_chunk_len ) {
+		part = music_chunk_len;
+	}
+	MUSIC_RING_BARRIER();
+	memcpy(ring->buf + pos, music_chunk_buf, part);
+	memcpy(ring->buf, music_chunk_buf + part, music_chunk_len - part);
+	MUSIC_RING_BARRIER();
+	ring->head += music_chunk_len;
+	return(1);
+}
+
+/* Keep the ring topped up */
+static int SDLCALL music_thread_main(void *unused)
+{
+	int decoded;
+
+	while ( !music_thread_quit ) {
+		SDL_mutexP(music_mutex);
+		decoded = music_ring_decode();
+		music_ring->live = (music_playing || music_layers_playing());
+		SDL_mutexV(music_mutex);
+
+		if ( !decoded ) {
+			SDL_SemWaitTimeout(music_sem, 10);
+		}
+	}
+	return(0);
+}
+
+/* Go back to decoding music in the audio callback */
+static void music_stop_thread(void)
+{
+	MusicRing *ring;
+	Uint32 timeout;
+
+	if ( music_thread ) {
+		music_thread_quit = 1;
+		SDL_SemPost(music_sem);
+		SDL_WaitThread(music_thread, NULL);
+		music_thread = NULL;
+	}
+
+	/* Let the callback play out what was decoded, so the music carries on
+	   from the right place */
+	timeout = SDL_GetTicks() + 2 * music_lookahead + 100;
+	while ( music_ring && music_ring_queued(music_ring) > 0 &&
+	        music_active && SDL_GetAudioStatus() == SDL_AUDIO_PLAYING &&
+	        (Sint32)(SDL_GetTicks() - timeout) < 0 ) {
+		SDL_Delay(10);
+	}
+
+	SDL_mutexP(music_mutex);
+	SDL_LockAudio();
+	ring = music_ring;
+	music_ring = NULL;
+	SDL_UnlockAudio();
+	SDL_mutexV(music_mutex);
+
+	if ( ring ) {
+		SDL_free(ring);
+	}
+	if ( music_chunk_buf ) {
+		SDL_free(music_chunk_buf);
+		music_chunk_buf = NULL;
+	}
+}
+
+/* Start decoding music ahead on music_thread, if a lookahead is set */
+static int music_start_thread(SDL_AudioSpec *mixer)
+{
+	MusicRing *ring;
+	int bytes, size;
+
+	if ( music_lookahead <= 0 ) {
+		return(0);
+	}
+
+	/* Round up to a power of two, with room for at least two buffers */
+	bytes = (int)(((double)music_lookahead * mixer->freq / 1000.0) *
+	              mixer->channels * ((mixer->format & 0xFF) / 8));
+	for ( size = 1; size < bytes || size < 2 * (int)mixer->size; size <<= 1 ) {
+		continue;
+	}
+
+	ring = (MusicRing *)SDL_malloc(sizeof(MusicRing) + size);
+	music_chunk_buf = (Uint8 *)SDL_malloc(mixer->size);
+	if ( ring == NULL || music_chunk_buf == NULL ) {
+		if ( ring ) {
+			SDL_free(ring);
+		}
+		if ( music_chunk_buf ) {
+			SDL_free(music_chunk_buf);
+			music_chunk_buf = NULL;
+		}
+		Mix_SetError("Out of memory");
+		return(-1);
+	}
+	memset(ring, 0, sizeof(*ring));
+	ring->buf = (Uint8 *)(ring + 1);
+	ring->size = size;
+	music_chunk_len = mixer->size;
+	music_silence = mixer->silence;
+
+	SDL_mutexP(music_mutex);
+	SDL_LockAudio();
+	ring->live = (music_playing != NULL);
+	music_ring = ring;
+	SDL_UnlockAudio();
+	SDL_mutexV(music_mutex);
+
+	music_thread_quit = 0;
+	music_thread = SDL_CreateThread(music_thread_main, NULL);
+	if ( music_thread == NULL ) {
+		music_stop_thread();
+		return(-1);
+	}
+	return(0);
+}
+
+int Mix_SetMusicLookahead(int ms)
+{
+	int prev_lookahead = music_lookahead;
+	SDL_AudioSpec mixer;
+	int channels;
+
+	if ( ms < 0 ) {
+		return(prev_lookahead);
+	}
+
+	/* Restart the decoding thread if the audio is open */
+	if ( music_mutex ) {
+		music_stop_thread();
+		music_lookahead = ms;
+		memset(&mixer, 0, sizeof(mixer));
+		Mix_QuerySpec(&mixer.freq, &mixer.format, &channels);
+		mixer.channels = (Uint8)channels;
+		mixer.size = music_chunk_len;
+		mixer.silence = music_silence;
+		if ( music_start_thread(&mixer) < 0 ) {
+			music_lookahead = 0;
+		}
+	} else {
+		music_lookahead = ms;
+	}
+	return(prev_lookahead);
+}
+
+void Mix_GetMusicLookaheadStats(int *queued, int *size, int *underruns)
+{
+	MusicRing *ring;
+
+	SDL_LockAudio();
+	ring = music_ring;
+	if ( queued ) {
+		*queued = ring ? music_ring_queued(ring) : 0;
+	}
+	if ( size ) {
+		*size = ring ? ring->size : 0;
+	}
+	if ( underruns ) {
+		*underruns = ring ? ring->underruns : 0;
+	}
+	SDL_UnlockAudio();
+}
 
 
 /* Support for hooking when the music has finished */
@@ -185,9 +536,9 @@ static void (*music_finished_hook)(void) = NULL;
 
 void Mix_HookMusicFinished(void (*music_finished)(void))
 {
-	SDL_LockAudio();
+	music_lock();
 	music_finished_hook = music_finished;
-	SDL_UnlockAudio();
+	music_unlock();
 }
 
 
@@ -233,34 +584,89 @@ static int music_halt_or_loop (void)
 /* Mixing function */
 void music_mixer(void *udata, Uint8 *stream, int len)
 {
-	int left = 0;
+	if ( music_ring ) {
+		music_ring_read(stream, len);
+	} else {
+		music_decode(udata, stream, len);
+		music_layers_mix(stream, len);
+	}
+}
 
-	if ( music_playing && music_active ) {
-		/* Handle fading */
-		if ( music_playing->fading != MIX_NO_FADING ) {
-			if ( music_playing->fade_step++ < music_playing->fade_steps ) {
-				int volume;
-				int fade_step = music_playing->fade_step;
-				int fade_steps = music_playing->fade_steps;
-
-				if ( music_playing->fading == MIX_FADING_OUT ) {
-					volume = (music_volume * (fade_steps-fade_step)) / fade_steps;
-				} else { /* Fading in */
-					volume = (music_volume * fade_step) / fade_steps;
-				}
-				music_internal_volume(volume);
-			} else {
-				if ( music_playing->fading == MIX_FADING_OUT ) {
-					music_internal_halt();
-					if ( music_finished_hook ) {
-						music_finished_hook();
-					}
-					return;
+/* The volume a fading music has reached, out of MIX_MAX_VOLUME */
+static int music_fade_volume(Mix_Music *music)
+{
+	if ( music->fading == MIX_FADING_OUT ) {
+		return (MIX_MAX_VOLUME * (music->fade_steps-music->fade_step)) / music->fade_steps;
+	} else { /* Fading in */
+		return (MIX_MAX_VOLUME * music->fade_step) / music->fade_steps;
+	}
+}
+
+/* Native MIDI and external commands don't play through the stream, so
+   they're faded by their volume instead of by ramping the stream.
+ */
+static int music_internal_external(void)
+{
+#ifdef CMD_MUSIC
+	if ( music_playing->type == MUS_CMD ) {
+		return(1);
+	}
+#endif
+#ifdef USE_NATIVE_MIDI
+	if ( music_playing->type == MUS_MID && native_midi_ok ) {
+		return(1);
+	}
+#endif
+	return(0);
+}
+
+/* Decode the playing music into the stream, which holds nothing else.
+   A fade moves the music's volume one step per buffer, ramping it from
+   sample to sample across the buffer so that it doesn't step.
+ */
+static void music_decode(void *udata, Uint8 *stream, int len)
+{
+	int fade_from = MIX_MAX_VOLUME, fade_to = MIX_MAX_VOLUME;
+
+	if ( !music_playing || !music_active ) {
+		return;
+	}
+
+	/* Handle fading */
+	if ( music_playing->fading != MIX_NO_FADING ) {
+		if ( music_playing->fade_step < music_playing->fade_steps ) {
+			fade_from = music_fade_volume(music_playing);
+			++music_playing->fade_step;
+			fade_to = music_fade_volume(music_playing);
+			if ( music_internal_external() ) {
+				music_internal_volume((music_volume * fade_to) / MIX_MAX_VOLUME);
+				fade_from = fade_to = MIX_MAX_VOLUME;
+			}
+		} else {
+			if ( music_playing->fading == MIX_FADING_OUT ) {
+				music_internal_halt();
+				if ( music_finished_hook ) {
+					music_finished_hook();
 				}
-				music_playing->fading = MIX_NO_FADING;
+				return;
 			}
+			music_playing->fading = MIX_NO_FADING;
 		}
-		
+	}
+
+	music_decode_some(udata, stream, len);
+
+	if ( fade_from != MIX_MAX_VOLUME || fade_to != MIX_MAX_VOLUME ) {
+		_Mix_RampVolume(music_format, music_channels, stream, len, fade_from, fade_to);
+	}
+}
+
+/* Decode the playing music, looping it if it ends part way through */
+static void music_decode_some(void *udata, Uint8 *stream, int len)
+{
+	int left = 0;
+
+	if ( music_playing && music_active ) {
 		music_halt_or_loop();
 		if (!music_internal_playing())
 			return;
@@ -303,7 +709,7 @@ void music_mixer(void *udata, Uint8 *stream, int len)
 #ifdef USE_TIMIDITY_MIDI
 				if ( timidity_ok ) {
 					int samples = len / samplesize;
-  					Timidity_PlaySome(stream, samples);
+					Timidity_PlaySome(music_playing->data.midi, stream, samples);
 					goto skip;
 				}
 #endif
@@ -341,7 +747,7 @@ skip:
 	if (left > 0 && left < len) {
 		music_halt_or_loop();
 		if (music_internal_playing())
-			music_mixer(udata, stream+(len-left), left);
+			music_decode_some(udata, stream+(len-left), left);
 	}
 }
 
@@ -412,6 +818,10 @@ int open_music(SDL_AudioSpec *mixer)
 #if defined(MP3_MUSIC) || defined(MP3_MAD_MUSIC)
 	/* Keep a copy of the mixer */
 	used_mixer = *mixer;
+#ifdef MP3_MUSIC
+	/* SMPEG only decodes to 16-bit audio */
+	if ( mixer->format != AUDIO_F32SYS )
+#endif
 	add_music_decoder("MP3");
 #endif
 
@@ -422,6 +832,19 @@ int open_music(SDL_AudioSpec *mixer)
 	/* Calculate the number of ms for each callback */
 	ms_per_step = (int) (((float)mixer->samples * 1000.0) / mixer->freq);
 
+	/* Decode ahead on a thread if asked to, else in the audio callback */
+	music_chunk_len = mixer->size;
+	music_silence = mixer->silence;
+	music_format = mixer->format;
+	music_channels = mixer->channels;
+	music_layer_buf = (Uint8 *)SDL_malloc(mixer->size);
+	music_mutex = SDL_CreateMutex();
+	music_sem = SDL_CreateSemaphore(0);
+	if ( music_mutex == NULL || music_sem == NULL ||
+	     music_start_thread(mixer) < 0 ) {
+		music_lookahead = 0;
+	}
+
 	return(0);
 }
 
@@ -654,7 +1077,11 @@ Mix_Music *Mix_LoadMUSType_RW(SDL_RWops *rw, Mix_MusicType type, int freesrc)
 #endif
 #ifdef MP3_MUSIC
 	case MUS_MP3:
-		if ( Mix_Init(MIX_INIT_MP3) ) {
+		if ( used_mixer.format == AUDIO_F32SYS ) {
+			/* SMPEG only decodes to 16-bit audio */
+			Mix_SetError("Unknown hardware audio format");
+			music->error = 1;
+		} else if ( Mix_Init(MIX_INIT_MP3) ) {
 			SMPEG_Info info;
 			music->type = MUS_MP3;
 			music->data.mp3 = smpeg.SMPEG_new_rwops(rw, &info, 0);
@@ -756,19 +1183,28 @@ void Mix_FreeMusic(Mix_Music *music)
 {
 	if ( music ) {
 		/* Stop the music if it's currently playing */
-		SDL_LockAudio();
+		music_lock();
 		if ( music == music_playing ) {
 			/* Wait for any fade out to finish */
 			while ( music->fading == MIX_FADING_OUT ) {
-				SDL_UnlockAudio();
+				music_unlock();
 				SDL_Delay(100);
-				SDL_LockAudio();
+				music_lock();
 			}
 			if ( music == music_playing ) {
 				music_internal_halt();
+				music_ring_flush();
+			}
+		} else {
+			int i;
+
+			for ( i = 0; i < num_layers; ++i ) {
+				if ( music_layers[i].music == music ) {
+					layer_internal_halt(i);
+				}
 			}
 		}
-		SDL_UnlockAudio();
+		music_unlock();
 		switch (music->type) {
 #ifdef CMD_MUSIC
 			case MUS_CMD:
@@ -852,11 +1288,11 @@ Mix_MusicType Mix_GetMusicType(const Mix_Music *music)
 	if ( music ) {
 		type = music->type;
 	} else {
-		SDL_LockAudio();
+		music_lock();
 		if ( music_playing ) {
 			type = music_playing->type;
 		}
-		SDL_UnlockAudio();
+		music_unlock();
 	}
 	return(type);
 }
@@ -1009,12 +1445,17 @@ int Mix_FadeInMusicPos(Mix_Music *music, int loops, int ms, double position)
 	music->fade_steps = ms/ms_per_step;
 
 	/* Play the puppy */
-	SDL_LockAudio();
+	music_lock();
+	if ( music_layer_of(music) >= 0 ) {
+		music_unlock();
+		Mix_SetError("Music is already playing on a layer");
+		return(-1);
+	}
 	/* If the current music is fading out, wait for the fade to complete */
 	while ( music_playing && (music_playing->fading == MIX_FADING_OUT) ) {
-		SDL_UnlockAudio();
+		music_unlock();
 		SDL_Delay(100);
-		SDL_LockAudio();
+		music_lock();
 	}
 	music_active = 1;
 	if (loops == 1) {
@@ -1023,7 +1464,8 @@ int Mix_FadeInMusicPos(Mix_Music *music, int loops, int ms, double position)
 	}
 	music_loops = loops;
 	retval = music_internal_play(music, position);
-	SDL_UnlockAudio();
+	music_ring_flush();
+	music_unlock();
 
 	return(retval);
 }
@@ -1036,44 +1478,44 @@ int Mix_PlayMusic(Mix_Music *music, int loops)
 	return Mix_FadeInMusicPos(music, loops, 0, 0.0);
 }
 
-/* Set the playing music position */
-int music_internal_position(double position)
+/* Set the position of a music */
+static int music_internal_seek(Mix_Music *music, double position)
 {
 	int retval = 0;
 
-	switch (music_playing->type) {
+	switch (music->type) {
 #ifdef MODPLUG_MUSIC
 	    case MUS_MODPLUG:
-		modplug_jump_to_time(music_playing->data.modplug, position);
+		modplug_jump_to_time(music->data.modplug, position);
 		break;
 #endif
 #ifdef MOD_MUSIC
 	    case MUS_MOD:
-		MOD_jump_to_time(music_playing->data.module, position);
+		MOD_jump_to_time(music->data.module, position);
 		break;
 #endif
 #ifdef OGG_MUSIC
 	    case MUS_OGG:
-		OGG_jump_to_time(music_playing->data.ogg, position);
+		OGG_jump_to_time(music->data.ogg, position);
 		break;
 #endif
 #ifdef FLAC_MUSIC
 	    case MUS_FLAC:
-		FLAC_jump_to_time(music_playing->data.flac, position);
+		FLAC_jump_to_time(music->data.flac, position);
 		break;
 #endif
 #ifdef MP3_MUSIC
 	    case MUS_MP3:
-		smpeg.SMPEG_rewind(music_playing->data.mp3);
-		smpeg.SMPEG_play(music_playing->data.mp3);
+		smpeg.SMPEG_rewind(music->data.mp3);
+		smpeg.SMPEG_play(music->data.mp3);
 		if ( position > 0.0 ) {
-			smpeg.SMPEG_skip(music_playing->data.mp3, (float)position);
+			smpeg.SMPEG_skip(music->data.mp3, (float)position);
 		}
 		break;
 #endif
 #ifdef MP3_MAD_MUSIC
 	    case MUS_MP3_MAD:
-		mad_seek(music_playing->data.mp3_mad, position);
+		mad_seek(music->data.mp3_mad, position);
 		break;
 #endif
 	    default:
@@ -1083,21 +1525,29 @@ int music_internal_position(double position)
 	}
 	return(retval);
 }
+
+/* Set the playing music position */
+int music_internal_position(double position)
+{
+	return music_internal_seek(music_playing, position);
+}
 int Mix_SetMusicPosition(double position)
 {
 	int retval;
 
-	SDL_LockAudio();
+	music_lock();
 	if ( music_playing ) {
 		retval = music_internal_position(position);
 		if ( retval < 0 ) {
 			Mix_SetError("Position not implemented for music type");
+		} else {
+			music_ring_flush();
 		}
 	} else {
 		Mix_SetError("Music isn't playing");
 		retval = -1;
 	}
-	SDL_UnlockAudio();
+	music_unlock();
 
 	return(retval);
 }
@@ -1105,7 +1555,7 @@ int Mix_SetMusicPosition(double position)
 /* Set the music's initial volume */
 static void music_internal_initialize_volume(void)
 {
-	if ( music_playing->fading == MIX_FADING_IN ) {
+	if ( music_playing->fading == MIX_FADING_IN && music_internal_external() ) {
 		music_internal_volume(0);
 	} else {
 		music_internal_volume(music_volume);
@@ -1152,7 +1602,7 @@ static void music_internal_volume(int volume)
 #endif
 #ifdef USE_TIMIDITY_MIDI
 		if ( timidity_ok ) {
-			Timidity_SetVolume(volume);
+			Timidity_SetVolume(music_playing->data.midi, volume);
 			return;
 		}
 #endif
@@ -1195,11 +1645,11 @@ int Mix_VolumeMusic(int volume)
 		volume = SDL_MIX_MAXVOLUME;
 	}
 	music_volume = volume;
-	SDL_LockAudio();
+	music_lock();
 	if ( music_playing ) {
 		music_internal_volume(music_volume);
 	}
-	SDL_UnlockAudio();
+	music_unlock();
 	return(prev_volume);
 }
 
@@ -1243,7 +1693,7 @@ static void music_internal_halt(void)
 #endif
 #ifdef USE_TIMIDITY_MIDI
 		if ( timidity_ok ) {
-			Timidity_Stop();
+			Timidity_Stop(music_playing->data.midi);
 			goto skip;
 		}
 #endif
@@ -1280,11 +1730,12 @@ skip:
 }
 int Mix_HaltMusic(void)
 {
-	SDL_LockAudio();
+	music_lock();
 	if ( music_playing ) {
 		music_internal_halt();
+		music_ring_flush();
 	}
-	SDL_UnlockAudio();
+	music_unlock();
 
 	return(0);
 }
@@ -1304,7 +1755,7 @@ int Mix_FadeOutMusic(int ms)
 		return 1;
 	}
 
-	SDL_LockAudio();
+	music_lock();
 	if ( music_playing) {
                 int fade_steps = (ms + ms_per_step - 1)/ms_per_step;
                 if ( music_playing->fading == MIX_NO_FADING ) {
@@ -1325,7 +1776,7 @@ int Mix_FadeOutMusic(int ms)
 		music_playing->fade_steps = fade_steps;
 		retval = 1;
 	}
-	SDL_UnlockAudio();
+	music_unlock();
 
 	return(retval);
 }
@@ -1334,11 +1785,11 @@ Mix_Fading Mix_FadingMusic(void)
 {
 	Mix_Fading fading = MIX_NO_FADING;
 
-	SDL_LockAudio();
+	music_lock();
 	if ( music_playing ) {
 		fading = music_playing->fading;
 	}
-	SDL_UnlockAudio();
+	music_unlock();
 
 	return(fading);
 }
@@ -1364,40 +1815,36 @@ int Mix_PausedMusic(void)
 	return (music_active == 0);
 }
 
-/* Check the status of the music */
-static int music_internal_playing()
+/* Check the status of a music */
+static int music_internal_active(Mix_Music *music)
 {
 	int playing = 1;
 
-	if (music_playing == NULL) {
-		return 0;
-	}
-
-	switch (music_playing->type) {
+	switch (music->type) {
 #ifdef CMD_MUSIC
 	    case MUS_CMD:
-		if (!MusicCMD_Active(music_playing->data.cmd)) {
+		if (!MusicCMD_Active(music->data.cmd)) {
 			playing = 0;
 		}
 		break;
 #endif
 #ifdef WAV_MUSIC
 	    case MUS_WAV:
-		if ( ! WAVStream_Active() ) {
+		if ( ! WAVStream_Playing(music->data.wave) ) {
 			playing = 0;
 		}
 		break;
 #endif
 #ifdef MODPLUG_MUSIC
 	    case MUS_MODPLUG:
-		if ( ! modplug_playing(music_playing->data.modplug) ) {
+		if ( ! modplug_playing(music->data.modplug) ) {
 			playing = 0;
 		}
 		break;
 #endif
 #ifdef MOD_MUSIC
 	    case MUS_MOD:
-		if ( ! MOD_playing(music_playing->data.module) ) {
+		if ( ! MOD_playing(music->data.module) ) {
 			playing = 0;
 		}
 		break;
@@ -1413,14 +1860,14 @@ static int music_internal_playing()
 #endif
 #ifdef USE_FLUIDSYNTH_MIDI
 		if ( fluidsynth_ok ) {
-			if ( ! fluidsynth_active(music_playing->data.fluidsynthmidi) )
+			if ( ! fluidsynth_active(music->data.fluidsynthmidi) )
 				playing = 0;
 			goto skip;
 		}
 #endif
 #ifdef USE_TIMIDITY_MIDI
 		if ( timidity_ok ) {
-			if ( ! Timidity_Active() )
+			if ( ! Timidity_Active(music->data.midi) )
 				playing = 0;
 			goto skip;
 		}
@@ -1429,27 +1876,27 @@ static int music_internal_playing()
 #endif
 #ifdef OGG_MUSIC
 	    case MUS_OGG:
-		if ( ! OGG_playing(music_playing->data.ogg) ) {
+		if ( ! OGG_playing(music->data.ogg) ) {
 			playing = 0;
 		}
 		break;
 #endif
 #ifdef FLAC_MUSIC
 	    case MUS_FLAC:
-		if ( ! FLAC_playing(music_playing->data.flac) ) {
+		if ( ! FLAC_playing(music->data.flac) ) {
 			playing = 0;
 		}
 		break;
 #endif
 #ifdef MP3_MUSIC
 	    case MUS_MP3:
-		if ( smpeg.SMPEG_status(music_playing->data.mp3) != SMPEG_PLAYING )
+		if ( smpeg.SMPEG_status(music->data.mp3) != SMPEG_PLAYING )
 			playing = 0;
 		break;
 #endif
 #ifdef MP3_MAD_MUSIC
 	    case MUS_MP3_MAD:
-		if (!mad_isPlaying(music_playing->data.mp3_mad)) {
+		if (!mad_isPlaying(music->data.mp3_mad)) {
 			playing = 0;
 		}
 		break;
@@ -1462,15 +1909,28 @@ static int music_internal_playing()
 skip:
 	return(playing);
 }
+
+/* Check the status of the music */
+static int music_internal_playing()
+{
+	if (music_playing == NULL) {
+		return 0;
+	}
+	return music_internal_active(music_playing);
+}
 int Mix_PlayingMusic(void)
 {
 	int playing = 0;
 
-	SDL_LockAudio();
+	music_lock();
 	if ( music_playing ) {
 		playing = music_loops || music_internal_playing();
 	}
-	SDL_UnlockAudio();
+	/* Music decoded ahead is still playing after the decoder finishes */
+	if ( music_ring && music_ring_queued(music_ring) > 0 ) {
+		playing = 1;
+	}
+	music_unlock();
 
 	return(playing);
 }
@@ -1506,10 +1966,670 @@ int Mix_GetSynchroValue(void)
 }
 
 
-/* Uninitialize the music players */
-void close_music(void)
+/* Only music types that keep all of their playback state in the song
+   can be played on a layer, alongside other music.
+ */
+static int layer_internal_supported(Mix_Music *music)
 {
-	Mix_HaltMusic();
+	switch (music->type) {
+#ifdef WAV_MUSIC
+	    case MUS_WAV:
+		return(1);
+#endif
+#ifdef MODPLUG_MUSIC
+	    case MUS_MODPLUG:
+		return(1);
+#endif
+#ifdef OGG_MUSIC
+	    case MUS_OGG:
+		return(1);
+#endif
+#ifdef FLAC_MUSIC
+	    case MUS_FLAC:
+		return(1);
+#endif
+#ifdef MP3_MUSIC
+	    case MUS_MP3:
+		return(1);
+#endif
+#ifdef MP3_MAD_MUSIC
+	    case MUS_MP3_MAD:
+		return(1);
+#endif
+#if defined(MID_MUSIC) && defined(USE_TIMIDITY_MIDI)
+	    case MUS_MID:
+		/* Each Timidity song has its own voices and mixing buffers */
+#ifdef USE_NATIVE_MIDI
+		if ( native_midi_ok ) {
+			return(0);
+		}
+#endif
+#ifdef USE_FLUIDSYNTH_MIDI
+		if ( fluidsynth_ok ) {
+			return(0);
+		}
+#endif
+		return(timidity_ok);
+#endif
+	    default:
+		return(0);
+	}
+}
+
+/* Start a layer's music from the beginning */
+static void layer_internal_start(Mix_Music *music)
+{
+	switch (music->type) {
+#ifdef WAV_MUSIC
+	    case MUS_WAV:
+		WAVStream_Rewind(music->data.wave);
+		break;
+#endif
+#ifdef MODPLUG_MUSIC
+	    case MUS_MODPLUG:
+		modplug_play(music->data.modplug);
+		break;
+#endif
+#ifdef OGG_MUSIC
+	    case MUS_OGG:
+		OGG_play(music->data.ogg);
+		break;
+#endif
+#ifdef FLAC_MUSIC
+	    case MUS_FLAC:
+		FLAC_play(music->data.flac);
+		break;
+#endif
+#ifdef MP3_MUSIC
+	    case MUS_MP3:
+		smpeg.SMPEG_enableaudio(music->data.mp3,1);
+		smpeg.SMPEG_enablevideo(music->data.mp3,0);
+		smpeg.SMPEG_play(music->data.mp3);
+		break;
+#endif
+#ifdef MP3_MAD_MUSIC
+	    case MUS_MP3_MAD:
+		mad_start(music->data.mp3_mad);
+		break;
+#endif
+#if defined(MID_MUSIC) && defined(USE_TIMIDITY_MIDI)
+	    case MUS_MID:
+		Timidity_Start(music->data.midi);
+		break;
+#endif
+	    default:
+		break;
+	}
+	music_internal_seek(music, 0.0);
+}
+
+/* Set the volume a layer is mixed at */
+static void layer_internal_volume(MusicLayer *layer, int volume)
+{
+	Mix_Music *music = layer->music;
+
+	layer->mix_volume = volume;
+	switch (music->type) {
+#ifdef MODPLUG_MUSIC
+	    case MUS_MODPLUG:
+		modplug_setvolume(music->data.modplug, volume);
+		break;
+#endif
+#ifdef OGG_MUSIC
+	    case MUS_OGG:
+		OGG_setvolume(music->data.ogg, volume);
+		break;
+#endif
+#ifdef FLAC_MUSIC
+	    case MUS_FLAC:
+		FLAC_setvolume(music->data.flac, volume);
+		break;
+#endif
+#ifdef MP3_MUSIC
+	    case MUS_MP3:
+		smpeg.SMPEG_setvolume(music->data.mp3,(int)(((float)volume/(float)MIX_MAX_VOLUME)*100.0));
+		break;
+#endif
+#ifdef MP3_MAD_MUSIC
+	    case MUS_MP3_MAD:
+		mad_setVolume(music->data.mp3_mad, volume);
+		break;
+#endif
+#if defined(MID_MUSIC) && defined(USE_TIMIDITY_MIDI)
+	    case MUS_MID:
+		Timidity_SetVolume(music->data.midi, volume);
+		break;
+#endif
+	    default:
+		/* WAV streams are mixed at mix_volume */
+		break;
+	}
+}
+
+/* Decode some of a layered song into a silent buffer, returning the bytes
+   left over.  Most decoders write over what's there, so this is never
+   the stream itself.  Only WAV streams are mixed at 'volume', the others
+   at the volume last set on the song.
+ */
+static int layer_internal_mix(Mix_Music *music, Uint8 *stream, int len, int volume)
+{
+	int left = len;
+
+	switch (music->type) {
+#ifdef WAV_MUSIC
+	    case MUS_WAV:
+		left = WAVStream_MixSome(music->data.wave, stream, len, volume);
+		break;
+#endif
+#ifdef MODPLUG_MUSIC
+	    case MUS_MODPLUG:
+		left = modplug_playAudio(music->data.modplug, stream, len);
+		break;
+#endif
+#ifdef OGG_MUSIC
+	    case MUS_OGG:
+		left = OGG_playAudio(music->data.ogg, stream, len);
+		break;
+#endif
+#ifdef FLAC_MUSIC
+	    case MUS_FLAC:
+		left = FLAC_playAudio(music->data.flac, stream, len);
+		break;
+#endif
+#ifdef MP3_MUSIC
+	    case MUS_MP3:
+		left = (len - smpeg.SMPEG_playAudio(music->data.mp3, stream, len));
+		break;
+#endif
+#ifdef MP3_MAD_MUSIC
+	    case MUS_MP3_MAD:
+		left = mad_getSamples(music->data.mp3_mad, stream, len);
+		break;
+#endif
+#if defined(MID_MUSIC) && defined(USE_TIMIDITY_MIDI)
+	    case MUS_MID:
+		Timidity_PlaySome(music->data.midi, stream, len / samplesize);
+		left = 0;
+		break;
+#endif
+	    default:
+		break;
+	}
+	return(left);
+}
+
+/* Stop a layer, called with the music lock held */
+static void layer_internal_halt(int which)
+{
+	Mix_Music *music = music_layers[which].music;
+
+	switch (music->type) {
+#ifdef MODPLUG_MUSIC
+	    case MUS_MODPLUG:
+		modplug_stop(music->data.modplug);
+		break;
+#endif
+#ifdef OGG_MUSIC
+	    case MUS_OGG:
+		OGG_stop(music->data.ogg);
+		break;
+#endif
+#ifdef FLAC_MUSIC
+	    case MUS_FLAC:
+		FLAC_stop(music->data.flac);
+		break;
+#endif
+#ifdef MP3_MUSIC
+	    case MUS_MP3:
+		smpeg.SMPEG_stop(music->data.mp3);
+		break;
+#endif
+#ifdef MP3_MAD_MUSIC
+	    case MUS_MP3_MAD:
+		mad_stop(music->data.mp3_mad);
+		break;
+#endif
+#if defined(MID_MUSIC) && defined(USE_TIMIDITY_MIDI)
+	    case MUS_MID:
+		Timidity_Stop(music->data.midi);
+		break;
+#endif
+	    default:
+		/* WAV streams are just no longer read */
+		break;
+	}
+	music->fading = MIX_NO_FADING;
+	music_layers[which].music = NULL;
+}
+
+/* A layer has finished playing */
+static void layer_internal_finished(int which)
+{
+	layer_internal_halt(which);
+	if ( layer_finished_hook ) {
+		layer_finished_hook(which);
+	}
+}
+
+/* Find the layer a music is playing on, or -1 */
+static int music_layer_of(Mix_Music *music)
+{
+	int i;
+
+	for ( i = 0; i < num_layers; ++i ) {
+		if ( music_layers[i].music == music ) {
+			return(i);
+		}
+	}
+	return(-1);
+}
+
+static int music_layers_playing(void)
+{
+	int i, playing = 0;
+
+	for ( i = 0; i < num_layers; ++i ) {
+		if ( music_layers[i].music ) {
+			++playing;
+		}
+	}
+	return(playing);
+}
+
+/* Mix one layer into the stream, fading and looping it as the music is.
+   The layer is decoded on its own, ramped if it's fading, then mixed in.
+ */
+static void music_layer_mix(int which, Uint8 *stream, int len)
+{
+	MusicLayer *layer = &music_layers[which];
+	Mix_Music *music = layer->music;
+	int fade_from = MIX_MAX_VOLUME, fade_to = MIX_MAX_VOLUME;
+	int finished = 0, left, size = len;
+	Uint8 *out = music_layer_buf, *p;
+
+	/* Handle fading */
+	if ( music->fading != MIX_NO_FADING ) {
+		if ( music->fade_step < music->fade_steps ) {
+			fade_from = music_fade_volume(music);
+			++music->fade_step;
+			fade_to = music_fade_volume(music);
+		} else {
+			if ( music->fading == MIX_FADING_OUT ) {
+				layer_internal_finished(which);
+				return;
+			}
+			music->fading = MIX_NO_FADING;
+			layer_internal_volume(layer, layer->volume);
+		}
+	}
+
+	memset(out, music_silence, len);
+	p = out;
+	while ( len > 0 ) {
+		if ( !music_internal_active(music) ) {
+			if ( !layer->loops ) {
+				finished = 1;
+				break;
+			}
+			--layer->loops;
+			layer_internal_start(music);
+		}
+		left = layer_internal_mix(music, p, len, layer->mix_volume);
+		if ( left >= len ) {
+			/* Nothing was decoded, try again next time */
+			break;
+		}
+		p += (len - left);
+		len = left;
+	}
+
+	if ( fade_from != MIX_MAX_VOLUME || fade_to != MIX_MAX_VOLUME ) {
+		_Mix_RampVolume(music_format, music_channels, out, size, fade_from, fade_to);
+	}
+	SDL_MixAudio(stream, out, size, MIX_MAX_VOLUME);
+	if ( finished ) {
+		layer_internal_finished(which);
+	}
+}
+
+/* Mix the playing layers into the stream, called with the music lock held */
+static void music_layers_mix(Uint8 *stream, int len)
+{
+	int i;
+
+	if ( !music_active ) {
+		return;
+	}
+	for ( i = 0; i < num_layers; ++i ) {
+		if ( music_layers[i].music ) {
+			music_layer_mix(i, stream, len);
+		}
+	}
+}
+
+int Mix_AllocateMusicLayers(int numlayers)
+{
+	int i;
+
+	if ( numlayers < 0 || numlayers == num_layers ) {
+		return(num_layers);
+	}
+	music_lock();
+	for ( i = numlayers; i < num_layers; ++i ) {
+		if ( music_layers[i].music ) {
+			layer_internal_halt(i);
+		}
+	}
+	if ( numlayers == 0 ) {
+		SDL_free(music_layers);
+		music_layers = NULL;
+	} else {
+		MusicLayer *layers;
+
+		layers = (MusicLayer *)SDL_realloc(music_layers,
+					numlayers * sizeof(*music_layers));
+		if ( layers == NULL ) {
+			music_unlock();
+			SDL_OutOfMemory();
+			return(num_layers);
+		}
+		for ( i = num_layers; i < numlayers; ++i ) {
+			layers[i].music = NULL;
+			layers[i].loops = 0;
+			layers[i].volume = MIX_MAX_VOLUME;
+			layers[i].mix_volume = MIX_MAX_VOLUME;
+		}
+		music_layers = layers;
+	}
+	num_layers = numlayers;
+	music_unlock();
+	return(num_layers);
+}
+
+int Mix_FadeInMusicLayerPos(int layer, Mix_Music *music, int loops, int ms, double position)
+{
+	MusicLayer *l;
+
+	if ( ms_per_step == 0 ) {
+		SDL_SetError("Audio device hasn't been opened");
+		return(-1);
+	}
+	if ( music_layer_buf == NULL ) {
+		Mix_SetError("Out of memory");
+		return(-1);
+	}
+	if ( music == NULL ) {
+		Mix_SetError("music parameter was NULL");
+		return(-1);
+	}
+	if ( !layer_internal_supported(music) ) {
+		Mix_SetError("Music type can't be played on a layer");
+		return(-1);
+	}
+
+	music_lock();
+	if ( music == music_playing || music_layer_of(music) >= 0 ) {
+		music_unlock();
+		Mix_SetError("Music is already playing");
+		return(-1);
+	}
+	if ( layer == -1 ) {
+		for ( layer = 0; layer < num_layers; ++layer ) {
+			if ( music_layers[layer].music == NULL ) {
+				break;
+			}
+		}
+		if ( layer == num_layers ) {
+			music_unlock();
+			Mix_SetError("No free music layers available");
+			return(-1);
+		}
+	} else if ( layer < 0 || layer >= num_layers ) {
+		music_unlock();
+		Mix_SetError("Invalid music layer");
+		return(-1);
+	}
+	l = &music_layers[layer];
+	if ( l->music ) {
+		layer_internal_halt(layer);
+	}
+
+	if ( ms ) {
+		music->fading = MIX_FADING_IN;
+	} else {
+		music->fading = MIX_NO_FADING;
+	}
+	music->fade_step = 0;
+	music->fade_steps = ms/ms_per_step;
+	if (loops == 1) {
+		/* Loop is the number of times to play the audio */
+		loops = 0;
+	}
+	l->loops = loops;
+	l->music = music;
+	layer_internal_start(music);
+	layer_internal_volume(l, l->volume);
+	if ( position > 0.0 && music_internal_seek(music, position) < 0 ) {
+		layer_internal_halt(layer);
+		music_unlock();
+		Mix_SetError("Position not implemented for music type");
+		return(-1);
+	}
+	music_unlock();
+
+	return(layer);
+}
+
+int Mix_VolumeMusicLayer(int layer, int volume)
+{
+	int i, prev_volume = 0;
+
+	if ( layer == -1 ) {
+		if ( num_layers == 0 ) {
+			return(MIX_MAX_VOLUME);
+		}
+		for ( i = 0; i < num_layers; ++i ) {
+			prev_volume += Mix_VolumeMusicLayer(i, volume);
+		}
+		return(prev_volume / num_layers);
+	}
+	if ( layer < 0 || layer >= num_layers ) {
+		return(0);
+	}
+
+	music_lock();
+	prev_volume = music_layers[layer].volume;
+	if ( volume >= 0 ) {
+		if ( volume > SDL_MIX_MAXVOLUME ) {
+			volume = SDL_MIX_MAXVOLUME;
+		}
+		music_layers[layer].volume = volume;
+		if ( music_layers[layer].music ) {
+			layer_internal_volume(&music_layers[layer], volume);
+		}
+	}
+	music_unlock();
+	return(prev_volume);
+}
+
+int Mix_FadeOutMusicLayer(int layer, int ms)
+{
+	Mix_Music *music;
+	int i, fade_steps, faded = 0;
+
+	if ( ms_per_step == 0 ) {
+		SDL_SetError("Audio device hasn't been opened");
+		return(0);
+	}
+	if ( layer == -1 ) {
+		for ( i = 0; i < num_layers; ++i ) {
+			faded += Mix_FadeOutMusicLayer(i, ms);
+		}
+		return(faded);
+	}
+	if ( layer < 0 || layer >= num_layers ) {
+		return(0);
+	}
+	if ( ms <= 0 ) {  /* just halt immediately. */
+		Mix_HaltMusicLayer(layer);
+		return(1);
+	}
+
+	music_lock();
+	music = music_layers[layer].music;
+	if ( music ) {
+		fade_steps = (ms + ms_per_step - 1)/ms_per_step;
+		if ( music->fading == MIX_NO_FADING ) {
+			music->fade_step = 0;
+		} else {
+			int step;
+			int old_fade_steps = music->fade_steps;
+			if ( music->fading == MIX_FADING_OUT ) {
+				step = music->fade_step;
+			} else {
+				step = old_fade_steps - music->fade_step + 1;
+			}
+			music->fade_step = (step * fade_steps) / old_fade_steps;
+		}
+		music->fading = MIX_FADING_OUT;
+		music->fade_steps = fade_steps;
+		faded = 1;
+	}
+	music_unlock();
+
+	return(faded);
+}
+
+int Mix_HaltMusicLayer(int layer)
+{
+	int i;
+
+	music_lock();
+	for ( i = 0; i < num_layers; ++i ) {
+		if ( (layer == -1 || layer == i) && music_layers[i].music ) {
+			layer_internal_halt(i);
+		}
+	}
+	music_unlock();
+
+	return(0);
+}
+
+int Mix_SetMusicLayerPosition(int layer, double position)
+{
+	int retval = -1;
+
+	music_lock();
+	if ( layer < 0 || layer >= num_layers || !music_layers[layer].music ) {
+		Mix_SetError("Music layer isn't playing");
+	} else if ( music_internal_seek(music_layers[layer].music, position) < 0 ) {
+		Mix_SetError("Position not implemented for music type");
+	} else {
+		retval = 0;
+	}
+	music_unlock();
+
+	return(retval);
+}
+
+int Mix_PlayingMusicLayer(int layer)
+{
+	int playing = 0;
+
+	music_lock();
+	if ( layer == -1 ) {
+		playing = music_layers_playing();
+	} else if ( layer >= 0 && layer < num_layers ) {
+		playing = (music_layers[layer].music != NULL);
+	}
+	music_unlock();
+
+	return(playing);
+}
+
+Mix_Fading Mix_FadingMusicLayer(int layer)
+{
+	Mix_Fading fading = MIX_NO_FADING;
+
+	music_lock();
+	if ( layer >= 0 && layer < num_layers && music_layers[layer].music ) {
+		fading = music_layers[layer].music->fading;
+	}
+	music_unlock();
+
+	return(fading);
+}
+
+void Mix_HookMusicLayerFinished(void (*layer_finished)(int layer))
+{
+	music_lock();
+	layer_finished_hook = layer_finished;
+	music_unlock();
+}
+
+
+/* Streamed chunks are songs of the same types as layers, owned by the
+   chunk and decoded by the mixer as a channel plays them.  They're never
+   the music or on a layer, so they need no music lock.
+ */
+Mix_Music *music_stream_open(SDL_RWops *src, int freesrc)
+{
+	Mix_Music *music;
+
+	music = Mix_LoadMUSType_RW(src, MUS_NONE, freesrc);
+	if ( music && !layer_internal_supported(music) ) {
+		Mix_FreeMusic(music);
+		Mix_SetError("Sound type can't be streamed");
+		music = NULL;
+	}
+	return(music);
+}
+
+void music_stream_rewind(Mix_Music *music)
+{
+	layer_internal_start(music);
+}
+
+/* Decode up to len bytes of a streamed chunk into buf, returning the
+   number of bytes decoded, which is less than len at the end.
+ */
+int music_stream_read(Mix_Music *music, Uint8 *buf, int len)
+{
+	int left = len;
+
+	memset(buf, music_silence, len);
+	while ( left > 0 && music_internal_active(music) ) {
+		int more = layer_internal_mix(music, buf + (len - left), left, MIX_MAX_VOLUME);
+		if ( more >= left ) {
+			break;
+		}
+		left = more;
+	}
+	return(len - left);
+}
+
+void music_stream_close(Mix_Music *music)
+{
+	Mix_FreeMusic(music);
+}
+
+
+/* Uninitialize the music players */
+void close_music(void)
+{
+	Mix_HaltMusic();
+	Mix_AllocateMusicLayers(0);
+	SDL_free(music_layer_buf);
+	music_layer_buf = NULL;
+	if ( music_mutex ) {
+		music_stop_thread();
+		SDL_DestroyMutex(music_mutex);
+		music_mutex = NULL;
+	}
+	if ( music_sem ) {
+		SDL_DestroySemaphore(music_sem);
+		music_sem = NULL;
+	}
 #ifdef CMD_MUSIC
 	Mix_SetMusicCMD(NULL);
 #endif
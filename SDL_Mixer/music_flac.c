@@ -468,6 +468,7 @@ static void FLAC_getsome(FLAC_music *music)
 		SDL_BuildAudioCVT (cvt, AUDIO_S16, (Uint8)music->flac_data.channels,
 						(int)music->flac_data.sample_rate, mixer.format,
 		                mixer.channels, mixer.freq);
+		cvt->rate_quality = Mix_SetResampleQuality(-1);
 		if (cvt->buf) {
 			free (cvt->buf);
 		}
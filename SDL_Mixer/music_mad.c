@@ -186,6 +186,7 @@ decode_frame(mad_data *mp3_mad) {
 	   In particular, it tells us enough to set up the convert
 	   structure now. */
 	SDL_BuildAudioCVT(&mp3_mad->cvt, AUDIO_S16, pcm->channels, mp3_mad->frame.header.samplerate, mp3_mad->mixer.format, mp3_mad->mixer.channels, mp3_mad->mixer.freq);
+	mp3_mad->cvt.rate_quality = Mix_SetResampleQuality(-1);
   }
 
   /* pcm->samplerate contains the sampling frequency */
@@ -250,9 +251,9 @@ mad_getSamples(mad_data *mp3_mad, Uint8 *stream, int len) {
 		mp3_mad->cvt.buf = mp3_mad->output_buffer;
 		mp3_mad->cvt.len = mp3_mad->output_end;
 		
-		mp3_mad->output_end = (int)(mp3_mad->output_end * mp3_mad->cvt.len_ratio);
-		/*assert(mp3_mad->output_end <= MAD_OUTPUT_BUFFER_SIZE);*/
 		SDL_ConvertAudio(&mp3_mad->cvt);
+		mp3_mad->output_end = mp3_mad->cvt.len_cvt;
+		/*assert(mp3_mad->output_end <= MAD_OUTPUT_BUFFER_SIZE);*/
 	  }
 	}
 
@@ -150,6 +150,7 @@ static void OGG_getsome(OGG_music *music)
 		vi = vorbis.ov_info(&music->vf, -1);
 		SDL_BuildAudioCVT(cvt, AUDIO_S16, vi->channels, vi->rate,
 		                       mixer.format,mixer.channels,mixer.freq);
+		cvt->rate_quality = Mix_SetResampleQuality(-1);
 		if ( cvt->buf ) {
 			SDL_free(cvt->buf);
 		}
@@ -0,0 +1,235 @@
+/*
+  RENDERMID:  Renders MIDI files offline with the SDL mixer's Timidity.
+  Copyright (C) 1997-2012 Sam Lantinga <slouken@libsdl.org>
+
+  This software is provided 'as-is', without any express or implied
+  warranty.  In no event will the authors be held liable for any damages
+  arising from the use of this software.
+
+  Permission is granted to anyone to use this software for any purpose,
+  including commercial applications, and to alter it and redistribute it
+  freely, subject to the following restrictions:
+
+  1. The origin of this software must not be misrepresented; you must not
+     claim that you wrote the original software. If you use this software
+     in a product, an acknowledgment in the product documentation would be
+     appreciated but is not required.
+  2. Altered source versions must be plainly marked as such, and must not be
+     misrepresented as being the original software.
+  3. This notice may not be removed or altered from any source distribution.
+*/
+
+/* $Id$ */
+
+/* Renders each MIDI file as fast as the synth can go, to a WAVE or raw
+   file, and tells how long loading and rendering took.  With no output
+   file the audio is thrown away, which times the synth alone. */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "SDL.h"
+#include "timidity.h"
+
+
+static int SDLCALL null_seek(SDL_RWops *context, int offset, int whence)
+{
+	return 0;
+}
+
+static int SDLCALL null_write(SDL_RWops *context, const void *ptr, int size, int num)
+{
+	return num;
+}
+
+static int SDLCALL null_close(SDL_RWops *context)
+{
+	SDL_FreeRW(context);
+	return 0;
+}
+
+static SDL_RWops *RWFromNull(void)
+{
+	SDL_RWops *rwops = SDL_AllocRW();
+
+	if ( rwops ) {
+		rwops->seek = null_seek;
+		rwops->read = NULL;
+		rwops->write = null_write;
+		rwops->close = null_close;
+	}
+	return rwops;
+}
+
+void Usage(char *argv0)
+{
+	fprintf(stderr, "Usage: %s [-r rate] [-c channels] [-8] [-f32] [-b frames] [-p voices] [-cubic] [-t threads] [-n passes] [-raw] [-o outfile] <midifile>...\n", argv0);
+}
+
+int main(int argc, char *argv[])
+{
+	SDL_RWops *src, *dst;
+	MidiSong *song;
+	const char *outfile = NULL;
+	int audio_rate = 44100;
+	Uint16 audio_format = AUDIO_S16LSB;
+	int audio_channels = 2;
+	int audio_frames = 1024;
+	int voices = 0;
+	int cubic = 0;
+	int threads = 1;
+	int passes = 1;
+	int raw = 0;
+	int frames = 0;
+	int files = 0;
+	int pass, i;
+	Uint32 start, load, ticks, best;
+	double seconds, total = 0.0;
+
+	/* Check command line usage */
+	for ( i=1; argv[i] && (*argv[i] == '-'); ++i ) {
+		if ( (strcmp(argv[i], "-r") == 0) && argv[i+1] ) {
+			++i;
+			audio_rate = atoi(argv[i]);
+		} else
+		if ( (strcmp(argv[i], "-c") == 0) && argv[i+1] ) {
+			++i;
+			audio_channels = atoi(argv[i]);
+		} else
+		if ( strcmp(argv[i], "-8") == 0 ) {
+			audio_format = AUDIO_U8;
+		} else
+		if ( strcmp(argv[i], "-f32") == 0 ) {
+			audio_format = AUDIO_F32LSB;
+		} else
+		if ( (strcmp(argv[i], "-b") == 0) && argv[i+1] ) {
+			++i;
+			audio_frames = atoi(argv[i]);
+		} else
+		if ( (strcmp(argv[i], "-p") == 0) && argv[i+1] ) {
+			++i;
+			voices = atoi(argv[i]);
+		} else
+		if ( strcmp(argv[i], "-cubic") == 0 ) {
+			cubic = 1;
+		} else
+		if ( (strcmp(argv[i], "-t") == 0) && argv[i+1] ) {
+			++i;
+			threads = atoi(argv[i]);
+		} else
+		if ( (strcmp(argv[i], "-n") == 0) && argv[i+1] ) {
+			++i;
+			passes = atoi(argv[i]);
+		} else
+		if ( strcmp(argv[i], "-raw") == 0 ) {
+			raw = 1;
+		} else
+		if ( (strcmp(argv[i], "-o") == 0) && argv[i+1] ) {
+			++i;
+			outfile = argv[i];
+		} else {
+			Usage(argv[0]);
+			return(1);
+		}
+	}
+	if ( ! argv[i] || (outfile && argv[i+1]) || passes < 1 ) {
+		Usage(argv[0]);
+		return(1);
+	}
+
+	/* Initialize the SDL library, for its timer */
+	if ( SDL_Init(0) < 0 ) {
+		fprintf(stderr, "Couldn't initialize SDL: %s\n",SDL_GetError());
+		return(255);
+	}
+	if ( Timidity_Init(audio_rate, audio_format, audio_channels, audio_frames) < 0 ) {
+		fprintf(stderr, "Couldn't initialize Timidity: %s\n", Timidity_Error());
+		SDL_Quit();
+		return(2);
+	}
+
+	while (argv[i]) {
+		src = SDL_RWFromFile(argv[i], "rb");
+		song = src ? Timidity_LoadSong_RW(src, 1) : NULL;
+		if ( song == NULL ) {
+			fprintf(stderr, "Couldn't load %s: %s\n", argv[i],
+				src ? Timidity_Error() : SDL_GetError());
+			Timidity_Close();
+			SDL_Quit();
+			return(2);
+		}
+		if ( voices ) {
+			Timidity_SetVoices(song, voices);
+		}
+		Timidity_SetInterpolation(song, cubic ?
+			TIMIDITY_INTERP_CUBIC : TIMIDITY_INTERP_LINEAR);
+		Timidity_SetThreads(song, threads);
+
+		/* Only the first pass is kept, the rest are for timing */
+		best = 0;
+		for ( pass=0; pass < passes; ++pass ) {
+			if ( outfile && pass == 0 ) {
+				dst = SDL_RWFromFile(outfile, "wb");
+			} else {
+				dst = RWFromNull();
+			}
+			if ( dst == NULL ) {
+				fprintf(stderr, "Couldn't open %s: %s\n",
+					outfile, SDL_GetError());
+				Timidity_FreeSong(song);
+				Timidity_Close();
+				SDL_Quit();
+				return(2);
+			}
+
+			/* Starting a song loads the instruments it uses */
+			start = SDL_GetTicks();
+			Timidity_Start(song);
+			load = SDL_GetTicks() - start;
+			if ( pass == 0 ) {
+				printf("%s: instruments loaded in %.3f s\n",
+					argv[i], load / 1000.0);
+			}
+
+			start = SDL_GetTicks();
+			frames = Timidity_RenderSong(song, dst, !raw);
+			ticks = SDL_GetTicks() - start;
+			SDL_RWclose(dst);
+			if ( frames < 0 ) {
+				fprintf(stderr, "Couldn't render %s: %s\n",
+					argv[i], Timidity_Error());
+				Timidity_FreeSong(song);
+				Timidity_Close();
+				SDL_Quit();
+				return(3);
+			}
+			if ( pass == 0 || ticks < best ) {
+				best = ticks;
+			}
+		}
+		Timidity_FreeSong(song);
+
+		seconds = (double)frames / audio_rate;
+		total += best / 1000.0;
+		printf("%s: %.1f s of audio rendered in %.3f s", argv[i],
+			seconds, best / 1000.0);
+		if ( passes > 1 ) {
+			printf(" (best of %d)", passes);
+		}
+		if ( best ) {
+			printf(", %.1fx realtime, %.0f frames/s",
+				seconds * 1000.0 / best, frames * 1000.0 / best);
+		}
+		printf("\n");
+		++files;
+		++i;
+	}
+	if ( files > 1 ) {
+		printf("Total render time %.3f s\n", total);
+	}
+
+	Timidity_Close();
+	SDL_Quit();
+	return(0);
+}
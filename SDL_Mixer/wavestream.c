@@ -86,7 +86,7 @@ typedef struct Chunk {
 #define COMM		0x4d4d4f43		/* "COMM" */
 
 
-/* Currently we only support a single stream at a time */
+/* The stream played as the music; music layers play theirs directly */
 static WAVStream *music = NULL;
 
 /* This is the format of the audio mixer data */
@@ -150,6 +150,8 @@ WAVStream *WAVStream_LoadSong_RW(SDL_RWops *rw, const char *magic, int freerw)
 		SDL_BuildAudioCVT(&wave->cvt,
 			wavespec.format, wavespec.channels, wavespec.freq,
 			mixer.format, mixer.channels, mixer.freq);
+		wave->cvt.rate_quality = Mix_SetResampleQuality(-1);
+		wave->framesize = ((wavespec.format & 0xFF)/8)*wavespec.channels;
 	} else {
 		SDL_OutOfMemory();
 		if ( freerw ) {
@@ -164,50 +166,83 @@ WAVStream *WAVStream_LoadSong_RW(SDL_RWops *rw, const char *magic, int freerw)
 void WAVStream_Start(WAVStream *wave)
 {
 	SDL_RWseek (wave->rw, wave->start, RW_SEEK_SET);
+	wave->cvt_left = 0;
 	music = wave;
 }
 
-/* Play some of a stream previously started with WAVStream_Start() */
-int WAVStream_PlaySome(Uint8 *stream, int len)
+/* Rewind a stream to its beginning */
+void WAVStream_Rewind(WAVStream *wave)
+{
+	SDL_RWseek (wave->rw, wave->start, RW_SEEK_SET);
+	wave->cvt_left = 0;
+}
+
+/* Mix some of a stream into the output at the given volume */
+int WAVStream_MixSome(WAVStream *music, Uint8 *stream, int len, int volume)
 {
 	long pos;
 	int left = 0;
 
-	if ( music && ((pos=SDL_RWtell(music->rw)) < music->stop) ) {
+	/* Converted audio may be left over after the end of the file */
+	if ( music && (music->cvt_left > 0 ||
+	               (pos=SDL_RWtell(music->rw)) < music->stop) ) {
 		if ( music->cvt.needed ) {
-			int original_len;
+			int original_len, mixed;
 
 			original_len=(int)((double)len/music->cvt.len_ratio);
-			if ( music->cvt.len != original_len ) {
+			/* Whole frames, or rate conversion comes up short */
+			original_len=((original_len+music->framesize-1)/
+			              music->framesize)*music->framesize;
+			if ( music->cvt_size < original_len ) {
 				int worksize;
-				if ( music->cvt.buf != NULL ) {
-					SDL_free(music->cvt.buf);
-				}
+				Uint8 *buf;
 				worksize = original_len*music->cvt.len_mult;
-				music->cvt.buf=(Uint8 *)SDL_malloc(worksize);
-				if ( music->cvt.buf == NULL ) {
+				buf=(Uint8 *)SDL_realloc(music->cvt.buf, worksize);
+				if ( buf == NULL ) {
 					return 0;
 				}
-				music->cvt.len = original_len;
-			}
-			if ( (music->stop - pos) < original_len ) {
-				left = (original_len - (music->stop - pos));
-				original_len -= left;
-				left = (int)((double)left*music->cvt.len_ratio);
+				music->cvt.buf = buf;
+				music->cvt_size = original_len;
 			}
-			original_len = SDL_RWread(music->rw, music->cvt.buf,1,original_len);
-			/* At least at the time of writing, SDL_ConvertAudio()
-			   does byte-order swapping starting at the end of the
-			   buffer. Thus, if we are reading 16-bit samples, we
-			   had better make damn sure that we get an even
-			   number of bytes, or we'll get garbage.
-			 */
-			if ( (music->cvt.src_format & 0x0010) && (original_len & 1) ) {
-				original_len--;
+
+			/* Rate conversion may come out a frame long or short, so
+			   mix what was left over last time, then convert more */
+			left = len;
+			while ( left > 0 ) {
+				if ( music->cvt_left == 0 ) {
+					pos = SDL_RWtell(music->rw);
+					if ( pos >= music->stop ) {
+						break;
+					}
+					if ( (music->stop - pos) < original_len ) {
+						original_len = (int)(music->stop - pos);
+					}
+					original_len = SDL_RWread(music->rw, music->cvt.buf,1,original_len);
+					/* At least at the time of writing, SDL_ConvertAudio()
+					   does byte-order swapping starting at the end of the
+					   buffer. Thus, if we are reading 16-bit samples, we
+					   had better make damn sure that we get an even
+					   number of bytes, or we'll get garbage.
+					 */
+					if ( (music->cvt.src_format & 0x0010) && (original_len & 1) ) {
+						original_len--;
+					}
+					music->cvt.len = original_len;
+					SDL_ConvertAudio(&music->cvt);
+					music->cvt_pos = 0;
+					music->cvt_left = music->cvt.len_cvt;
+					if ( music->cvt_left <= 0 ) {
+						music->cvt_left = 0;
+						break;
+					}
+				}
+				mixed = (music->cvt_left < left) ? music->cvt_left : left;
+				SDL_MixAudio(stream, music->cvt.buf + music->cvt_pos, mixed, volume);
+				stream += mixed;
+				left -= mixed;
+				music->cvt_pos += mixed;
+				music->cvt_left -= mixed;
 			}
-			music->cvt.len = original_len;
-			SDL_ConvertAudio(&music->cvt);
-			SDL_MixAudio(stream, music->cvt.buf, music->cvt.len_cvt, wavestream_volume);
 		} else {
 			Uint8 *data;
 			if ( (music->stop - pos) < len ) {
@@ -218,7 +253,7 @@ int WAVStream_PlaySome(Uint8 *stream, int len)
 			if (data)
 			{		
 				SDL_RWread(music->rw, data, len, 1);
-				SDL_MixAudio(stream, data, len, wavestream_volume);
+				SDL_MixAudio(stream, data, len, volume);
 				SDL_stack_free(data);
 			}	
 		}
@@ -226,6 +261,12 @@ int WAVStream_PlaySome(Uint8 *stream, int len)
 	return left;
 }
 
+/* Play some of a stream previously started with WAVStream_Start() */
+int WAVStream_PlaySome(Uint8 *stream, int len)
+{
+	return WAVStream_MixSome(music, stream, len, wavestream_volume);
+}
+
 /* Stop playback of a stream previously started with WAVStream_Start() */
 void WAVStream_Stop(void)
 {
@@ -247,18 +288,25 @@ void WAVStream_FreeSong(WAVStream *wave)
 	}
 }
 
-/* Return non-zero if a stream is currently playing */
-int WAVStream_Active(void)
+/* Return non-zero if the given stream has data left to play */
+int WAVStream_Playing(WAVStream *wave)
 {
 	int active;
 
 	active = 0;
-	if ( music && (SDL_RWtell(music->rw) < music->stop) ) {
+	if ( wave && (wave->cvt_left > 0 ||
+	              SDL_RWtell(wave->rw) < wave->stop) ) {
 		active = 1;
 	}
 	return(active);
 }
 
+/* Return non-zero if a stream is currently playing */
+int WAVStream_Active(void)
+{
+	return WAVStream_Playing(music);
+}
+
 static int ReadChunk(SDL_RWops *src, Chunk *chunk, int read_data)
 {
 	chunk->magic	= SDL_ReadLE32(src);
@@ -30,7 +30,11 @@ typedef struct {
 	SDL_bool freerw;
 	long  start;
 	long  stop;
+	int   framesize;
 	SDL_AudioCVT cvt;
+	int   cvt_size;		/* bytes of source cvt.buf has room for */
+	int   cvt_pos;		/* converted audio not mixed yet, kept */
+	int   cvt_left;		/*  as rates don't divide into buffers */
 } WAVStream;
 
 /* Initialize the WAVStream player, with the given mixer settings
@@ -50,6 +54,14 @@ extern void WAVStream_Start(WAVStream *wave);
 /* Play some of a stream previously started with WAVStream_Start() */
 extern int WAVStream_PlaySome(Uint8 *stream, int len);
 
+/* Rewind a stream to its beginning */
+extern void WAVStream_Rewind(WAVStream *wave);
+
+/* Mix some of a stream into the output at the given volume, without it
+   being the current stream.  Returns the number of bytes left unfilled.
+ */
+extern int WAVStream_MixSome(WAVStream *wave, Uint8 *stream, int len, int volume);
+
 /* Stop playback of a stream previously started with WAVStream_Start() */
 extern void WAVStream_Stop(void);
 
@@ -58,3 +70,6 @@ extern void WAVStream_FreeSong(WAVStream *wave);
 
 /* Return non-zero if a stream is currently playing */
 extern int WAVStream_Active(void);
+
+/* Return non-zero if the given stream has data left to play */
+extern int WAVStream_Playing(WAVStream *wave);
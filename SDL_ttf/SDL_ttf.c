@@ -24,18 +24,6 @@
 #include <stdlib.h>
 #include <string.h>
 
-#ifdef HAVE_ALLOCA_H
-#include <alloca.h>
-#endif
-
-#ifdef HAVE_ALLOCA
-#define ALLOCA(n) ((void*)alloca(n))
-#define FREEA(p)
-#else
-#define ALLOCA(n) malloc(n)
-#define FREEA(p) free(p)
-#endif
-
 #include <ft2build.h>
 #include FT_FREETYPE_H
 #include FT_OUTLINE_H
@@ -72,9 +60,32 @@ typedef struct cached_glyph {
 	int maxy;
 	int yoffset;
 	int advance;
-	Uint16 cached;
+	Uint32 cached;		/* code point */
+	Uint32 key;		/* style, outline and hinting it was loaded with */
+	int size;		/* bytes charged against the cache budget */
+	struct cached_glyph *next;	/* hash chain */
+	struct cached_glyph *lru_prev;	/* more recently used */
+	struct cached_glyph *lru_next;	/* less recently used */
 } c_glyph;
 
+/* A glyph placed in a line of text */
+typedef struct positioned_glyph {
+	c_glyph *glyph;
+	int x;
+} p_glyph;
+
+/* Text encodings understood by Layout_Text() */
+#define TEXT_LATIN1	0
+#define TEXT_UTF8	1
+#define TEXT_UNICODE	2
+
+/* Default glyph cache budget per font, in bytes */
+#define GLYPH_CACHE_SIZE	(1024*1024)
+
+/* Initial and maximum hash table sizes, as powers of two */
+#define GLYPH_HASH_MINBITS	6
+#define GLYPH_HASH_MAXBITS	16
+
 /* The structure used to hold internal font information */
 struct _TTF_Font {
 	/* Freetype2 maintains all sorts of useful info itself */
@@ -102,9 +113,28 @@ struct _TTF_Font {
 	int underline_offset;
 	int underline_height;
 
-	/* Cache for style-transformed glyphs */
+	/* Cache for style-transformed glyphs.
+	 * Glyphs are hashed on code point and glyph_key, and kept on a
+	 * list in most recently used order so the oldest ones can be
+	 * dropped when the cache grows past cache_limit bytes.
+	 */
 	c_glyph *current;
-	c_glyph cache[257]; /* 257 is a prime */
+	c_glyph **cache;
+	int cache_bits;
+	int cache_count;
+	int cache_used;
+	int cache_limit;
+	c_glyph *lru_head;
+	c_glyph *lru_tail;
+	Uint32 cache_hits;
+	Uint32 cache_misses;
+	Uint32 glyph_key;
+	int cache_pinned;
+
+	/* Scratch list of the glyphs in the text being rendered */
+	p_glyph *run;
+	int run_len;
+	int run_max;
 
 	/* We are responsible for closing the font stream */
 	SDL_RWops *src;
@@ -116,6 +146,33 @@ struct _TTF_Font {
 	
 	/* really just flags passed into FT_Load_Glyph */
 	int hinting;
+
+	/* Identifies the font's glyphs in shared atlases */
+	Uint32 id;
+};
+
+/* A glyph packed into an atlas, with the metrics needed to lay it out */
+typedef struct atlas_glyph {
+	Uint32 font_id;
+	Uint32 ch;
+	Uint32 key;
+	FT_UInt index;
+	SDL_Rect src;
+	int minx;
+	int yoffset;
+	int advance;
+	struct atlas_glyph *next;
+} a_glyph;
+
+/* A surface that glyphs are packed into, one shelf at a time */
+struct _TTF_Atlas {
+	SDL_Surface *surface;
+	Uint32 pixel;
+	int shelf_x;
+	int shelf_y;
+	int shelf_h;
+	a_glyph **hash;
+	int hash_bits;
 };
 
 /* Handle a style only if the font does not already handle it */
@@ -133,6 +190,7 @@ struct _TTF_Font {
 static FT_Library library;
 static int TTF_initialized = 0;
 static int TTF_byteswapped = 0;
+static Uint32 TTF_font_ids = 0;
 
 
 /* Gets the top row of the underline. The outline
@@ -369,6 +427,14 @@ static unsigned long RWread(
 	return SDL_RWread( src, buffer, 1, (int)count );
 }
 
+static void Update_Glyph_Key( TTF_Font* font )
+{
+	/* Only the settings that change the rendered glyph go in the key */
+	font->glyph_key = (Uint32)(font->style & ~TTF_STYLE_NO_GLYPH_CHANGE);
+	font->glyph_key |= (Uint32)TTF_GetFontHinting( font ) << 4;
+	font->glyph_key |= (Uint32)font->outline << 8;
+}
+
 TTF_Font* TTF_OpenFontIndexRW( SDL_RWops *src, int freesrc, int ptsize, long index )
 {
 	TTF_Font* font;
@@ -516,6 +582,9 @@ TTF_Font* TTF_OpenFontIndexRW( SDL_RWops *src, int freesrc, int ptsize, long ind
 	font->style = font->face_style;
 	font->outline = 0;
 	font->kerning = 1;
+	font->cache_limit = GLYPH_CACHE_SIZE;
+	font->id = ++TTF_font_ids;
+	Update_Glyph_Key( font );
 	font->glyph_overhang = face->size->metrics.y_ppem / 10;
 	/* x offset = cos(((90.0-12)/360)*2*M_PI), or 12 degree angle */
 	font->glyph_italics = 0.207f;
@@ -544,35 +613,115 @@ TTF_Font* TTF_OpenFont( const char *file, int ptsize )
 	return TTF_OpenFontIndex(file, ptsize, 0);
 }
 
-static void Flush_Glyph( c_glyph* glyph )
+static __inline__ int Hash_Glyph( TTF_Font* font, Uint32 ch, Uint32 key )
+{
+	return (int)(((ch ^ (key * 0x9E3779B1)) * 0x9E3779B1) >> (32 - font->cache_bits));
+}
+
+static int Glyph_Size( c_glyph* glyph )
+{
+	int size = sizeof( *glyph );
+
+	if( glyph->bitmap.buffer ) {
+		size += glyph->bitmap.pitch * glyph->bitmap.rows;
+	}
+	if( glyph->pixmap.buffer ) {
+		size += glyph->pixmap.pitch * glyph->pixmap.rows;
+	}
+	return size;
+}
+
+static void Flush_Glyph( TTF_Font* font, c_glyph* glyph )
 {
-	glyph->stored = 0;
-	glyph->index = 0;
+	c_glyph **prev;
+
+	/* Unlink from the hash chain and the LRU list */
+	prev = &font->cache[Hash_Glyph( font, glyph->cached, glyph->key )];
+	while( *prev != glyph ) {
+		prev = &(*prev)->next;
+	}
+	*prev = glyph->next;
+	if( glyph->lru_prev ) {
+		glyph->lru_prev->lru_next = glyph->lru_next;
+	} else {
+		font->lru_head = glyph->lru_next;
+	}
+	if( glyph->lru_next ) {
+		glyph->lru_next->lru_prev = glyph->lru_prev;
+	} else {
+		font->lru_tail = glyph->lru_prev;
+	}
+	if( font->current == glyph ) {
+		font->current = NULL;
+	}
+	font->cache_used -= glyph->size;
+	--font->cache_count;
+
 	if( glyph->bitmap.buffer ) {
 		free( glyph->bitmap.buffer );
-		glyph->bitmap.buffer = 0;
 	}
 	if( glyph->pixmap.buffer ) {
 		free( glyph->pixmap.buffer );
-		glyph->pixmap.buffer = 0;
 	}
-	glyph->cached = 0;
+	free( glyph );
 }
-	
+
 static void Flush_Cache( TTF_Font* font )
 {
-	int i;
-	int size = sizeof( font->cache ) / sizeof( font->cache[0] );
+	while( font->lru_head ) {
+		Flush_Glyph( font, font->lru_head );
+	}
+}
 
-	for( i = 0; i < size; ++i ) {
-		if( font->cache[i].cached ) {
-			Flush_Glyph( &font->cache[i] );
-		}
+/* Drop least recently used glyphs until the cache fits in its budget */
+static void Trim_Cache( TTF_Font* font, int limit )
+{
+	/* Glyphs of the text being laid out must stay put */
+	if( font->cache_pinned ) {
+		return;
+	}
+	while( font->cache_used > limit && font->lru_tail &&
+	       font->lru_tail != font->current ) {
+		Flush_Glyph( font, font->lru_tail );
+	}
+}
+
+/* Let the cache drop glyphs again once a line of text is finished */
+static void Unpin_Cache( TTF_Font* font )
+{
+	font->cache_pinned = 0;
+	Trim_Cache( font, font->cache_limit );
+}
+
+static int Grow_Cache( TTF_Font* font )
+{
+	c_glyph **cache;
+	c_glyph *glyph;
+	int bits;
+	int h;
+
+	bits = font->cache ? font->cache_bits + 1 : GLYPH_HASH_MINBITS;
+	cache = (c_glyph **)malloc( sizeof(*cache) << bits );
+	if( !cache ) {
+		return -1;
+	}
+	memset( cache, 0, sizeof(*cache) << bits );
 
+	/* Rehash everything into the new table */
+	if( font->cache ) {
+		free( font->cache );
 	}
+	font->cache = cache;
+	font->cache_bits = bits;
+	for( glyph = font->lru_head; glyph; glyph = glyph->lru_next ) {
+		h = Hash_Glyph( font, glyph->cached, glyph->key );
+		glyph->next = cache[h];
+		cache[h] = glyph;
+	}
+	return 0;
 }
 
-static FT_Error Load_Glyph( TTF_Font* font, Uint16 ch, c_glyph* cached, int want )
+static FT_Error Load_Glyph( TTF_Font* font, Uint32 ch, c_glyph* cached, int want )
 {
 	FT_Face face;
 	FT_Error error;
@@ -880,25 +1029,78 @@ static FT_Error Load_Glyph( TTF_Font* font, Uint16 ch, c_glyph* cached, int want
 		}
 	}
 
-	/* We're done, mark this glyph cached */
-	cached->cached = ch;
-
 	return 0;
 }
 
-static FT_Error Find_Glyph( TTF_Font* font, Uint16 ch, int want )
+static FT_Error Find_Glyph( TTF_Font* font, Uint32 ch, int want )
 {
 	int retval = 0;
-	int hsize = sizeof( font->cache ) / sizeof( font->cache[0] );
+	Uint32 key = font->glyph_key;
+	c_glyph *glyph;
+	int h;
 
-	int h = ch % hsize;
-	font->current = &font->cache[h];
+	if( !font->cache || (font->cache_count > (1 << font->cache_bits) &&
+	                     font->cache_bits < GLYPH_HASH_MAXBITS) ) {
+		if( Grow_Cache( font ) < 0 && !font->cache ) {
+			return FT_Err_Out_Of_Memory;
+		}
+	}
 
-	if (font->current->cached != ch)
-		Flush_Glyph( font->current );
+	h = Hash_Glyph( font, ch, key );
+	for( glyph = font->cache[h]; glyph; glyph = glyph->next ) {
+		if( glyph->cached == ch && glyph->key == key ) {
+			break;
+		}
+	}
 
-	if ( (font->current->stored & want) != want ) {
-		retval = Load_Glyph( font, ch, font->current, want );
+	if( !glyph ) {
+		glyph = (c_glyph *)malloc( sizeof(*glyph) );
+		if( !glyph ) {
+			return FT_Err_Out_Of_Memory;
+		}
+		memset( glyph, 0, sizeof(*glyph) );
+		glyph->cached = ch;
+		glyph->key = key;
+		glyph->size = sizeof(*glyph);
+		glyph->next = font->cache[h];
+		font->cache[h] = glyph;
+		glyph->lru_next = font->lru_head;
+		font->lru_head = glyph;
+		if( glyph->lru_next ) {
+			glyph->lru_next->lru_prev = glyph;
+		} else {
+			font->lru_tail = glyph;
+		}
+		font->cache_used += glyph->size;
+		++font->cache_count;
+	} else if( glyph != font->lru_head ) {
+		/* Move to the front of the LRU list */
+		glyph->lru_prev->lru_next = glyph->lru_next;
+		if( glyph->lru_next ) {
+			glyph->lru_next->lru_prev = glyph->lru_prev;
+		} else {
+			font->lru_tail = glyph->lru_prev;
+		}
+		glyph->lru_prev = NULL;
+		glyph->lru_next = font->lru_head;
+		font->lru_head->lru_prev = glyph;
+		font->lru_head = glyph;
+	}
+	font->current = glyph;
+
+	if ( (glyph->stored & want) != want ) {
+		++font->cache_misses;
+		retval = Load_Glyph( font, ch, glyph, want );
+		if( !glyph->stored ) {
+			Flush_Glyph( font, glyph );
+			return retval;
+		}
+		font->cache_used -= glyph->size;
+		glyph->size = Glyph_Size( glyph );
+		font->cache_used += glyph->size;
+		Trim_Cache( font, font->cache_limit );
+	} else {
+		++font->cache_hits;
 	}
 	return retval;
 }
@@ -907,6 +1109,12 @@ void TTF_CloseFont( TTF_Font* font )
 {
 	if ( font ) {
 		Flush_Cache( font );
+		if ( font->cache ) {
+			free( font->cache );
+		}
+		if ( font->run ) {
+			free( font->run );
+		}
 		if ( font->face ) {
 			FT_Done_Face( font->face );
 		}
@@ -920,45 +1128,29 @@ void TTF_CloseFont( TTF_Font* font )
 	}
 }
 
-static Uint16 *LATIN1_to_UNICODE(Uint16 *unicode, const char *text, int len)
-{
-	int i;
-
-	for ( i=0; i < len; ++i ) {
-		unicode[i] = ((const unsigned char *)text)[i];
-	}
-	unicode[i] = 0;
-
-	return unicode;
-}
-
-static Uint16 *UTF8_to_UNICODE(Uint16 *unicode, const char *utf8, int len)
+/* Decode one UTF-8 character and advance past it */
+static Uint32 UTF8_getch(const char **utf8)
 {
-	int i, j;
-	Uint16 ch;
-
-	for ( i=0, j=0; i < len; ++i, ++j ) {
-		ch = ((const unsigned char *)utf8)[i];
-		if ( ch >= 0xF0 ) {
-			ch  =  (Uint16)(utf8[i]&0x07) << 18;
-			ch |=  (Uint16)(utf8[++i]&0x3F) << 12;
-			ch |=  (Uint16)(utf8[++i]&0x3F) << 6;
-			ch |=  (Uint16)(utf8[++i]&0x3F);
-		} else
-		if ( ch >= 0xE0 ) {
-			ch  =  (Uint16)(utf8[i]&0x0F) << 12;
-			ch |=  (Uint16)(utf8[++i]&0x3F) << 6;
-			ch |=  (Uint16)(utf8[++i]&0x3F);
-		} else
-		if ( ch >= 0xC0 ) {
-			ch  =  (Uint16)(utf8[i]&0x1F) << 6;
-			ch |=  (Uint16)(utf8[++i]&0x3F);
-		}
-		unicode[j] = ch;
-	}
-	unicode[j] = 0;
-
-	return unicode;
+	const unsigned char *p = (const unsigned char *)*utf8;
+	Uint32 ch = *p++;
+	int left = 0;
+
+	if ( ch >= 0xF0 ) {
+		ch &= 0x07;
+		left = 3;
+	} else if ( ch >= 0xE0 ) {
+		ch &= 0x0F;
+		left = 2;
+	} else if ( ch >= 0xC0 ) {
+		ch &= 0x1F;
+		left = 1;
+	}
+	while ( left-- > 0 && (*p & 0xC0) == 0x80 ) {
+		ch = (ch << 6) | (*p++ & 0x3F);
+	}
+	*utf8 = (const char *)p;
+
+	return ch;
 }
 
 int TTF_FontHeight(const TTF_Font *font)
@@ -1051,60 +1243,19 @@ int TTF_GlyphMetrics(TTF_Font *font, Uint16 ch,
 	return 0;
 }
 
-int TTF_SizeText(TTF_Font *font, const char *text, int *w, int *h)
-{
-	Uint16 *unicode_text;
-	int unicode_len;
-	int status;
-
-	/* Copy the Latin-1 text to a UNICODE text buffer */
-	unicode_len = strlen(text);
-	unicode_text = (Uint16 *)ALLOCA((1+unicode_len+1)*(sizeof *unicode_text));
-	if ( unicode_text == NULL ) {
-		TTF_SetError("Out of memory");
-		return -1;
-	}
-	*unicode_text = UNICODE_BOM_NATIVE;
-	LATIN1_to_UNICODE(unicode_text+1, text, unicode_len);
-
-	/* Render the new text */
-	status = TTF_SizeUNICODE(font, unicode_text, w, h);
-
-	/* Free the text buffer and return */
-	FREEA(unicode_text);
-	return status;
-}
-
-int TTF_SizeUTF8(TTF_Font *font, const char *text, int *w, int *h)
-{
-	Uint16 *unicode_text;
-	int unicode_len;
-	int status;
-
-	/* Copy the UTF-8 text to a UNICODE text buffer */
-	unicode_len = strlen(text);
-	unicode_text = (Uint16 *)ALLOCA((1+unicode_len+1)*(sizeof *unicode_text));
-	if ( unicode_text == NULL ) {
-		TTF_SetError("Out of memory");
-		return -1;
-	}
-	*unicode_text = UNICODE_BOM_NATIVE;
-	UTF8_to_UNICODE(unicode_text+1, text, unicode_len);
-
-	/* Render the new text */
-	status = TTF_SizeUNICODE(font, unicode_text, w, h);
-
-	/* Free the text buffer and return */
-	FREEA(unicode_text);
-	return status;
-}
-
-int TTF_SizeUNICODE(TTF_Font *font, const Uint16 *text, int *w, int *h)
+/* Load the glyphs of a line of text and work out their positions and the
+   size of the text, all in one pass.  The glyphs are left in font->run,
+   and stay in the cache until Unpin_Cache() is called, unless this fails.
+*/
+static int Layout_Text(TTF_Font *font, const void *text, int encoding,
+                       int want, int *w, int *h)
 {
-	int status;
-	const Uint16 *ch;
+	const char *utf8 = (const char *)text;
+	const Uint16 *ucs2 = (const Uint16 *)text;
+	Uint32 c;
 	int swapped;
 	int x, z;
+	int shift;
 	int minx, maxx;
 	int miny, maxy;
 	c_glyph *glyph;
@@ -1118,10 +1269,12 @@ int TTF_SizeUNICODE(TTF_Font *font, const Uint16 *text, int *w, int *h)
 		TTF_SetError( "Library not initialized" );
 		return -1;
 	}
-	status = 0;
 	minx = maxx = 0;
 	miny = maxy = 0;
+	shift = 0;
 	swapped = TTF_byteswapped;
+	font->run_len = 0;
+	font->cache_pinned = 1;
 
 	/* check kerning */
 	use_kerning = FT_HAS_KERNING( font->face ) && font->kerning;
@@ -1133,32 +1286,52 @@ int TTF_SizeUNICODE(TTF_Font *font, const Uint16 *text, int *w, int *h)
 
 	/* Load each character and sum it's bounding box */
 	x= 0;
-	for ( ch=text; *ch; ++ch ) {
-		Uint16 c = *ch;
-		if ( c == UNICODE_BOM_NATIVE ) {
-			swapped = 0;
-			if ( text == ch ) {
-				++text;
+	for ( ; ; ) {
+		if ( encoding == TEXT_UNICODE ) {
+			c = *ucs2++;
+			if ( c == UNICODE_BOM_NATIVE ) {
+				swapped = 0;
+				continue;
 			}
-			continue;
-		}
-		if ( c == UNICODE_BOM_SWAPPED ) {
-			swapped = 1;
-			if ( text == ch ) {
-				++text;
+			if ( c == UNICODE_BOM_SWAPPED ) {
+				swapped = 1;
+				continue;
 			}
-			continue;
+			if ( swapped ) {
+				c = SDL_Swap16((Uint16)c);
+			}
+		} else if ( encoding == TEXT_UTF8 ) {
+			c = UTF8_getch(&utf8);
+			if ( c == UNICODE_BOM_NATIVE ) {
+				continue;
+			}
+		} else {
+			c = *(const unsigned char *)utf8++;
 		}
-		if ( swapped ) {
-			c = SDL_Swap16(c);
+		if ( !c ) {
+			break;
 		}
 
-		error = Find_Glyph(font, c, CACHED_METRICS);
+		error = Find_Glyph(font, c, want);
 		if ( error ) {
+			TTF_SetFTError("Couldn't find glyph", error);
+			Unpin_Cache(font);
 			return -1;
 		}
 		glyph = font->current;
 
+		if ( font->run_len == font->run_max ) {
+			int max = font->run_max ? font->run_max * 2 : 64;
+			p_glyph *run = (p_glyph *)realloc(font->run, max * sizeof(*run));
+			if ( run == NULL ) {
+				TTF_SetError("Out of memory");
+				Unpin_Cache(font);
+				return -1;
+			}
+			font->run = run;
+			font->run_max = max;
+		}
+
 		/* handle kerning */
 		if ( use_kerning && prev_index && glyph->index ) {
 			FT_Vector delta; 
@@ -1166,26 +1339,14 @@ int TTF_SizeUNICODE(TTF_Font *font, const Uint16 *text, int *w, int *h)
 			x += delta.x >> 6;
 		}
 
-#if 0
-		if ( (ch == text) && (glyph->minx < 0) ) {
-		/* Fixes the texture wrapping bug when the first letter
-		 * has a negative minx value or horibearing value.  The entire
-		 * bounding box must be adjusted to be bigger so the entire
-		 * letter can fit without any texture corruption or wrapping.
-		 *
-		 * Effects: First enlarges bounding box.
-		 * Second, xstart has to start ahead of its normal spot in the
-		 * negative direction of the negative minx value.
-		 * (pushes everything to the right).
-		 *
-		 * This will make the memory copy of the glyph bitmap data
-		 * work out correctly.
-		 * */
-			z -= glyph->minx;
-			
+		/* Compensate for the wrap around bug with negative minx's */
+		if ( font->run_len == 0 && glyph->minx < 0 ) {
+			shift = -glyph->minx;
 		}
-#endif
-		
+		font->run[font->run_len].glyph = glyph;
+		font->run[font->run_len].x = x + shift + glyph->minx;
+		++font->run_len;
+
 		z = x + glyph->minx;
 		if ( minx > z ) {
 			minx = z;
@@ -1232,86 +1393,56 @@ int TTF_SizeUNICODE(TTF_Font *font, const Uint16 *text, int *w, int *h)
 			}
 		}
 	}
-	return status;
+	return 0;
 }
 
-/* Convert the Latin-1 text to UNICODE and render it
-*/
-SDL_Surface *TTF_RenderText_Solid(TTF_Font *font,
-				const char *text, SDL_Color fg)
+int TTF_SizeText(TTF_Font *font, const char *text, int *w, int *h)
 {
-	SDL_Surface *textbuf;
-	Uint16 *unicode_text;
-	int unicode_len;
-
-	/* Copy the Latin-1 text to a UNICODE text buffer */
-	unicode_len = strlen(text);
-	unicode_text = (Uint16 *)ALLOCA((1+unicode_len+1)*(sizeof *unicode_text));
-	if ( unicode_text == NULL ) {
-		TTF_SetError("Out of memory");
-		return(NULL);
+	int status = Layout_Text(font, text, TEXT_LATIN1, CACHED_METRICS, w, h);
+	if ( status == 0 ) {
+		Unpin_Cache(font);
 	}
-	*unicode_text = UNICODE_BOM_NATIVE;
-	LATIN1_to_UNICODE(unicode_text+1, text, unicode_len);
-
-	/* Render the new text */
-	textbuf = TTF_RenderUNICODE_Solid(font, unicode_text, fg);
-
-	/* Free the text buffer and return */
-	FREEA(unicode_text);
-	return(textbuf);
+	return status;
 }
 
-/* Convert the UTF-8 text to UNICODE and render it
-*/
-SDL_Surface *TTF_RenderUTF8_Solid(TTF_Font *font,
-				const char *text, SDL_Color fg)
+int TTF_SizeUTF8(TTF_Font *font, const char *text, int *w, int *h)
 {
-	SDL_Surface *textbuf;
-	Uint16 *unicode_text;
-	int unicode_len;
-
-	/* Copy the UTF-8 text to a UNICODE text buffer */
-	unicode_len = strlen(text);
-	unicode_text = (Uint16 *)ALLOCA((1+unicode_len+1)*(sizeof *unicode_text));
-	if ( unicode_text == NULL ) {
-		TTF_SetError("Out of memory");
-		return(NULL);
+	int status = Layout_Text(font, text, TEXT_UTF8, CACHED_METRICS, w, h);
+	if ( status == 0 ) {
+		Unpin_Cache(font);
 	}
-	*unicode_text = UNICODE_BOM_NATIVE;
-	UTF8_to_UNICODE(unicode_text+1, text, unicode_len);
-
-	/* Render the new text */
-	textbuf = TTF_RenderUNICODE_Solid(font, unicode_text, fg);
+	return status;
+}
 
-	/* Free the text buffer and return */
-	FREEA(unicode_text);
-	return(textbuf);
+int TTF_SizeUNICODE(TTF_Font *font, const Uint16 *text, int *w, int *h)
+{
+	int status = Layout_Text(font, text, TEXT_UNICODE, CACHED_METRICS, w, h);
+	if ( status == 0 ) {
+		Unpin_Cache(font);
+	}
+	return status;
 }
 
-SDL_Surface *TTF_RenderUNICODE_Solid(TTF_Font *font,
-				const Uint16 *text, SDL_Color fg)
+static SDL_Surface *Render_Solid(TTF_Font *font,
+				const void *text, int encoding, SDL_Color fg)
 {
-	int xstart;
 	int width;
 	int height;
 	SDL_Surface* textbuf;
 	SDL_Palette* palette;
-	const Uint16* ch;
 	Uint8* src;
 	Uint8* dst;
 	Uint8 *dst_check;
-	int swapped;
-	int row, col;
+	int i, row, col;
 	c_glyph *glyph;
-
 	FT_Bitmap *current;
-	FT_Error error;
-	FT_Long use_kerning;
-	FT_UInt prev_index = 0;
 
-	/* Get the dimensions of the text surface */
-	if( ( TTF_SizeUNICODE(font, text, &width, &height) < 0 ) || !width ) {
+	/* Load the glyphs and get the dimensions of the text surface */
+	if ( Layout_Text(font, text, encoding, CACHED_METRICS|CACHED_BITMAP, &width, &height) < 0 ) {
+		return NULL;
+	}
+	if ( !width ) {
+		Unpin_Cache( font );
 		TTF_SetError( "Text has zero width" );
 		return NULL;
 	}
@@ -1319,6 +1450,7 @@ SDL_Surface *TTF_RenderUNICODE_Solid(TTF_Font *font,
 	/* Create the target surface */
 	textbuf = SDL_AllocSurface(SDL_SWSURFACE, width, height, 8, 0, 0, 0, 0);
 	if( textbuf == NULL ) {
+		Unpin_Cache( font );
 		return NULL;
 	}
 
@@ -1336,38 +1468,9 @@ SDL_Surface *TTF_RenderUNICODE_Solid(TTF_Font *font,
 	palette->colors[1].b = fg.b;
 	SDL_SetColorKey( textbuf, SDL_SRCCOLORKEY, 0 );
 
-	/* check kerning */
-	use_kerning = FT_HAS_KERNING( font->face ) && font->kerning;
-	
-	/* Load and render each character */
-	xstart = 0;
-	swapped = TTF_byteswapped;
-	for( ch=text; *ch; ++ch ) {
-		Uint16 c = *ch;
-		if ( c == UNICODE_BOM_NATIVE ) {
-			swapped = 0;
-			if ( text == ch ) {
-				++text;
-			}
-			continue;
-		}
-		if ( c == UNICODE_BOM_SWAPPED ) {
-			swapped = 1;
-			if ( text == ch ) {
-				++text;
-			}
-			continue;
-		}
-		if ( swapped ) {
-			c = SDL_Swap16(c);
-		}
-
-		error = Find_Glyph(font, c, CACHED_METRICS|CACHED_BITMAP);
-		if( error ) {
-			SDL_FreeSurface( textbuf );
-			return NULL;
-		}
-		glyph = font->current;
+	/* Render each character */
+	for( i = 0; i < font->run_len; ++i ) {
+		glyph = font->run[i].glyph;
 		current = &glyph->bitmap;
 		/* Ensure the width of the pixmap is correct. On some cases,
 		 * freetype may report a larger pixmap than possible.*/
@@ -1375,17 +1478,7 @@ SDL_Surface *TTF_RenderUNICODE_Solid(TTF_Font *font,
 		if (font->outline <= 0 && width > glyph->maxx - glyph->minx) {
 			width = glyph->maxx - glyph->minx;
 		}
-		/* do kerning, if possible AC-Patch */
-		if ( use_kerning && prev_index && glyph->index ) {
-			FT_Vector delta; 
-			FT_Get_Kerning( font->face, prev_index, glyph->index, ft_kerning_default, &delta ); 
-			xstart += delta.x >> 6;
-		}
-		/* Compensate for wrap around bug with negative minx's */
-		if ( (ch == text) && (glyph->minx < 0) ) {
-			xstart -= glyph->minx;
-		}
-		
+
 		for( row = 0; row < current->rows; ++row ) {
 			/* Make sure we don't go either over, or under the
 			 * limit */
@@ -1397,20 +1490,15 @@ SDL_Surface *TTF_RenderUNICODE_Solid(TTF_Font *font,
 			}
 			dst = (Uint8*) textbuf->pixels +
 				(row+glyph->yoffset) * textbuf->pitch +
-				xstart + glyph->minx;
+				font->run[i].x;
 			src = current->buffer + row * current->pitch;
 
 			for ( col=width; col>0 && dst < dst_check; --col ) {
 				*dst++ |= *src++;
 			}
 		}
-
-		xstart += glyph->advance;
-		if ( TTF_HANDLE_STYLE_BOLD(font) ) {
-			xstart += font->glyph_overhang;
-		}
-		prev_index = glyph->index;
 	}
+	Unpin_Cache( font );
 
 	/* Handle the underline style */
 	if( TTF_HANDLE_STYLE_UNDERLINE(font) ) {
@@ -1426,6 +1514,24 @@ SDL_Surface *TTF_RenderUNICODE_Solid(TTF_Font *font,
 	return textbuf;
 }
 
+SDL_Surface *TTF_RenderText_Solid(TTF_Font *font,
+				const char *text, SDL_Color fg)
+{
+	return Render_Solid(font, text, TEXT_LATIN1, fg);
+}
+
+SDL_Surface *TTF_RenderUTF8_Solid(TTF_Font *font,
+				const char *text, SDL_Color fg)
+{
+	return Render_Solid(font, text, TEXT_UTF8, fg);
+}
+
+SDL_Surface *TTF_RenderUNICODE_Solid(TTF_Font *font,
+				const Uint16 *text, SDL_Color fg)
+{
+	return Render_Solid(font, text, TEXT_UNICODE, fg);
+}
+
 SDL_Surface *TTF_RenderGlyph_Solid(TTF_Font *font, Uint16 ch, SDL_Color fg)
 {
 	SDL_Surface *textbuf;
@@ -1494,66 +1600,11 @@ SDL_Surface *TTF_RenderGlyph_Solid(TTF_Font *font, Uint16 ch, SDL_Color fg)
 }
 
 
-/* Convert the Latin-1 text to UNICODE and render it
-*/
-SDL_Surface *TTF_RenderText_Shaded(TTF_Font *font,
-				const char *text, SDL_Color fg, SDL_Color bg)
-{
-	SDL_Surface *textbuf;
-	Uint16 *unicode_text;
-	int unicode_len;
-
-	/* Copy the Latin-1 text to a UNICODE text buffer */
-	unicode_len = strlen(text);
-	unicode_text = (Uint16 *)ALLOCA((1+unicode_len+1)*(sizeof *unicode_text));
-	if ( unicode_text == NULL ) {
-		TTF_SetError("Out of memory");
-		return(NULL);
-	}
-	*unicode_text = UNICODE_BOM_NATIVE;
-	LATIN1_to_UNICODE(unicode_text+1, text, unicode_len);
-
-	/* Render the new text */
-	textbuf = TTF_RenderUNICODE_Shaded(font, unicode_text, fg, bg);
-
-	/* Free the text buffer and return */
-	FREEA(unicode_text);
-	return(textbuf);
-}
-
-/* Convert the UTF-8 text to UNICODE and render it
-*/
-SDL_Surface *TTF_RenderUTF8_Shaded(TTF_Font *font,
-				const char *text, SDL_Color fg, SDL_Color bg)
-{
-	SDL_Surface *textbuf;
-	Uint16 *unicode_text;
-	int unicode_len;
-
-	/* Copy the UTF-8 text to a UNICODE text buffer */
-	unicode_len = strlen(text);
-	unicode_text = (Uint16 *)ALLOCA((1+unicode_len+1)*(sizeof *unicode_text));
-	if ( unicode_text == NULL ) {
-		TTF_SetError("Out of memory");
-		return(NULL);
-	}
-	*unicode_text = UNICODE_BOM_NATIVE;
-	UTF8_to_UNICODE(unicode_text+1, text, unicode_len);
-
-	/* Render the new text */
-	textbuf = TTF_RenderUNICODE_Shaded(font, unicode_text, fg, bg);
-
-	/* Free the text buffer and return */
-	FREEA(unicode_text);
-	return(textbuf);
-}
-
-SDL_Surface* TTF_RenderUNICODE_Shaded( TTF_Font* font,
-				       const Uint16* text,
-				       SDL_Color fg,
-				       SDL_Color bg )
+static SDL_Surface* Render_Shaded( TTF_Font* font,
+				   const void* text, int encoding,
+				   SDL_Color fg,
+				   SDL_Color bg )
 {
-	int xstart;
 	int width;
 	int height;
 	SDL_Surface* textbuf;
@@ -1562,20 +1613,19 @@ SDL_Surface* TTF_RenderUNICODE_Shaded( TTF_Font* font,
 	int rdiff;
 	int gdiff;
 	int bdiff;
-	const Uint16* ch;
 	Uint8* src;
 	Uint8* dst;
 	Uint8* dst_check;
-	int swapped;
-	int row, col;
+	int i, row, col;
 	FT_Bitmap* current;
 	c_glyph *glyph;
-	FT_Error error;
-	FT_Long use_kerning;
-	FT_UInt prev_index = 0;
 
-	/* Get the dimensions of the text surface */
-	if( ( TTF_SizeUNICODE(font, text, &width, &height) < 0 ) || !width ) {
+	/* Load the glyphs and get the dimensions of the text surface */
+	if ( Layout_Text(font, text, encoding, CACHED_METRICS|CACHED_PIXMAP, &width, &height) < 0 ) {
+		return NULL;
+	}
+	if ( !width ) {
+		Unpin_Cache( font );
 		TTF_SetError("Text has zero width");
 		return NULL;
 	}
@@ -1583,6 +1633,7 @@ SDL_Surface* TTF_RenderUNICODE_Shaded( TTF_Font* font,
 	/* Create the target surface */
 	textbuf = SDL_AllocSurface(SDL_SWSURFACE, width, height, 8, 0, 0, 0, 0);
 	if( textbuf == NULL ) {
+		Unpin_Cache( font );
 		return NULL;
 	}
 
@@ -1602,55 +1653,16 @@ SDL_Surface* TTF_RenderUNICODE_Shaded( TTF_Font* font,
 		palette->colors[index].b = bg.b + (index*bdiff) / (NUM_GRAYS-1);
 	}
 
-	/* check kerning */
-	use_kerning = FT_HAS_KERNING( font->face ) && font->kerning;
-	
-	/* Load and render each character */
-	xstart = 0;
-	swapped = TTF_byteswapped;
-	for( ch = text; *ch; ++ch ) {
-		Uint16 c = *ch;
-		if ( c == UNICODE_BOM_NATIVE ) {
-			swapped = 0;
-			if ( text == ch ) {
-				++text;
-			}
-			continue;
-		}
-		if ( c == UNICODE_BOM_SWAPPED ) {
-			swapped = 1;
-			if ( text == ch ) {
-				++text;
-			}
-			continue;
-		}
-		if ( swapped ) {
-			c = SDL_Swap16(c);
-		}
-
-		error = Find_Glyph(font, c, CACHED_METRICS|CACHED_PIXMAP);
-		if( error ) {
-			SDL_FreeSurface( textbuf );
-			return NULL;
-		}
-		glyph = font->current;
+	/* Render each character */
+	for( i = 0; i < font->run_len; ++i ) {
+		glyph = font->run[i].glyph;
 		/* Ensure the width of the pixmap is correct. On some cases,
 		 * freetype may report a larger pixmap than possible.*/
 		width = glyph->pixmap.width;
 		if (font->outline <= 0 && width > glyph->maxx - glyph->minx) {
 			width = glyph->maxx - glyph->minx;
 		}
-		/* do kerning, if possible AC-Patch */
-		if ( use_kerning && prev_index && glyph->index ) {
-			FT_Vector delta; 
-			FT_Get_Kerning( font->face, prev_index, glyph->index, ft_kerning_default, &delta ); 
-			xstart += delta.x >> 6;
-		}
-		/* Compensate for the wrap around with negative minx's */
-		if ( (ch == text) && (glyph->minx < 0) ) {
-			xstart -= glyph->minx;
-		}
-		
+
 		current = &glyph->pixmap;
 		for( row = 0; row < current->rows; ++row ) {
 			/* Make sure we don't go either over, or under the
@@ -1663,19 +1675,14 @@ SDL_Surface* TTF_RenderUNICODE_Shaded( TTF_Font* font,
 			}
 			dst = (Uint8*) textbuf->pixels +
 				(row+glyph->yoffset) * textbuf->pitch +
-				xstart + glyph->minx;
+				font->run[i].x;
 			src = current->buffer + row * current->pitch;
 			for ( col=width; col>0 && dst < dst_check; --col ) {
 				*dst++ |= *src++;
 			}
 		}
-
-		xstart += glyph->advance;
-		if( TTF_HANDLE_STYLE_BOLD(font) ) {
-			xstart += font->glyph_overhang;
-		}
-		prev_index = glyph->index;
 	}
+	Unpin_Cache( font );
 
 	/* Handle the underline style */
 	if( TTF_HANDLE_STYLE_UNDERLINE(font) ) {
@@ -1691,6 +1698,26 @@ SDL_Surface* TTF_RenderUNICODE_Shaded( TTF_Font* font,
 	return textbuf;
 }
 
+SDL_Surface *TTF_RenderText_Shaded(TTF_Font *font,
+				const char *text, SDL_Color fg, SDL_Color bg)
+{
+	return Render_Shaded(font, text, TEXT_LATIN1, fg, bg);
+}
+
+SDL_Surface *TTF_RenderUTF8_Shaded(TTF_Font *font,
+				const char *text, SDL_Color fg, SDL_Color bg)
+{
+	return Render_Shaded(font, text, TEXT_UTF8, fg, bg);
+}
+
+SDL_Surface* TTF_RenderUNICODE_Shaded( TTF_Font* font,
+				       const Uint16* text,
+				       SDL_Color fg,
+				       SDL_Color bg )
+{
+	return Render_Shaded(font, text, TEXT_UNICODE, fg, bg);
+}
+
 SDL_Surface* TTF_RenderGlyph_Shaded( TTF_Font* font,
 				     Uint16 ch,
 				     SDL_Color fg,
@@ -1767,81 +1794,25 @@ SDL_Surface* TTF_RenderGlyph_Shaded( TTF_Font* font,
 	return textbuf;
 }
 
-/* Convert the Latin-1 text to UNICODE and render it
-*/
-SDL_Surface *TTF_RenderText_Blended(TTF_Font *font,
-				const char *text, SDL_Color fg)
-{
-	SDL_Surface *textbuf;
-	Uint16 *unicode_text;
-	int unicode_len;
-
-	/* Copy the Latin-1 text to a UNICODE text buffer */
-	unicode_len = strlen(text);
-	unicode_text = (Uint16 *)ALLOCA((1+unicode_len+1)*(sizeof *unicode_text));
-	if ( unicode_text == NULL ) {
-		TTF_SetError("Out of memory");
-		return(NULL);
-	}
-	*unicode_text = UNICODE_BOM_NATIVE;
-	LATIN1_to_UNICODE(unicode_text+1, text, unicode_len);
-
-	/* Render the new text */
-	textbuf = TTF_RenderUNICODE_Blended(font, unicode_text, fg);
-
-	/* Free the text buffer and return */
-	FREEA(unicode_text);
-	return(textbuf);
-}
-
-/* Convert the UTF-8 text to UNICODE and render it
-*/
-SDL_Surface *TTF_RenderUTF8_Blended(TTF_Font *font,
-				const char *text, SDL_Color fg)
-{
-	SDL_Surface *textbuf;
-	Uint16 *unicode_text;
-	int unicode_len;
-
-	/* Copy the UTF-8 text to a UNICODE text buffer */
-	unicode_len = strlen(text);
-	unicode_text = (Uint16 *)ALLOCA((1+unicode_len+1)*(sizeof *unicode_text));
-	if ( unicode_text == NULL ) {
-		TTF_SetError("Out of memory");
-		return(NULL);
-	}
-	*unicode_text = UNICODE_BOM_NATIVE;
-	UTF8_to_UNICODE(unicode_text+1, text, unicode_len);
-
-	/* Render the new text */
-	textbuf = TTF_RenderUNICODE_Blended(font, unicode_text, fg);
-
-	/* Free the text buffer and return */
-	FREEA(unicode_text);
-	return(textbuf);
-}
-
-SDL_Surface *TTF_RenderUNICODE_Blended(TTF_Font *font,
-				const Uint16 *text, SDL_Color fg)
+static SDL_Surface *Render_Blended(TTF_Font *font,
+				const void *text, int encoding, SDL_Color fg)
 {
-	int xstart;
 	int width, height;
 	SDL_Surface *textbuf;
 	Uint32 alpha;
 	Uint32 pixel;
-	const Uint16 *ch;
 	Uint8 *src;
 	Uint32 *dst;
 	Uint32 *dst_check;
-	int swapped;
-	int row, col;
+	int i, row, col;
 	c_glyph *glyph;
-	FT_Error error;
-	FT_Long use_kerning;
-	FT_UInt prev_index = 0;
 
-	/* Get the dimensions of the text surface */
-	if ( (TTF_SizeUNICODE(font, text, &width, &height) < 0) || !width ) {
+	/* Load the glyphs and get the dimensions of the text surface */
+	if ( Layout_Text(font, text, encoding, CACHED_METRICS|CACHED_PIXMAP, &width, &height) < 0 ) {
+		return(NULL);
+	}
+	if ( !width ) {
+		Unpin_Cache( font );
 		TTF_SetError("Text has zero width");
 		return(NULL);
 	}
@@ -1850,6 +1821,7 @@ SDL_Surface *TTF_RenderUNICODE_Blended(TTF_Font *font,
 	textbuf = SDL_AllocSurface(SDL_SWSURFACE, width, height, 32,
 	                           0x00FF0000, 0x0000FF00, 0x000000FF, 0xFF000000);
 	if ( textbuf == NULL ) {
+		Unpin_Cache( font );
 		return(NULL);
 	}
 
@@ -1857,57 +1829,18 @@ SDL_Surface *TTF_RenderUNICODE_Blended(TTF_Font *font,
 	   that may occur. */
 	dst_check = (Uint32*)textbuf->pixels + textbuf->pitch/4 * textbuf->h;
 
-	/* check kerning */
-	use_kerning = FT_HAS_KERNING( font->face ) && font->kerning;
-	
-	/* Load and render each character */
-	xstart = 0;
-	swapped = TTF_byteswapped;
+	/* Render each character */
 	pixel = (fg.r<<16)|(fg.g<<8)|fg.b;
 	SDL_FillRect(textbuf, NULL, pixel);	/* Initialize with fg and 0 alpha */
 
-	for ( ch=text; *ch; ++ch ) {
-		Uint16 c = *ch;
-		if ( c == UNICODE_BOM_NATIVE ) {
-			swapped = 0;
-			if ( text == ch ) {
-				++text;
-			}
-			continue;
-		}
-		if ( c == UNICODE_BOM_SWAPPED ) {
-			swapped = 1;
-			if ( text == ch ) {
-				++text;
-			}
-			continue;
-		}
-		if ( swapped ) {
-			c = SDL_Swap16(c);
-		}
-		error = Find_Glyph(font, c, CACHED_METRICS|CACHED_PIXMAP);
-		if( error ) {
-			SDL_FreeSurface( textbuf );
-			return NULL;
-		}
-		glyph = font->current;
+	for ( i = 0; i < font->run_len; ++i ) {
+		glyph = font->run[i].glyph;
 		/* Ensure the width of the pixmap is correct. On some cases,
 		 * freetype may report a larger pixmap than possible.*/
 		width = glyph->pixmap.width;
 		if (font->outline <= 0 && width > glyph->maxx - glyph->minx) {
 			width = glyph->maxx - glyph->minx;
 		}
-		/* do kerning, if possible AC-Patch */
-		if ( use_kerning && prev_index && glyph->index ) {
-			FT_Vector delta; 
-			FT_Get_Kerning( font->face, prev_index, glyph->index, ft_kerning_default, &delta ); 
-			xstart += delta.x >> 6;
-		}
-		
-		/* Compensate for the wrap around bug with negative minx's */
-		if ( (ch == text) && (glyph->minx < 0) ) {
-			xstart -= glyph->minx;
-		}
 
 		for ( row = 0; row < glyph->pixmap.rows; ++row ) {
 			/* Make sure we don't go either over, or under the
@@ -1920,7 +1853,7 @@ SDL_Surface *TTF_RenderUNICODE_Blended(TTF_Font *font,
 			}
 			dst = (Uint32*) textbuf->pixels +
 				(row+glyph->yoffset) * textbuf->pitch/4 +
-				xstart + glyph->minx;
+				font->run[i].x;
 
 			/* Added code to adjust src pointer for pixmaps to
 			 * account for pitch.
@@ -1931,13 +1864,8 @@ SDL_Surface *TTF_RenderUNICODE_Blended(TTF_Font *font,
 				*dst++ |= pixel | (alpha << 24);
 			}
 		}
-
-		xstart += glyph->advance;
-		if ( TTF_HANDLE_STYLE_BOLD(font) ) {
-			xstart += font->glyph_overhang;
-		}
-		prev_index = glyph->index;
 	}
+	Unpin_Cache( font );
 
 	/* Handle the underline style */
 	if( TTF_HANDLE_STYLE_UNDERLINE(font) ) {
@@ -1953,6 +1881,24 @@ SDL_Surface *TTF_RenderUNICODE_Blended(TTF_Font *font,
 	return(textbuf);
 }
 
+SDL_Surface *TTF_RenderText_Blended(TTF_Font *font,
+				const char *text, SDL_Color fg)
+{
+	return Render_Blended(font, text, TEXT_LATIN1, fg);
+}
+
+SDL_Surface *TTF_RenderUTF8_Blended(TTF_Font *font,
+				const char *text, SDL_Color fg)
+{
+	return Render_Blended(font, text, TEXT_UTF8, fg);
+}
+
+SDL_Surface *TTF_RenderUNICODE_Blended(TTF_Font *font,
+				const Uint16 *text, SDL_Color fg)
+{
+	return Render_Blended(font, text, TEXT_UNICODE, fg);
+}
+
 SDL_Surface *TTF_RenderGlyph_Blended(TTF_Font *font, Uint16 ch, SDL_Color fg)
 {
 	SDL_Surface *textbuf;
@@ -2016,17 +1962,333 @@ SDL_Surface *TTF_RenderGlyph_Blended(TTF_Font *font, Uint16 ch, SDL_Color fg)
 	return(textbuf);
 }
 
+/* Glyph atlases */
+
+TTF_Atlas *TTF_CreateAtlas(int w, int h, SDL_Color fg)
+{
+	TTF_Atlas *atlas;
+
+	atlas = (TTF_Atlas *)malloc(sizeof *atlas);
+	if ( atlas == NULL ) {
+		TTF_SetError("Out of memory");
+		return NULL;
+	}
+	memset(atlas, 0, sizeof(*atlas));
+
+	/* Same layout as the blended renderers, glyph coverage in alpha */
+	atlas->surface = SDL_AllocSurface(SDL_SWSURFACE, w, h, 32,
+	                      0x00FF0000, 0x0000FF00, 0x000000FF, 0xFF000000);
+	if ( atlas->surface == NULL ) {
+		free(atlas);
+		return NULL;
+	}
+	atlas->pixel = (fg.r<<16)|(fg.g<<8)|fg.b;
+
+	/* Roughly one bucket per 16x16 cell */
+	atlas->hash_bits = 6;
+	while ( atlas->hash_bits < 16 && (1 << (atlas->hash_bits + 8)) < w * h ) {
+		++atlas->hash_bits;
+	}
+	atlas->hash = (a_glyph **)malloc(sizeof(*atlas->hash) << atlas->hash_bits);
+	if ( atlas->hash == NULL ) {
+		SDL_FreeSurface(atlas->surface);
+		free(atlas);
+		TTF_SetError("Out of memory");
+		return NULL;
+	}
+	memset(atlas->hash, 0, sizeof(*atlas->hash) << atlas->hash_bits);
+
+	TTF_ClearAtlas(atlas);
+	return atlas;
+}
+
+void TTF_ClearAtlas(TTF_Atlas *atlas)
+{
+	a_glyph *glyph, *next;
+	int i;
+
+	for ( i = 0; i < (1 << atlas->hash_bits); ++i ) {
+		for ( glyph = atlas->hash[i]; glyph; glyph = next ) {
+			next = glyph->next;
+			free(glyph);
+		}
+		atlas->hash[i] = NULL;
+	}
+	atlas->shelf_x = 0;
+	atlas->shelf_y = 0;
+	atlas->shelf_h = 0;
+	SDL_FillRect(atlas->surface, NULL, atlas->pixel);
+}
+
+void TTF_FreeAtlas(TTF_Atlas *atlas)
+{
+	if ( atlas ) {
+		TTF_ClearAtlas(atlas);
+		free(atlas->hash);
+		SDL_FreeSurface(atlas->surface);
+		free(atlas);
+	}
+}
+
+SDL_Surface *TTF_AtlasSurface(TTF_Atlas *atlas)
+{
+	return atlas->surface;
+}
+
+/* Copy the current glyph's pixmap into free space in the atlas.
+   Returns 0 if it was added, 1 if the atlas is full, or -1 on error.
+*/
+static int Atlas_Add(TTF_Atlas *atlas, TTF_Font *font, a_glyph *slot)
+{
+	c_glyph *glyph = font->current;
+	SDL_Surface *surface = atlas->surface;
+	Uint8 *src;
+	Uint32 *dst;
+	int width, height;
+	int row, col;
+
+	/* Same width clipping as TTF_RenderUNICODE_Blended() */
+	width = glyph->pixmap.width;
+	if ( font->outline <= 0 && width > glyph->maxx - glyph->minx ) {
+		width = glyph->maxx - glyph->minx;
+	}
+	height = glyph->pixmap.rows;
+	if ( width <= 0 || height <= 0 ) {
+		slot->src.w = slot->src.h = 0;
+		return 0;
+	}
+	if ( width > surface->w || height > surface->h ) {
+		TTF_SetError("Glyph is larger than the atlas");
+		return -1;
+	}
+
+	/* Start a new shelf if the glyph doesn't fit on this one */
+	if ( atlas->shelf_x + width > surface->w ) {
+		atlas->shelf_y += atlas->shelf_h + 1;
+		atlas->shelf_x = 0;
+		atlas->shelf_h = 0;
+	}
+	if ( atlas->shelf_y + height > surface->h ) {
+		return 1;
+	}
+	slot->src.x = atlas->shelf_x;
+	slot->src.y = atlas->shelf_y;
+	slot->src.w = width;
+	slot->src.h = height;
+	atlas->shelf_x += width + 1;
+	if ( atlas->shelf_h < height ) {
+		atlas->shelf_h = height;
+	}
+
+	if ( SDL_MUSTLOCK(surface) ) {
+		SDL_LockSurface(surface);
+	}
+	for ( row = 0; row < height; ++row ) {
+		src = glyph->pixmap.buffer + row * glyph->pixmap.pitch;
+		dst = (Uint32 *)((Uint8 *)surface->pixels +
+		                 (slot->src.y + row) * surface->pitch) + slot->src.x;
+		for ( col = width; col > 0; --col ) {
+			*dst++ = atlas->pixel | ((Uint32)*src++ << 24);
+		}
+	}
+	if ( SDL_MUSTLOCK(surface) ) {
+		SDL_UnlockSurface(surface);
+	}
+	return 0;
+}
+
+/* Look up a glyph in the atlas, packing it in if needed.
+   Returns 1 if the atlas is full.
+*/
+static int Atlas_Glyph(TTF_Atlas *atlas, TTF_Font *font, Uint32 ch, a_glyph **result)
+{
+	a_glyph *glyph;
+	FT_Error error;
+	int h, status;
+
+	h = (int)(((ch ^ (font->glyph_key * 0x9E3779B1) ^ (font->id << 24)) * 0x9E3779B1) >> (32 - atlas->hash_bits));
+	for ( glyph = atlas->hash[h]; glyph; glyph = glyph->next ) {
+		if ( glyph->ch == ch && glyph->font_id == font->id &&
+		     glyph->key == font->glyph_key ) {
+			*result = glyph;
+			return 0;
+		}
+	}
+
+	error = Find_Glyph(font, ch, CACHED_METRICS|CACHED_PIXMAP);
+	if ( error ) {
+		TTF_SetFTError("Couldn't find glyph", error);
+		return -1;
+	}
+	glyph = (a_glyph *)malloc(sizeof *glyph);
+	if ( glyph == NULL ) {
+		TTF_SetError("Out of memory");
+		return -1;
+	}
+	status = Atlas_Add(atlas, font, glyph);
+	if ( status != 0 ) {
+		free(glyph);
+		return status;
+	}
+	glyph->font_id = font->id;
+	glyph->ch = ch;
+	glyph->key = font->glyph_key;
+	glyph->index = font->current->index;
+	glyph->minx = font->current->minx;
+	glyph->yoffset = font->current->yoffset;
+	glyph->advance = font->current->advance;
+	glyph->next = atlas->hash[h];
+	atlas->hash[h] = glyph;
+
+	*result = glyph;
+	return 0;
+}
+
+/* Lay out UTF-8 text from the atlas, storing up to maxquads glyph quads
+   or, if dst is not NULL, blitting each glyph to it at (x, y).
+   The width of the text is returned in *width.
+*/
+static int Atlas_Run(TTF_Atlas *atlas, TTF_Font *font, const char *text,
+                     TTF_GlyphQuad *quads, int maxquads,
+                     SDL_Surface *dst, int x, int y, int *width)
+{
+	a_glyph *glyph;
+	SDL_Rect rect;
+	FT_Long use_kerning;
+	FT_UInt prev_index = 0;
+	int first = 1;
+	int xstart = 0;
+	int minx = 0, maxx = 0;
+	int count = 0;
+	int status;
+	Uint32 c;
+
+	if ( ! TTF_initialized ) {
+		TTF_SetError( "Library not initialized" );
+		return -1;
+	}
+
+	/* check kerning */
+	use_kerning = FT_HAS_KERNING( font->face ) && font->kerning;
+
+	while ( *text ) {
+		c = UTF8_getch(&text);
+		if ( c == UNICODE_BOM_NATIVE ) {
+			continue;
+		}
+
+		status = Atlas_Glyph(atlas, font, c, &glyph);
+		if ( status > 0 && dst ) {
+			/* Everything drawn so far is already on the target */
+			TTF_ClearAtlas(atlas);
+			status = Atlas_Glyph(atlas, font, c, &glyph);
+		}
+		if ( status > 0 ) {
+			TTF_SetError("Glyph atlas is full");
+			return -1;
+		}
+		if ( status < 0 ) {
+			return -1;
+		}
+
+		/* do kerning, if possible AC-Patch */
+		if ( use_kerning && prev_index && glyph->index ) {
+			FT_Vector delta;
+			FT_Get_Kerning( font->face, prev_index, glyph->index, ft_kerning_default, &delta );
+			xstart += delta.x >> 6;
+		}
+
+		/* Compensate for the wrap around bug with negative minx's */
+		if ( first && glyph->minx < 0 ) {
+			xstart -= glyph->minx;
+		}
+		first = 0;
+
+		if ( glyph->src.w > 0 ) {
+			if ( dst ) {
+				rect.x = x + xstart + glyph->minx;
+				rect.y = y + glyph->yoffset;
+				SDL_BlitSurface(atlas->surface, &glyph->src, dst, &rect);
+			} else if ( count < maxquads ) {
+				quads[count].src = glyph->src;
+				quads[count].x = xstart + glyph->minx;
+				quads[count].y = glyph->yoffset;
+			}
+			++count;
+		}
+		if ( xstart + glyph->minx < minx ) {
+			minx = xstart + glyph->minx;
+		}
+		if ( xstart + glyph->minx + glyph->src.w > maxx ) {
+			maxx = xstart + glyph->minx + glyph->src.w;
+		}
+
+		xstart += glyph->advance;
+		if ( TTF_HANDLE_STYLE_BOLD(font) ) {
+			xstart += font->glyph_overhang;
+		}
+		if ( xstart > maxx ) {
+			maxx = xstart;
+		}
+		prev_index = glyph->index;
+	}
+
+	if ( width ) {
+		*width = maxx - minx;
+	}
+	return count;
+}
+
+int TTF_AtlasGlyphsUTF8(TTF_Atlas *atlas, TTF_Font *font, const char *text,
+                        TTF_GlyphQuad *quads, int maxquads)
+{
+	return Atlas_Run(atlas, font, text, quads, maxquads, NULL, 0, 0, NULL);
+}
+
+int TTF_AtlasDrawUTF8(TTF_Atlas *atlas, TTF_Font *font, const char *text,
+                      SDL_Surface *dst, int x, int y)
+{
+	SDL_Rect rect;
+	Uint32 color;
+	Uint8 r, g, b;
+	int width;
+
+	if ( Atlas_Run(atlas, font, text, NULL, 0, dst, x, y, &width) < 0 ) {
+		return -1;
+	}
+
+	/* Underline and strikethrough are drawn as solid lines */
+	if ( TTF_HANDLE_STYLE_UNDERLINE(font) ||
+	     TTF_HANDLE_STYLE_STRIKETHROUGH(font) ) {
+		r = (Uint8)(atlas->pixel >> 16);
+		g = (Uint8)(atlas->pixel >> 8);
+		b = (Uint8)atlas->pixel;
+		color = SDL_MapRGB(dst->format, r, g, b);
+		rect.x = x;
+		rect.w = width;
+		rect.h = font->underline_height;
+		if ( font->outline > 0 ) {
+			rect.w += font->outline * 2;
+			rect.h += font->outline * 2;
+		}
+		if ( TTF_HANDLE_STYLE_UNDERLINE(font) ) {
+			rect.y = y + TTF_underline_top_row(font);
+			SDL_FillRect(dst, &rect, color);
+		}
+		if ( TTF_HANDLE_STYLE_STRIKETHROUGH(font) ) {
+			rect.y = y + TTF_strikethrough_top_row(font);
+			SDL_FillRect(dst, &rect, color);
+		}
+	}
+	return 0;
+}
+
 void TTF_SetFontStyle( TTF_Font* font, int style )
 {
-	int prev_style = font->style;
 	font->style = style | font->face_style;
 
-	/* Flush the cache if the style has changed.
-	 * Ignore UNDERLINE which does not impact glyph drawning.
-	 * */
-	if ( (font->style | TTF_STYLE_NO_GLYPH_CHANGE ) != ( prev_style | TTF_STYLE_NO_GLYPH_CHANGE )) {
-		Flush_Cache( font );
-	}
+	/* Glyphs are cached per style, so there is nothing to flush */
+	Update_Glyph_Key( font );
 }
 
 int TTF_GetFontStyle( const TTF_Font* font )
@@ -2037,7 +2299,7 @@ int TTF_GetFontStyle( const TTF_Font* font )
 void TTF_SetFontOutline( TTF_Font* font, int outline )
 {
 	font->outline = outline;
-	Flush_Cache( font );
+	Update_Glyph_Key( font );
 }
 
 int TTF_GetFontOutline( const TTF_Font* font )
@@ -2056,7 +2318,7 @@ void TTF_SetFontHinting( TTF_Font* font, int hinting )
 	else
 		font->hinting = 0;
 
-	Flush_Cache( font );
+	Update_Glyph_Key( font );
 }
 
 int TTF_GetFontHinting( const TTF_Font* font )
@@ -2084,6 +2346,43 @@ int TTF_WasInit( void )
 	return TTF_initialized;
 }
 
+void TTF_SetGlyphCacheSize(TTF_Font* font, int bytes)
+{
+	if ( bytes < 0 ) {
+		bytes = 0;
+	}
+	font->cache_limit = bytes;
+	font->current = NULL;
+	Trim_Cache( font, font->cache_limit );
+}
+
+int TTF_GetGlyphCacheSize(const TTF_Font* font)
+{
+	return font->cache_limit;
+}
+
+void TTF_GetGlyphCacheStats(const TTF_Font* font, Uint32 *hits, Uint32 *misses, int *glyphs, int *bytes)
+{
+	if ( hits ) {
+		*hits = font->cache_hits;
+	}
+	if ( misses ) {
+		*misses = font->cache_misses;
+	}
+	if ( glyphs ) {
+		*glyphs = font->cache_count;
+	}
+	if ( bytes ) {
+		*bytes = font->cache_used;
+	}
+}
+
+void TTF_ResetGlyphCacheStats(TTF_Font* font)
+{
+	font->cache_hits = 0;
+	font->cache_misses = 0;
+}
+
 int TTF_GetFontKerningSize(TTF_Font* font, int prev_index, int index)
 {
 	FT_Vector delta; 
@@ -146,7 +146,10 @@ extern DECLSPEC int SDLCALL TTF_GlyphMetrics(TTF_Font *font, Uint16 ch,
 				     int *minx, int *maxx,
                                      int *miny, int *maxy, int *advance);
 
-/* Get the dimensions of a rendered string of text */
+/* Get the dimensions of a rendered string of text
+   UTF-8 text may contain any code point, including those outside the
+   Basic Multilingual Plane that UNICODE (UCS-2) text cannot represent.
+ */
 extern DECLSPEC int SDLCALL TTF_SizeText(TTF_Font *font, const char *text, int *w, int *h);
 extern DECLSPEC int SDLCALL TTF_SizeUTF8(TTF_Font *font, const char *text, int *w, int *h);
 extern DECLSPEC int SDLCALL TTF_SizeUNICODE(TTF_Font *font, const Uint16 *text, int *w, int *h);
@@ -236,6 +239,63 @@ extern DECLSPEC int SDLCALL TTF_WasInit(void);
 /* Get the kerning size of two glyphs */
 extern DECLSPEC int TTF_GetFontKerningSize(TTF_Font *font, int prev_index, int index);
 
+/* Set and retrieve the memory budget, in bytes, of the font's glyph cache.
+   Rendered glyphs are cached per code point, style, outline and hinting
+   setting, and the least recently used ones are dropped when the cache
+   grows past this size.  The default is 1 megabyte.
+ */
+extern DECLSPEC void SDLCALL TTF_SetGlyphCacheSize(TTF_Font *font, int bytes);
+extern DECLSPEC int SDLCALL TTF_GetGlyphCacheSize(const TTF_Font *font);
+
+/* Get the glyph cache hit and miss counts, the number of cached glyphs
+   and the memory they use.  Any of the pointers may be NULL.
+ */
+extern DECLSPEC void SDLCALL TTF_GetGlyphCacheStats(const TTF_Font *font,
+			Uint32 *hits, Uint32 *misses, int *glyphs, int *bytes);
+extern DECLSPEC void SDLCALL TTF_ResetGlyphCacheStats(TTF_Font *font);
+
+/* A glyph atlas is a 32-bit ARGB surface that rendered glyphs of one
+   color are packed into, shared by any number of fonts.  Text drawn
+   from an atlas needs no surface allocation once its glyphs are packed.
+ */
+typedef struct _TTF_Atlas TTF_Atlas;
+
+/* The position of one glyph of a text run: the glyph's rectangle in the
+   atlas surface, and where it goes relative to the top left corner of
+   the text, as laid out by TTF_RenderUTF8_Blended().
+ */
+typedef struct {
+	SDL_Rect src;
+	Sint16 x, y;
+} TTF_GlyphQuad;
+
+/* Create an atlas surface of the given size for glyphs of color 'fg' */
+extern DECLSPEC TTF_Atlas * SDLCALL TTF_CreateAtlas(int w, int h, SDL_Color fg);
+
+/* Remove all glyphs from the atlas, invalidating any quads returned */
+extern DECLSPEC void SDLCALL TTF_ClearAtlas(TTF_Atlas *atlas);
+extern DECLSPEC void SDLCALL TTF_FreeAtlas(TTF_Atlas *atlas);
+
+/* Get the atlas surface, for blitting or uploading as a texture */
+extern DECLSPEC SDL_Surface * SDLCALL TTF_AtlasSurface(TTF_Atlas *atlas);
+
+/* Pack the glyphs of UTF-8 text into the atlas and store up to 'maxquads'
+   of their quads.  Whitespace produces no quad, and underline and
+   strikethrough are not included.  Returns the number of quads the text
+   needs, which may be more than 'maxquads', or -1 on error.  If the
+   atlas is full, clear it and lay out the text again.
+ */
+extern DECLSPEC int SDLCALL TTF_AtlasGlyphsUTF8(TTF_Atlas *atlas,
+		TTF_Font *font, const char *text,
+		TTF_GlyphQuad *quads, int maxquads);
+
+/* Blit UTF-8 text from the atlas onto 'dst' with its top left corner at
+   (x, y), packing glyphs as needed.  The atlas is cleared if it fills up.
+   Returns 0 on success or -1 on error.
+ */
+extern DECLSPEC int SDLCALL TTF_AtlasDrawUTF8(TTF_Atlas *atlas,
+		TTF_Font *font, const char *text, SDL_Surface *dst, int x, int y);
+
 /* We'll use SDL for reporting errors */
 #define TTF_SetError	SDL_SetError
 #define TTF_GetError	SDL_GetError
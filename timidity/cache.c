@@ -0,0 +1,473 @@
+/*
+    TiMidity -- Experimental MIDI to WAVE converter
+    Copyright (C) 1995 Tuukka Toivonen <toivonen@clinet.fi>
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the Perl Artistic License, available in COPYING.
+ */
+
+/* The instrument cache keeps each patch as load_instrument() left it,
+   converted, filtered and resampled, in a file of its own.  Loading it
+   again just maps the file, and the samples play straight from the
+   mapping, whose pages are shared by every song and process using it.
+   The Xbox can't map files, so there it's read into one block. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#if defined(_XBOX)
+#include <xtl.h>
+#elif defined(_WIN32)
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#endif
+
+#include "config.h"
+#include "common.h"
+#include "instrum.h"
+#include "ctrlmode.h"
+#include "cache.h"
+
+/* A cache file holds a header, the patch file name, then each layer
+   followed by its samples, and last the sample data, each part 16-byte
+   aligned.  It's all in this machine's layout.  A file that doesn't
+   match the patch and settings asked for is simply made again. */
+#define CACHE_MAGIC "TiMiCach"
+#define CACHE_VERSION 1
+#define CACHE_ALIGN(n) (((uint32)(n) + 15) & ~(uint32)15)
+
+typedef struct {
+  char magic[8];
+  int32 version, byte_order, sample_size, fraction_bits;
+  int32 patch_size, patch_time;
+  int32 key[CACHE_KEY_WORDS];
+  int32 name_length, layers;
+  uint32 size;
+} CacheHeader;
+
+typedef struct {
+  int32 size, type, samples, right_samples, lo, hi;
+} CacheLayer;
+
+typedef struct {
+  uint32 offset, length;
+  Sample sample;
+} CacheSample;
+
+/* The files this process has mapped, each shared by all the instruments
+   loaded from it.  Like the tone banks, they're guarded by bank_lock. */
+typedef struct _CacheMap {
+  char *name;
+  unsigned char *base;
+  uint32 size;
+  int refs;
+  struct _CacheMap *next;
+} CacheMap;
+
+static CacheMap *cache_maps=NULL;
+static char *cache_dir=NULL;
+
+void set_instrument_cache(const char *dir)
+{
+  if (cache_dir)
+    free(cache_dir);
+  cache_dir=NULL;
+  if (!dir)
+    return;
+#ifdef LOOKUP_HACK
+  ctl->cmsg(CMSG_WARNING, VERB_NORMAL,
+	    "The instrument cache can't be used with LOOKUP_HACK");
+#else
+  strcpy((cache_dir=safe_malloc(strlen(dir)+1)), dir);
+#endif
+}
+
+/* Cache files are named after a hash of everything that went into them */
+static int cache_file_name(char *file, const char *name, const CacheHeader *h)
+{
+  const unsigned char *cp;
+  uint32 hash=2166136261u;
+  int l=strlen(cache_dir);
+  size_t i;
+
+  for (cp=(const unsigned char *)name; *cp; cp++)
+    hash=(hash ^ *cp) * 16777619u;
+  for (cp=(const unsigned char *)h, i=0; i<sizeof(*h); i++)
+    hash=(hash ^ cp[i]) * 16777619u;
+
+  if (l + 16 >= PATH_MAX)
+    return -1;
+  strcpy(file, cache_dir);
+  if (l && file[l-1]!=PATH_SEP)
+    file[l++]=PATH_SEP;
+  sprintf(file+l, "%08lx.cache", (unsigned long)hash);
+  return 0;
+}
+
+static int fill_header(CacheHeader *h, const char *name, const int32 *key)
+{
+  struct stat st;
+
+  if (stat(name, &st))
+    return -1;
+  memset(h, 0, sizeof(*h));
+  memcpy(h->magic, CACHE_MAGIC, 8);
+  h->version=CACHE_VERSION;
+  h->byte_order=0x01020304;
+  h->sample_size=sizeof(Sample);
+  h->fraction_bits=FRACTION_BITS;
+  h->patch_size=(int32)st.st_size;
+  h->patch_time=(int32)st.st_mtime;
+  memcpy(h->key, key, sizeof(h->key));
+  h->name_length=strlen(name);
+  return 0;
+}
+
+/* The data points each sample keeps: the guard points after the end
+   that are read while interpolating, two for pre-resampled samples */
+static uint32 sample_length(const Sample *sp)
+{
+  return (sp->data_length >> FRACTION_BITS) + (sp->sample_rate ? 3 : 2);
+}
+
+static unsigned char *map_file(const char *file, uint32 *size)
+{
+  unsigned char *base=NULL;
+#if defined(_XBOX)
+  FILE *fp;
+  long l;
+
+  if (!(fp=fopen(file, "rb")))
+    return NULL;
+  if (!fseek(fp, 0, SEEK_END) && (l=ftell(fp))>=(long)sizeof(CacheHeader) &&
+      !fseek(fp, 0, SEEK_SET) && (base=malloc(l)))
+    {
+      if (fread(base, l, 1, fp)==1)
+	*size=l;
+      else
+	{
+	  free(base);
+	  base=NULL;
+	}
+    }
+  fclose(fp);
+#elif defined(_WIN32)
+  HANDLE fh, mh;
+  DWORD low, high;
+
+  fh=CreateFileA(file, GENERIC_READ, FILE_SHARE_READ|FILE_SHARE_DELETE,
+		 NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+  if (fh==INVALID_HANDLE_VALUE)
+    return NULL;
+  low=GetFileSize(fh, &high);
+  if (low!=INVALID_FILE_SIZE && !high && low>=sizeof(CacheHeader) &&
+      (mh=CreateFileMapping(fh, NULL, PAGE_READONLY, 0, 0, NULL)))
+    {
+      base=MapViewOfFile(mh, FILE_MAP_READ, 0, 0, 0);
+      CloseHandle(mh);
+      *size=low;
+    }
+  CloseHandle(fh);
+#else
+  struct stat st;
+  void *p;
+  int fd;
+
+  if ((fd=open(file, O_RDONLY)) < 0)
+    return NULL;
+  if (!fstat(fd, &st) && st.st_size>=(off_t)sizeof(CacheHeader) &&
+      st.st_size<=0x7fffffff &&
+      (p=mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0))!=MAP_FAILED)
+    {
+      base=p;
+      *size=st.st_size;
+    }
+  close(fd);
+#endif
+  return base;
+}
+
+static void unmap_file(unsigned char *base, uint32 size)
+{
+#if defined(_XBOX)
+  free(base);
+#elif defined(_WIN32)
+  UnmapViewOfFile(base);
+#else
+  munmap(base, size);
+#endif
+}
+
+/* Tells apart the temporary files of processes saving the same patch.
+   The Xbox only ever runs one. */
+static unsigned long process_id(void)
+{
+#if defined(_XBOX)
+  return 0;
+#elif defined(_WIN32)
+  return GetCurrentProcessId();
+#else
+  return getpid();
+#endif
+}
+
+/* Makes sure everything the records point at lies inside the file */
+static int check_layers(const unsigned char *base, uint32 size)
+{
+  const CacheHeader *h=(const CacheHeader *)base;
+  const CacheLayer *cl;
+  const CacheSample *cs;
+  uint32 pos=CACHE_ALIGN(sizeof(CacheHeader)) + CACHE_ALIGN(h->name_length+1);
+  int i, j, n;
+
+  for (i=0; i<h->layers; i++)
+    {
+      if (pos > size || size-pos < sizeof(CacheLayer))
+	return 0;
+      cl=(const CacheLayer *)(base+pos);
+      if (cl->samples < 0 || cl->samples > 255 ||
+	  cl->right_samples < 0 || cl->right_samples > 255)
+	return 0;
+      pos+=CACHE_ALIGN(sizeof(CacheLayer));
+      n=cl->samples + cl->right_samples;
+      if (pos > size || (size-pos)/sizeof(CacheSample) < (uint32)n)
+	return 0;
+      cs=(const CacheSample *)(base+pos);
+      for (j=0; j<n; j++, cs++)
+	if ((cs->offset & 15) || cs->offset > size ||
+	    (size-cs->offset)/sizeof(sample_t) < cs->length ||
+	    cs->sample.data_length < 0 ||
+	    sample_length(&cs->sample) > cs->length)
+	  return 0;
+      pos+=CACHE_ALIGN(n*sizeof(CacheSample));
+    }
+  return 1;
+}
+
+static void read_sample(Sample *sp, const CacheSample *cs,
+			unsigned char *base)
+{
+  *sp=cs->sample;
+  sp->data=(sample_t *)(base + cs->offset);
+}
+
+static InstrumentLayer *read_layers(CacheMap *m)
+{
+  const CacheHeader *h=(const CacheHeader *)m->base;
+  const CacheLayer *cl;
+  const CacheSample *cs;
+  uint32 pos=CACHE_ALIGN(sizeof(CacheHeader)) + CACHE_ALIGN(h->name_length+1);
+  InstrumentLayer *lp, *lastlp=0, *headlp=0;
+  Instrument *ip;
+  int i, j;
+
+  for (i=0; i<h->layers; i++)
+    {
+      cl=(const CacheLayer *)(m->base+pos);
+      pos+=CACHE_ALIGN(sizeof(CacheLayer));
+      cs=(const CacheSample *)(m->base+pos);
+      pos+=CACHE_ALIGN((cl->samples + cl->right_samples)*sizeof(CacheSample));
+
+      lp=(InstrumentLayer *)safe_malloc(sizeof(InstrumentLayer));
+      lp->size=cl->size;
+      lp->lo=cl->lo;
+      lp->hi=cl->hi;
+      lp->instrument=ip=(Instrument *)safe_malloc(sizeof(Instrument));
+      lp->next=0;
+
+      ip->type=cl->type;
+      ip->samples=ip->left_samples=cl->samples;
+      ip->sample=ip->left_sample=
+	(Sample *)safe_malloc(sizeof(Sample) * cl->samples);
+      for (j=0; j<cl->samples; j++)
+	read_sample(&ip->sample[j], cs++, m->base);
+      ip->right_samples=cl->right_samples;
+      if (cl->right_samples)
+	{
+	  ip->right_sample=
+	    (Sample *)safe_malloc(sizeof(Sample) * cl->right_samples);
+	  for (j=0; j<cl->right_samples; j++)
+	    read_sample(&ip->right_sample[j], cs++, m->base);
+	}
+      else ip->right_sample=0;
+      ip->contents=m->base;
+      m->refs++;
+
+      if (lastlp) lastlp->next=lp;
+      else headlp=lp;
+      lastlp=lp;
+    }
+  return headlp;
+}
+
+InstrumentLayer *load_cached_instrument(const char *name, const int32 *key)
+{
+  char file[PATH_MAX];
+  CacheHeader want;
+  const CacheHeader *h;
+  CacheMap *m;
+  unsigned char *base;
+  uint32 size;
+
+  if (!cache_dir || fill_header(&want, name, key) ||
+      cache_file_name(file, name, &want))
+    return 0;
+
+  for (m=cache_maps; m; m=m->next)
+    if (!strcmp(m->name, file))
+      break;
+  if (m)
+    {
+      base=m->base;
+      size=m->size;
+    }
+  else if (!(base=map_file(file, &size)))
+    return 0;
+
+  /* Another patch or other settings could hash to the same name */
+  h=(const CacheHeader *)base;
+  want.layers=h->layers;
+  want.size=h->size;
+  if (memcmp(&want, h, sizeof(want)) || want.size!=size ||
+      memcmp(base + CACHE_ALIGN(sizeof(CacheHeader)), name,
+	     want.name_length+1) ||
+      (!m && (want.layers < 1 || !check_layers(base, size))))
+    {
+      ctl->cmsg(CMSG_INFO, VERB_VERBOSE,
+		"%s doesn't match %s, it will be made again", file, name);
+      if (!m)
+	unmap_file(base, size);
+      return 0;
+    }
+
+  if (!m)
+    {
+      m=(CacheMap *)safe_malloc(sizeof(CacheMap));
+      strcpy((m->name=safe_malloc(strlen(file)+1)), file);
+      m->base=base;
+      m->size=size;
+      m->refs=0;
+      m->next=cache_maps;
+      cache_maps=m;
+    }
+  ctl->cmsg(CMSG_INFO, VERB_DEBUG, "Mapped %s from %s", name, file);
+  return read_layers(m);
+}
+
+void save_cached_instrument(const char *name, const int32 *key,
+			    InstrumentLayer *lp)
+{
+  char file[PATH_MAX], temp[PATH_MAX+16];
+  CacheHeader head, *h;
+  CacheLayer *cl;
+  CacheSample *cs;
+  InstrumentLayer *l;
+  Instrument *ip;
+  Sample *sp;
+  unsigned char *buf;
+  uint32 size, pos, data;
+  int i, n, ok;
+  FILE *fp;
+
+  if (!cache_dir || fill_header(&head, name, key) ||
+      cache_file_name(file, name, &head))
+    return;
+
+  /* The records come first, then the data they point at */
+  size=CACHE_ALIGN(sizeof(CacheHeader)) + CACHE_ALIGN(head.name_length+1);
+  for (l=lp; l; l=l->next, head.layers++)
+    size+=CACHE_ALIGN(sizeof(CacheLayer)) +
+      CACHE_ALIGN((l->instrument->samples + l->instrument->right_samples) *
+		  sizeof(CacheSample));
+  data=size;
+  for (l=lp; l; l=l->next)
+    {
+      ip=l->instrument;
+      for (i=0; i<ip->samples; i++)
+	size+=CACHE_ALIGN(sample_length(&ip->sample[i]) * sizeof(sample_t));
+      for (i=0; i<ip->right_samples; i++)
+	size+=CACHE_ALIGN(sample_length(&ip->right_sample[i]) * sizeof(sample_t));
+    }
+  head.size=size;
+
+  /* Patches can be bigger than safe_malloc() allows */
+  if (!(buf=calloc(size, 1)))
+    return;
+  h=(CacheHeader *)buf;
+  *h=head;
+  memcpy(buf + CACHE_ALIGN(sizeof(CacheHeader)), name, h->name_length+1);
+
+  pos=CACHE_ALIGN(sizeof(CacheHeader)) + CACHE_ALIGN(h->name_length+1);
+  for (l=lp; l; l=l->next)
+    {
+      ip=l->instrument;
+      n=ip->samples + ip->right_samples;
+      cl=(CacheLayer *)(buf+pos);
+      cl->size=l->size;
+      cl->type=ip->type;
+      cl->samples=ip->samples;
+      cl->right_samples=ip->right_samples;
+      cl->lo=l->lo;
+      cl->hi=l->hi;
+      pos+=CACHE_ALIGN(sizeof(CacheLayer));
+      cs=(CacheSample *)(buf+pos);
+      pos+=CACHE_ALIGN(n*sizeof(CacheSample));
+      for (i=0; i<n; i++, cs++)
+	{
+	  sp=(i < ip->samples) ? &ip->sample[i] :
+	    &ip->right_sample[i - ip->samples];
+	  cs->sample=*sp;
+	  cs->sample.data=NULL;
+	  cs->offset=data;
+	  cs->length=sample_length(sp);
+	  memcpy(buf+data, sp->data, cs->length * sizeof(sample_t));
+	  data+=CACHE_ALIGN(cs->length * sizeof(sample_t));
+	}
+    }
+
+  /* Write it under another name first, so no one maps it half done */
+  sprintf(temp, "%s.%lu", file, process_id());
+  ok=0;
+  if ((fp=fopen(temp, "wb")))
+    {
+      ok=(fwrite(buf, size, 1, fp)==1);
+      if (fclose(fp))
+	ok=0;
+#ifdef _WIN32
+      if (ok)
+	remove(file);
+#endif
+      if (ok && rename(temp, file))
+	ok=0;
+      if (!ok)
+	remove(temp);
+    }
+  if (ok)
+    ctl->cmsg(CMSG_INFO, VERB_DEBUG, "Saved %s to %s", name, file);
+  else
+    ctl->cmsg(CMSG_WARNING, VERB_VERBOSE,
+	      "Couldn't save %s to the instrument cache", name);
+  free(buf);
+}
+
+void release_cached_instrument(unsigned char *contents)
+{
+  CacheMap **mp, *m;
+
+  for (mp=&cache_maps; (m=*mp); mp=&m->next)
+    if (m->base==contents)
+      {
+	if (--m->refs)
+	  return;
+	*mp=m->next;
+	unmap_file(m->base, m->size);
+	free(m->name);
+	free(m);
+	return;
+      }
+}
@@ -0,0 +1,19 @@
+/*
+    TiMidity -- Experimental MIDI to WAVE converter
+    Copyright (C) 1995 Tuukka Toivonen <toivonen@clinet.fi>
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the Perl Artistic License, available in COPYING.
+ */
+
+/* Everything besides the patch file itself that changes what
+   load_instrument() makes of it: the output rate, then the tone bank
+   settings it was given. */
+#define CACHE_KEY_WORDS 9
+
+extern void set_instrument_cache(const char *dir);
+extern InstrumentLayer *load_cached_instrument(const char *name,
+					       const int32 *key);
+extern void save_cached_instrument(const char *name, const int32 *key,
+				   InstrumentLayer *lp);
+extern void release_cached_instrument(unsigned char *contents);
@@ -19,6 +19,7 @@
 #include "resample.h"
 #include "tables.h"
 #include "filter.h"
+#include "cache.h"
 
 /* Some functions get aggravated if not even the standard banks are 
    available. */
@@ -70,6 +71,8 @@ static void free_instrument(Instrument *ip)
     }
   if (ip->right_sample)
     free(ip->right_sample);
+  if (ip->contents)
+    release_cached_instrument(ip->contents);
   free(ip);
 }
 
@@ -250,6 +253,8 @@ static InstrumentLayer *load_instrument(const char *name, int font_type, int per
   int right_samples = 0;
   int stereo_channels = 1, stereo_layer;
   int vlayer_list[19][4], vlayer, vlayer_count = 0;
+  int32 cache_key[CACHE_KEY_WORDS];
+  char patch_name[PATH_MAX];
 
   if (!name) return 0;
   
@@ -282,6 +287,24 @@ static InstrumentLayer *load_instrument(const char *name, int font_type, int per
 		"Instrument `%s' can't be found.", name);
       return 0;
     }
+
+  /* The same patch loaded with the same settings before can be mapped
+     from the instrument cache */
+  strcpy(patch_name, current_filename);
+  cache_key[0] = play_mode->rate;
+  cache_key[1] = panning;
+  cache_key[2] = amp;
+  cache_key[3] = cfg_tuning;
+  cache_key[4] = note_to_use;
+  cache_key[5] = strip_loop;
+  cache_key[6] = strip_envelope;
+  cache_key[7] = strip_tail;
+  cache_key[8] = antialiasing_allowed;
+  if ((headlp = load_cached_instrument(patch_name, cache_key)))
+    {
+      close_file(fp);
+      return headlp;
+    }
       
   /*ctl->cmsg(CMSG_INFO, VERB_NOISY, "Loading instrument %s", current_filename);*/
   
@@ -669,7 +692,7 @@ static InstrumentLayer *load_instrument(const char *name, int font_type, int per
         {
 	  goto fail;
 	}
-      sp->data = safe_malloc(sp->data_length + 2);
+      sp->data = safe_malloc(sp->data_length + 6);
       lp->size += sp->data_length + 1;
 
       if (1 != fread(sp->data, sp->data_length, 1, fp))
@@ -680,7 +703,7 @@ static InstrumentLayer *load_instrument(const char *name, int font_type, int per
 	  int32 i=sp->data_length;
 	  uint8 *cp=(uint8 *)(sp->data);
 	  uint16 *tmp,*newdta;
-	  tmp=newdta=safe_malloc(sp->data_length*2 + 4);
+	  tmp=newdta=safe_malloc(sp->data_length*2 + 6);
 	  while (i--)
 	    *tmp++ = (uint16)(*cp++) << 8;
 	  cp=(uint8 *)(sp->data);
@@ -785,7 +808,9 @@ static InstrumentLayer *load_instrument(const char *name, int font_type, int per
 
       sp->loop_start /= 2;
       sp->loop_end /= 2;
-      sp->data[sp->data_length] = sp->data[sp->data_length+1] = 0;
+      /* Guard points for interpolating past the end; cubic reads 3 */
+      sp->data[sp->data_length] = sp->data[sp->data_length+1] =
+	sp->data[sp->data_length+2] = 0;
 
       /* Then fractional samples */
       sp->data_length <<= FRACTION_BITS;
@@ -841,12 +866,13 @@ static InstrumentLayer *load_instrument(const char *name, int font_type, int per
  } /* end of stereo layer loop */
  } /* end of vlayer loop */
 
+  save_cached_instrument(patch_name, cache_key, headlp);
 
   close_file(fp);
   return headlp;
 }
 
-static int fill_bank(int dr, int b)
+static int fill_bank(int dr, int b, int purge)
 {
   int i, errors=0;
   ToneBank *bank=((dr) ? drumset[b] : tonebank[b]);
@@ -919,7 +945,8 @@ static int fill_bank(int dr, int b)
 	    { /* it's loaded now */
 		bank->tone[i].last_used = current_tune_number;
 		current_patch_memory += bank->tone[i].layer->size;
-		purge_as_required();
+		if (purge)
+		  purge_as_required();
 		if (current_patch_memory > max_patch_memory) {
 	      		ctl->cmsg(CMSG_ERROR, VERB_NORMAL, 
 		   		"Not enough memory to load instrument %s (%s %d, program %d)",
@@ -969,15 +996,17 @@ static void purge_as_required(void)
 }
 
 
-int load_missing_instruments(void)
+/* Old instruments are only purged to make room if (purge) is set, since
+   they could still be playing in another song. */
+int load_missing_instruments(int purge)
 {
   int i=MAXBANK,errors=0;
   while (i--)
     {
       if (tonebank[i])
-	errors+=fill_bank(0,i);
+	errors+=fill_bank(0,i,purge);
       if (drumset[i])
-	errors+=fill_bank(1,i);
+	errors+=fill_bank(1,i,purge);
     }
   current_tune_number++;
   return errors;
@@ -145,7 +145,7 @@ extern int free_instruments_afterwards;
 
 #define SPECIAL_PROGRAM -1
 
-extern int load_missing_instruments(void);
+extern int load_missing_instruments(int purge);
 extern void free_instruments(void);
 extern void end_soundfont(void);
 extern int set_default_instrument(const char *name);
@@ -21,60 +21,60 @@
 #include "mix.h"
 
 /* Returns 1 if envelope runs out */
-int recompute_envelope(int v)
+int recompute_envelope(MidiSong *song, int v)
 {
   int stage;
 
-  stage = voice[v].envelope_stage;
+  stage = song->voice[v].envelope_stage;
 
   if (stage>5)
     {
       /* Envelope ran out. */
-      int tmp=(voice[v].status == VOICE_DIE); /* Already displayed as dead */
-      voice[v].status = VOICE_FREE;
+      int tmp=(song->voice[v].status == VOICE_DIE); /* Already displayed as dead */
+      song->voice[v].status = VOICE_FREE;
       if(!tmp)
 	ctl->note(v);
       return 1;
     }
 
-  if (voice[v].sample->modes & MODES_ENVELOPE)
+  if (song->voice[v].sample->modes & MODES_ENVELOPE)
     {
-      if (voice[v].status==VOICE_ON || voice[v].status==VOICE_SUSTAINED)
+      if (song->voice[v].status==VOICE_ON || song->voice[v].status==VOICE_SUSTAINED)
 	{
 	  if (stage>2)
 	    {
 	      /* Freeze envelope until note turns off. Trumpets want this. */
-	      voice[v].envelope_increment=0;
+	      song->voice[v].envelope_increment=0;
 	      return 0;
 	    }
 	}
     }
-  voice[v].envelope_stage=stage+1;
-
-  if (voice[v].envelope_volume==voice[v].sample->envelope_offset[stage])
-    return recompute_envelope(v);
-  voice[v].envelope_target=voice[v].sample->envelope_offset[stage];
-  voice[v].envelope_increment = voice[v].sample->envelope_rate[stage];
-  if (voice[v].envelope_target<voice[v].envelope_volume)
-    voice[v].envelope_increment = -voice[v].envelope_increment;
+  song->voice[v].envelope_stage=stage+1;
+
+  if (song->voice[v].envelope_volume==song->voice[v].sample->envelope_offset[stage])
+    return recompute_envelope(song, v);
+  song->voice[v].envelope_target=song->voice[v].sample->envelope_offset[stage];
+  song->voice[v].envelope_increment = song->voice[v].sample->envelope_rate[stage];
+  if (song->voice[v].envelope_target<song->voice[v].envelope_volume)
+    song->voice[v].envelope_increment = -song->voice[v].envelope_increment;
   return 0;
 }
 
-void apply_envelope_to_amp(int v)
+void apply_envelope_to_amp(MidiSong *song, int v)
 {
-  FLOAT_T lamp=voice[v].left_amp, ramp, lramp, rramp, ceamp, lfeamp;
+  FLOAT_T lamp=song->voice[v].left_amp, ramp, lramp, rramp, ceamp, lfeamp;
   int32 la,ra, lra, rra, cea, lfea;
-  if (voice[v].panned == PANNED_MYSTERY)
+  if (song->voice[v].panned == PANNED_MYSTERY)
     {
-      lramp=voice[v].lr_amp;
-      ramp=voice[v].right_amp;
-      ceamp=voice[v].ce_amp;
-      rramp=voice[v].rr_amp;
-      lfeamp=voice[v].lfe_amp;
+      lramp=song->voice[v].lr_amp;
+      ramp=song->voice[v].right_amp;
+      ceamp=song->voice[v].ce_amp;
+      rramp=song->voice[v].rr_amp;
+      lfeamp=song->voice[v].lfe_amp;
 
-      if (voice[v].tremolo_phase_increment)
+      if (song->voice[v].tremolo_phase_increment)
 	{
-	  FLOAT_T tv = voice[v].tremolo_volume;
+	  FLOAT_T tv = song->voice[v].tremolo_volume;
 	  lramp *= tv;
 	  lamp *= tv;
 	  ceamp *= tv;
@@ -82,9 +82,9 @@ void apply_envelope_to_amp(int v)
 	  rramp *= tv;
 	  lfeamp *= tv;
 	}
-      if (voice[v].sample->modes & MODES_ENVELOPE)
+      if (song->voice[v].sample->modes & MODES_ENVELOPE)
 	{
-	  FLOAT_T ev = (FLOAT_T)vol_table[voice[v].envelope_volume>>23];
+	  FLOAT_T ev = (FLOAT_T)vol_table[song->voice[v].envelope_volume>>23];
 	  lramp *= ev;
 	  lamp *= ev;
 	  ceamp *= ev;
@@ -107,71 +107,71 @@ void apply_envelope_to_amp(int v)
       if (cea>MAX_AMP_VALUE) cea=MAX_AMP_VALUE;
       if (lfea>MAX_AMP_VALUE) lfea=MAX_AMP_VALUE;
 
-      voice[v].lr_mix=FINAL_VOLUME(lra);
-      voice[v].left_mix=FINAL_VOLUME(la);
-      voice[v].ce_mix=FINAL_VOLUME(cea);
-      voice[v].right_mix=FINAL_VOLUME(ra);
-      voice[v].rr_mix=FINAL_VOLUME(rra);
-      voice[v].lfe_mix=FINAL_VOLUME(lfea);
+      song->voice[v].lr_mix=FINAL_VOLUME(lra);
+      song->voice[v].left_mix=FINAL_VOLUME(la);
+      song->voice[v].ce_mix=FINAL_VOLUME(cea);
+      song->voice[v].right_mix=FINAL_VOLUME(ra);
+      song->voice[v].rr_mix=FINAL_VOLUME(rra);
+      song->voice[v].lfe_mix=FINAL_VOLUME(lfea);
     }
   else
     {
-      if (voice[v].tremolo_phase_increment)
-	lamp *= voice[v].tremolo_volume;
-      if (voice[v].sample->modes & MODES_ENVELOPE)
-	lamp *= (FLOAT_T)vol_table[voice[v].envelope_volume>>23];
+      if (song->voice[v].tremolo_phase_increment)
+	lamp *= song->voice[v].tremolo_volume;
+      if (song->voice[v].sample->modes & MODES_ENVELOPE)
+	lamp *= (FLOAT_T)vol_table[song->voice[v].envelope_volume>>23];
 
       la = (int32)FSCALE(lamp,AMP_BITS);
 
       if (la>MAX_AMP_VALUE)
 	la=MAX_AMP_VALUE;
 
-      voice[v].left_mix=FINAL_VOLUME(la);
+      song->voice[v].left_mix=FINAL_VOLUME(la);
     }
 }
 
-static int update_envelope(int v)
+static int update_envelope(MidiSong *song, int v)
 {
-  voice[v].envelope_volume += voice[v].envelope_increment;
+  song->voice[v].envelope_volume += song->voice[v].envelope_increment;
   /* Why is there no ^^ operator?? */
-  if (((voice[v].envelope_increment < 0) &&
-       (voice[v].envelope_volume <= voice[v].envelope_target)) ||
-      ((voice[v].envelope_increment > 0) &&
-	   (voice[v].envelope_volume >= voice[v].envelope_target)))
+  if (((song->voice[v].envelope_increment < 0) &&
+       (song->voice[v].envelope_volume <= song->voice[v].envelope_target)) ||
+      ((song->voice[v].envelope_increment > 0) &&
+	   (song->voice[v].envelope_volume >= song->voice[v].envelope_target)))
     {
-      voice[v].envelope_volume = voice[v].envelope_target;
-      if (recompute_envelope(v))
+      song->voice[v].envelope_volume = song->voice[v].envelope_target;
+      if (recompute_envelope(song, v))
 	return 1;
     }
   return 0;
 }
 
-static void update_tremolo(int v)
+static void update_tremolo(MidiSong *song, int v)
 {
-  int32 depth=voice[v].sample->tremolo_depth<<7;
+  int32 depth=song->voice[v].sample->tremolo_depth<<7;
 
-  if (voice[v].tremolo_sweep)
+  if (song->voice[v].tremolo_sweep)
     {
       /* Update sweep position */
 
-      voice[v].tremolo_sweep_position += voice[v].tremolo_sweep;
-      if (voice[v].tremolo_sweep_position>=(1<<SWEEP_SHIFT))
-	voice[v].tremolo_sweep=0; /* Swept to max amplitude */
+      song->voice[v].tremolo_sweep_position += song->voice[v].tremolo_sweep;
+      if (song->voice[v].tremolo_sweep_position>=(1<<SWEEP_SHIFT))
+	song->voice[v].tremolo_sweep=0; /* Swept to max amplitude */
       else
 	{
 	  /* Need to adjust depth */
-	  depth *= voice[v].tremolo_sweep_position;
+	  depth *= song->voice[v].tremolo_sweep_position;
 	  depth >>= SWEEP_SHIFT;
 	}
     }
 
-  voice[v].tremolo_phase += voice[v].tremolo_phase_increment;
+  song->voice[v].tremolo_phase += song->voice[v].tremolo_phase_increment;
 
-  /* if (voice[v].tremolo_phase >= (SINE_CYCLE_LENGTH<<RATE_SHIFT))
-     voice[v].tremolo_phase -= SINE_CYCLE_LENGTH<<RATE_SHIFT;  */
+  /* if (song->voice[v].tremolo_phase >= (SINE_CYCLE_LENGTH<<RATE_SHIFT))
+     song->voice[v].tremolo_phase -= SINE_CYCLE_LENGTH<<RATE_SHIFT;  */
 
-  voice[v].tremolo_volume = (FLOAT_T) 
-    (1.0 - FSCALENEG((sine(voice[v].tremolo_phase >> RATE_SHIFT) + 1.0)
+  song->voice[v].tremolo_volume = (FLOAT_T) 
+    (1.0 - FSCALENEG((sine(song->voice[v].tremolo_phase >> RATE_SHIFT) + 1.0)
 		    * depth * TREMOLO_AMPLITUDE_TUNING,
 		    17));
 
@@ -180,15 +180,15 @@ static void update_tremolo(int v)
 }
 
 /* Returns 1 if the note died */
-static int update_signal(int v)
+static int update_signal(MidiSong *song, int v)
 {
-  if (voice[v].envelope_increment && update_envelope(v))
+  if (song->voice[v].envelope_increment && update_envelope(song, v))
     return 1;
 
-  if (voice[v].tremolo_phase_increment)
-    update_tremolo(v);
+  if (song->voice[v].tremolo_phase_increment)
+    update_tremolo(song, v);
 
-  apply_envelope_to_amp(v);
+  apply_envelope_to_amp(song, v);
   return 0;
 }
 
@@ -203,9 +203,71 @@ static int update_signal(int v)
 #define MIXCENT(a,b) *lp++ += (a/2+b/2) * s
 #define MIXHALF(a)	*lp++ += (a>>1)*s;
 
-static void mix_mystery_signal(resample_t *sp, int32 *lp, int v, int count)
+#ifdef RESAMPLE_MIX
+/* The gain of each output channel, laid out the way the mix_*()
+   functions that resample_mix() replaced used to apply them */
+static void voice_gains(MidiSong *song, int v, int signal, int32 *gain)
 {
-  Voice *vp = voice + v;
+  Voice *vp = song->voice + v;
+  final_volume_t left = vp->left_mix;
+  int c, r;
+
+  for (c = 0; c < 6; c++)
+    gain[c] = 0;
+
+  if (play_mode->encoding & PE_MONO)
+    gain[0] = left;
+  else if (vp->panned == PANNED_MYSTERY)
+    {
+      gain[0] = left;
+      gain[1] = vp->right_mix;
+      gain[2] = vp->lr_mix;
+      gain[3] = vp->rr_mix;
+      gain[4] = vp->ce_mix;
+      gain[5] = vp->lfe_mix;
+    }
+  else if (vp->panned == PANNED_CENTER)
+    {
+      if (num_ochannels == 2)
+	gain[0] = gain[1] = left;
+      else if (num_ochannels == 4)
+	{
+	  /* mix_center() and mix_center_signal() never agreed on this */
+	  gain[0] = left;
+	  gain[signal ? 2 : 1] = left;
+	}
+      else if (num_ochannels == 6)
+	gain[4] = gain[5] = left;
+    }
+  else
+    {
+      /* Full left or full right */
+      r = (vp->panned == PANNED_RIGHT);
+      if (num_ochannels == 2)
+	gain[r] = left;
+      if (num_ochannels >= 4)
+	{
+	  gain[r] = left >> 1;
+	  gain[2 + r] = left;
+	}
+      if (num_ochannels == 6)
+	gain[5] = left;
+    }
+}
+
+static int signal_gains(MidiSong *song, int v, int32 *gain)
+{
+  if (update_signal(song, v))
+    return 1;	/* Envelope ran out */
+  voice_gains(song, v, 1, gain);
+  return 0;
+}
+
+#else /* RESAMPLE_MIX */
+
+static void mix_mystery_signal(MidiSong *song, resample_t *sp, int32 *lp, int v, int count)
+{
+  Voice *vp = song->voice + v;
   final_volume_t 
     left_rear=vp->lr_mix, 
     left=vp->left_mix, 
@@ -219,7 +281,7 @@ static void mix_mystery_signal(resample_t *sp, int32 *lp, int v, int count)
   if (!(cc = vp->control_counter))
     {
       cc = control_ratio;
-      if (update_signal(v))
+      if (update_signal(song, v))
 	return;	/* Envelope ran out */
 
 	left_rear = vp->lr_mix;
@@ -249,7 +311,7 @@ static void mix_mystery_signal(resample_t *sp, int32 *lp, int v, int count)
 		}
 	  }
 	cc = control_ratio;
-	if (update_signal(v))
+	if (update_signal(song, v))
 	  return;	/* Envelope ran out */
 	left_rear = vp->lr_mix;
 	left = vp->left_mix;
@@ -279,9 +341,9 @@ static void mix_mystery_signal(resample_t *sp, int32 *lp, int v, int count)
       }
 }
 
-static void mix_center_signal(resample_t *sp, int32 *lp, int v, int count)
+static void mix_center_signal(MidiSong *song, resample_t *sp, int32 *lp, int v, int count)
 {
-  Voice *vp = voice + v;
+  Voice *vp = song->voice + v;
   final_volume_t 
     left=vp->left_mix;
   int cc;
@@ -290,7 +352,7 @@ static void mix_center_signal(resample_t *sp, int32 *lp, int v, int count)
   if (!(cc = vp->control_counter))
     {
       cc = control_ratio;
-      if (update_signal(v))
+      if (update_signal(song, v))
 	return;	/* Envelope ran out */
       left = vp->left_mix;
     }
@@ -322,7 +384,7 @@ static void mix_center_signal(resample_t *sp, int32 *lp, int v, int count)
 		}
 	  }
 	cc = control_ratio;
-	if (update_signal(v))
+	if (update_signal(song, v))
 	  return;	/* Envelope ran out */
 	left = vp->left_mix;
       }
@@ -355,9 +417,9 @@ static void mix_center_signal(resample_t *sp, int32 *lp, int v, int count)
       }
 }
 
-static void mix_single_left_signal(resample_t *sp, int32 *lp, int v, int count)
+static void mix_single_left_signal(MidiSong *song, resample_t *sp, int32 *lp, int v, int count)
 {
-  Voice *vp = voice + v;
+  Voice *vp = song->voice + v;
   final_volume_t 
     left=vp->left_mix;
   int cc;
@@ -366,7 +428,7 @@ static void mix_single_left_signal(resample_t *sp, int32 *lp, int v, int count)
   if (!(cc = vp->control_counter))
     {
       cc = control_ratio;
-      if (update_signal(v))
+      if (update_signal(song, v))
 	return;	/* Envelope ran out */
       left = vp->left_mix;
     }
@@ -394,7 +456,7 @@ static void mix_single_left_signal(resample_t *sp, int32 *lp, int v, int count)
 		}
 	  }
 	cc = control_ratio;
-	if (update_signal(v))
+	if (update_signal(song, v))
 	  return;	/* Envelope ran out */
 	left = vp->left_mix;
       }
@@ -423,9 +485,9 @@ static void mix_single_left_signal(resample_t *sp, int32 *lp, int v, int count)
       }
 }
 
-static void mix_single_right_signal(resample_t *sp, int32 *lp, int v, int count)
+static void mix_single_right_signal(MidiSong *song, resample_t *sp, int32 *lp, int v, int count)
 {
-  Voice *vp = voice + v;
+  Voice *vp = song->voice + v;
   final_volume_t 
     left=vp->left_mix;
   int cc;
@@ -434,7 +496,7 @@ static void mix_single_right_signal(resample_t *sp, int32 *lp, int v, int count)
   if (!(cc = vp->control_counter))
     {
       cc = control_ratio;
-      if (update_signal(v))
+      if (update_signal(song, v))
 	return;	/* Envelope ran out */
       left = vp->left_mix;
     }
@@ -461,7 +523,7 @@ static void mix_single_right_signal(resample_t *sp, int32 *lp, int v, int count)
 		}
 	  }
 	cc = control_ratio;
-	if (update_signal(v))
+	if (update_signal(song, v))
 	  return;	/* Envelope ran out */
 	left = vp->left_mix;
       }
@@ -489,9 +551,9 @@ static void mix_single_right_signal(resample_t *sp, int32 *lp, int v, int count)
       }
 }
 
-static void mix_mono_signal(resample_t *sp, int32 *lp, int v, int count)
+static void mix_mono_signal(MidiSong *song, resample_t *sp, int32 *lp, int v, int count)
 {
-  Voice *vp = voice + v;
+  Voice *vp = song->voice + v;
   final_volume_t 
     left=vp->left_mix;
   int cc;
@@ -500,7 +562,7 @@ static void mix_mono_signal(resample_t *sp, int32 *lp, int v, int count)
   if (!(cc = vp->control_counter))
     {
       cc = control_ratio;
-      if (update_signal(v))
+      if (update_signal(song, v))
 	return;	/* Envelope ran out */
       left = vp->left_mix;
     }
@@ -515,7 +577,7 @@ static void mix_mono_signal(resample_t *sp, int32 *lp, int v, int count)
 	    MIXATION(left);
 	  }
 	cc = control_ratio;
-	if (update_signal(v))
+	if (update_signal(song, v))
 	  return;	/* Envelope ran out */
 	left = vp->left_mix;
       }
@@ -531,15 +593,15 @@ static void mix_mono_signal(resample_t *sp, int32 *lp, int v, int count)
       }
 }
 
-static void mix_mystery(resample_t *sp, int32 *lp, int v, int count)
+static void mix_mystery(MidiSong *song, resample_t *sp, int32 *lp, int v, int count)
 {
   final_volume_t 
-    left_rear=voice[v].lr_mix, 
-    left=voice[v].left_mix, 
-    center=voice[v].ce_mix, 
-    right=voice[v].right_mix, 
-    right_rear=voice[v].rr_mix, 
-    lfe=voice[v].lfe_mix;
+    left_rear=song->voice[v].lr_mix, 
+    left=song->voice[v].left_mix, 
+    center=song->voice[v].ce_mix, 
+    right=song->voice[v].right_mix, 
+    right_rear=song->voice[v].rr_mix, 
+    lfe=song->voice[v].lfe_mix;
   resample_t s;
   
   while (count--)
@@ -558,10 +620,10 @@ static void mix_mystery(resample_t *sp, int32 *lp, int v, int count)
     }
 }
 
-static void mix_center(resample_t *sp, int32 *lp, int v, int count)
+static void mix_center(MidiSong *song, resample_t *sp, int32 *lp, int v, int count)
 {
   final_volume_t 
-    left=voice[v].left_mix;
+    left=song->voice[v].left_mix;
   resample_t s;
   
   while (count--)
@@ -588,10 +650,10 @@ static void mix_center(resample_t *sp, int32 *lp, int v, int count)
     }
 }
 
-static void mix_single_left(resample_t *sp, int32 *lp, int v, int count)
+static void mix_single_left(MidiSong *song, resample_t *sp, int32 *lp, int v, int count)
 {
   final_volume_t 
-    left=voice[v].left_mix;
+    left=song->voice[v].left_mix;
   resample_t s;
   
   while (count--)
@@ -613,10 +675,10 @@ static void mix_single_left(resample_t *sp, int32 *lp, int v, int count)
 		}
     }
 }
-static void mix_single_right(resample_t *sp, int32 *lp, int v, int count)
+static void mix_single_right(MidiSong *song, resample_t *sp, int32 *lp, int v, int count)
 {
   final_volume_t 
-    left=voice[v].left_mix;
+    left=song->voice[v].left_mix;
   resample_t s;
   
   while (count--)
@@ -639,10 +701,10 @@ static void mix_single_right(resample_t *sp, int32 *lp, int v, int count)
     }
 }
 
-static void mix_mono(resample_t *sp, int32 *lp, int v, int count)
+static void mix_mono(MidiSong *song, resample_t *sp, int32 *lp, int v, int count)
 {
   final_volume_t 
-    left=voice[v].left_mix;
+    left=song->voice[v].left_mix;
   resample_t s;
   
   while (count--)
@@ -652,8 +714,10 @@ static void mix_mono(resample_t *sp, int32 *lp, int v, int count)
     }
 }
 
+#endif /* RESAMPLE_MIX */
+
 /* Ramp a note out in c samples */
-static void ramp_out(resample_t *sp, int32 *lp, int v, int32 c)
+static void ramp_out(MidiSong *song, resample_t *sp, int32 *lp, int v, int32 c)
 {
 
   /* should be final_volume_t, but uint8 gives trouble. */
@@ -664,7 +728,7 @@ static void ramp_out(resample_t *sp, int32 *lp, int v, int32 c)
   /* Fix by James Caldwell */
   if ( c == 0 ) c = 1;
 
-  left = voice[v].left_mix;
+  left = song->voice[v].left_mix;
   li = -(left/c);
   if (!li) li = -1;
 
@@ -672,13 +736,13 @@ static void ramp_out(resample_t *sp, int32 *lp, int v, int32 c)
 
   if (!(play_mode->encoding & PE_MONO))
     {
-      if (voice[v].panned==PANNED_MYSTERY)
+      if (song->voice[v].panned==PANNED_MYSTERY)
 	{
-	  left_rear = voice[v].lr_mix;
-	  center=voice[v].ce_mix;
-	  right=voice[v].right_mix;
-	  right_rear = voice[v].rr_mix;
-	  lfe = voice[v].lfe_mix;
+	  left_rear = song->voice[v].lr_mix;
+	  center=song->voice[v].ce_mix;
+	  right=song->voice[v].right_mix;
+	  right_rear = song->voice[v].rr_mix;
+	  lfe = song->voice[v].lfe_mix;
 
 	  ri=-(right/c);
 	  while (c--)
@@ -702,7 +766,7 @@ static void ramp_out(resample_t *sp, int32 *lp, int v, int32 c)
 		}
 	    }
 	}
-      else if (voice[v].panned==PANNED_CENTER)
+      else if (song->voice[v].panned==PANNED_CENTER)
 	{
 	  while (c--)
 	    {
@@ -730,7 +794,7 @@ static void ramp_out(resample_t *sp, int32 *lp, int v, int32 c)
 		}
 	    }
 	}
-      else if (voice[v].panned==PANNED_LEFT)
+      else if (song->voice[v].panned==PANNED_LEFT)
 	{
 	  while (c--)
 	    {
@@ -749,7 +813,7 @@ static void ramp_out(resample_t *sp, int32 *lp, int v, int32 c)
 		}
 	    }
 	}
-      else if (voice[v].panned==PANNED_RIGHT)
+      else if (song->voice[v].panned==PANNED_RIGHT)
 	{
 	  while (c--)
 	    {
@@ -786,9 +850,9 @@ static void ramp_out(resample_t *sp, int32 *lp, int v, int32 c)
 
 /**************** interface function ******************/
 
-void mix_voice(int32 *buf, int v, int32 c)
+void mix_voice(MidiSong *song, int32 *buf, resample_t *rbuf, int v, int32 c)
 {
-  Voice *vp=voice+v;
+  Voice *vp=song->voice+v;
   int32 count=c;
   resample_t *sp;
   if (c<0) return;
@@ -796,37 +860,46 @@ void mix_voice(int32 *buf, int v, int32 c)
     {
       if (count>=MAX_DIE_TIME)
 	count=MAX_DIE_TIME;
-      sp=resample_voice(v, &count);
-      ramp_out(sp, buf, v, count);
+      sp=resample_voice(song, rbuf, v, &count);
+      ramp_out(song, sp, buf, v, count);
       vp->status=VOICE_FREE;
     }
   else
     {
-      sp=resample_voice(v, &count);
+#ifdef RESAMPLE_MIX
+      int32 gain[6];
+      int signal = (vp->envelope_increment || vp->tremolo_phase_increment);
+
+      voice_gains(song, v, signal, gain);
+      resample_mix(song, rbuf, v, count, buf,
+		   (play_mode->encoding & PE_MONO) ? 1 : num_ochannels,
+		   gain, signal ? signal_gains : NULL);
+#else
+      sp=resample_voice(song, rbuf, v, &count);
       if (count<0) return;
       if (play_mode->encoding & PE_MONO)
 	{
 	  /* Mono output. */
 	  if (vp->envelope_increment || vp->tremolo_phase_increment)
-	    mix_mono_signal(sp, buf, v, count);
+	    mix_mono_signal(song, sp, buf, v, count);
 	  else
-	    mix_mono(sp, buf, v, count);
+	    mix_mono(song, sp, buf, v, count);
 	}
       else
 	{
 	  if (vp->panned == PANNED_MYSTERY)
 	    {
 	      if (vp->envelope_increment || vp->tremolo_phase_increment)
-		mix_mystery_signal(sp, buf, v, count);
+		mix_mystery_signal(song, sp, buf, v, count);
 	      else
-		mix_mystery(sp, buf, v, count);
+		mix_mystery(song, sp, buf, v, count);
 	    }
 	  else if (vp->panned == PANNED_CENTER)
 	    {
 	      if (vp->envelope_increment || vp->tremolo_phase_increment)
-		mix_center_signal(sp, buf, v, count);
+		mix_center_signal(song, sp, buf, v, count);
 	      else
-		mix_center(sp, buf, v, count);
+		mix_center(song, sp, buf, v, count);
 	    }
 	  else
 	    { 
@@ -836,16 +909,17 @@ void mix_voice(int32 *buf, int v, int32 c)
 	      if (vp->envelope_increment || vp->tremolo_phase_increment)
 	      {
 	        if (vp->panned == PANNED_RIGHT)
-			mix_single_right_signal(sp, buf, v, count);
-		else mix_single_left_signal(sp, buf, v, count);
+			mix_single_right_signal(song, sp, buf, v, count);
+		else mix_single_left_signal(song, sp, buf, v, count);
 	      }
 	      else 
 	      {
 	        if (vp->panned == PANNED_RIGHT)
-			mix_single_right(sp, buf, v, count);
-		else mix_single_left(sp, buf, v, count);
+			mix_single_right(song, sp, buf, v, count);
+		else mix_single_left(song, sp, buf, v, count);
 	      }
 	    }
 	}
+#endif /* RESAMPLE_MIX */
     }
 }
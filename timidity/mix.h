@@ -6,6 +6,7 @@
     it under the terms of the Perl Artistic License, available in COPYING.
  */
 
-extern void mix_voice(int32 *buf, int v, int32 c);
-extern int recompute_envelope(int v);
-extern void apply_envelope_to_amp(int v);
+extern void mix_voice(MidiSong *song, int32 *buf, resample_t *rbuf, int v,
+		      int32 c);
+extern int recompute_envelope(MidiSong *song, int v);
+extern void apply_envelope_to_amp(MidiSong *song, int v);
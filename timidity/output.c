@@ -108,6 +108,16 @@ void s32tou16x(void *dp, int32 *lp, int32 c)
     }
 }
 
+void s32tof32(void *dp, int32 *lp, int32 c)
+{
+  float *fp=(float *)(dp);
+  while (c--)
+    {
+      /* full scale is where 16-bit output clips, float doesn't */
+      *fp++ = (float)(*lp++) * (1.0f / (float)(1L<<(31-GUARD_BITS)));
+    }
+}
+
 void s32toulaw(void *dp, int32 *lp, int32 c)
 {
   uint8 *up=(uint8 *)(dp);
@@ -28,6 +28,9 @@ extern int init_buffers(int kbytes);
 /* The size of the output buffers */
 extern int AUDIO_BUFFER_SIZE;
 
+/* The SDL audio format it's all converted to */
+extern int output_format;
+
 /* Actual copy function */
 extern void (*s32tobuf)(void *dp, int32 *lp, int32 c);
 
@@ -43,6 +46,9 @@ extern void s32tou16(void *dp, int32 *lp, int32 c);
 extern void s32tos16x(void *dp, int32 *lp, int32 c);
 extern void s32tou16x(void *dp, int32 *lp, int32 c);
 
+/* native float, unclipped */
+extern void s32tof32(void *dp, int32 *lp, int32 c);
+
 /* uLaw (8 bits) */
 extern void s32toulaw(void *dp, int32 *lp, int32 c);
 
@@ -11,10 +11,14 @@
 #include <string.h>
 
 #include <SDL_rwops.h>
+#include <SDL_mutex.h>
+#include <SDL_thread.h>
+#include <SDL_audio.h>
 
 #include "config.h"
 #include "common.h"
 #include "instrum.h"
+#include "cache.h"
 #include "playmidi.h"
 #include "readmidi.h"
 #include "output.h"
@@ -30,126 +34,92 @@ static int opt_volume_curve = 2;
 static int opt_stereo_surround = 0;
 
 
-Channel channel[MAXCHAN];
-Voice voice[MAX_VOICES];
-signed char drumvolume[MAXCHAN][MAXNOTE];
-signed char drumpanpot[MAXCHAN][MAXNOTE];
-signed char drumreverberation[MAXCHAN][MAXNOTE];
-signed char drumchorusdepth[MAXCHAN][MAXNOTE];
-
-int
-    voices=DEFAULT_VOICES;
-
-int32
-    control_ratio=0,
-    amplification=DEFAULT_AMPLIFICATION;
-
-FLOAT_T
-    master_volume;
+int32 control_ratio=0;
 
 int32 drumchannels=DEFAULT_DRUMCHANNELS;
 int adjust_panning_immediately=0;
 
-struct _MidiSong {
-	int32 samples;
-	MidiEvent *events;
-};
-static int midi_playing = 0;
-static int32 lost_notes, cut_notes;
-static int32 *buffer_pointer;
-static int32 buffered_count;
-extern int32 *common_buffer;
-extern resample_t *resample_buffer; /* to free it on Timidity_Close */
-
-static MidiEvent *event_list, *current_event;
-static int32 sample_count, current_sample;
-
-int GM_System_On=0;
-int XG_System_On=0;
-int GS_System_On=0;
-int XG_System_reverb_type;
-int XG_System_chorus_type;
-int XG_System_variation_type;
+/* Loading songs and instruments touches the shared tone banks, so it's
+   done under this lock.  Rendering only reads the banks, and instruments
+   aren't purged or freed while any song is playing. */
+extern SDL_mutex *bank_lock;
+static int songs_playing = 0;
 
-
-static void adjust_amplification(void)
+static void adjust_amplification(MidiSong *song)
 { 
-  master_volume = (FLOAT_T)(amplification) / (FLOAT_T)100.0;
-  master_volume /= 2;
+  song->master_volume = (FLOAT_T)(song->amplification) / (FLOAT_T)100.0;
+  song->master_volume /= 2;
 }
 
 
-static void adjust_master_volume(int32 vol)
+static void adjust_master_volume(MidiSong *song, int32 vol)
 { 
-  master_volume = (double)(vol*amplification) / 1638400.0L;
-  master_volume /= 2;
+  song->master_volume = (double)(vol*song->amplification) / 1638400.0L;
+  song->master_volume /= 2;
 }
 
 
-static void reset_voices(void)
+static void reset_voices(MidiSong *song)
 {
   int i;
   for (i=0; i<MAX_VOICES; i++)
-    voice[i].status=VOICE_FREE;
+    song->voice[i].status=VOICE_FREE;
 }
 
 /* Process the Reset All Controllers event */
-static void reset_controllers(int c)
+static void reset_controllers(MidiSong *song, int c)
 {
-  channel[c].volume=90; /* Some standard says, although the SCC docs say 0. */
-  channel[c].expression=127; /* SCC-1 does this. */
-  channel[c].sustain=0;
-  channel[c].pitchbend=0x2000;
-  channel[c].pitchfactor=0; /* to be computed */
-
-  channel[c].reverberation = 0;
-  channel[c].chorusdepth = 0;
+  song->channel[c].volume=90; /* Some standard says, although the SCC docs say 0. */
+  song->channel[c].expression=127; /* SCC-1 does this. */
+  song->channel[c].sustain=0;
+  song->channel[c].pitchbend=0x2000;
+  song->channel[c].pitchfactor=0; /* to be computed */
+
+  song->channel[c].reverberation = 0;
+  song->channel[c].chorusdepth = 0;
 }
 
-static void redraw_controllers(int c)
+static void redraw_controllers(MidiSong *song, int c)
 {
-  ctl->volume(c, channel[c].volume);
-  ctl->expression(c, channel[c].expression);
-  ctl->sustain(c, channel[c].sustain);
-  ctl->pitch_bend(c, channel[c].pitchbend);
+  ctl->volume(c, song->channel[c].volume);
+  ctl->expression(c, song->channel[c].expression);
+  ctl->sustain(c, song->channel[c].sustain);
+  ctl->pitch_bend(c, song->channel[c].pitchbend);
 }
 
-static void reset_midi(void)
+static void reset_midi(MidiSong *song)
 {
   int i;
   for (i=0; i<MAXCHAN; i++)
     {
-      reset_controllers(i);
+      reset_controllers(song, i);
       /* The rest of these are unaffected by the Reset All Controllers event */
-      channel[i].program=default_program;
-      channel[i].panning=NO_PANNING;
-      channel[i].pitchsens=2;
-      channel[i].bank=0; /* tone bank or drum set */
-      channel[i].harmoniccontent=64,
-      channel[i].releasetime=64,
-      channel[i].attacktime=64,
-      channel[i].brightness=64,
-      channel[i].sfx=0;
+      song->channel[i].program=default_program;
+      song->channel[i].panning=NO_PANNING;
+      song->channel[i].pitchsens=2;
+      song->channel[i].bank=0; /* tone bank or drum set */
+      song->channel[i].harmoniccontent=64,
+      song->channel[i].releasetime=64,
+      song->channel[i].attacktime=64,
+      song->channel[i].brightness=64,
+      song->channel[i].sfx=0;
     }
-  reset_voices();
+  reset_voices(song);
 }
 
-static void select_sample(int v, Instrument *ip)
+static void select_sample(MidiSong *song, int v, Sample *sp, int s)
 {
   int32 f, cdiff, diff, midfreq;
-  int s,i;
-  Sample *sp, *closest;
-
-  s=ip->samples;
-  sp=ip->sample;
+  int i;
+  Sample *closest;
 
   if (s==1)
     {
-      voice[v].sample=sp;
+      song->voice[v].sample=sp;
       return;
     }
 
-  f=voice[v].orig_frequency;
+  f=song->voice[v].orig_frequency;
   /* 
      No suitable sample found! We'll select the sample whose root
      frequency is closest to the one we want. (Actually we should
@@ -157,7 +127,7 @@ static void select_sample(int v, Instrument *ip)
      values and compare those.) */
 
   cdiff=0x7FFFFFFF;
-  closest=sp=ip->sample;
+  closest=sp;
   midfreq = (sp->low_freq + sp->high_freq) / 2;
   for(i=0; i<s; i++)
     {
@@ -174,13 +144,13 @@ static void select_sample(int v, Instrument *ip)
 	}
       sp++;
     }
-  voice[v].sample=closest;
+  song->voice[v].sample=closest;
   return;
 }
 
 
 
-static void select_stereo_samples(int v, InstrumentLayer *lp)
+static void select_stereo_samples(MidiSong *song, int v, InstrumentLayer *lp)
 {
   Instrument *ip;
   InstrumentLayer *nlp, *bestvel;
@@ -192,9 +162,9 @@ static void select_stereo_samples(int v, InstrumentLayer *lp)
   for (nlp = lp; nlp; nlp = nlp->next) {
 	midvel = (nlp->hi + nlp->lo)/2;
 	if (!midvel) diffvel = 127;
-	else if (voice[v].velocity < nlp->lo || voice[v].velocity > nlp->hi)
+	else if (song->voice[v].velocity < nlp->lo || song->voice[v].velocity > nlp->hi)
 		diffvel = 200;
-	else diffvel = voice[v].velocity - midvel;
+	else diffvel = song->voice[v].velocity - midvel;
 	if (diffvel < 0) diffvel = -diffvel;
 	if (diffvel < mindiff) {
 		mindiff = diffvel;
@@ -203,73 +173,70 @@ static void select_stereo_samples(int v, InstrumentLayer *lp)
   }
   ip = bestvel->instrument;
 
+  /* The instrument is shared with other songs, so it's left untouched */
   if (ip->right_sample) {
-    ip->sample = ip->right_sample;
-    ip->samples = ip->right_samples;
-    select_sample(v, ip);
-    voice[v].right_sample = voice[v].sample;
+    select_sample(song, v, ip->right_sample, ip->right_samples);
+    song->voice[v].right_sample = song->voice[v].sample;
   }
-  else voice[v].right_sample = 0;
-  ip->sample = ip->left_sample;
-  ip->samples = ip->left_samples;
-  select_sample(v, ip);
+  else song->voice[v].right_sample = 0;
+  select_sample(song, v, ip->left_sample, ip->left_samples);
 }
 
 
-static void recompute_freq(int v)
+static void recompute_freq(MidiSong *song, int v)
 {
   int 
-    sign=(voice[v].sample_increment < 0), /* for bidirectional loops */
-    pb=channel[voice[v].channel].pitchbend;
+    sign=(song->voice[v].sample_increment < 0), /* for bidirectional loops */
+    pb=song->channel[song->voice[v].channel].pitchbend;
   double a;
   
-  if (!voice[v].sample->sample_rate)
+  if (!song->voice[v].sample->sample_rate)
     return;
 
-  if (voice[v].vibrato_control_ratio)
+  if (song->voice[v].vibrato_control_ratio)
     {
       /* This instrument has vibrato. Invalidate any precomputed
          sample_increments. */
 
       int i=VIBRATO_SAMPLE_INCREMENTS;
       while (i--)
-	voice[v].vibrato_sample_increment[i]=0;
+	song->voice[v].vibrato_sample_increment[i]=0;
     }
 
   if (pb==0x2000 || pb<0 || pb>0x3FFF)
-    voice[v].frequency=voice[v].orig_frequency;
+    song->voice[v].frequency=song->voice[v].orig_frequency;
   else
     {
       pb-=0x2000;
-      if (!(channel[voice[v].channel].pitchfactor))
+      if (!(song->channel[song->voice[v].channel].pitchfactor))
 	{
 	  /* Damn. Somebody bent the pitch. */
-	  int32 i=pb*channel[voice[v].channel].pitchsens;
+	  int32 i=pb*song->channel[song->voice[v].channel].pitchsens;
 	  if (pb<0)
 	    i=-i;
-	  channel[voice[v].channel].pitchfactor=
+	  song->channel[song->voice[v].channel].pitchfactor=
 	    (FLOAT_T)(bend_fine[(i>>5) & 0xFF] * bend_coarse[i>>13]);
 	}
       if (pb>0)
-	voice[v].frequency=
-	  (int32)(channel[voice[v].channel].pitchfactor *
-		  (double)(voice[v].orig_frequency));
+	song->voice[v].frequency=
+	  (int32)(song->channel[song->voice[v].channel].pitchfactor *
+		  (double)(song->voice[v].orig_frequency));
       else
-	voice[v].frequency=
-	  (int32)((double)(voice[v].orig_frequency) /
-		  channel[voice[v].channel].pitchfactor);
+	song->voice[v].frequency=
+	  (int32)((double)(song->voice[v].orig_frequency) /
+		  song->channel[song->voice[v].channel].pitchfactor);
     }
 
-  a = FSCALE(((double)(voice[v].sample->sample_rate) *
-	      (double)(voice[v].frequency)) /
-	     ((double)(voice[v].sample->root_freq) *
+  a = FSCALE(((double)(song->voice[v].sample->sample_rate) *
+	      (double)(song->voice[v].frequency)) /
+	     ((double)(song->voice[v].sample->root_freq) *
 	      (double)(play_mode->rate)),
 	     FRACTION_BITS);
 
   if (sign) 
     a = -a; /* need to preserve the loop direction */
 
-  voice[v].sample_increment = (int32)(a);
+  song->voice[v].sample_increment = (int32)(a);
 }
 
 static int expr_curve[128] = {
@@ -312,21 +279,21 @@ static int vcurve[128] = {
 126,126,126,126,126,127,127,127
 };
 
-static void recompute_amp(int v)
+static void recompute_amp(MidiSong *song, int v)
 {
   int32 tempamp;
-  int chan = voice[v].channel;
-  int panning = voice[v].panning;
-  int vol = channel[chan].volume;
-  int expr = channel[chan].expression;
-  int vel = vcurve[voice[v].velocity];
+  int chan = song->voice[v].channel;
+  int panning = song->voice[v].panning;
+  int vol = song->channel[chan].volume;
+  int expr = song->channel[chan].expression;
+  int vel = vcurve[song->voice[v].velocity];
   FLOAT_T curved_expression, curved_volume;
 
-  if (channel[chan].kit)
+  if (song->channel[chan].kit)
    {
-    int note = voice[v].sample->note_to_use;
-    if (note>0 && drumvolume[chan][note]>=0) vol = drumvolume[chan][note];
-    if (note>0 && drumpanpot[chan][note]>=0) panning = drumvolume[chan][note];
+    int note = song->voice[v].sample->note_to_use;
+    if (note>0 && song->drumvolume[chan][note]>=0) vol = song->drumvolume[chan][note];
+    if (note>0 && song->drumpanpot[chan][note]>=0) panning = song->drumvolume[chan][note];
    }
 
   if (opt_expression_curve == 2) curved_expression = 127.0 * vol_table[expr];
@@ -345,63 +312,63 @@ static void recompute_amp(int v)
     {
       if (panning > 60 && panning < 68)
 	{
-	  voice[v].panned=PANNED_CENTER;
-
-	  if (num_ochannels == 6) voice[v].left_amp =
-		FSCALENEG((double) (tempamp) * voice[v].sample->volume *
-			    master_volume, 20);
-	  else voice[v].left_amp=
-	        FSCALENEG((double)(tempamp) * voice[v].sample->volume *
-			    master_volume, 21);
+	  song->voice[v].panned=PANNED_CENTER;
+
+	  if (num_ochannels == 6) song->voice[v].left_amp =
+		FSCALENEG((double) (tempamp) * song->voice[v].sample->volume *
+			    song->master_volume, 20);
+	  else song->voice[v].left_amp=
+	        FSCALENEG((double)(tempamp) * song->voice[v].sample->volume *
+			    song->master_volume, 21);
 	}
       else if (panning<5)
 	{
-	  voice[v].panned = PANNED_LEFT;
+	  song->voice[v].panned = PANNED_LEFT;
 
-	  voice[v].left_amp=
-	    FSCALENEG((double)(tempamp) * voice[v].sample->volume * master_volume,
+	  song->voice[v].left_amp=
+	    FSCALENEG((double)(tempamp) * song->voice[v].sample->volume * song->master_volume,
 		      20);
 	}
       else if (panning>123)
 	{
-	  voice[v].panned = PANNED_RIGHT;
+	  song->voice[v].panned = PANNED_RIGHT;
 
-	  voice[v].left_amp= /* left_amp will be used */
-	    FSCALENEG((double)(tempamp) * voice[v].sample->volume * master_volume,
+	  song->voice[v].left_amp= /* left_amp will be used */
+	    FSCALENEG((double)(tempamp) * song->voice[v].sample->volume * song->master_volume,
 		      20);
 	}
       else
 	{
-	  FLOAT_T refv = (double)(tempamp) * voice[v].sample->volume * master_volume;
+	  FLOAT_T refv = (double)(tempamp) * song->voice[v].sample->volume * song->master_volume;
 	  int wide_panning = 64;
 
 	  if (num_ochannels == 4) wide_panning = 95;
 
-	  voice[v].panned = PANNED_MYSTERY;
-	  voice[v].lfe_amp = FSCALENEG(refv * 64, 27);
+	  song->voice[v].panned = PANNED_MYSTERY;
+	  song->voice[v].lfe_amp = FSCALENEG(refv * 64, 27);
 
 		switch (num_ochannels)
 		{
 		    case 2:
-		      voice[v].lr_amp = 0;
-		      voice[v].left_amp = FSCALENEG(refv * (128-panning), 27);
-		      voice[v].ce_amp = 0;
-		      voice[v].right_amp = FSCALENEG(refv * panning, 27);
-		      voice[v].rr_amp = 0;
+		      song->voice[v].lr_amp = 0;
+		      song->voice[v].left_amp = FSCALENEG(refv * (128-panning), 27);
+		      song->voice[v].ce_amp = 0;
+		      song->voice[v].right_amp = FSCALENEG(refv * panning, 27);
+		      song->voice[v].rr_amp = 0;
 		      break;
 		    case 4:
-		      voice[v].lr_amp = FSCALENEG(refv * panf(panning, 0, wide_panning), 27);
-		      voice[v].left_amp = FSCALENEG(refv * panf(panning, 32, wide_panning), 27);
-		      voice[v].ce_amp = 0;
-		      voice[v].right_amp = FSCALENEG(refv * panf(panning, 95, wide_panning), 27);
-		      voice[v].rr_amp = FSCALENEG(refv * panf(panning, 128, wide_panning), 27);
+		      song->voice[v].lr_amp = FSCALENEG(refv * panf(panning, 0, wide_panning), 27);
+		      song->voice[v].left_amp = FSCALENEG(refv * panf(panning, 32, wide_panning), 27);
+		      song->voice[v].ce_amp = 0;
+		      song->voice[v].right_amp = FSCALENEG(refv * panf(panning, 95, wide_panning), 27);
+		      song->voice[v].rr_amp = FSCALENEG(refv * panf(panning, 128, wide_panning), 27);
 		      break;
 		    case 6:
-		      voice[v].lr_amp = FSCALENEG(refv * panf(panning, 0, wide_panning), 27);
-		      voice[v].left_amp = FSCALENEG(refv * panf(panning, 32, wide_panning), 27);
-		      voice[v].ce_amp = FSCALENEG(refv * panf(panning, 64, wide_panning), 27);
-		      voice[v].right_amp = FSCALENEG(refv * panf(panning, 95, wide_panning), 27);
-		      voice[v].rr_amp = FSCALENEG(refv * panf(panning, 128, wide_panning), 27);
+		      song->voice[v].lr_amp = FSCALENEG(refv * panf(panning, 0, wide_panning), 27);
+		      song->voice[v].left_amp = FSCALENEG(refv * panf(panning, 32, wide_panning), 27);
+		      song->voice[v].ce_amp = FSCALENEG(refv * panf(panning, 64, wide_panning), 27);
+		      song->voice[v].right_amp = FSCALENEG(refv * panf(panning, 95, wide_panning), 27);
+		      song->voice[v].rr_amp = FSCALENEG(refv * panf(panning, 128, wide_panning), 27);
 		      break;
 		}
 
@@ -409,10 +376,10 @@ static void recompute_amp(int v)
     }
   else
     {
-      voice[v].panned=PANNED_CENTER;
+      song->voice[v].panned=PANNED_CENTER;
 
-      voice[v].left_amp=
-	FSCALENEG((double)(tempamp) * voice[v].sample->volume * master_volume,
+      song->voice[v].left_amp=
+	FSCALENEG((double)(tempamp) * song->voice[v].sample->volume * song->master_volume,
 		  21);
     }
 }
@@ -425,59 +392,59 @@ static void recompute_amp(int v)
 
 
 /* just a variant of note_on() */
-static int vc_alloc(int j)
+static int vc_alloc(MidiSong *song, int j)
 {
-  int i=voices; 
+  int i=song->voices; 
 
   while (i--)
     {
       if (i == j) continue;
-      if (voice[i].status & VOICE_FREE) {
+      if (song->voice[i].status & VOICE_FREE) {
 	return i;
       }
     }
   return -1;
 }
 
-static void kill_note(int i);
+static void kill_note(MidiSong *song, int i);
 
-static void kill_others(int i)
+static void kill_others(MidiSong *song, int i)
 {
-  int j=voices; 
+  int j=song->voices; 
 
-  if (!voice[i].sample->exclusiveClass) return;
+  if (!song->voice[i].sample->exclusiveClass) return;
 
   while (j--)
     {
-      if (voice[j].status & (VOICE_FREE|VOICE_OFF|VOICE_DIE)) continue;
+      if (song->voice[j].status & (VOICE_FREE|VOICE_OFF|VOICE_DIE)) continue;
       if (i == j) continue;
-      if (voice[i].channel != voice[j].channel) continue;
-      if (voice[j].sample->note_to_use)
+      if (song->voice[i].channel != song->voice[j].channel) continue;
+      if (song->voice[j].sample->note_to_use)
       {
-    	if (voice[j].sample->exclusiveClass != voice[i].sample->exclusiveClass) continue;
-        kill_note(j);
+    	if (song->voice[j].sample->exclusiveClass != song->voice[i].sample->exclusiveClass) continue;
+        kill_note(song, j);
       }
     }
 }
 
 
-static void clone_voice(Instrument *ip, int v, MidiEvent *e, int clone_type, int variationbank)
+static void clone_voice(MidiSong *song, Instrument *ip, int v, MidiEvent *e, int clone_type, int variationbank)
 {
   int w, played_note, chorus=0, reverb=0, milli;
-  int chan = voice[v].channel;
+  int chan = song->voice[v].channel;
 
   if (clone_type == STEREO_CLONE) {
-	if (!voice[v].right_sample && variationbank != 3) return;
+	if (!song->voice[v].right_sample && variationbank != 3) return;
 	if (variationbank == 6) return;
   }
 
-  if (channel[chan].kit) {
-	reverb = drumreverberation[chan][voice[v].note];
-	chorus = drumchorusdepth[chan][voice[v].note];
+  if (song->channel[chan].kit) {
+	reverb = song->drumreverberation[chan][song->voice[v].note];
+	chorus = song->drumchorusdepth[chan][song->voice[v].note];
   }
   else {
-	reverb = channel[chan].reverberation;
-	chorus = channel[chan].chorusdepth;
+	reverb = song->channel[chan].reverberation;
+	chorus = song->channel[chan].chorusdepth;
   }
 
   if (clone_type == REVERB_CLONE) chorus = 0;
@@ -497,27 +464,27 @@ static void clone_voice(Instrument *ip, int v, MidiEvent *e, int clone_type, int
 
   if (!reverb && !chorus && clone_type != STEREO_CLONE) return;
 
-  if ( (w = vc_alloc(v)) < 0 ) return;
+  if ( (w = vc_alloc(song, v)) < 0 ) return;
 
-  voice[w] = voice[v];
-  if (clone_type==STEREO_CLONE) voice[v].clone_voice = w;
-  voice[w].clone_voice = v;
-  voice[w].clone_type = clone_type;
+  song->voice[w] = song->voice[v];
+  if (clone_type==STEREO_CLONE) song->voice[v].clone_voice = w;
+  song->voice[w].clone_voice = v;
+  song->voice[w].clone_type = clone_type;
 
-  voice[w].sample = voice[v].right_sample;
-  voice[w].velocity= e->b;
+  song->voice[w].sample = song->voice[v].right_sample;
+  song->voice[w].velocity= e->b;
 
   milli = play_mode->rate/1000;
 
   if (clone_type == STEREO_CLONE) {
     int left, right, leftpan, rightpan;
-    int panrequest = voice[v].panning;
+    int panrequest = song->voice[v].panning;
     if (variationbank == 3) {
-	voice[v].panning = 0;
-	voice[w].panning = 127;
+	song->voice[v].panning = 0;
+	song->voice[w].panning = 127;
     }
     else {
-	if (voice[v].sample->panning > voice[w].sample->panning) {
+	if (song->voice[v].sample->panning > song->voice[w].sample->panning) {
 	  left = w;
 	  right = v;
 	}
@@ -536,67 +503,67 @@ static void clone_voice(Instrument *ip, int v, MidiEvent *e, int clone_type, int
 		rightpan = 127;
 		leftpan = rightpan - INSTRUMENT_SEPARATION;
 	}
-	voice[left].panning = leftpan;
-	voice[right].panning = rightpan;
-	voice[right].echo_delay = 20 * milli;
+	song->voice[left].panning = leftpan;
+	song->voice[right].panning = rightpan;
+	song->voice[right].echo_delay = 20 * milli;
     }
   }
 
-  voice[w].volume = voice[w].sample->volume;
+  song->voice[w].volume = song->voice[w].sample->volume;
 
   if (reverb) {
 	if (opt_stereo_surround) {
-		if (voice[w].panning > 64) voice[w].panning = 127;
-		else voice[w].panning = 0;
+		if (song->voice[w].panning > 64) song->voice[w].panning = 127;
+		else song->voice[w].panning = 0;
 	}
 	else {
-		if (voice[v].panning < 64) voice[w].panning = 64 + reverb/2;
-		else voice[w].panning = 64 - reverb/2;
+		if (song->voice[v].panning < 64) song->voice[w].panning = 64 + reverb/2;
+		else song->voice[w].panning = 64 - reverb/2;
 	}
 
 /* try 98->99 for melodic instruments ? (bit much for percussion) */
-	voice[w].volume *= vol_table[(127-reverb)/8 + 98];
+	song->voice[w].volume *= vol_table[(127-reverb)/8 + 98];
 
-	voice[w].echo_delay += reverb * milli;
-	voice[w].envelope_rate[DECAY] *= 2;
-	voice[w].envelope_rate[RELEASE] /= 2;
+	song->voice[w].echo_delay += reverb * milli;
+	song->voice[w].envelope_rate[DECAY] *= 2;
+	song->voice[w].envelope_rate[RELEASE] /= 2;
 
-	if (XG_System_reverb_type >= 0) {
-	    int subtype = XG_System_reverb_type & 0x07;
-	    int rtype = XG_System_reverb_type >>3;
+	if (song->XG_System_reverb_type >= 0) {
+	    int subtype = song->XG_System_reverb_type & 0x07;
+	    int rtype = song->XG_System_reverb_type >>3;
 	    switch (rtype) {
 		case 0: /* no effect */
 		  break;
 		case 1: /* hall */
-		  if (subtype) voice[w].echo_delay += 100 * milli;
+		  if (subtype) song->voice[w].echo_delay += 100 * milli;
 		  break;
 		case 2: /* room */
-		  voice[w].echo_delay /= 2;
+		  song->voice[w].echo_delay /= 2;
 		  break;
 		case 3: /* stage */
-		  voice[w].velocity = voice[v].velocity;
+		  song->voice[w].velocity = song->voice[v].velocity;
 		  break;
 		case 4: /* plate */
-		  voice[w].panning = voice[v].panning;
+		  song->voice[w].panning = song->voice[v].panning;
 		  break;
 		case 16: /* white room */
-		  voice[w].echo_delay = 0;
+		  song->voice[w].echo_delay = 0;
 		  break;
 		case 17: /* tunnel */
-		  voice[w].echo_delay *= 2;
-		  voice[w].velocity /= 2;
+		  song->voice[w].echo_delay *= 2;
+		  song->voice[w].velocity /= 2;
 		  break;
 		case 18: /* canyon */
-		  voice[w].echo_delay *= 2;
+		  song->voice[w].echo_delay *= 2;
 		  break;
 		case 19: /* basement */
-		  voice[w].velocity /= 2;
+		  song->voice[w].velocity /= 2;
 		  break;
 	        default: break;
 	    }
 	}
   }
-  played_note = voice[w].sample->note_to_use;
+  played_note = song->voice[w].sample->note_to_use;
   if (!played_note) {
 	played_note = e->a & 0x7f;
 	if (variationbank == 35) played_note += 12;
@@ -605,61 +572,61 @@ static void clone_voice(Instrument *ip, int v, MidiEvent *e, int clone_type, int
 	else if (variationbank == 36) played_note -= 7;
   }
 #if 0
-  played_note = ( (played_note - voice[w].sample->freq_center) * voice[w].sample->freq_scale ) / 1024 +
-		voice[w].sample->freq_center;
+  played_note = ( (played_note - song->voice[w].sample->freq_center) * song->voice[w].sample->freq_scale ) / 1024 +
+		song->voice[w].sample->freq_center;
 #endif
-  voice[w].note = played_note;
-  voice[w].orig_frequency = freq_table[played_note];
+  song->voice[w].note = played_note;
+  song->voice[w].orig_frequency = freq_table[played_note];
 
   if (chorus) {
 	if (opt_stereo_surround) {
-	  if (voice[v].panning < 64) voice[w].panning = voice[v].panning + 32;
-	  else voice[w].panning = voice[v].panning - 32;
+	  if (song->voice[v].panning < 64) song->voice[w].panning = song->voice[v].panning + 32;
+	  else song->voice[w].panning = song->voice[v].panning - 32;
 	}
 
-	if (!voice[w].vibrato_control_ratio) {
-		voice[w].vibrato_control_ratio = 100;
-		voice[w].vibrato_depth = 6;
-		voice[w].vibrato_sweep = 74;
+	if (!song->voice[w].vibrato_control_ratio) {
+		song->voice[w].vibrato_control_ratio = 100;
+		song->voice[w].vibrato_depth = 6;
+		song->voice[w].vibrato_sweep = 74;
 	}
-	voice[w].volume *= 0.40;
-	voice[v].volume = voice[w].volume;
-	recompute_amp(v);
-        apply_envelope_to_amp(v);
-	voice[w].vibrato_sweep = chorus/2;
-	voice[w].vibrato_depth /= 2;
-	if (!voice[w].vibrato_depth) voice[w].vibrato_depth = 2;
-	voice[w].vibrato_control_ratio /= 2;
-	voice[w].echo_delay += 30 * milli;
-
-	if (XG_System_chorus_type >= 0) {
-	    int subtype = XG_System_chorus_type & 0x07;
-	    int chtype = 0x0f & (XG_System_chorus_type >> 3);
+	song->voice[w].volume *= 0.40;
+	song->voice[v].volume = song->voice[w].volume;
+	recompute_amp(song, v);
+        apply_envelope_to_amp(song, v);
+	song->voice[w].vibrato_sweep = chorus/2;
+	song->voice[w].vibrato_depth /= 2;
+	if (!song->voice[w].vibrato_depth) song->voice[w].vibrato_depth = 2;
+	song->voice[w].vibrato_control_ratio /= 2;
+	song->voice[w].echo_delay += 30 * milli;
+
+	if (song->XG_System_chorus_type >= 0) {
+	    int subtype = song->XG_System_chorus_type & 0x07;
+	    int chtype = 0x0f & (song->XG_System_chorus_type >> 3);
 	    switch (chtype) {
 		case 0: /* no effect */
 		  break;
 		case 1: /* chorus */
 		  chorus /= 3;
-		  if(channel[ voice[w].channel ].pitchbend + chorus < 0x2000)
-            		voice[w].orig_frequency =
-				(uint32)( (FLOAT_T)voice[w].orig_frequency * bend_fine[chorus] );
-        	  else voice[w].orig_frequency =
-			(uint32)( (FLOAT_T)voice[w].orig_frequency / bend_fine[chorus] );
-		  if (subtype) voice[w].vibrato_depth *= 2;
+		  if(song->channel[ song->voice[w].channel ].pitchbend + chorus < 0x2000)
+            		song->voice[w].orig_frequency =
+				(uint32)( (FLOAT_T)song->voice[w].orig_frequency * bend_fine[chorus] );
+        	  else song->voice[w].orig_frequency =
+			(uint32)( (FLOAT_T)song->voice[w].orig_frequency / bend_fine[chorus] );
+		  if (subtype) song->voice[w].vibrato_depth *= 2;
 		  break;
 		case 2: /* celeste */
-		  voice[w].orig_frequency += (voice[w].orig_frequency/128) * chorus;
+		  song->voice[w].orig_frequency += (song->voice[w].orig_frequency/128) * chorus;
 		  break;
 		case 3: /* flanger */
-		  voice[w].vibrato_control_ratio = 10;
-		  voice[w].vibrato_depth = 100;
-		  voice[w].vibrato_sweep = 8;
-		  voice[w].echo_delay += 200 * milli;
+		  song->voice[w].vibrato_control_ratio = 10;
+		  song->voice[w].vibrato_depth = 100;
+		  song->voice[w].vibrato_sweep = 8;
+		  song->voice[w].echo_delay += 200 * milli;
 		  break;
 		case 4: /* symphonic : cf Children of the Night /128 bad, /1024 ok */
-		  voice[w].orig_frequency += (voice[w].orig_frequency/512) * chorus;
-		  voice[v].orig_frequency -= (voice[v].orig_frequency/512) * chorus;
-		  recompute_freq(v);
+		  song->voice[w].orig_frequency += (song->voice[w].orig_frequency/512) * chorus;
+		  song->voice[v].orig_frequency -= (song->voice[v].orig_frequency/512) * chorus;
+		  recompute_freq(song, v);
 		  break;
 		case 8: /* phaser */
 		  break;
@@ -669,40 +636,40 @@ static void clone_voice(Instrument *ip, int v, MidiEvent *e, int clone_type, int
 	}
 	else {
 	    chorus /= 3;
-	    if(channel[ voice[w].channel ].pitchbend + chorus < 0x2000)
-          	voice[w].orig_frequency =
-			(uint32)( (FLOAT_T)voice[w].orig_frequency * bend_fine[chorus] );
-            else voice[w].orig_frequency =
-		(uint32)( (FLOAT_T)voice[w].orig_frequency / bend_fine[chorus] );
+	    if(song->channel[ song->voice[w].channel ].pitchbend + chorus < 0x2000)
+          	song->voice[w].orig_frequency =
+			(uint32)( (FLOAT_T)song->voice[w].orig_frequency * bend_fine[chorus] );
+            else song->voice[w].orig_frequency =
+		(uint32)( (FLOAT_T)song->voice[w].orig_frequency / bend_fine[chorus] );
 	}
   }
 #if 0
-  voice[w].loop_start = voice[w].sample->loop_start;
-  voice[w].loop_end = voice[w].sample->loop_end;
+  song->voice[w].loop_start = song->voice[w].sample->loop_start;
+  song->voice[w].loop_end = song->voice[w].sample->loop_end;
 #endif
-  voice[w].echo_delay_count = voice[w].echo_delay;
-  if (reverb) voice[w].echo_delay *= 2;
+  song->voice[w].echo_delay_count = song->voice[w].echo_delay;
+  if (reverb) song->voice[w].echo_delay *= 2;
 
-  recompute_freq(w);
-  recompute_amp(w);
-  if (voice[w].sample->modes & MODES_ENVELOPE)
+  recompute_freq(song, w);
+  recompute_amp(song, w);
+  if (song->voice[w].sample->modes & MODES_ENVELOPE)
     {
       /* Ramp up from 0 */
-      voice[w].envelope_stage=ATTACK;
-      voice[w].modulation_stage=ATTACK;
-      voice[w].envelope_volume=0;
-      voice[w].modulation_volume=0;
-      voice[w].control_counter=0;
-      voice[w].modulation_counter=0;
-      recompute_envelope(w);
+      song->voice[w].envelope_stage=ATTACK;
+      song->voice[w].modulation_stage=ATTACK;
+      song->voice[w].envelope_volume=0;
+      song->voice[w].modulation_volume=0;
+      song->voice[w].control_counter=0;
+      song->voice[w].modulation_counter=0;
+      recompute_envelope(song, w);
       /*recompute_modulation(w);*/
     }
   else
     {
-      voice[w].envelope_increment=0;
-      voice[w].modulation_increment=0;
+      song->voice[w].envelope_increment=0;
+      song->voice[w].modulation_increment=0;
     }
-  apply_envelope_to_amp(w);
+  apply_envelope_to_amp(song, w);
 }
 
 
@@ -740,7 +707,14 @@ static void xremap(int *banknumpt, int *this_notept, int this_kit) {
 }
 
 
-static void start_note(MidiEvent *e, int i)
+/* Another song may have marked an instrument for loading that isn't
+   loaded yet, and that can't be played either. */
+static InstrumentLayer *playable(InstrumentLayer *lp)
+{
+  return (lp == MAGIC_LOAD_INSTRUMENT) ? NULL : lp;
+}
+
+static void start_note(MidiSong *song, MidiEvent *e, int i)
 {
   InstrumentLayer *lp;
   Instrument *ip;
@@ -748,26 +722,26 @@ static void start_note(MidiEvent *e, int i)
   int played_note, drumpan=NO_PANNING;
   int32 rt;
   int attacktime, releasetime, decaytime, variationbank;
-  int brightness = channel[ch].brightness;
-  int harmoniccontent = channel[ch].harmoniccontent;
+  int brightness = song->channel[ch].brightness;
+  int harmoniccontent = song->channel[ch].harmoniccontent;
   int this_note = e->a;
   int this_velocity = e->b;
-  int drumsflag = channel[ch].kit;
-  int this_prog = channel[ch].program;
+  int drumsflag = song->channel[ch].kit;
+  int this_prog = song->channel[ch].program;
 
-  if (channel[ch].sfx) banknum=channel[ch].sfx;
-  else banknum=channel[ch].bank;
+  if (song->channel[ch].sfx) banknum=song->channel[ch].sfx;
+  else banknum=song->channel[ch].bank;
 
-  voice[i].velocity=this_velocity;
+  song->voice[i].velocity=this_velocity;
 
-  if (XG_System_On) xremap(&banknum, &this_note, drumsflag);
+  if (song->XG_System_On) xremap(&banknum, &this_note, drumsflag);
   /*   if (current_config_pc42b) pcmap(&banknum, &this_note, &this_prog, &drumsflag); */
 
   if (drumsflag)
     {
-      if (!(lp=drumset[banknum]->tone[this_note].layer))
+      if (!(lp=playable(drumset[banknum]->tone[this_note].layer)))
 	{
-	  if (!(lp=drumset[0]->tone[this_note].layer))
+	  if (!(lp=playable(drumset[0]->tone[this_note].layer)))
 	    return; /* No instrument? Then we can't play. */
 	}
       ip = lp->instrument;
@@ -779,69 +753,69 @@ static void start_note(MidiEvent *e, int i)
 
       if (ip->sample->note_to_use) /* Do we have a fixed pitch? */
 	{
-	  voice[i].orig_frequency=freq_table[(int)(ip->sample->note_to_use)];
-	  drumpan=drumpanpot[ch][(int)ip->sample->note_to_use];
+	  song->voice[i].orig_frequency=freq_table[(int)(ip->sample->note_to_use)];
+	  drumpan=song->drumpanpot[ch][(int)ip->sample->note_to_use];
 	}
       else
-	voice[i].orig_frequency=freq_table[this_note & 0x7F];
+	song->voice[i].orig_frequency=freq_table[this_note & 0x7F];
 
     }
   else
     {
-      if (channel[ch].program==SPECIAL_PROGRAM)
+      if (song->channel[ch].program==SPECIAL_PROGRAM)
 	lp=default_instrument;
-      else if (!(lp=tonebank[channel[ch].bank]->
-		 tone[channel[ch].program].layer))
+      else if (!(lp=playable(tonebank[song->channel[ch].bank]->
+		 tone[song->channel[ch].program].layer)))
 	{
-	  if (!(lp=tonebank[0]->tone[this_prog].layer))
+	  if (!(lp=playable(tonebank[0]->tone[this_prog].layer)))
 	    return; /* No instrument? Then we can't play. */
 	}
       ip = lp->instrument;
       if (ip->sample->note_to_use) /* Fixed-pitch instrument? */
-	voice[i].orig_frequency=freq_table[(int)(ip->sample->note_to_use)];
+	song->voice[i].orig_frequency=freq_table[(int)(ip->sample->note_to_use)];
       else
-	voice[i].orig_frequency=freq_table[this_note & 0x7F];
+	song->voice[i].orig_frequency=freq_table[this_note & 0x7F];
     }
 
-    select_stereo_samples(i, lp);
+    select_stereo_samples(song, i, lp);
 
-  voice[i].starttime = e->time;
-  played_note = voice[i].sample->note_to_use;
+  song->voice[i].starttime = e->time;
+  played_note = song->voice[i].sample->note_to_use;
 
   if (!played_note || !drumsflag) played_note = this_note & 0x7f;
 #if 0
-  played_note = ( (played_note - voice[i].sample->freq_center) * voice[i].sample->freq_scale ) / 1024 +
-		voice[i].sample->freq_center;
+  played_note = ( (played_note - song->voice[i].sample->freq_center) * song->voice[i].sample->freq_scale ) / 1024 +
+		song->voice[i].sample->freq_center;
 #endif
-  voice[i].status=VOICE_ON;
-  voice[i].channel=ch;
-  voice[i].note=played_note;
-  voice[i].velocity=this_velocity;
-  voice[i].sample_offset=0;
-  voice[i].sample_increment=0; /* make sure it isn't negative */
-
-  voice[i].tremolo_phase=0;
-  voice[i].tremolo_phase_increment=voice[i].sample->tremolo_phase_increment;
-  voice[i].tremolo_sweep=voice[i].sample->tremolo_sweep_increment;
-  voice[i].tremolo_sweep_position=0;
-
-  voice[i].vibrato_sweep=voice[i].sample->vibrato_sweep_increment;
-  voice[i].vibrato_sweep_position=0;
-  voice[i].vibrato_depth=voice[i].sample->vibrato_depth;
-  voice[i].vibrato_control_ratio=voice[i].sample->vibrato_control_ratio;
-  voice[i].vibrato_control_counter=voice[i].vibrato_phase=0;
-  voice[i].vibrato_delay = voice[i].sample->vibrato_delay;
-
-  kill_others(i);
+  song->voice[i].status=VOICE_ON;
+  song->voice[i].channel=ch;
+  song->voice[i].note=played_note;
+  song->voice[i].velocity=this_velocity;
+  song->voice[i].sample_offset=0;
+  song->voice[i].sample_increment=0; /* make sure it isn't negative */
+
+  song->voice[i].tremolo_phase=0;
+  song->voice[i].tremolo_phase_increment=song->voice[i].sample->tremolo_phase_increment;
+  song->voice[i].tremolo_sweep=song->voice[i].sample->tremolo_sweep_increment;
+  song->voice[i].tremolo_sweep_position=0;
+
+  song->voice[i].vibrato_sweep=song->voice[i].sample->vibrato_sweep_increment;
+  song->voice[i].vibrato_sweep_position=0;
+  song->voice[i].vibrato_depth=song->voice[i].sample->vibrato_depth;
+  song->voice[i].vibrato_control_ratio=song->voice[i].sample->vibrato_control_ratio;
+  song->voice[i].vibrato_control_counter=song->voice[i].vibrato_phase=0;
+  song->voice[i].vibrato_delay = song->voice[i].sample->vibrato_delay;
+
+  kill_others(song, i);
 
   for (j=0; j<VIBRATO_SAMPLE_INCREMENTS; j++)
-    voice[i].vibrato_sample_increment[j]=0;
+    song->voice[i].vibrato_sample_increment[j]=0;
 
 
-  attacktime = channel[ch].attacktime;
-  releasetime = channel[ch].releasetime;
+  attacktime = song->channel[ch].attacktime;
+  releasetime = song->channel[ch].releasetime;
   decaytime = 64;
-  variationbank = channel[ch].variationbank;
+  variationbank = song->channel[ch].variationbank;
 
   switch (variationbank) {
 	case  8:
@@ -867,24 +841,24 @@ static void start_note(MidiEvent *e, int i)
 		break;
 #if 0
 	case 24:
-		voice[i].modEnvToFilterFc=2.0;
-      		voice[i].sample->cutoff_freq = 800;
+		song->voice[i].modEnvToFilterFc=2.0;
+      		song->voice[i].sample->cutoff_freq = 800;
 		break;
 	case 25:
-		voice[i].modEnvToFilterFc=-2.0;
-      		voice[i].sample->cutoff_freq = 800;
+		song->voice[i].modEnvToFilterFc=-2.0;
+      		song->voice[i].sample->cutoff_freq = 800;
 		break;
 	case 27:
-		voice[i].modLfoToFilterFc=2.0;
-		voice[i].lfo_phase_increment=109;
-		voice[i].lfo_sweep=122;
-      		voice[i].sample->cutoff_freq = 800;
+		song->voice[i].modLfoToFilterFc=2.0;
+		song->voice[i].lfo_phase_increment=109;
+		song->voice[i].lfo_sweep=122;
+      		song->voice[i].sample->cutoff_freq = 800;
 		break;
 	case 28:
-		voice[i].modLfoToFilterFc=-2.0;
-		voice[i].lfo_phase_increment=109;
-		voice[i].lfo_sweep=122;
-      		voice[i].sample->cutoff_freq = 800;
+		song->voice[i].modLfoToFilterFc=-2.0;
+		song->voice[i].lfo_phase_increment=109;
+		song->voice[i].lfo_sweep=122;
+      		song->voice[i].sample->cutoff_freq = 800;
 		break;
 #endif
 	default:
@@ -894,48 +868,48 @@ static void start_note(MidiEvent *e, int i)
 
   for (j=ATTACK; j<MAXPOINT; j++)
     {
-	voice[i].envelope_rate[j]=voice[i].sample->envelope_rate[j];
-	voice[i].envelope_offset[j]=voice[i].sample->envelope_offset[j];
+	song->voice[i].envelope_rate[j]=song->voice[i].sample->envelope_rate[j];
+	song->voice[i].envelope_offset[j]=song->voice[i].sample->envelope_offset[j];
     }
 
-  voice[i].echo_delay=voice[i].envelope_rate[DELAY];
-  voice[i].echo_delay_count = voice[i].echo_delay;
+  song->voice[i].echo_delay=song->voice[i].envelope_rate[DELAY];
+  song->voice[i].echo_delay_count = song->voice[i].echo_delay;
 
   if (attacktime!=64)
     {
-	rt = voice[i].envelope_rate[ATTACK];
+	rt = song->voice[i].envelope_rate[ATTACK];
 	rt = rt + ( (64-attacktime)*rt ) / 100;
-	if (rt > 1000) voice[i].envelope_rate[ATTACK] = rt;
+	if (rt > 1000) song->voice[i].envelope_rate[ATTACK] = rt;
     }
   if (releasetime!=64)
     {
-	rt = voice[i].envelope_rate[RELEASE];
+	rt = song->voice[i].envelope_rate[RELEASE];
 	rt = rt + ( (64-releasetime)*rt ) / 100;
-	if (rt > 1000) voice[i].envelope_rate[RELEASE] = rt;
+	if (rt > 1000) song->voice[i].envelope_rate[RELEASE] = rt;
     }
   if (decaytime!=64)
     {
-	rt = voice[i].envelope_rate[DECAY];
+	rt = song->voice[i].envelope_rate[DECAY];
 	rt = rt + ( (64-decaytime)*rt ) / 100;
-	if (rt > 1000) voice[i].envelope_rate[DECAY] = rt;
+	if (rt > 1000) song->voice[i].envelope_rate[DECAY] = rt;
     }
 
-  if (channel[ch].panning != NO_PANNING)
-    voice[i].panning=channel[ch].panning;
+  if (song->channel[ch].panning != NO_PANNING)
+    song->voice[i].panning=song->channel[ch].panning;
   else
-    voice[i].panning=voice[i].sample->panning;
+    song->voice[i].panning=song->voice[i].sample->panning;
   if (drumpan != NO_PANNING)
-    voice[i].panning=drumpan;
+    song->voice[i].panning=drumpan;
 
   if (variationbank == 1) {
-    int pan = voice[i].panning;
+    int pan = song->voice[i].panning;
     int disturb = 0;
     /* If they're close up (no reverb) and you are behind the pianist,
      * high notes come from the right, so we'll spread piano etc. notes
      * out horizontally according to their pitches.
      */
     if (this_prog < 21) {
-	    int n = voice[i].velocity - 32;
+	    int n = song->voice[i].velocity - 32;
 	    if (n < 0) n = 0;
 	    if (n > 64) n = 64;
 	    pan = pan/2 + n;
@@ -945,83 +919,83 @@ static void start_note(MidiEvent *e, int i)
      * do drift around in a sometimes disconcerting way, so the following
      * might not be such a good idea.
      */
-    else disturb = (voice[i].velocity/32 % 8) +
-	(voice[i].note % 8); /* /16? */
+    else disturb = (song->voice[i].velocity/32 % 8) +
+	(song->voice[i].note % 8); /* /16? */
 
     if (pan < 64) pan += disturb;
     else pan -= disturb;
     if (pan < 0) pan = 0;
     else if (pan > 127) pan = 127;
-    voice[i].panning = pan;
+    song->voice[i].panning = pan;
   }
 
-  recompute_freq(i);
-  recompute_amp(i);
-  if (voice[i].sample->modes & MODES_ENVELOPE)
+  recompute_freq(song, i);
+  recompute_amp(song, i);
+  if (song->voice[i].sample->modes & MODES_ENVELOPE)
     {
       /* Ramp up from 0 */
-      voice[i].envelope_stage=ATTACK;
-      voice[i].envelope_volume=0;
-      voice[i].control_counter=0;
-      recompute_envelope(i);
+      song->voice[i].envelope_stage=ATTACK;
+      song->voice[i].envelope_volume=0;
+      song->voice[i].control_counter=0;
+      recompute_envelope(song, i);
     }
   else
     {
-      voice[i].envelope_increment=0;
+      song->voice[i].envelope_increment=0;
     }
-  apply_envelope_to_amp(i);
+  apply_envelope_to_amp(song, i);
 
-  voice[i].clone_voice = -1;
-  voice[i].clone_type = NOT_CLONE;
+  song->voice[i].clone_voice = -1;
+  song->voice[i].clone_type = NOT_CLONE;
 
-  clone_voice(ip, i, e, STEREO_CLONE, variationbank);
-  clone_voice(ip, i, e, CHORUS_CLONE, variationbank);
-  clone_voice(ip, i, e, REVERB_CLONE, variationbank);
+  clone_voice(song, ip, i, e, STEREO_CLONE, variationbank);
+  clone_voice(song, ip, i, e, CHORUS_CLONE, variationbank);
+  clone_voice(song, ip, i, e, REVERB_CLONE, variationbank);
 
   ctl->note(i);
 }
 
-static void kill_note(int i)
+static void kill_note(MidiSong *song, int i)
 {
-  voice[i].status=VOICE_DIE;
-  if (voice[i].clone_voice >= 0)
-	voice[ voice[i].clone_voice ].status=VOICE_DIE;
+  song->voice[i].status=VOICE_DIE;
+  if (song->voice[i].clone_voice >= 0)
+	song->voice[ song->voice[i].clone_voice ].status=VOICE_DIE;
   ctl->note(i);
 }
 
 
 /* Only one instance of a note can be playing on a single channel. */
-static void note_on(MidiEvent *e)
+static void note_on(MidiSong *song, MidiEvent *e)
 {
-  int i=voices, lowest=-1; 
+  int i=song->voices, lowest=-1; 
   int32 lv=0x7FFFFFFF, v;
 
   while (i--)
     {
-      if (voice[i].status == VOICE_FREE)
+      if (song->voice[i].status == VOICE_FREE)
 	lowest=i; /* Can't get a lower volume than silence */
-      else if (voice[i].channel==e->channel && 
-	       (voice[i].note==e->a || channel[voice[i].channel].mono))
-	kill_note(i);
+      else if (song->voice[i].channel==e->channel && 
+	       (song->voice[i].note==e->a || song->channel[song->voice[i].channel].mono))
+	kill_note(song, i);
     }
 
   if (lowest != -1)
     {
       /* Found a free voice. */
-      start_note(e,lowest);
+      start_note(song, e,lowest);
       return;
     }
   
 #if 0
   /* Look for the decaying note with the lowest volume */
-  i=voices;
+  i=song->voices;
   while (i--)
     {
-      if (voice[i].status & ~(VOICE_ON | VOICE_DIE | VOICE_FREE))
+      if (song->voice[i].status & ~(VOICE_ON | VOICE_DIE | VOICE_FREE))
 	{
-	  v=voice[i].left_mix;
-	  if ((voice[i].panned==PANNED_MYSTERY) && (voice[i].right_mix>v))
-	    v=voice[i].right_mix;
+	  v=song->voice[i].left_mix;
+	  if ((song->voice[i].panned==PANNED_MYSTERY) && (song->voice[i].right_mix>v))
+	    v=song->voice[i].right_mix;
 	  if (v<lv)
 	    {
 	      lv=v;
@@ -1034,15 +1008,15 @@ static void note_on(MidiEvent *e)
   /* Look for the decaying note with the lowest volume */
   if (lowest==-1)
    {
-   i=voices;
+   i=song->voices;
    while (i--)
     {
-      if ( (voice[i].status & ~(VOICE_ON | VOICE_DIE | VOICE_FREE)) &&
-	  (!voice[i].clone_type))
+      if ( (song->voice[i].status & ~(VOICE_ON | VOICE_DIE | VOICE_FREE)) &&
+	  (!song->voice[i].clone_type))
 	{
-	  v=voice[i].left_mix;
-	  if ((voice[i].panned==PANNED_MYSTERY) && (voice[i].right_mix>v))
-	    v=voice[i].right_mix;
+	  v=song->voice[i].left_mix;
+	  if ((song->voice[i].panned==PANNED_MYSTERY) && (song->voice[i].right_mix>v))
+	    v=song->voice[i].right_mix;
 	  if (v<lv)
 	    {
 	      lv=v;
@@ -1054,7 +1028,7 @@ static void note_on(MidiEvent *e)
 
   if (lowest != -1)
     {
-      int cl = voice[lowest].clone_voice;
+      int cl = song->voice[lowest].clone_voice;
 
       /* This can still cause a click, but if we had a free voice to
 	 spare for ramping down this note, we wouldn't need to kill it
@@ -1062,30 +1036,30 @@ static void note_on(MidiEvent *e)
 	 we could use a reserve of voices to play dying notes only. */
 
       if (cl >= 0) {
-	if (voice[cl].clone_type==STEREO_CLONE ||
-		       	(!voice[cl].clone_type && voice[lowest].clone_type==STEREO_CLONE))
-	   voice[cl].status=VOICE_FREE;
-	else if (voice[cl].clone_voice==lowest) voice[cl].clone_voice=-1;
+	if (song->voice[cl].clone_type==STEREO_CLONE ||
+		       	(!song->voice[cl].clone_type && song->voice[lowest].clone_type==STEREO_CLONE))
+	   song->voice[cl].status=VOICE_FREE;
+	else if (song->voice[cl].clone_voice==lowest) song->voice[cl].clone_voice=-1;
       }
 
-      cut_notes++;
-      voice[lowest].status=VOICE_FREE;
+      song->cut_notes++;
+      song->voice[lowest].status=VOICE_FREE;
       ctl->note(lowest);
-      start_note(e,lowest);
+      start_note(song, e,lowest);
     }
   else
-    lost_notes++;
+    song->lost_notes++;
 }
 
-static void finish_note(int i)
+static void finish_note(MidiSong *song, int i)
 {
-  if (voice[i].sample->modes & MODES_ENVELOPE)
+  if (song->voice[i].sample->modes & MODES_ENVELOPE)
     {
       /* We need to get the envelope out of Sustain stage */
-      voice[i].envelope_stage=3;
-      voice[i].status=VOICE_OFF;
-      recompute_envelope(i);
-      apply_envelope_to_amp(i);
+      song->voice[i].envelope_stage=3;
+      song->voice[i].status=VOICE_OFF;
+      recompute_envelope(song, i);
+      apply_envelope_to_amp(song, i);
       ctl->note(i);
     }
   else
@@ -1093,260 +1067,260 @@ static void finish_note(int i)
       /* Set status to OFF so resample_voice() will let this voice out
          of its loop, if any. In any case, this voice dies when it
          hits the end of its data (ofs>=data_length). */
-      voice[i].status=VOICE_OFF;
+      song->voice[i].status=VOICE_OFF;
     }
 
   { int v;
-    if ( (v=voice[i].clone_voice) >= 0)
+    if ( (v=song->voice[i].clone_voice) >= 0)
       {
-	voice[i].clone_voice = -1;
-        finish_note(v);
+	song->voice[i].clone_voice = -1;
+        finish_note(song, v);
       }
   }
 }
 
-static void note_off(MidiEvent *e)
+static void note_off(MidiSong *song, MidiEvent *e)
 {
-  int i=voices, v;
+  int i=song->voices, v;
   while (i--)
-    if (voice[i].status==VOICE_ON &&
-	voice[i].channel==e->channel &&
-	voice[i].note==e->a)
+    if (song->voice[i].status==VOICE_ON &&
+	song->voice[i].channel==e->channel &&
+	song->voice[i].note==e->a)
       {
-	if (channel[e->channel].sustain)
+	if (song->channel[e->channel].sustain)
 	  {
-	    voice[i].status=VOICE_SUSTAINED;
+	    song->voice[i].status=VOICE_SUSTAINED;
 
-    	    if ( (v=voice[i].clone_voice) >= 0)
+    	    if ( (v=song->voice[i].clone_voice) >= 0)
 	      {
-		if (voice[v].status == VOICE_ON)
-		  voice[v].status=VOICE_SUSTAINED;
+		if (song->voice[v].status == VOICE_ON)
+		  song->voice[v].status=VOICE_SUSTAINED;
 	      }
 
 	    ctl->note(i);
 	  }
 	else
-	  finish_note(i);
+	  finish_note(song, i);
 	return;
       }
 }
 
 /* Process the All Notes Off event */
-static void all_notes_off(int c)
+static void all_notes_off(MidiSong *song, int c)
 {
-  int i=voices;
+  int i=song->voices;
   ctl->cmsg(CMSG_INFO, VERB_DEBUG, "All notes off on channel %d", c);
   while (i--)
-    if (voice[i].status==VOICE_ON &&
-	voice[i].channel==c)
+    if (song->voice[i].status==VOICE_ON &&
+	song->voice[i].channel==c)
       {
-	if (channel[c].sustain) 
+	if (song->channel[c].sustain) 
 	  {
-	    voice[i].status=VOICE_SUSTAINED;
+	    song->voice[i].status=VOICE_SUSTAINED;
 	    ctl->note(i);
 	  }
 	else
-	  finish_note(i);
+	  finish_note(song, i);
       }
 }
 
 /* Process the All Sounds Off event */
-static void all_sounds_off(int c)
+static void all_sounds_off(MidiSong *song, int c)
 {
-  int i=voices;
+  int i=song->voices;
   while (i--)
-    if (voice[i].channel==c && 
-	voice[i].status != VOICE_FREE &&
-	voice[i].status != VOICE_DIE)
+    if (song->voice[i].channel==c && 
+	song->voice[i].status != VOICE_FREE &&
+	song->voice[i].status != VOICE_DIE)
       {
-	kill_note(i);
+	kill_note(song, i);
       }
 }
 
-static void adjust_pressure(MidiEvent *e)
+static void adjust_pressure(MidiSong *song, MidiEvent *e)
 {
-  int i=voices;
+  int i=song->voices;
   while (i--)
-    if (voice[i].status==VOICE_ON &&
-	voice[i].channel==e->channel &&
-	voice[i].note==e->a)
+    if (song->voice[i].status==VOICE_ON &&
+	song->voice[i].channel==e->channel &&
+	song->voice[i].note==e->a)
       {
-	voice[i].velocity=e->b;
-	recompute_amp(i);
-	apply_envelope_to_amp(i);
+	song->voice[i].velocity=e->b;
+	recompute_amp(song, i);
+	apply_envelope_to_amp(song, i);
 	return;
       }
 }
 
-static void adjust_panning(int c)
+static void adjust_panning(MidiSong *song, int c)
 {
-  int i=voices;
+  int i=song->voices;
   while (i--)
-    if ((voice[i].channel==c) &&
-	(voice[i].status==VOICE_ON || voice[i].status==VOICE_SUSTAINED))
+    if ((song->voice[i].channel==c) &&
+	(song->voice[i].status==VOICE_ON || song->voice[i].status==VOICE_SUSTAINED))
       {
-	if (voice[i].clone_type != NOT_CLONE) continue;
-	voice[i].panning=channel[c].panning;
-	recompute_amp(i);
-	apply_envelope_to_amp(i);
+	if (song->voice[i].clone_type != NOT_CLONE) continue;
+	song->voice[i].panning=song->channel[c].panning;
+	recompute_amp(song, i);
+	apply_envelope_to_amp(song, i);
       }
 }
 
-static void drop_sustain(int c)
+static void drop_sustain(MidiSong *song, int c)
 {
-  int i=voices;
+  int i=song->voices;
   while (i--)
-    if (voice[i].status==VOICE_SUSTAINED && voice[i].channel==c)
-      finish_note(i);
+    if (song->voice[i].status==VOICE_SUSTAINED && song->voice[i].channel==c)
+      finish_note(song, i);
 }
 
-static void adjust_pitchbend(int c)
+static void adjust_pitchbend(MidiSong *song, int c)
 {
-  int i=voices;
+  int i=song->voices;
   while (i--)
-    if (voice[i].status!=VOICE_FREE && voice[i].channel==c)
+    if (song->voice[i].status!=VOICE_FREE && song->voice[i].channel==c)
       {
-	recompute_freq(i);
+	recompute_freq(song, i);
       }
 }
 
-static void adjust_volume(int c)
+static void adjust_volume(MidiSong *song, int c)
 {
-  int i=voices;
+  int i=song->voices;
   while (i--)
-    if (voice[i].channel==c &&
-	(voice[i].status==VOICE_ON || voice[i].status==VOICE_SUSTAINED))
+    if (song->voice[i].channel==c &&
+	(song->voice[i].status==VOICE_ON || song->voice[i].status==VOICE_SUSTAINED))
       {
-	recompute_amp(i);
-	apply_envelope_to_amp(i);
+	recompute_amp(song, i);
+	apply_envelope_to_amp(song, i);
       }
 }
 
-static void seek_forward(int32 until_time)
+static void seek_forward(MidiSong *song, int32 until_time)
 {
-  reset_voices();
-  while (current_event->time < until_time)
+  reset_voices(song);
+  while (song->current_event->time < until_time)
     {
-      switch(current_event->type)
+      switch(song->current_event->type)
 	{
 	  /* All notes stay off. Just handle the parameter changes. */
 
 	case ME_PITCH_SENS:
-	  channel[current_event->channel].pitchsens=
-	    current_event->a;
-	  channel[current_event->channel].pitchfactor=0;
+	  song->channel[song->current_event->channel].pitchsens=
+	    song->current_event->a;
+	  song->channel[song->current_event->channel].pitchfactor=0;
 	  break;
 	  
 	case ME_PITCHWHEEL:
-	  channel[current_event->channel].pitchbend=
-	    current_event->a + current_event->b * 128;
-	  channel[current_event->channel].pitchfactor=0;
+	  song->channel[song->current_event->channel].pitchbend=
+	    song->current_event->a + song->current_event->b * 128;
+	  song->channel[song->current_event->channel].pitchfactor=0;
 	  break;
 	  
 	case ME_MAINVOLUME:
-	  channel[current_event->channel].volume=current_event->a;
+	  song->channel[song->current_event->channel].volume=song->current_event->a;
 	  break;
 	  
 	case ME_MASTERVOLUME:
-	  adjust_master_volume(current_event->a + (current_event->b <<7));
+	  adjust_master_volume(song, song->current_event->a + (song->current_event->b <<7));
 	  break;
 	  
 	case ME_PAN:
-	  channel[current_event->channel].panning=current_event->a;
+	  song->channel[song->current_event->channel].panning=song->current_event->a;
 	  break;
 	      
 	case ME_EXPRESSION:
-	  channel[current_event->channel].expression=current_event->a;
+	  song->channel[song->current_event->channel].expression=song->current_event->a;
 	  break;
 	  
 	case ME_PROGRAM:
-	  /* if (ISDRUMCHANNEL(current_event->channel)) */
-	  if (channel[current_event->channel].kit)
+	  /* if (ISDRUMCHANNEL(song->current_event->channel)) */
+	  if (song->channel[song->current_event->channel].kit)
 	    /* Change drum set */
-	    channel[current_event->channel].bank=current_event->a;
+	    song->channel[song->current_event->channel].bank=song->current_event->a;
 	  else
-	    channel[current_event->channel].program=current_event->a;
+	    song->channel[song->current_event->channel].program=song->current_event->a;
 	  break;
 
 	case ME_SUSTAIN:
-	  channel[current_event->channel].sustain=current_event->a;
+	  song->channel[song->current_event->channel].sustain=song->current_event->a;
 	  break;
 
 
 	case ME_REVERBERATION:
-	  channel[current_event->channel].reverberation=current_event->a;
+	  song->channel[song->current_event->channel].reverberation=song->current_event->a;
 	  break;
 
 	case ME_CHORUSDEPTH:
-	  channel[current_event->channel].chorusdepth=current_event->a;
+	  song->channel[song->current_event->channel].chorusdepth=song->current_event->a;
 	  break;
 
 	case ME_HARMONICCONTENT:
-	  channel[current_event->channel].harmoniccontent=current_event->a;
+	  song->channel[song->current_event->channel].harmoniccontent=song->current_event->a;
 	  break;
 
 	case ME_RELEASETIME:
-	  channel[current_event->channel].releasetime=current_event->a;
+	  song->channel[song->current_event->channel].releasetime=song->current_event->a;
 	  break;
 
 	case ME_ATTACKTIME:
-	  channel[current_event->channel].attacktime=current_event->a;
+	  song->channel[song->current_event->channel].attacktime=song->current_event->a;
 	  break;
 
 	case ME_BRIGHTNESS:
-	  channel[current_event->channel].brightness=current_event->a;
+	  song->channel[song->current_event->channel].brightness=song->current_event->a;
 	  break;
 
 	case ME_TONE_KIT:
-	  if (current_event->a==SFX_BANKTYPE)
+	  if (song->current_event->a==SFX_BANKTYPE)
 		{
-		    channel[current_event->channel].sfx=SFXBANK;
-		    channel[current_event->channel].kit=0;
+		    song->channel[song->current_event->channel].sfx=SFXBANK;
+		    song->channel[song->current_event->channel].kit=0;
 		}
 	  else
 		{
-		    channel[current_event->channel].sfx=0;
-		    channel[current_event->channel].kit=current_event->a;
+		    song->channel[song->current_event->channel].sfx=0;
+		    song->channel[song->current_event->channel].kit=song->current_event->a;
 		}
 	  break;
 
 
 	case ME_RESET_CONTROLLERS:
-	  reset_controllers(current_event->channel);
+	  reset_controllers(song, song->current_event->channel);
 	  break;
 	      
 	case ME_TONE_BANK:
-	  channel[current_event->channel].bank=current_event->a;
+	  song->channel[song->current_event->channel].bank=song->current_event->a;
 	  break;
 	  
 	case ME_EOT:
-	  current_sample=current_event->time;
+	  song->current_sample=song->current_event->time;
 	  return;
 	}
-      current_event++;
+      song->current_event++;
     }
-  /*current_sample=current_event->time;*/
-  if (current_event != event_list)
-    current_event--;
-  current_sample=until_time;
+  /*song->current_sample=song->current_event->time;*/
+  if (song->current_event != song->events)
+    song->current_event--;
+  song->current_sample=until_time;
 }
 
-static void skip_to(int32 until_time)
+static void skip_to(MidiSong *song, int32 until_time)
 {
-  if (current_sample > until_time)
-    current_sample=0;
+  if (song->current_sample > until_time)
+    song->current_sample=0;
 
-  reset_midi();
-  buffered_count=0;
-  buffer_pointer=common_buffer;
-  current_event=event_list;
+  reset_midi(song);
+  song->buffered_count=0;
+  song->buffer_pointer=song->common_buffer;
+  song->current_event=song->events;
   
   if (until_time)
-    seek_forward(until_time);
+    seek_forward(song, until_time);
   ctl->reset();
 }
 
-static int apply_controls(void)
+static int apply_controls(MidiSong *song)
 {
   int rc, i, did_skip=0;
   int32 val;
@@ -1361,50 +1335,50 @@ static int apply_controls(void)
 	return rc;
 	
       case RC_CHANGE_VOLUME:
-	if (val>0 || amplification > -val)
-	  amplification += val;
+	if (val>0 || song->amplification > -val)
+	  song->amplification += val;
 	else 
-	  amplification=0;
-	if (amplification > MAX_AMPLIFICATION)
-	  amplification=MAX_AMPLIFICATION;
-	adjust_amplification();
-	for (i=0; i<voices; i++)
-	  if (voice[i].status != VOICE_FREE)
+	  song->amplification=0;
+	if (song->amplification > MAX_AMPLIFICATION)
+	  song->amplification=MAX_AMPLIFICATION;
+	adjust_amplification(song);
+	for (i=0; i<song->voices; i++)
+	  if (song->voice[i].status != VOICE_FREE)
 	    {
-	      recompute_amp(i);
-	      apply_envelope_to_amp(i);
+	      recompute_amp(song, i);
+	      apply_envelope_to_amp(song, i);
 	    }
-	ctl->master_volume(amplification);
+	ctl->master_volume(song->amplification);
 	break;
 
       case RC_PREVIOUS: /* |<< */
-	if (current_sample < 2*play_mode->rate)
+	if (song->current_sample < 2*play_mode->rate)
 	  return RC_REALLY_PREVIOUS;
 	return RC_RESTART;
 
       case RC_RESTART: /* |<< */
-	skip_to(0);
+	skip_to(song, 0);
 	did_skip=1;
 	break;
 	
       case RC_JUMP:
-	if (val >= sample_count)
+	if (val >= song->samples)
 	  return RC_NEXT;
-	skip_to(val);
+	skip_to(song, val);
 	return rc;
 	
       case RC_FORWARD: /* >> */
-	if (val+current_sample >= sample_count)
+	if (val+song->current_sample >= song->samples)
 	  return RC_NEXT;
-	skip_to(val+current_sample);
+	skip_to(song, val+song->current_sample);
 	did_skip=1;
 	break;
 	
       case RC_BACK: /* << */
-	if (current_sample > val)
-	  skip_to(current_sample-val);
+	if (song->current_sample > val)
+	  skip_to(song, song->current_sample-val);
 	else
-	  skip_to(0); /* We can't seek to end of previous song. */
+	  skip_to(song, 0); /* We can't seek to end of previous song. */
 	did_skip=1;
 	break;
       }
@@ -1417,34 +1391,181 @@ static int apply_controls(void)
     return rc;
 }
 
-static void do_compute_data(uint32 count)
+/* Mixes the n voices in list into buf */
+static void mix_voices(MidiSong *song, int32 *buf, resample_t *rbuf,
+		       const int *list, int n, uint32 count)
 {
   int i;
-  if (!count) return; /* (gl) */
-  memset(buffer_pointer, 0, count * num_ochannels * 4);
-  for (i=0; i<voices; i++)
+  while (n--)
     {
-      if(voice[i].status != VOICE_FREE)
+      i = *list++;
+      if (!song->voice[i].sample_offset && song->voice[i].echo_delay_count)
 	{
-	  if (!voice[i].sample_offset && voice[i].echo_delay_count)
-	    {
-		if ((uint32)voice[i].echo_delay_count >= count) voice[i].echo_delay_count -= count;
-		else
-		  {
-	            mix_voice(buffer_pointer+voice[i].echo_delay_count, i, count-voice[i].echo_delay_count);
-		    voice[i].echo_delay_count = 0;
-		  }
-	    }
-	  else mix_voice(buffer_pointer, i, count);
+	    if ((uint32)song->voice[i].echo_delay_count >= count) song->voice[i].echo_delay_count -= count;
+	    else
+	      {
+		mix_voice(song, buf+song->voice[i].echo_delay_count, rbuf, i, count-song->voice[i].echo_delay_count);
+		song->voice[i].echo_delay_count = 0;
+	      }
+	}
+      else mix_voice(song, buf, rbuf, i, count);
+    }
+}
+
+/* Songs can have their voices mixed by a few threads at once.  Voices
+   don't touch each other's state, so each thread mixes its share into
+   a buffer of its own, and adding the buffers up afterwards gives the
+   same sums as mixing the voices one after another. */
+#define MIX_MAX_THREADS 16
+#define MIX_MIN_VOICES 8	/* per thread, or it's not worth waking one */
+
+typedef struct {
+  struct _MixPool *pool;
+  SDL_Thread *thread;
+  SDL_sem *go;
+  int32 *buffer;
+  resample_t *resample_buffer;
+  int first, last;	/* share of pool->active */
+} MixWorker;
+
+typedef struct _MixPool {
+  MidiSong *song;
+  int workers;
+  MixWorker worker[MIX_MAX_THREADS-1];
+  SDL_sem *done;
+  const int *active;
+  uint32 count;
+  volatile int quit;
+} MixPool;
+
+static int SDLCALL mix_worker(void *data)
+{
+  MixWorker *w = (MixWorker *)data;
+  MixPool *pool = w->pool;
+
+  for (;;)
+    {
+      SDL_SemWait(w->go);
+      if (pool->quit)
+	break;
+      memset(w->buffer, 0, pool->count * num_ochannels * 4);
+      mix_voices(pool->song, w->buffer, w->resample_buffer,
+		 pool->active + w->first, w->last - w->first, pool->count);
+      SDL_SemPost(pool->done);
+    }
+  return 0;
+}
+
+static void free_mix_pool(MixPool *pool)
+{
+  int i;
+
+  pool->quit = 1;
+  for (i=0; i<pool->workers; i++)
+    {
+      SDL_SemPost(pool->worker[i].go);
+      SDL_WaitThread(pool->worker[i].thread, NULL);
+      SDL_DestroySemaphore(pool->worker[i].go);
+      free(pool->worker[i].buffer);
+      free(pool->worker[i].resample_buffer);
+    }
+  if (pool->done)
+    SDL_DestroySemaphore(pool->done);
+  free(pool);
+}
+
+/* Returns NULL if not even one worker could be started */
+static MixPool *new_mix_pool(MidiSong *song, int workers)
+{
+  MixPool *pool;
+  MixWorker *w;
+
+  pool = (MixPool *)safe_malloc(sizeof(*pool));
+  memset(pool, 0, sizeof(*pool));
+  pool->song = song;
+  pool->done = SDL_CreateSemaphore(0);
+  while (pool->done && pool->workers < workers)
+    {
+      w = &pool->worker[pool->workers];
+      w->pool = pool;
+      w->go = SDL_CreateSemaphore(0);
+      if (!w->go)
+	break;
+      w->buffer = safe_malloc(AUDIO_BUFFER_SIZE*num_ochannels*sizeof(int32));
+      w->resample_buffer = safe_malloc(AUDIO_BUFFER_SIZE*sizeof(resample_t)+100);
+      w->thread = SDL_CreateThread(mix_worker, w);
+      if (!w->thread)
+	{
+	  SDL_DestroySemaphore(w->go);
+	  free(w->buffer);
+	  free(w->resample_buffer);
+	  break;
 	}
+      pool->workers++;
     }
-  current_sample += count;
+  if (!pool->workers)
+    {
+      free_mix_pool(pool);
+      return NULL;
+    }
+  return pool;
+}
+
+static void mix_threaded(MidiSong *song, const int *active, int n,
+			 uint32 count)
+{
+  MixPool *pool = song->pool;
+  int32 *dst, *src, len = count * num_ochannels;
+  int threads, i, k;
+
+  threads = n / MIX_MIN_VOICES;
+  if (threads > pool->workers + 1)
+    threads = pool->workers + 1;
+
+  pool->active = active;
+  pool->count = count;
+  for (k=1; k<threads; k++)
+    {
+      pool->worker[k-1].first = n * k / threads;
+      pool->worker[k-1].last = n * (k+1) / threads;
+      SDL_SemPost(pool->worker[k-1].go);
+    }
+
+  /* This thread takes the first share, straight into the output */
+  mix_voices(song, song->buffer_pointer, song->resample_buffer,
+	     active, n / threads, count);
+
+  for (k=1; k<threads; k++)
+    SDL_SemWait(pool->done);
+  for (k=1; k<threads; k++)
+    {
+      dst = song->buffer_pointer;
+      src = pool->worker[k-1].buffer;
+      for (i=0; i<len; i++)
+	*dst++ += *src++;
+    }
+}
+
+static void do_compute_data(MidiSong *song, uint32 count)
+{
+  int i, n, active[MAX_VOICES];
+  if (!count) return; /* (gl) */
+  memset(song->buffer_pointer, 0, count * num_ochannels * 4);
+  for (i=n=0; i<song->voices; i++)
+    if(song->voice[i].status != VOICE_FREE)
+      active[n++] = i;
+  if (song->pool && n >= 2 * MIX_MIN_VOICES)
+    mix_threaded(song, active, n, count);
+  else
+    mix_voices(song, song->buffer_pointer, song->resample_buffer,
+	       active, n, count);
+  song->current_sample += count;
 }
 
 
 /* count=0 means flush remaining buffered data to output device, then
    flush the device itself */
-static int compute_data(void *stream, int32 count)
+static int compute_data(MidiSong *song, void *stream, int32 count)
 {
   int rc, channels;
 
@@ -1455,199 +1576,211 @@ static int compute_data(void *stream, int32 count)
 
   if (!count)
     {
-      if (buffered_count)
-          s32tobuf(stream, common_buffer, channels*buffered_count);
-      buffer_pointer=common_buffer;
-      buffered_count=0;
+      if (song->buffered_count)
+          s32tobuf(stream, song->common_buffer, channels*song->buffered_count);
+      song->buffer_pointer=song->common_buffer;
+      song->buffered_count=0;
       return RC_NONE;
     }
 
-  while ((count+buffered_count) >= AUDIO_BUFFER_SIZE)
+  while ((count+song->buffered_count) >= AUDIO_BUFFER_SIZE)
     {
-      do_compute_data(AUDIO_BUFFER_SIZE-buffered_count);
-      count -= AUDIO_BUFFER_SIZE-buffered_count;
-      s32tobuf(stream, common_buffer, channels*AUDIO_BUFFER_SIZE);
-      buffer_pointer=common_buffer;
-      buffered_count=0;
+      do_compute_data(song, AUDIO_BUFFER_SIZE-song->buffered_count);
+      count -= AUDIO_BUFFER_SIZE-song->buffered_count;
+      s32tobuf(stream, song->common_buffer, channels*AUDIO_BUFFER_SIZE);
+      song->buffer_pointer=song->common_buffer;
+      song->buffered_count=0;
       
-      ctl->current_time(current_sample);
-      if ((rc=apply_controls())!=RC_NONE)
+      ctl->current_time(song->current_sample);
+      if ((rc=apply_controls(song))!=RC_NONE)
 	return rc;
     }
   if (count>0)
     {
-      do_compute_data(count);
-      buffered_count += count;
-      buffer_pointer += count * channels;
+      do_compute_data(song, count);
+      song->buffered_count += count;
+      song->buffer_pointer += count * channels;
     }
   return RC_NONE;
 }
 
-int Timidity_PlaySome(void *stream, int samples)
+/* A song stops playing at its end or when it's stopped */
+static void stop_playing(MidiSong *song)
+{
+  SDL_LockMutex(bank_lock);
+  if (song->playing)
+    {
+      song->playing = 0;
+      songs_playing--;
+    }
+  SDL_UnlockMutex(bank_lock);
+}
+
+int Timidity_PlaySome(MidiSong *song, void *stream, int samples)
 {
   int rc = RC_NONE;
   int32 end_sample;
   
-  if ( ! midi_playing ) {
+  if ( ! song->playing ) {
     return RC_NONE;
   }
-  end_sample = current_sample+samples;
-  while ( current_sample < end_sample ) {
+  end_sample = song->current_sample+samples;
+  while ( song->current_sample < end_sample ) {
     /* Handle all events that should happen at this time */
-    while (current_event->time <= current_sample) {
-      switch(current_event->type) {
+    while (song->current_event->time <= song->current_sample) {
+      switch(song->current_event->type) {
 
         /* Effects affecting a single note */
 
         case ME_NOTEON:
-	  current_event->a += channel[current_event->channel].transpose;
-          if (!(current_event->b)) /* Velocity 0? */
-            note_off(current_event);
+	  song->current_event->a += song->channel[song->current_event->channel].transpose;
+          if (!(song->current_event->b)) /* Velocity 0? */
+            note_off(song, song->current_event);
           else
-            note_on(current_event);
+            note_on(song, song->current_event);
           break;
   
         case ME_NOTEOFF:
-	  current_event->a += channel[current_event->channel].transpose;
-          note_off(current_event);
+	  song->current_event->a += song->channel[song->current_event->channel].transpose;
+          note_off(song, song->current_event);
           break;
   
         case ME_KEYPRESSURE:
-          adjust_pressure(current_event);
+          adjust_pressure(song, song->current_event);
           break;
   
           /* Effects affecting a single channel */
   
         case ME_PITCH_SENS:
-          channel[current_event->channel].pitchsens=current_event->a;
-          channel[current_event->channel].pitchfactor=0;
+          song->channel[song->current_event->channel].pitchsens=song->current_event->a;
+          song->channel[song->current_event->channel].pitchfactor=0;
           break;
           
         case ME_PITCHWHEEL:
-          channel[current_event->channel].pitchbend=
-            current_event->a + current_event->b * 128;
-          channel[current_event->channel].pitchfactor=0;
+          song->channel[song->current_event->channel].pitchbend=
+            song->current_event->a + song->current_event->b * 128;
+          song->channel[song->current_event->channel].pitchfactor=0;
           /* Adjust pitch for notes already playing */
-          adjust_pitchbend(current_event->channel);
-          ctl->pitch_bend(current_event->channel, 
-              channel[current_event->channel].pitchbend);
+          adjust_pitchbend(song, song->current_event->channel);
+          ctl->pitch_bend(song->current_event->channel, 
+              song->channel[song->current_event->channel].pitchbend);
           break;
           
         case ME_MAINVOLUME:
-          channel[current_event->channel].volume=current_event->a;
-          adjust_volume(current_event->channel);
-          ctl->volume(current_event->channel, current_event->a);
+          song->channel[song->current_event->channel].volume=song->current_event->a;
+          adjust_volume(song, song->current_event->channel);
+          ctl->volume(song->current_event->channel, song->current_event->a);
           break;
 
 	case ME_MASTERVOLUME:
-	  adjust_master_volume(current_event->a + (current_event->b <<7));
+	  adjust_master_volume(song, song->current_event->a + (song->current_event->b <<7));
 	  break;
 	      
 	case ME_REVERBERATION:
-	  channel[current_event->channel].reverberation=current_event->a;
+	  song->channel[song->current_event->channel].reverberation=song->current_event->a;
 	  break;
 
 	case ME_CHORUSDEPTH:
-	  channel[current_event->channel].chorusdepth=current_event->a;
+	  song->channel[song->current_event->channel].chorusdepth=song->current_event->a;
 	  break;
 
         case ME_PAN:
-          channel[current_event->channel].panning=current_event->a;
+          song->channel[song->current_event->channel].panning=song->current_event->a;
           if (adjust_panning_immediately)
-            adjust_panning(current_event->channel);
-          ctl->panning(current_event->channel, current_event->a);
+            adjust_panning(song, song->current_event->channel);
+          ctl->panning(song->current_event->channel, song->current_event->a);
           break;
           
         case ME_EXPRESSION:
-          channel[current_event->channel].expression=current_event->a;
-          adjust_volume(current_event->channel);
-          ctl->expression(current_event->channel, current_event->a);
+          song->channel[song->current_event->channel].expression=song->current_event->a;
+          adjust_volume(song, song->current_event->channel);
+          ctl->expression(song->current_event->channel, song->current_event->a);
           break;
   
         case ME_PROGRAM:
-          /* if (ISDRUMCHANNEL(current_event->channel)) { */
-	  if (channel[current_event->channel].kit) {
+          /* if (ISDRUMCHANNEL(song->current_event->channel)) { */
+	  if (song->channel[song->current_event->channel].kit) {
             /* Change drum set */
-            channel[current_event->channel].bank=current_event->a;
+            song->channel[song->current_event->channel].bank=song->current_event->a;
           }
           else
           {
-            channel[current_event->channel].program=current_event->a;
+            song->channel[song->current_event->channel].program=song->current_event->a;
           }
-          ctl->program(current_event->channel, current_event->a);
+          ctl->program(song->current_event->channel, song->current_event->a);
           break;
   
         case ME_SUSTAIN:
-          channel[current_event->channel].sustain=current_event->a;
-          if (!current_event->a)
-            drop_sustain(current_event->channel);
-          ctl->sustain(current_event->channel, current_event->a);
+          song->channel[song->current_event->channel].sustain=song->current_event->a;
+          if (!song->current_event->a)
+            drop_sustain(song, song->current_event->channel);
+          ctl->sustain(song->current_event->channel, song->current_event->a);
           break;
           
         case ME_RESET_CONTROLLERS:
-          reset_controllers(current_event->channel);
-          redraw_controllers(current_event->channel);
+          reset_controllers(song, song->current_event->channel);
+          redraw_controllers(song, song->current_event->channel);
           break;
   
         case ME_ALL_NOTES_OFF:
-          all_notes_off(current_event->channel);
+          all_notes_off(song, song->current_event->channel);
           break;
           
         case ME_ALL_SOUNDS_OFF:
-          all_sounds_off(current_event->channel);
+          all_sounds_off(song, song->current_event->channel);
           break;
 
 	case ME_HARMONICCONTENT:
-	  channel[current_event->channel].harmoniccontent=current_event->a;
+	  song->channel[song->current_event->channel].harmoniccontent=song->current_event->a;
 	  break;
 
 	case ME_RELEASETIME:
-	  channel[current_event->channel].releasetime=current_event->a;
+	  song->channel[song->current_event->channel].releasetime=song->current_event->a;
 	  break;
 
 	case ME_ATTACKTIME:
-	  channel[current_event->channel].attacktime=current_event->a;
+	  song->channel[song->current_event->channel].attacktime=song->current_event->a;
 	  break;
 
 	case ME_BRIGHTNESS:
-	  channel[current_event->channel].brightness=current_event->a;
+	  song->channel[song->current_event->channel].brightness=song->current_event->a;
 	  break;
 
         case ME_TONE_BANK:
-          channel[current_event->channel].bank=current_event->a;
+          song->channel[song->current_event->channel].bank=song->current_event->a;
           break;
 
 
 	case ME_TONE_KIT:
-	  if (current_event->a==SFX_BANKTYPE)
+	  if (song->current_event->a==SFX_BANKTYPE)
 	  {
-	    channel[current_event->channel].sfx=SFXBANK;
-	    channel[current_event->channel].kit=0;
+	    song->channel[song->current_event->channel].sfx=SFXBANK;
+	    song->channel[song->current_event->channel].kit=0;
 	  }
 	  else
 	  {
-	    channel[current_event->channel].sfx=0;
-	    channel[current_event->channel].kit=current_event->a;
+	    song->channel[song->current_event->channel].sfx=0;
+	    song->channel[song->current_event->channel].kit=song->current_event->a;
 	  }
 	  break;
 
         case ME_EOT:
           /* Give the last notes a couple of seconds to decay  */
           ctl->cmsg(CMSG_INFO, VERB_VERBOSE,
-            "Playing time: ~%d seconds", current_sample/play_mode->rate+2);
+            "Playing time: ~%d seconds", song->current_sample/play_mode->rate+2);
           ctl->cmsg(CMSG_INFO, VERB_VERBOSE,
-            "Notes cut: %d", cut_notes);
+            "Notes cut: %d", song->cut_notes);
           ctl->cmsg(CMSG_INFO, VERB_VERBOSE,
-          "Notes lost totally: %d", lost_notes);
-          midi_playing = 0;
+          "Notes lost totally: %d", song->lost_notes);
+          stop_playing(song);
           return RC_TUNE_END;
         }
-      current_event++;
+      song->current_event++;
     }
-    if (current_event->time > end_sample)
-      rc=compute_data(stream, end_sample-current_sample);
+    if (song->current_event->time > end_sample)
+      rc=compute_data(song, stream, end_sample-song->current_sample);
     else
-      rc=compute_data(stream, current_event->time-current_sample);
+      rc=compute_data(song, stream, song->current_event->time-song->current_sample);
     ctl->refresh();
     if ( (rc!=RC_NONE) && (rc!=RC_JUMP))
       break;
@@ -1656,24 +1789,141 @@ int Timidity_PlaySome(void *stream, int samples)
 }
 
 
-void Timidity_SetVolume(int volume)
+/* Writes a RIFF WAVE header, to be finished once the data size is known */
+static int write_wave_header(SDL_RWops *dst, int tag, int channels,
+			     int frame_size, Uint32 data_size)
+{
+  return (SDL_RWwrite(dst, "RIFF", 4, 1) == 1 &&
+	  SDL_WriteLE32(dst, 36 + data_size) &&
+	  SDL_RWwrite(dst, "WAVEfmt ", 8, 1) == 1 &&
+	  SDL_WriteLE32(dst, 16) &&
+	  SDL_WriteLE16(dst, tag) &&
+	  SDL_WriteLE16(dst, channels) &&
+	  SDL_WriteLE32(dst, play_mode->rate) &&
+	  SDL_WriteLE32(dst, play_mode->rate * frame_size) &&
+	  SDL_WriteLE16(dst, frame_size) &&
+	  SDL_WriteLE16(dst, 8 * frame_size / channels) &&
+	  SDL_RWwrite(dst, "data", 4, 1) == 1 &&
+	  SDL_WriteLE32(dst, data_size));
+}
+
+int Timidity_RenderSong(MidiSong *song, SDL_RWops *dst, int wave)
+{
+  int channels, frame_size, tag = 1, start = 0, ok = 1;
+  int32 n, frames = 0;
+  Uint8 *buf;
+
+  if ( play_mode->encoding & PE_MONO )
+    channels = 1;
+  else
+    channels = num_ochannels;
+  frame_size = channels * (output_format & 0xFF) / 8;
+
+  if (wave)
+    {
+      switch (output_format)
+	{
+	case AUDIO_U8:
+	case AUDIO_S16LSB:
+	  break;
+	case AUDIO_F32LSB:
+	  tag = 3; /* WAVE_FORMAT_IEEE_FLOAT */
+	  break;
+	default:
+	  ctl->cmsg(CMSG_ERROR, VERB_NORMAL,
+		    "WAVE files can't hold this audio format");
+	  return -1;
+	}
+      start = SDL_RWtell(dst);
+      if (!write_wave_header(dst, tag, channels, frame_size, 0))
+	ok = 0;
+    }
+
+  /* Each call computes and converts one whole buffer, but the song
+     ends partway through one, and that part is still to be converted */
+  buf = safe_malloc(AUDIO_BUFFER_SIZE * frame_size);
+  while (ok && song->playing)
+    {
+      Timidity_PlaySome(song, buf, AUDIO_BUFFER_SIZE);
+      if (song->playing)
+	n = AUDIO_BUFFER_SIZE;
+      else
+	{
+	  n = song->buffered_count;
+	  compute_data(song, buf, 0);
+	}
+      if (n && SDL_RWwrite(dst, buf, frame_size, n) != n)
+	ok = 0;
+      frames += n;
+    }
+  free(buf);
+
+  if (ok && wave && start >= 0 &&
+      SDL_RWseek(dst, start, RW_SEEK_SET) == start)
+    {
+      ok = write_wave_header(dst, tag, channels, frame_size,
+			     frames * frame_size);
+      SDL_RWseek(dst, 0, RW_SEEK_END);
+    }
+  if (!ok)
+    {
+      ctl->cmsg(CMSG_ERROR, VERB_NORMAL, "Couldn't write the rendered song");
+      return -1;
+    }
+  return frames;
+}
+
+void Timidity_SetVolume(MidiSong *song, int volume)
 {
   int i;
   if (volume > MAX_AMPLIFICATION)
-    amplification=MAX_AMPLIFICATION;
+    song->amplification=MAX_AMPLIFICATION;
   else
   if (volume < 0)
-    amplification=0;
+    song->amplification=0;
   else
-    amplification=volume;
-  adjust_amplification();
-  for (i=0; i<voices; i++)
-    if (voice[i].status != VOICE_FREE)
+    song->amplification=volume;
+  adjust_amplification(song);
+  for (i=0; i<song->voices; i++)
+    if (song->voice[i].status != VOICE_FREE)
       {
-        recompute_amp(i);
-        apply_envelope_to_amp(i);
+        recompute_amp(song, i);
+        apply_envelope_to_amp(song, i);
       }
-  ctl->master_volume(amplification);
+  ctl->master_volume(song->amplification);
+}
+
+void Timidity_SetThreads(MidiSong *song, int threads)
+{
+  if (threads > MIX_MAX_THREADS)
+    threads = MIX_MAX_THREADS;
+  if (song->pool)
+    {
+      if (threads == song->pool->workers + 1)
+	return;
+      free_mix_pool(song->pool);
+      song->pool = NULL;
+    }
+  if (threads > 1)
+    song->pool = new_mix_pool(song, threads - 1);
+}
+
+void Timidity_SetVoices(MidiSong *song, int voices)
+{
+  int i;
+  if (voices > MAX_VOICES)
+    voices = MAX_VOICES;
+  else if (voices < 1)
+    voices = 1;
+  /* Voices past the new limit would never be mixed or freed */
+  for (i = voices; i < song->voices; i++)
+    song->voice[i].status = VOICE_FREE;
+  song->voices = voices;
+}
+
+void Timidity_SetInterpolation(MidiSong *song, int interpolation)
+{
+  song->cubic = (interpolation == TIMIDITY_INTERP_CUBIC);
 }
 
 MidiSong *Timidity_LoadSong_RW(SDL_RWops *rw, int freerw)
@@ -1684,10 +1934,13 @@ MidiSong *Timidity_LoadSong_RW(SDL_RWops *rw, int freerw)
   /* Allocate memory for the song */
   song = (MidiSong *)safe_malloc(sizeof(*song));
   memset(song, 0, sizeof(*song));
+  song->voices = DEFAULT_VOICES;
+  song->amplification = DEFAULT_AMPLIFICATION;
 
+  SDL_LockMutex(bank_lock);
   strcpy(midi_name, "SDLrwops source");
-
-  song->events = read_midi_file(rw, &events, &song->samples);
+  song->events = read_midi_file(song, rw, &events, &song->samples);
+  SDL_UnlockMutex(bank_lock);
   if (freerw) {
     SDL_RWclose(rw);
   }
@@ -1695,53 +1948,63 @@ MidiSong *Timidity_LoadSong_RW(SDL_RWops *rw, int freerw)
   /* Make sure everything is okay */
   if (!song->events) {
     free(song);
-    song = NULL;
+    return(NULL);
   }
+
+  /* Each song mixes into buffers of its own */
+  song->resample_buffer = safe_malloc(AUDIO_BUFFER_SIZE*sizeof(resample_t)+100);
+  song->common_buffer = safe_malloc(AUDIO_BUFFER_SIZE*num_ochannels*sizeof(int32));
   return(song);
 }
 
 void Timidity_Start(MidiSong *song)
 {
-  load_missing_instruments();
-  adjust_amplification();
-  sample_count = song->samples;
-  event_list = song->events;
-  lost_notes=cut_notes=0;
-
-  skip_to(0);
-  midi_playing = 1;
+  SDL_LockMutex(bank_lock);
+  /* Don't purge instruments another song may be playing */
+  load_missing_instruments(!songs_playing);
+  adjust_amplification(song);
+  song->lost_notes=song->cut_notes=0;
+
+  skip_to(song, 0);
+  if (!song->playing)
+    songs_playing++;
+  song->playing = 1;
+  SDL_UnlockMutex(bank_lock);
 }
 
-int Timidity_Active(void)
+int Timidity_Active(MidiSong *song)
 {
-	return(midi_playing);
+	return(song->playing);
 }
 
-void Timidity_Stop(void)
+void Timidity_Stop(MidiSong *song)
 {
-  midi_playing = 0;
+  stop_playing(song);
 }
 
 void Timidity_FreeSong(MidiSong *song)
 {
-  if (free_instruments_afterwards)
+  stop_playing(song);
+  SDL_LockMutex(bank_lock);
+  if (free_instruments_afterwards && !songs_playing)
     free_instruments();
-  
+  SDL_UnlockMutex(bank_lock);
+
+  if (song->pool)
+    free_mix_pool(song->pool);
+  free(song->resample_buffer);
+  free(song->common_buffer);
   free(song->events);
   free(song);
 }
 
 void Timidity_Close(void)
 {
-  if (resample_buffer) {
-    free(resample_buffer);
-    resample_buffer=NULL;
-  }
-  if (common_buffer) {
-    free(common_buffer);
-    common_buffer=NULL;
-  }
   free_instruments();
+  set_instrument_cache(NULL);
   free_pathlist();
+  if (bank_lock) {
+    SDL_DestroyMutex(bank_lock);
+    bank_lock=NULL;
+  }
 }
-
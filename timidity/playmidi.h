@@ -133,27 +133,50 @@ typedef struct {
 #define RELEASEC 5
 #define DELAY 6
 
-extern Channel channel[16];
-extern Voice voice[MAX_VOICES];
-extern signed char drumvolume[MAXCHAN][MAXNOTE];
-extern signed char drumpanpot[MAXCHAN][MAXNOTE];
-extern signed char drumreverberation[MAXCHAN][MAXNOTE];
-extern signed char drumchorusdepth[MAXCHAN][MAXNOTE];
-
-extern int32 control_ratio, amp_with_poly, amplification;
+extern int32 control_ratio;
 extern int32 drumchannels;
 extern int adjust_panning_immediately;
-extern int voices;
 
 #define ISDRUMCHANNEL(c) ((drumchannels & (1<<(c))))
 
-extern int GM_System_On;
-extern int XG_System_On;
-extern int GS_System_On;
-
-extern int XG_System_reverb_type;
-extern int XG_System_chorus_type;
-extern int XG_System_variation_type;
+#ifndef TIMIDITY_MIDISONG
+#define TIMIDITY_MIDISONG
+typedef struct _MidiSong MidiSong;
+#endif
+
+/* Everything that changes while a song plays, so that any number of songs
+   can be rendered at once, each from one thread at a time.  The output
+   format and the tone banks are shared. */
+struct _MidiSong {
+  int32 samples;
+  MidiEvent *events;
+  int playing;
+
+  Channel channel[MAXCHAN];
+  Voice voice[MAX_VOICES];
+  signed char drumvolume[MAXCHAN][MAXNOTE];
+  signed char drumpanpot[MAXCHAN][MAXNOTE];
+  signed char drumreverberation[MAXCHAN][MAXNOTE];
+  signed char drumchorusdepth[MAXCHAN][MAXNOTE];
+  int voices;
+  int32 amplification;
+  FLOAT_T master_volume;
+
+  int GM_System_On, XG_System_On, GS_System_On;
+  int XG_System_reverb_type, XG_System_chorus_type, XG_System_variation_type;
+
+  MidiEvent *current_event;
+  int32 current_sample;
+  int32 lost_notes, cut_notes;
+
+  int cubic;			/* TIMIDITY_INTERP_CUBIC */
+
+  resample_t *resample_buffer;
+  int32 *common_buffer, *buffer_pointer;
+  int32 buffered_count;
+
+  struct _MixPool *pool;	/* Timidity_SetThreads() */
+};
 
 extern int play_midi(MidiEvent *el, int32 events, int32 samples);
 extern int play_midi_file(const char *fn);
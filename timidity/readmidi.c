@@ -36,6 +36,7 @@ static char title[128];
 #endif
 
 /* to avoid some unnecessary parameter passing */
+static MidiSong *song;
 static MidiEventList *evlist;
 static int32 event_count;
 static SDL_RWops *rw;
@@ -89,7 +90,7 @@ static int sysex(uint32 len, uint8 *syschan, uint8 *sysa, uint8 *sysb, SDL_RWops
   if (id==0x7e && port==0x7f && model==0x09 && adhi==0x01)
     {
       ctl->cmsg(CMSG_TEXT, VERB_VERBOSE, "GM System On", len);
-      GM_System_On=1;
+      song->GM_System_On=1;
       free(s);
       return 0;
     }
@@ -119,7 +120,7 @@ static int sysex(uint32 len, uint8 *syschan, uint8 *sysa, uint8 *sysb, SDL_RWops
 	if (!adhi && !adlo && cd==0x7e && !dta)
 	  {
       	    ctl->cmsg(CMSG_TEXT, VERB_VERBOSE, "XG System On", len);
-	    XG_System_On=1;
+	    song->XG_System_On=1;
 	    #ifdef tplus
 	    vol_table = xg_vol_table;
 	    #endif
@@ -130,13 +131,13 @@ static int sysex(uint32 len, uint8 *syschan, uint8 *sysa, uint8 *sysb, SDL_RWops
 	    switch (cd)
 	      {
 		case 0x00:
-		  XG_System_reverb_type=(dta<<3)+dtb;
+		  song->XG_System_reverb_type=(dta<<3)+dtb;
 		  break;
 		case 0x20:
-		  XG_System_chorus_type=((dta-64)<<3)+dtb;
+		  song->XG_System_chorus_type=((dta-64)<<3)+dtb;
 		  break;
 		case 0x40:
-		  XG_System_variation_type=dta;
+		  song->XG_System_variation_type=dta;
 		  break;
 		case 0x5a:
 		  /* dta==0 Insertion; dta==1 System */
@@ -161,7 +162,7 @@ static int sysex(uint32 len, uint8 *syschan, uint8 *sysa, uint8 *sysb, SDL_RWops
 		  break;
 		case 0x08: /*  */
 		  /* d->channel[adlo&0x0f].transpose = (char)(dta-64); */
-		  channel[ch].transpose = (char)(dta-64);
+		  song->channel[ch].transpose = (char)(dta-64);
       	    	  ctl->cmsg(CMSG_TEXT, VERB_DEBUG, "transpose channel %d by %d",
 			(adlo&0x0f)+1, dta-64);
 		  break;
@@ -196,7 +197,7 @@ static int sysex(uint32 len, uint8 *syschan, uint8 *sysa, uint8 *sysb, SDL_RWops
 	if (!cd && dta==0x7f && !dtb && dtc==0x41)
 	  {
       	    ctl->cmsg(CMSG_TEXT, VERB_VERBOSE, "GS System On", len);
-	    GS_System_On=1;
+	    song->GS_System_On=1;
 	    #ifdef tplus
 	    vol_table = gs_vol_table;
 	    #endif
@@ -207,34 +208,34 @@ static int sysex(uint32 len, uint8 *syschan, uint8 *sysa, uint8 *sysb, SDL_RWops
 	    if (!chan) chan=9;
 	    else if (chan<10) chan--;
 	    chan = MERGE_CHANNEL_PORT(chan);
-	    channel[chan].kit=dtb;
+	    song->channel[chan].kit=dtb;
 	  }
 	else if (cd==0x01) switch(dta)
 	  {
 	    case 0x30:
 		switch(dtb)
 		  {
-		    case 0: XG_System_reverb_type=16+0; break;
-		    case 1: XG_System_reverb_type=16+1; break;
-		    case 2: XG_System_reverb_type=16+2; break;
-		    case 3: XG_System_reverb_type= 8+0; break;
-		    case 4: XG_System_reverb_type= 8+1; break;
-		    case 5: XG_System_reverb_type=32+0; break;
-		    case 6: XG_System_reverb_type=8*17; break;
-		    case 7: XG_System_reverb_type=8*18; break;
+		    case 0: song->XG_System_reverb_type=16+0; break;
+		    case 1: song->XG_System_reverb_type=16+1; break;
+		    case 2: song->XG_System_reverb_type=16+2; break;
+		    case 3: song->XG_System_reverb_type= 8+0; break;
+		    case 4: song->XG_System_reverb_type= 8+1; break;
+		    case 5: song->XG_System_reverb_type=32+0; break;
+		    case 6: song->XG_System_reverb_type=8*17; break;
+		    case 7: song->XG_System_reverb_type=8*18; break;
 		  }
 		break;
 	    case 0x38:
 		switch(dtb)
 		  {
-		    case 0: XG_System_chorus_type= 8+0; break;
-		    case 1: XG_System_chorus_type= 8+1; break;
-		    case 2: XG_System_chorus_type= 8+2; break;
-		    case 3: XG_System_chorus_type= 8+4; break;
-		    case 4: XG_System_chorus_type=  -1; break;
-		    case 5: XG_System_chorus_type= 8*3; break;
-		    case 6: XG_System_chorus_type=  -1; break;
-		    case 7: XG_System_chorus_type=  -1; break;
+		    case 0: song->XG_System_chorus_type= 8+0; break;
+		    case 1: song->XG_System_chorus_type= 8+1; break;
+		    case 2: song->XG_System_chorus_type= 8+2; break;
+		    case 3: song->XG_System_chorus_type= 8+4; break;
+		    case 4: song->XG_System_chorus_type=  -1; break;
+		    case 5: song->XG_System_chorus_type= 8*3; break;
+		    case 6: song->XG_System_chorus_type=  -1; break;
+		    case 7: song->XG_System_chorus_type=  -1; break;
 		  }
 		break;
 	  }
@@ -411,9 +412,9 @@ static MidiEventList *read_midi_event(void)
 		       Also, some MIDI files use 0 as some sort of
 		       continuous controller. This will cause lots of
 		       warnings about undefined tone banks. */
-		  case 0: if (XG_System_On) control = ME_TONE_KIT; else control=ME_TONE_BANK; break;
+		  case 0: if (song->XG_System_On) control = ME_TONE_KIT; else control=ME_TONE_BANK; break;
 
-		  case 32: if (XG_System_On) control = ME_TONE_BANK; break;
+		  case 32: if (song->XG_System_On) control = ME_TONE_BANK; break;
 
 		  case 100: nrpn=0; rpn_msb[lastchan]=b; break;
 		  case 101: nrpn=0; rpn_lsb[lastchan]=b; break;
@@ -448,13 +449,13 @@ static MidiEventList *read_midi_event(void)
 			   case 0x18: pitch coarse
 			   case 0x19: pitch fine
 			*/
-			   case 0x1a: drumvolume[lastchan][0x7f & rpn_lsb[lastchan]] = b; break;
+			   case 0x1a: song->drumvolume[lastchan][0x7f & rpn_lsb[lastchan]] = b; break;
 			   case 0x1c:
 			     if (!b) b=(int) (127.0*rand()/(RAND_MAX));
-			     drumpanpot[lastchan][0x7f & rpn_lsb[lastchan]] = b;
+			     song->drumpanpot[lastchan][0x7f & rpn_lsb[lastchan]] = b;
 			     break;
-			   case 0x1d: drumreverberation[lastchan][0x7f & rpn_lsb[lastchan]] = b; break;
-			   case 0x1e: drumchorusdepth[lastchan][0x7f & rpn_lsb[lastchan]] = b; break;
+			   case 0x1d: song->drumreverberation[lastchan][0x7f & rpn_lsb[lastchan]] = b; break;
+			   case 0x1e: song->drumchorusdepth[lastchan][0x7f & rpn_lsb[lastchan]] = b; break;
 			/*
 			   case 0x1f: variation send level
 			*/
@@ -649,7 +650,7 @@ static MidiEvent *groom_list(int32 divisions,int32 *eventsp,int32 *samplesp)
       current_bank[i]=0;
       current_banktype[i]=0;
       current_set[i]=0;
-      current_kit[i]=channel[i].kit;
+      current_kit[i]=song->channel[i].kit;
       current_program[i]=default_program;
     }
 
@@ -749,7 +750,7 @@ static MidiEvent *groom_list(int32 divisions,int32 *eventsp,int32 *samplesp)
 	    {
 	      dset = current_set[meep->event.channel];
 	      dnote=meep->event.a;
-	      if (XG_System_On) xremap_percussion(&dset, &dnote, drumsflag);
+	      if (song->XG_System_On) xremap_percussion(&dset, &dnote, drumsflag);
 
 	      /*if (current_config_pc42b) pcmap(&dset, &dnote, &mprog, &drumsflag);*/
 
@@ -763,7 +764,7 @@ static MidiEvent *groom_list(int32 divisions,int32 *eventsp,int32 *samplesp)
 	       }
 	      else drumset[dset]->tone[dnote].last_used
 		 = current_tune_number;
-	      if (!channel[meep->event.channel].name) channel[meep->event.channel].name=
+	      if (!song->channel[meep->event.channel].name) song->channel[meep->event.channel].name=
 		    drumset[dset]->name;
 	     }
 	    }
@@ -781,7 +782,7 @@ static MidiEvent *groom_list(int32 divisions,int32 *eventsp,int32 *samplesp)
 	      if (mprog==SPECIAL_PROGRAM)
 		break;
 
-	      if (XG_System_On && banknum==SFXBANK && !tonebank[SFXBANK] && tonebank[120]) 
+	      if (song->XG_System_On && banknum==SFXBANK && !tonebank[SFXBANK] && tonebank[120]) 
 		      banknum = 120;
 
 	      /*if (current_config_pc42b) pcmap(&banknum, &dnote, &mprog, &drumsflag);*/
@@ -794,7 +795,7 @@ static MidiEvent *groom_list(int32 divisions,int32 *eventsp,int32 *samplesp)
 		drumset[dset]->tone[dnote].layer=MAGIC_LOAD_INSTRUMENT;
 	       }
 	      else drumset[dset]->tone[dnote].last_used = current_tune_number;
-	      if (!channel[meep->event.channel].name) channel[meep->event.channel].name=
+	      if (!song->channel[meep->event.channel].name) song->channel[meep->event.channel].name=
 		    drumset[dset]->name;
 	     }
 	     if (!drumsflag)
@@ -805,7 +806,7 @@ static MidiEvent *groom_list(int32 divisions,int32 *eventsp,int32 *samplesp)
 		  tonebank[banknum]->tone[mprog].layer=MAGIC_LOAD_INSTRUMENT;
 		}
 	      else tonebank[banknum]->tone[mprog].last_used = current_tune_number;
-	      if (!channel[meep->event.channel].name) channel[meep->event.channel].name=
+	      if (!song->channel[meep->event.channel].name) song->channel[meep->event.channel].name=
 		    tonebank[banknum]->tone[mprog].name;
 	     }
 	    }
@@ -870,8 +871,8 @@ static MidiEvent *groom_list(int32 divisions,int32 *eventsp,int32 *samplesp)
 	      skip_this_event=1;
 	      break;
 	    }
-	  if (XG_System_On && meep->event.a > 0 && meep->event.a < 48) {
-	      channel[meep->event.channel].variationbank=meep->event.a;
+	  if (song->XG_System_On && meep->event.a > 0 && meep->event.a < 48) {
+	      song->channel[meep->event.channel].variationbank=meep->event.a;
 	      ctl->cmsg(CMSG_WARNING, VERB_VERBOSE,
 		   "XG variation bank %d", meep->event.a);
 	      new_value=meep->event.a=0;
@@ -892,10 +893,10 @@ static MidiEvent *groom_list(int32 divisions,int32 *eventsp,int32 *samplesp)
 	  break;
 
 	case ME_HARMONICCONTENT:
-	  channel[meep->event.channel].harmoniccontent=meep->event.a;
+	  song->channel[meep->event.channel].harmoniccontent=meep->event.a;
 	  break;
 	case ME_BRIGHTNESS:
-	  channel[meep->event.channel].brightness=meep->event.a;
+	  song->channel[meep->event.channel].brightness=meep->event.a;
 	  break;
 
 	}
@@ -935,36 +936,37 @@ static MidiEvent *groom_list(int32 divisions,int32 *eventsp,int32 *samplesp)
   return groomed_list;
 }
 
-MidiEvent *read_midi_file(SDL_RWops *mrw, int32 *count, int32 *sp)
+MidiEvent *read_midi_file(MidiSong *msong, SDL_RWops *mrw, int32 *count, int32 *sp)
 {
   int32 len, divisions;
   int16 format, tracks, divisions_tmp;
   int i;
   char tmp[4];
 
+  song = msong;
   rw = mrw;
   event_count=0;
   at=0;
   evlist=0;
 
-  GM_System_On=GS_System_On=XG_System_On=0;
+  song->GM_System_On=song->GS_System_On=song->XG_System_On=0;
   /* vol_table = def_vol_table; */
-  XG_System_reverb_type=XG_System_chorus_type=XG_System_variation_type=0;
-  memset(&drumvolume,-1,sizeof(drumvolume));
-  memset(&drumchorusdepth,-1,sizeof(drumchorusdepth));
-  memset(&drumreverberation,-1,sizeof(drumreverberation));
-  memset(&drumpanpot,NO_PANNING,sizeof(drumpanpot));
+  song->XG_System_reverb_type=song->XG_System_chorus_type=song->XG_System_variation_type=0;
+  memset(song->drumvolume,-1,sizeof(song->drumvolume));
+  memset(song->drumchorusdepth,-1,sizeof(song->drumchorusdepth));
+  memset(song->drumreverberation,-1,sizeof(song->drumreverberation));
+  memset(song->drumpanpot,NO_PANNING,sizeof(song->drumpanpot));
 
   for (i=0; i<MAXCHAN; i++)
      {
-	if (ISDRUMCHANNEL(i)) channel[i].kit = 127;
-	else channel[i].kit = 0;
-	channel[i].brightness = 64;
-	channel[i].harmoniccontent = 64;
-	channel[i].variationbank = 0;
-	channel[i].chorusdepth = 0;
-	channel[i].reverberation = 0;
-	channel[i].transpose = 0;
+	if (ISDRUMCHANNEL(i)) song->channel[i].kit = 127;
+	else song->channel[i].kit = 0;
+	song->channel[i].brightness = 64;
+	song->channel[i].harmoniccontent = 64;
+	song->channel[i].variationbank = 0;
+	song->channel[i].chorusdepth = 0;
+	song->channel[i].reverberation = 0;
+	song->channel[i].transpose = 0;
      }
 
 past_riff:
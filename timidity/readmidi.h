@@ -13,6 +13,6 @@ typedef struct {
 
 extern int32 quietchannels;
 
-extern MidiEvent *read_midi_file(SDL_RWops *mrw, int32 *count, int32 *sp);
+extern MidiEvent *read_midi_file(MidiSong *song, SDL_RWops *mrw, int32 *count, int32 *sp);
 
 extern char midi_name[FILENAME_MAX+1];
@@ -9,7 +9,9 @@
 #include <math.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
+#include "SDL_cpuinfo.h"
 #include "config.h"
 #include "common.h"
 #include "instrum.h"
@@ -42,20 +44,409 @@
 #define FINALINTERP if (ofs == le) *dest++=src[ofs>>FRACTION_BITS];
 /* So it isn't interpolation. At least it's final. */
 
-extern resample_t *resample_buffer;
+#ifdef PRECALC_LOOPS
+/* The precalculated loops hand whole runs of points to rs_span() */
+#  define RSVARS
+#else
+#  define RSVARS INTERPVARS; resample_t *dest=out->dest
+#endif
+
+#if defined(RESAMPLE_MIX) && SDL_ASSEMBLY_ROUTINES
+#  if (defined(__GNUC__) && defined(__SSE2__)) || \
+      (defined(_MSC_VER) && (_MSC_VER >= 1300) && \
+       (defined(_M_IX86) || defined(_M_X64)) && !defined(_XBOX))
+#    define RESAMPLE_SSE2
+#    include <emmintrin.h>
+#  endif
+#  if defined(RESAMPLE_SSE2) && \
+      ((defined(__GNUC__) && ((__GNUC__ > 4) || \
+        (__GNUC__ == 4 && __GNUC_MINOR__ >= 9))) || \
+       defined(__clang__) || (defined(_MSC_VER) && (_MSC_VER >= 1700)))
+#    define RESAMPLE_AVX2
+#    include <immintrin.h>
+/* GCC only emits AVX2 code in functions that ask for it */
+#    if defined(__GNUC__)
+#      define TARGET_AVX2 __attribute__((target("avx2")))
+#    else
+#      define TARGET_AVX2
+#    endif
+#  endif
+#endif
+
+/* Where the resampled points go: into dest, or, if that is NULL,
+   times gain[] into the interleaved channels at lp */
+typedef struct {
+  resample_t *dest;
+  int cubic;
+#ifdef RESAMPLE_MIX
+  int32 *lp, *gain;
+  int channels, simd, dead;
+  int32 cc;
+  ResampleGains update;
+  MidiSong *song;
+  int v;
+#endif
+} ResampleOut;
+
+#ifdef RESAMPLE_MIX
+
+/*************** interpolation and mixing kernels *****************/
+
+/* Cubic interpolation uses the points at -1, 0, 1 and 2, with src[0]
+   standing in for src[-1] at the very start.  Unlike linear
+   interpolation it can overshoot, so the result is clipped. */
+static __inline__ int32 rs_cubic(const sample_t *src, int32 ofs)
+{
+  const sample_t *p = src + (ofs >> FRACTION_BITS);
+  const int16 *c = cubic_table[(ofs & FRACTION_MASK) >>
+			       (FRACTION_BITS - CUBIC_PHASE_BITS)];
+  int32 s;
+
+  s = (p == src ? p[0] : p[-1]) * c[0] + p[0] * c[1] + p[1] * c[2] +
+    p[2] * c[3];
+  s = (s + (1 << (CUBIC_BITS - 1))) >> CUBIC_BITS;
+  if (s > 32767) s = 32767;
+  else if (s < -32768) s = -32768;
+  return s;
+}
+
+static void mix_c(int32 *lp, const int32 *gain, int channels, int cubic,
+		  const sample_t *src, int32 ofs, int32 incr, int32 n)
+{
+  INTERPVARS;
+  int32 s;
+
+  while (n--)
+    {
+      if (cubic)
+	s = rs_cubic(src, ofs);
+      else
+	{
+	  v1=src[ofs>>FRACTION_BITS];
+	  v2=src[(ofs>>FRACTION_BITS)+1];
+	  s = (resample_t)(v1 + (((v2-v1) * (ofs & FRACTION_MASK)) >> FRACTION_BITS));
+	}
+      ofs += incr;
+      switch (channels)	/* each case falls through */
+	{
+	case 6:
+	  lp[5] += gain[5] * s;
+	  lp[4] += gain[4] * s;
+	case 4:
+	  lp[3] += gain[3] * s;
+	  lp[2] += gain[2] * s;
+	case 2:
+	  lp[1] += gain[1] * s;
+	case 1:
+	  lp[0] += gain[0] * s;
+	}
+      lp += channels;
+    }
+}
+
+#ifdef RESAMPLE_SSE2
+/* Two neighbouring points, src[0] in the low half */
+static __inline__ int32 rs_pair(const sample_t *src)
+{
+  int32 p;
+  memcpy(&p, src, sizeof(p));
+  return p;
+}
+
+static __inline__ int32 rs_pair_before(const sample_t *src, int32 i)
+{
+  if (i)
+    return rs_pair(src + i - 1);
+  return (int32)((uint32)(uint16)src[0] | ((uint32)(uint16)src[0] << 16));
+}
+
+/* The SSE2 and AVX2 kernels interpolate 4 or 8 points at a time with
+   pmaddwd, weighting each pair of points with (1 - frac, frac), which
+   gives exactly what mix_c() does.  Points times gains are also done
+   with pmaddwd, so the gains must fit in 15 bits.  They return how many
+   points they did; mix_c() does the rest. */
+#define CUBIC_ROW(o) \
+  ((const __m128i *)cubic_table[((o) & FRACTION_MASK) >> \
+				(FRACTION_BITS - CUBIC_PHASE_BITS)])
+
+static int32 mix_sse2(int32 *lp, const int32 *gain, int channels, int cubic,
+		      const sample_t *src, int32 ofs, int32 incr, int32 n)
+{
+  __m128i g[6], s, a, b, w;
+  const __m128i mask = _mm_set1_epi32(FRACTION_MASK);
+  const __m128i one = _mm_set1_epi32(1 << FRACTION_BITS);
+  const __m128i round = _mm_set1_epi32(1 << (CUBIC_BITS - 1));
+  int32 i, o1, o2, o3, gx[24];
+  int k, c;
+
+  /* Four points make channels vectors of output */
+  for (k = c = 0; k < 4 * channels; k++)
+    {
+      gx[k] = gain[c];
+      if (++c == channels)
+	c = 0;
+    }
+  for (k = 0; k < channels; k++)
+    g[k] = _mm_loadu_si128((const __m128i *)gx + k);
+
+  for (i = 0; i + 4 <= n; i += 4)
+    {
+      o1 = ofs + incr;
+      o2 = o1 + incr;
+      o3 = o2 + incr;
+      if (!cubic)
+	{
+	  a = _mm_setr_epi32(rs_pair(src + (ofs >> FRACTION_BITS)),
+			     rs_pair(src + (o1 >> FRACTION_BITS)),
+			     rs_pair(src + (o2 >> FRACTION_BITS)),
+			     rs_pair(src + (o3 >> FRACTION_BITS)));
+	  w = _mm_and_si128(_mm_setr_epi32(ofs, o1, o2, o3), mask);
+	  w = _mm_or_si128(_mm_sub_epi32(one, w), _mm_slli_epi32(w, 16));
+	  s = _mm_srai_epi32(_mm_madd_epi16(a, w), FRACTION_BITS);
+	}
+      else
+	{
+	  a = _mm_setr_epi32(rs_pair_before(src, ofs >> FRACTION_BITS),
+			     rs_pair_before(src, o1 >> FRACTION_BITS),
+			     rs_pair_before(src, o2 >> FRACTION_BITS),
+			     rs_pair_before(src, o3 >> FRACTION_BITS));
+	  b = _mm_setr_epi32(rs_pair(src + (ofs >> FRACTION_BITS) + 1),
+			     rs_pair(src + (o1 >> FRACTION_BITS) + 1),
+			     rs_pair(src + (o2 >> FRACTION_BITS) + 1),
+			     rs_pair(src + (o3 >> FRACTION_BITS) + 1));
+	  /* Each row of the table is a (w0 w1) and a (w2 w3) pair */
+	  w = _mm_unpacklo_epi32(_mm_loadl_epi64(CUBIC_ROW(ofs)),
+				 _mm_loadl_epi64(CUBIC_ROW(o1)));
+	  s = _mm_unpacklo_epi32(_mm_loadl_epi64(CUBIC_ROW(o2)),
+				 _mm_loadl_epi64(CUBIC_ROW(o3)));
+	  s = _mm_add_epi32(_mm_madd_epi16(a, _mm_unpacklo_epi64(w, s)),
+			    _mm_madd_epi16(b, _mm_unpackhi_epi64(w, s)));
+	  s = _mm_srai_epi32(_mm_add_epi32(s, round), CUBIC_BITS);
+	  s = _mm_packs_epi32(s, s);
+	  s = _mm_srai_epi32(_mm_unpacklo_epi16(s, s), 16);
+	}
+      ofs = o3 + incr;
+
+#define MIX4(k, x) \
+      _mm_storeu_si128((__m128i *)lp + (k), \
+		       _mm_add_epi32(_mm_loadu_si128((__m128i *)lp + (k)), \
+				     _mm_madd_epi16((x), g[k])))
+      switch (channels)
+	{
+	case 1:
+	  MIX4(0, s);
+	  break;
+	case 2:
+	  MIX4(0, _mm_unpacklo_epi32(s, s));
+	  MIX4(1, _mm_unpackhi_epi32(s, s));
+	  break;
+	case 4:
+	  MIX4(0, _mm_shuffle_epi32(s, 0x00));
+	  MIX4(1, _mm_shuffle_epi32(s, 0x55));
+	  MIX4(2, _mm_shuffle_epi32(s, 0xAA));
+	  MIX4(3, _mm_shuffle_epi32(s, 0xFF));
+	  break;
+	case 6:
+	  MIX4(0, _mm_shuffle_epi32(s, 0x00));
+	  MIX4(1, _mm_unpacklo_epi32(s, s));
+	  MIX4(2, _mm_shuffle_epi32(s, 0x55));
+	  MIX4(3, _mm_shuffle_epi32(s, 0xAA));
+	  MIX4(4, _mm_unpackhi_epi32(s, s));
+	  MIX4(5, _mm_shuffle_epi32(s, 0xFF));
+	  break;
+	}
+#undef MIX4
+      lp += 4 * channels;
+    }
+  return i;
+}
+#endif /* RESAMPLE_SSE2 */
+
+#ifdef RESAMPLE_AVX2
+static TARGET_AVX2 int32 mix_avx2(int32 *lp, const int32 *gain, int channels,
+				  int cubic, const sample_t *src, int32 ofs,
+				  int32 incr, int32 n)
+{
+  __m256i g[6], perm[6], s, a, b, f, idx, o;
+  const __m256i mask = _mm256_set1_epi32(FRACTION_MASK);
+  const __m256i one = _mm256_set1_epi32(1 << FRACTION_BITS);
+  const __m256i round = _mm256_set1_epi32(1 << (CUBIC_BITS - 1));
+  const __m256i zero = _mm256_setzero_si256();
+  const __m256i first = _mm256_set1_epi32(rs_pair_before(src, 0));
+  const __m256i step = _mm256_set1_epi32(8 * incr);
+  int32 i, gx[48], px[48];
+  int k, c, p;
+
+  /* Eight points make channels vectors of output; perm[] spreads the
+     points over them */
+  for (k = c = p = 0; k < 8 * channels; k++)
+    {
+      gx[k] = gain[c];
+      px[k] = p;
+      if (++c == channels)
+	{
+	  c = 0;
+	  p++;
+	}
+    }
+  for (k = 0; k < channels; k++)
+    {
+      g[k] = _mm256_loadu_si256((const __m256i *)gx + k);
+      perm[k] = _mm256_loadu_si256((const __m256i *)px + k);
+    }
+  for (k = 0; k < 8; k++)
+    gx[k] = ofs + k * incr;
+  o = _mm256_loadu_si256((const __m256i *)gx);
+
+  for (i = 0; i + 8 <= n; i += 8)
+    {
+      idx = _mm256_srli_epi32(o, FRACTION_BITS);
+      f = _mm256_and_si256(o, mask);
+      o = _mm256_add_epi32(o, step);
+      if (!cubic)
+	{
+	  a = _mm256_i32gather_epi32((const int *)src, idx, 2);
+	  f = _mm256_or_si256(_mm256_sub_epi32(one, f),
+			      _mm256_slli_epi32(f, 16));
+	  s = _mm256_srai_epi32(_mm256_madd_epi16(a, f), FRACTION_BITS);
+	}
+      else
+	{
+	  a = _mm256_i32gather_epi32((const int *)src,
+		_mm256_max_epi32(_mm256_sub_epi32(idx, _mm256_set1_epi32(1)),
+				 zero), 2);
+	  a = _mm256_blendv_epi8(a, first, _mm256_cmpeq_epi32(idx, zero));
+	  b = _mm256_i32gather_epi32((const int *)src,
+		_mm256_add_epi32(idx, _mm256_set1_epi32(1)), 2);
+	  /* Each row of the table is a (w0 w1) and a (w2 w3) pair */
+	  f = _mm256_slli_epi32(
+		_mm256_srli_epi32(f, FRACTION_BITS - CUBIC_PHASE_BITS), 1);
+	  s = _mm256_add_epi32(
+		_mm256_madd_epi16(a,
+		  _mm256_i32gather_epi32((const int *)cubic_table, f, 4)),
+		_mm256_madd_epi16(b,
+		  _mm256_i32gather_epi32((const int *)cubic_table,
+		    _mm256_add_epi32(f, _mm256_set1_epi32(1)), 4)));
+	  s = _mm256_srai_epi32(_mm256_add_epi32(s, round), CUBIC_BITS);
+	  s = _mm256_max_epi32(_mm256_min_epi32(s, _mm256_set1_epi32(32767)),
+			       _mm256_set1_epi32(-32768));
+	}
+      for (k = 0; k < channels; k++)
+	_mm256_storeu_si256((__m256i *)lp + k,
+	  _mm256_add_epi32(_mm256_loadu_si256((__m256i *)lp + k),
+	    _mm256_madd_epi16(_mm256_permutevar8x32_epi32(s, perm[k]), g[k])));
+      lp += 8 * channels;
+    }
+  return i;
+}
+#endif /* RESAMPLE_AVX2 */
+
+/* Mixes n points with the fastest kernel simd (0 for C, 1 for SSE2,
+   2 for AVX2) allows, finishing off with the slower ones */
+static void mix_points(int simd, int32 *lp, const int32 *gain, int channels,
+		       int cubic, const sample_t *src, int32 ofs, int32 incr,
+		       int32 n)
+{
+  int32 done = 0;
+
+#ifdef RESAMPLE_AVX2
+  if (simd == 2)
+    done = mix_avx2(lp, gain, channels, cubic, src, ofs, incr, n);
+#endif
+#ifdef RESAMPLE_SSE2
+  /* Also picks up 4 of what's left after the AVX2 kernel */
+  if (simd)
+    done += mix_sse2(lp + done * channels, gain, channels, cubic, src,
+		     ofs + done * incr, incr, n - done);
+#endif
+  mix_c(lp + done * channels, gain, channels, cubic, src,
+	ofs + done * incr, incr, n - done);
+}
+
+/* Mixes n points, recomputing the gains as the control counter runs
+   out, the way mix_*_signal() used to */
+static void mix_span(ResampleOut *out, const sample_t *src, int32 ofs,
+		     int32 incr, int32 n)
+{
+  int32 m;
+  int c;
+
+  while (n > 0 && !out->dead)
+    {
+      m = n;
+      if (out->update)
+	{
+	  if (!out->cc)
+	    {
+	      out->cc = control_ratio;
+	      if (out->update(out->song, out->v, out->gain))
+		{
+		  out->dead = 1;	/* Envelope ran out */
+		  return;
+		}
+	    }
+	  if (m > out->cc)
+	    m = out->cc;
+	  out->cc -= m;
+	}
+
+      /* The vector kernels need gains that fit in 15 bits */
+      for (c = 0; c < out->channels; c++)
+	if (out->gain[c] < 0 || out->gain[c] > 32767)
+	  break;
+      mix_points((c == out->channels) ? out->simd : 0, out->lp, out->gain,
+		 out->channels, out->cubic, src, ofs, incr, m);
+
+      out->lp += m * out->channels;
+      ofs += m * incr;
+      n -= m;
+    }
+}
+#endif /* RESAMPLE_MIX */
+
+#ifdef PRECALC_LOOPS
+/* Resamples n points starting from ofs */
+static void rs_span(ResampleOut *out, sample_t *src, int32 ofs, int32 incr,
+		    int32 n)
+{
+  INTERPVARS;
+  resample_t *dest=out->dest;
+
+  if (n <= 0)
+    return;
+#ifdef RESAMPLE_MIX
+  if (!dest)
+    {
+      mix_span(out, src, ofs, incr, n);
+      return;
+    }
+  if (out->cubic)
+    while (n--)
+      {
+	*dest++ = (resample_t)rs_cubic(src, ofs);
+	ofs += incr;
+      }
+  else
+#endif
+  while (n--)
+    {
+      RESAMPLATION;
+      ofs += incr;
+    }
+  out->dest = dest;
+}
+#endif /* PRECALC_LOOPS */
 
 /*************** resampling with fixed increment *****************/
 
-static resample_t *rs_plain(int v, int32 *countptr)
+static void rs_plain(MidiSong *song, int v, int32 *countptr, ResampleOut *out)
 {
 
   /* Play sample until end, then free the voice. */
 
-  INTERPVARS;
+  RSVARS;
   Voice 
-    *vp=&voice[v];
-  resample_t 
-    *dest=resample_buffer;
+    *vp=&song->voice[v];
   sample_t 
     *src=vp->sample->data;
   int32 
@@ -65,7 +456,7 @@ static resample_t *rs_plain(int v, int32 *countptr)
     count=*countptr;
 
 #ifdef PRECALC_LOOPS
-  int32 i, j;
+  int32 i;
 
   if (incr<0) incr = -incr; /* In case we're coming out of a bidir loop */
 
@@ -80,19 +471,17 @@ static resample_t *rs_plain(int v, int32 *countptr)
     } 
   else count -= i;
 
-  for(j = 0; j < i; j++)
-    {
-      RESAMPLATION;
-      ofs += incr;
-    }
-
-  if (ofs >= le) 
+  if (ofs + i * incr >= le)
     {
-      FINALINTERP;
+      /* The last point isn't played, only ramp_out() may look at it */
       vp->status=VOICE_FREE;
       ctl->note(v);
       *countptr-=count+1;
+      rs_span(out, src, ofs, incr, out->dest ? i : i - 1);
     }
+  else
+    rs_span(out, src, ofs, incr, i);
+  ofs += i * incr;
 
 #else /* PRECALC_LOOPS */
     while (count--)
@@ -111,29 +500,26 @@ static resample_t *rs_plain(int v, int32 *countptr)
 #endif /* PRECALC_LOOPS */
   
   vp->sample_offset=ofs; /* Update offset */
-  return resample_buffer;
 }
 
-static resample_t *rs_loop(Voice *vp, int32 count)
+static void rs_loop(Voice *vp, int32 count, ResampleOut *out)
 {
 
   /* Play sample until end-of-loop, skip back and continue. */
 
-  INTERPVARS;
+  RSVARS;
   int32 
     ofs=vp->sample_offset, 
     incr=vp->sample_increment,
     le=vp->sample->loop_end, 
     ll=le - vp->sample->loop_start;
-  resample_t
-    *dest=resample_buffer;
   sample_t
     *src=vp->sample->data;
 
 #ifdef PRECALC_LOOPS
   int32 i;
  
-  if (ofs < 0 || le < 0) return resample_buffer;
+  if (ofs < 0 || le < 0) return;
 
   while (count) 
     {
@@ -149,10 +535,9 @@ static resample_t *rs_loop(Voice *vp, int32 count)
 	} 
       else count -= i;
       if (i > 0)
-      while (i--) 
 	{
-	  RESAMPLATION;
-	  ofs += incr;
+	  rs_span(out, src, ofs, incr, i);
+	  ofs += i * incr;
 	}
     }
 #else
@@ -166,19 +551,16 @@ static resample_t *rs_loop(Voice *vp, int32 count)
 #endif
 
   vp->sample_offset=ofs; /* Update offset */
-  return resample_buffer;
 }
 
-static resample_t *rs_bidir(Voice *vp, int32 count)
+static void rs_bidir(Voice *vp, int32 count, ResampleOut *out)
 {
-  INTERPVARS;
+  RSVARS;
   int32 
     ofs=vp->sample_offset,
     incr=vp->sample_increment,
     le=vp->sample->loop_end,
     ls=vp->sample->loop_start;
-  resample_t 
-    *dest=resample_buffer; 
   sample_t 
     *src=vp->sample->data;
 
@@ -201,11 +583,8 @@ static resample_t *rs_bidir(Voice *vp, int32 count)
 	  count = 0;
 	} 
       else count -= i;
-      while (i--) 
-	{
-	  RESAMPLATION;
-	  ofs += incr;
-	}
+      rs_span(out, src, ofs, incr, i);
+      ofs += i * incr;
     }
 
   /* Then do the bidirectional looping */
@@ -220,11 +599,8 @@ static resample_t *rs_bidir(Voice *vp, int32 count)
 	  count = 0;
 	} 
       else count -= i;
-      while (i--) 
-	{
-	  RESAMPLATION;
-	  ofs += incr;
-	}
+      rs_span(out, src, ofs, incr, i);
+      ofs += i * incr;
       if (ofs>=le) 
 	{
 	  /* fold the overshoot back in */
@@ -274,7 +650,6 @@ static resample_t *rs_bidir(Voice *vp, int32 count)
 #endif /* PRECALC_LOOPS */
   vp->sample_increment=incr;
   vp->sample_offset=ofs; /* Update offset */
-  return resample_buffer;
 }
 
 /*********************** vibrato versions ***************************/
@@ -354,15 +729,14 @@ static int32 update_vibrato(Voice *vp, int sign)
   return (int32) a;
 }
 
-static resample_t *rs_vib_plain(int v, int32 *countptr)
+static void rs_vib_plain(MidiSong *song, int v, int32 *countptr,
+			 ResampleOut *out)
 {
 
   /* Play sample until end, then free the voice. */
 
-  INTERPVARS;
-  Voice *vp=&voice[v];
-  resample_t 
-    *dest=resample_buffer; 
+  RSVARS;
+  Voice *vp=&song->voice[v];
   sample_t 
     *src=vp->sample->data;
   int32 
@@ -375,6 +749,40 @@ static resample_t *rs_vib_plain(int v, int32 *countptr)
 
   /* This has never been tested */
 
+#ifdef PRECALC_LOOPS
+  int32 i, j;
+
+  if (incr<0) incr = -incr; /* In case we're coming out of a bidir loop */
+
+  while (count)
+    {
+      /* Same as below: the increment changes on the point where cc
+	 runs out, and holds for that one and the next ratio points */
+      if (!cc)
+	{
+	  cc=vp->vibrato_control_ratio+1;
+	  incr=update_vibrato(vp, 0);
+	}
+      i = (cc < count) ? cc : count;
+      /* The first point after which ofs >= le is the last */
+      j = (ofs < le) ? (le - ofs - 1) / incr + 1 : 1;
+      if (j <= i)
+	{
+	  rs_span(out, src, ofs, incr, j);
+	  ofs += j * incr;
+	  cc -= j;
+	  vp->status=VOICE_FREE;
+	  ctl->note(v);
+	  *countptr-=count-j+1;
+	  break;
+	}
+      rs_span(out, src, ofs, incr, i);
+      ofs += i * incr;
+      cc -= i;
+      count -= i;
+    }
+
+#else /* PRECALC_LOOPS */
   if (incr<0) incr = -incr; /* In case we're coming out of a bidir loop */
 
   while (count--)
@@ -395,26 +803,24 @@ static resample_t *rs_vib_plain(int v, int32 *countptr)
 	  break;
 	}
     }
+#endif /* PRECALC_LOOPS */
   
   vp->vibrato_control_counter=cc;
   vp->sample_increment=incr;
   vp->sample_offset=ofs; /* Update offset */
-  return resample_buffer;
 }
 
-static resample_t *rs_vib_loop(Voice *vp, int32 count)
+static void rs_vib_loop(Voice *vp, int32 count, ResampleOut *out)
 {
 
   /* Play sample until end-of-loop, skip back and continue. */
   
-  INTERPVARS;
+  RSVARS;
   int32 
     ofs=vp->sample_offset, 
     incr=vp->sample_increment, 
     le=vp->sample->loop_end,
     ll=le - vp->sample->loop_start;
-  resample_t 
-    *dest=resample_buffer; 
   sample_t 
     *src=vp->sample->data;
   int 
@@ -441,11 +847,8 @@ static resample_t *rs_vib_loop(Voice *vp, int32 count)
 	} 
       else cc -= i;
       count -= i;
-      while(i--) 
-	{
-	  RESAMPLATION;
-	  ofs += incr;
-	}
+      rs_span(out, src, ofs, incr, i);
+      ofs += i * incr;
       if(vibflag) 
 	{
 	  cc = vp->vibrato_control_ratio;
@@ -472,19 +875,16 @@ static resample_t *rs_vib_loop(Voice *vp, int32 count)
   vp->vibrato_control_counter=cc;
   vp->sample_increment=incr;
   vp->sample_offset=ofs; /* Update offset */
-  return resample_buffer;
 }
 
-static resample_t *rs_vib_bidir(Voice *vp, int32 count)
+static void rs_vib_bidir(Voice *vp, int32 count, ResampleOut *out)
 {
-  INTERPVARS;
+  RSVARS;
   int32 
     ofs=vp->sample_offset, 
     incr=vp->sample_increment,
     le=vp->sample->loop_end, 
     ls=vp->sample->loop_start;
-  resample_t 
-    *dest=resample_buffer; 
   sample_t 
     *src=vp->sample->data;
   int 
@@ -510,11 +910,8 @@ static resample_t *rs_vib_bidir(Voice *vp, int32 count)
 	} 
       else cc -= i;
       count -= i;
-      while (i--) 
-	{
-	  RESAMPLATION;
-	  ofs += incr;
-	}
+      rs_span(out, src, ofs, incr, i);
+      ofs += i * incr;
       if (vibflag) 
 	{
 	  cc = vp->vibrato_control_ratio;
@@ -537,11 +934,8 @@ static resample_t *rs_vib_bidir(Voice *vp, int32 count)
 	} 
       else cc -= i;
       count -= i;
-      while (i--) 
-	{
-	  RESAMPLATION;
-	  ofs += incr;
-	}
+      rs_span(out, src, ofs, incr, i);
+      ofs += i * incr;
       if (vibflag) 
 	{
 	  cc = vp->vibrato_control_ratio;
@@ -609,14 +1003,54 @@ static resample_t *rs_vib_bidir(Voice *vp, int32 count)
   vp->vibrato_control_counter=cc;
   vp->sample_increment=incr;
   vp->sample_offset=ofs; /* Update offset */
-  return resample_buffer;
 }
 
-resample_t *resample_voice(int v, int32 *countptr)
+static int rs_looping(Voice *vp)
+{
+  uint8 modes=vp->sample->modes;
+
+  return (modes & MODES_LOOPING) &&
+    ((modes & MODES_ENVELOPE) ||
+     (vp->status==VOICE_ON || vp->status==VOICE_SUSTAINED));
+}
+
+/* Need to resample. Use the proper function. */
+static void rs_voice(MidiSong *song, int v, int32 *countptr, ResampleOut *out)
+{
+  Voice *vp=&song->voice[v];
+
+  if (vp->vibrato_control_ratio)
+    {
+      if (rs_looping(vp))
+	{
+	  if (vp->sample->modes & MODES_PINGPONG)
+	    rs_vib_bidir(vp, *countptr, out);
+	  else
+	    rs_vib_loop(vp, *countptr, out);
+	}
+      else
+	rs_vib_plain(song, v, countptr, out);
+    }
+  else
+    {
+      if (rs_looping(vp))
+	{
+	  if (vp->sample->modes & MODES_PINGPONG)
+	    rs_bidir(vp, *countptr, out);
+	  else
+	    rs_loop(vp, *countptr, out);
+	}
+      else
+	rs_plain(song, v, countptr, out);
+    }
+}
+
+resample_t *resample_voice(MidiSong *song, resample_t *rbuf, int v,
+			   int32 *countptr)
 {
   int32 ofs;
-  uint8 modes;
-  Voice *vp=&voice[v];
+  Voice *vp=&song->voice[v];
+  ResampleOut out;
   
   if (!(vp->sample->sample_rate))
     {
@@ -639,38 +1073,60 @@ resample_t *resample_voice(int v, int32 *countptr)
       return (resample_t *)vp->sample->data+ofs;
     }
 
-  /* Need to resample. Use the proper function. */
-  modes=vp->sample->modes;
+  out.dest=rbuf;
+  out.cubic=song->cubic;
+  rs_voice(song, v, countptr, &out);
+  return rbuf;
+}
 
-  if (vp->vibrato_control_ratio)
-    {
-      if ((modes & MODES_LOOPING) &&
-	  ((modes & MODES_ENVELOPE) ||
-	   (vp->status==VOICE_ON || vp->status==VOICE_SUSTAINED)))
-	{
-	  if (modes & MODES_PINGPONG)
-	    return rs_vib_bidir(vp, *countptr);
-	  else
-	    return rs_vib_loop(vp, *countptr);
-	}
-      else
-	return rs_vib_plain(v, countptr);
-    }
+#ifdef RESAMPLE_MIX
+void resample_mix(MidiSong *song, resample_t *rbuf, int v, int32 count,
+		  int32 *lp, int channels, int32 *gain, ResampleGains update)
+{
+  Voice *vp=&song->voice[v];
+  resample_t *sp;
+  ResampleOut out;
+
+  out.dest=NULL;
+  out.cubic=song->cubic;
+  out.lp=lp;
+  out.gain=gain;
+  out.channels=channels;
+#ifdef RESAMPLE_AVX2
+  if (SDL_HasAVX2())
+    out.simd=2;
+  else
+#endif
+#ifdef RESAMPLE_SSE2
+  if (SDL_HasSSE2())
+    out.simd=1;
   else
+#endif
+    out.simd=0;
+  out.dead=0;
+  out.cc=vp->control_counter;
+  out.update=update;
+  out.song=song;
+  out.v=v;
+
+  if (!vp->sample->sample_rate ||
+      (vp->vibrato_control_ratio && !rs_looping(vp)))
     {
-      if ((modes & MODES_LOOPING) &&
-	  ((modes & MODES_ENVELOPE) ||
-	   (vp->status==VOICE_ON || vp->status==VOICE_SUSTAINED)))
-	{
-	  if (modes & MODES_PINGPONG)
-	    return rs_bidir(vp, *countptr);
-	  else
-	    return rs_loop(vp, *countptr);
-	}
-      else
-	return rs_plain(v, countptr);
+      /* Pre-resampled data only needs mixing.  rs_vib_plain() may
+	 free the voice partway, and the envelope has always seen that
+	 from the first point on, so it fills the buffer first too. */
+      sp=resample_voice(song, rbuf, v, &count);
+      if (count<0) return;
+      out.cubic=0;
+      mix_span(&out, sp, 0, 1<<FRACTION_BITS, count);
     }
+  else
+    rs_voice(song, v, &count, &out);
+
+  if (update && !out.dead)
+    vp->control_counter=out.cc;
 }
+#endif /* RESAMPLE_MIX */
 
 void pre_resample(Sample * sp)
 {
@@ -693,7 +1149,7 @@ void pre_resample(Sample * sp)
   if (a <= 0) return;
   newlen = (int32)(sp->data_length / a);
   if (newlen < 0 || (newlen >> FRACTION_BITS) > MAX_SAMPLE_SIZE) return;
-  dest = newdata = safe_malloc(newlen >> (FRACTION_BITS - 1));
+  dest = newdata = safe_malloc((newlen >> (FRACTION_BITS - 1)) + 4);
 
   count = (newlen >> FRACTION_BITS) - 1;
   ofs = incr = (sp->data_length - (1 << FRACTION_BITS)) / count;
@@ -725,6 +1181,11 @@ void pre_resample(Sample * sp)
   else
     *dest++ = src[ofs >> FRACTION_BITS];
 
+  /* Clear the rest, and the guard points after the end that are read
+     while interpolating, so they don't depend on what the heap held */
+  while (dest < newdata + (newlen >> FRACTION_BITS) + 2)
+    *dest++ = 0;
+
   sp->data_length = newlen;
   sp->loop_start = (int32)(sp->loop_start / a);
   sp->loop_end = (int32)(sp->loop_end / a);
@@ -732,3 +1193,113 @@ void pre_resample(Sample * sp)
   sp->data = (sample_t *) newdata;
   sp->sample_rate = 0;
 }
+
+#if defined(TEST_MAIN) && defined(RESAMPLE_MIX)
+
+#include <time.h>
+
+/* Mix random samples with the C, SSE2 and AVX2 kernels the way a voice
+   is mixed at 44.1 kHz, control_ratio points at a time, check that
+   they add up to the same, and time them. */
+
+#define TEST_POINTS 1024
+#define TEST_SPAN 44
+
+static sample_t test_src[TEST_POINTS * 4 + 4];
+static int32 test_lp[3][TEST_POINTS * 6];
+
+static void test_mix(int simd, int32 *lp, const int32 *gain, int channels,
+		     int cubic, int32 incr, int span)
+{
+  int32 i, n, ofs = 0;
+
+  for (i = 0; i < TEST_POINTS; i += n)
+    {
+      n = TEST_POINTS - i;
+      if (n > span)
+	n = span;
+      mix_points(simd, lp + i * channels, gain, channels, cubic, test_src,
+		 ofs, incr, n);
+      ofs += n * incr;
+    }
+}
+
+/* Points a second through the kernels simd allows */
+static double time_mix(int simd, const int32 *gain, int channels,
+		       int cubic, int32 incr)
+{
+  clock_t start;
+  int runs = 0;
+
+  start = clock();
+  do
+    {
+      /* Cleared each time, or the sums would overflow */
+      memset(test_lp[simd], 0, sizeof(test_lp[simd]));
+      test_mix(simd, test_lp[simd], gain, channels, cubic, incr, TEST_SPAN);
+      runs++;
+    }
+  while (clock() - start < CLOCKS_PER_SEC / 4);
+  return (double)TEST_POINTS * runs * CLOCKS_PER_SEC / (clock() - start);
+}
+
+/* Every span length, so each kernel leaves every possible tail */
+static int compare_mix(int simd, const int32 *gain, int channels, int cubic,
+		       int32 incr)
+{
+  int span;
+
+  for (span = 1; span <= TEST_SPAN; span++)
+    {
+      memset(test_lp[0], 0, sizeof(test_lp[0]));
+      memset(test_lp[simd], 0, sizeof(test_lp[simd]));
+      test_mix(0, test_lp[0], gain, channels, cubic, incr, span);
+      test_mix(simd, test_lp[simd], gain, channels, cubic, incr, span);
+      if (memcmp(test_lp[0], test_lp[simd], sizeof(test_lp[0])))
+	return 0;
+    }
+  return 1;
+}
+
+int main(int argc, char *argv[])
+{
+  static const int channels[] = { 1, 2, 4, 6 };
+  static const double steps[] = { 0.749, 1.0, 1.498 };
+  int32 gain[6], incr;
+  int i, c, k, cubic;
+
+  init_tables();
+  srand(1);
+  for (i = 0; i < (int)(sizeof(test_src) / sizeof(test_src[0])); i++)
+    test_src[i] = (sample_t)(((rand() & 0xFF) << 8) | (rand() & 0xFF));
+  for (i = 0; i < 6; i++)
+    gain[i] = rand() & 0x7FFF;
+
+  for (cubic = 0; cubic < 2; cubic++)
+    for (c = 0; c < (int)(sizeof(channels) / sizeof(channels[0])); c++)
+      for (k = 0; k < (int)(sizeof(steps) / sizeof(steps[0])); k++)
+	{
+	  incr = (int32)(steps[k] * (1 << FRACTION_BITS));
+	  printf("%-6s %d channels, step %.3f: C %6.1f",
+		 cubic ? "cubic" : "linear", channels[c], steps[k],
+		 time_mix(0, gain, channels[c], cubic, incr) / 1e6);
+#ifdef RESAMPLE_SSE2
+	  if (SDL_HasSSE2())
+	    printf(", SSE2 %6.1f %s",
+		   time_mix(1, gain, channels[c], cubic, incr) / 1e6,
+		   compare_mix(1, gain, channels[c], cubic, incr) ?
+		   "(identical)" : "(failed)");
+#endif
+#ifdef RESAMPLE_AVX2
+	  if (SDL_HasAVX2())
+	    printf(", AVX2 %6.1f %s",
+		   time_mix(2, gain, channels[c], cubic, incr) / 1e6,
+		   compare_mix(2, gain, channels[c], cubic, incr) ?
+		   "(identical)" : "(failed)");
+#endif
+	  printf(" Mpoints/s\n");
+	}
+  return 0;
+}
+
+#endif /* TEST_MAIN */
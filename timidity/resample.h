@@ -6,5 +6,26 @@
     it under the terms of the Perl Artistic License, available in COPYING.
  */
 
-extern resample_t *resample_voice(int v, int32 *countptr);
+/* rbuf is the AUDIO_BUFFER_SIZE scratch buffer to resample into, either
+   song->resample_buffer or the mixing thread's own */
+extern resample_t *resample_voice(MidiSong *song, resample_t *rbuf, int v,
+				  int32 *countptr);
 extern void pre_resample(Sample *sp);
+
+/* The precalculated loops can resample straight into the mixing buffer,
+   without going through song->resample_buffer first. */
+#if defined(PRECALC_LOOPS) && defined(LINEAR_INTERPOLATION) && \
+    !defined(LOOKUP_HACK)
+#define RESAMPLE_MIX
+
+/* Recomputes the gains every control_ratio samples; returns 1 if the
+   note died */
+typedef int (*ResampleGains)(MidiSong *song, int v, int32 *gain);
+
+/* Resamples count samples of voice v and adds them, times gain[],
+   to the channels interleaved in lp.  If update is set it is called
+   whenever song->voice[v].control_counter runs out. */
+extern void resample_mix(MidiSong *song, resample_t *rbuf, int v,
+			 int32 count, int32 *lp, int channels, int32 *gain,
+			 ResampleGains update);
+#endif
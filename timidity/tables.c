@@ -6,6 +6,7 @@
     it under the terms of the Perl Artistic License, available in COPYING.
  */
 
+#include <math.h>
 #include <stdio.h>
 #include "config.h"
 #include "common.h"
@@ -369,6 +370,30 @@ int8 *iplookup;
 
 #endif
 
+/* 4-point Lagrange weights for the samples at -1, 0, 1 and 2, scaled by
+   2^CUBIC_BITS.  Each row sums to exactly 2^CUBIC_BITS, so constant
+   input comes out unchanged. */
+int16 cubic_table[1<<CUBIC_PHASE_BITS][4];
+
+static void init_cubic_table(void)
+{
+  int i;
+  double x;
+  int32 c0, c2, c3;
+
+  for (i=0; i<(1<<CUBIC_PHASE_BITS); i++)
+    {
+      x = (double)i / (1<<CUBIC_PHASE_BITS);
+      c0 = (int32)floor(-x*(x-1)*(x-2)/6 * (1<<CUBIC_BITS) + 0.5);
+      c2 = (int32)floor(-(x+1)*x*(x-2)/2 * (1<<CUBIC_BITS) + 0.5);
+      c3 = (int32)floor((x+1)*x*(x-1)/6 * (1<<CUBIC_BITS) + 0.5);
+      cubic_table[i][0] = (int16)c0;
+      cubic_table[i][1] = (int16)((1<<CUBIC_BITS) - c0 - c2 - c3);
+      cubic_table[i][2] = (int16)c2;
+      cubic_table[i][3] = (int16)c3;
+    }
+}
+
 void init_tables(void)
 {
 #ifdef LOOKUP_HACK
@@ -394,6 +419,7 @@ void init_tables(void)
 #endif
 
 #endif
+  init_cubic_table();
 }
 
 uint8 _l2u_[] =
@@ -29,6 +29,13 @@ extern int8 *iplookup;
 #endif
 #endif
 
+
+/* Cubic interpolation weights, looked up by the top CUBIC_PHASE_BITS of
+   the sample offset's fraction */
+#define CUBIC_PHASE_BITS 8
+#define CUBIC_BITS 14
+extern int16 cubic_table[1<<CUBIC_PHASE_BITS][4];
+
 extern void init_tables(void);
 
 #define XMAPMAX 800
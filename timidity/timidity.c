@@ -14,6 +14,7 @@
 #include "config.h"
 #include "common.h"
 #include "instrum.h"
+#include "cache.h"
 #include "playmidi.h"
 #include "readmidi.h"
 #include "output.h"
@@ -26,9 +27,11 @@ void (*s32tobuf)(void *dp, int32 *lp, int32 c);
 int free_instruments_afterwards=0;
 static char def_instr_name[256]="";
 
+/* Guards the tone banks, which are shared by every loaded song */
+SDL_mutex *bank_lock=NULL;
+
 int AUDIO_BUFFER_SIZE;
-resample_t *resample_buffer=NULL;
-int32 *common_buffer=NULL;
+int output_format;
 int num_ochannels;
 
 #define MAXWORDS 10
@@ -87,6 +90,17 @@ static int read_config_file(const char *name)
       read_config_file(w[i]);
         rcf_count--;
       }
+  }
+  else if (!strcmp(w[0], "cache"))
+  {
+    if (words != 2)
+      {
+        ctl->cmsg(CMSG_ERROR, VERB_NORMAL,
+          "%s: line %d: Must specify exactly one cache directory\n",
+          name, line);
+        return -2;
+      }
+    set_instrument_cache(w[1]);
   }
       else if (!strcmp(w[0], "default"))
   {
@@ -321,15 +335,19 @@ int Timidity_Init(int rate, int format, int channels, int samples)
     case AUDIO_U16MSB:
       s32tobuf = s32tou16b;
       break;
+    case AUDIO_F32SYS:
+      s32tobuf = s32tof32;
+      break;
     default:
       ctl->cmsg(CMSG_ERROR, VERB_NORMAL, "Unsupported audio format");
       return(-1);
   }
   AUDIO_BUFFER_SIZE = samples;
+  output_format = format;
 
-  /* Allocate memory for mixing (WARNING:  Memory leak!) */
-  resample_buffer = safe_malloc(AUDIO_BUFFER_SIZE*sizeof(resample_t)+100);
-  common_buffer = safe_malloc(AUDIO_BUFFER_SIZE*num_ochannels*sizeof(int32));
+  /* Mixing buffers are allocated per song in Timidity_LoadSong_RW */
+  if (!bank_lock)
+    bank_lock = SDL_CreateMutex();
 
   init_tables();
 
@@ -6,15 +6,44 @@
     it under the terms of the Perl Artistic License, available in COPYING.
  */
 
+#ifndef TIMIDITY_MIDISONG
+#define TIMIDITY_MIDISONG
 typedef struct _MidiSong MidiSong;
+#endif
 
+/* The output format is set once for all songs by Timidity_Init().  Songs
+   keep their own playback state, so several can be played at once, each
+   from a single thread. */
 extern int Timidity_Init(int rate, int format, int channels, int samples);
 extern const char *Timidity_Error(void);
-extern void Timidity_SetVolume(int volume);
-extern int Timidity_PlaySome(void *stream, int samples);
+extern void Timidity_SetVolume(MidiSong *song, int volume);
+
+/* Songs start out with linear interpolation.  Cubic costs more, and is
+   smoother on notes played far from their sample's root pitch. */
+#define TIMIDITY_INTERP_LINEAR	0
+#define TIMIDITY_INTERP_CUBIC	1
+extern void Timidity_SetInterpolation(MidiSong *song, int interpolation);
+
+/* Mixes a song's voices on up to threads threads, the calling one
+   included, when there are enough of them playing.  The output is the
+   same as with 1, the default. */
+extern void Timidity_SetThreads(MidiSong *song, int threads);
+
+/* Limits how many notes can sound at once.  Songs start out with
+   DEFAULT_VOICES, and can have up to MAX_VOICES (see config.h). */
+extern void Timidity_SetVoices(MidiSong *song, int voices);
+
+extern int Timidity_PlaySome(MidiSong *song, void *stream, int samples);
+
+/* Plays a started song through to its end as fast as it can be computed,
+   writing it to dst in the format given to Timidity_Init(), as a RIFF
+   WAVE file if wave is set or else as raw samples.  WAVE files only hold
+   AUDIO_U8, AUDIO_S16LSB and AUDIO_F32LSB.  Returns the number of sample
+   frames written, or -1 on error. */
+extern int Timidity_RenderSong(MidiSong *song, SDL_RWops *dst, int wave);
 extern MidiSong *Timidity_LoadSong_RW(SDL_RWops *rw, int freerw);
 extern void Timidity_Start(MidiSong *song);
-extern int Timidity_Active(void);
-extern void Timidity_Stop(void);
+extern int Timidity_Active(MidiSong *song);
+extern void Timidity_Stop(MidiSong *song);
 extern void Timidity_FreeSong(MidiSong *song);
 extern void Timidity_Close(void);